@@ -0,0 +1,118 @@
+#ifndef DataFormats_Provenance_ColumnarFileIndex_h
+#define DataFormats_Provenance_ColumnarFileIndex_h
+
+/*----------------------------------------------------------------------
+
+ColumnarFileIndex: A read-only copy of a FileIndex, the index found
+in files written before release 3_8_0, stored as separate arrays of
+run, lumi, event and entry numbers, with a directory of its runs and
+lumis.
+
+The elements are in the order of a FileIndex sorted by run, lumi and
+event, which is the order FileIndex is written in. The directory has
+one element for each run or lumi, giving the positions of its run or
+lumi elements and of its events. The find functions look up the
+directory and then search only the events of one lumi, so they never
+step over elements of other types. They find the same elements as the
+FileIndex functions with the same names, with positions in place of
+iterators and size() in place of end().
+
+fillIndexIntoFile converts the index directly into the runOrLumiEntries
+of an IndexIntoFile, already in the order sortVector_Run_Or_Lumi_Entries
+would give them. Only the runs and lumis are sorted, by their first
+entries; the events are placed with a single pass over the event entries.
+
+----------------------------------------------------------------------*/
+
+#include "DataFormats/Provenance/interface/FileIndex.h"
+#include "DataFormats/Provenance/interface/ProcessHistoryID.h"
+
+#include <vector>
+
+namespace edm {
+
+  class IndexIntoFile;
+
+  class ColumnarFileIndex {
+  public:
+    typedef FileIndex::EntryNumber_t EntryNumber_t;
+    typedef std::vector<RunNumber_t>::size_type size_type;
+
+    explicit ColumnarFileIndex(FileIndex const& fileIndex);
+
+    size_type size() const {return runs_.size();}
+    bool empty() const {return runs_.empty();}
+
+    RunNumber_t run(size_type i) const {return runs_[i];}
+    LuminosityBlockNumber_t lumi(size_type i) const {return lumis_[i];}
+    EventNumber_t event(size_type i) const {return events_[i];}
+    EntryNumber_t entry(size_type i) const {return entries_[i];}
+    FileIndex::EntryType getEntryType(size_type i) const {
+      return lumis_[i] == 0U ? FileIndex::kRun : (events_[i] == 0U ? FileIndex::kLumi : FileIndex::kEvent);
+    }
+
+    /// If lumi is 0, the lumis of the run are searched in order like FileIndex does.
+    size_type findEventPosition(RunNumber_t run, LuminosityBlockNumber_t lumi, EventNumber_t event) const;
+
+    size_type findLumiPosition(RunNumber_t run, LuminosityBlockNumber_t lumi) const;
+
+    size_type findRunPosition(RunNumber_t run) const;
+
+    bool
+    containsItem(RunNumber_t run, LuminosityBlockNumber_t lumi, EventNumber_t event) const {
+      return event ? containsEvent(run, lumi, event) : (lumi ? containsLumi(run, lumi) : containsRun(run));
+    }
+
+    bool
+    containsEvent(RunNumber_t run, LuminosityBlockNumber_t lumi, EventNumber_t event) const {
+      return findEventPosition(run, lumi, event) != size();
+    }
+
+    bool
+    containsLumi(RunNumber_t run, LuminosityBlockNumber_t lumi) const {
+      return findLumiPosition(run, lumi) != size();
+    }
+
+    bool
+    containsRun(RunNumber_t run) const {
+      return findRunPosition(run) != size();
+    }
+
+    /// Computed once by the constructor
+    bool allEventsInEntryOrder() const {return allEventsInEntryOrder_;}
+
+    size_type numberOfEvents() const {return numberOfEvents_;}
+
+    /// Fills an empty IndexIntoFile with the runs, lumis and event ranges of the
+    /// file, all with processHistoryID, and sets its number of events. Events with
+    /// consecutive entries in the same lumi form one event range. The event ranges
+    /// of a lumi use its first lumi entry, and any other lumi entries of the lumi
+    /// are added without events. Throws if a run or a lumi with events has no entry.
+    void fillIndexIntoFile(IndexIntoFile& indexIntoFile, ProcessHistoryID const& processHistoryID) const;
+
+  private:
+    // The elements of one run (lumi 0) or one lumi. Its run or lumi elements
+    // are at [begin_, beginEvents_) and its events, sorted by event number,
+    // at [beginEvents_, end_).
+    struct Group {
+      RunNumber_t run_;
+      LuminosityBlockNumber_t lumi_;
+      size_type begin_;
+      size_type beginEvents_;
+      size_type end_;
+    };
+
+    std::vector<Group>::const_iterator findGroup(RunNumber_t run, LuminosityBlockNumber_t lumi) const;
+    size_type findEventInGroup(Group const& group, EventNumber_t event) const;
+
+    std::vector<RunNumber_t> runs_;
+    std::vector<LuminosityBlockNumber_t> lumis_;
+    std::vector<EventNumber_t> events_;
+    std::vector<EntryNumber_t> entries_;
+    std::vector<Group> directory_;
+    size_type numberOfEvents_;
+    bool allEventsInEntryOrder_;
+  };
+}
+
+#endif
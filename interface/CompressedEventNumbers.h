@@ -0,0 +1,84 @@
+#ifndef DataFormats_Provenance_CompressedEventNumbers_h
+#define DataFormats_Provenance_CompressedEventNumbers_h
+
+/*----------------------------------------------------------------------
+
+CompressedEventNumbers: A read-only, bit packed copy of a vector
+of event numbers.
+
+The values are split into consecutive blocks of kBlockSize elements.
+Each block stores the minimum value in the block and the difference
+of every element from that minimum, using only as many bits as the
+largest difference requires. Inside a luminosity block the sorted
+event numbers of IndexIntoFile are dense, so most blocks need 8 to 12
+bits per event instead of 32. Blocks straddling the end of a lumi
+simply get a wider bit width.
+
+Any element can be decoded in constant time. The first element of
+each block acts as a skip index, so lower_bound over a sorted
+subrange only decodes a few values per block crossed plus a binary
+search inside a single block.
+
+----------------------------------------------------------------------*/
+
+#include "DataFormats/Provenance/interface/EventID.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace edm {
+
+  class CompressedEventNumbers {
+  public:
+    typedef std::vector<EventNumber_t>::size_type size_type;
+
+    static size_type const kBlockSize = 128;
+
+    CompressedEventNumbers();
+
+    /// Replace the contents with a packed copy of eventNumbers.
+    /// The values do not need to be sorted.
+    void assign(std::vector<EventNumber_t> const& eventNumbers);
+
+    void clear();
+
+    bool empty() const {return size_ == 0;}
+    size_type size() const {return size_;}
+
+    EventNumber_t operator[](size_type i) const {
+      Block const& block = blocks_[i / kBlockSize];
+      if(block.width_ == 0) return block.base_;
+      unsigned long long bit = (i % kBlockSize) * block.width_;
+      unsigned long long const* word = &words_[block.offset_ + (bit >> 6)];
+      unsigned int shift = bit & 63;
+      unsigned long long value = word[0] >> shift;
+      if(shift + block.width_ > 64) {
+        value |= word[1] << (64 - shift);
+      }
+      return block.base_ + static_cast<EventNumber_t>(value & ((1ULL << block.width_) - 1));
+    }
+
+    /// Returns the position of the first element in [begin, end)
+    /// that is not less than event, or end if there is none. The
+    /// elements in [begin, end) must be sorted.
+    size_type lower_bound(size_type begin, size_type end, EventNumber_t event) const;
+
+    /// Decode the elements in [begin, end) into out.
+    void copy(size_type begin, size_type end, EventNumber_t* out) const;
+
+    /// Heap memory used, in bytes.
+    std::size_t memoryUsed() const;
+
+  private:
+    struct Block {
+      unsigned long long offset_; // into words_
+      EventNumber_t base_;
+      unsigned int width_; // bits per element, 0 to 32
+    };
+
+    std::vector<Block> blocks_;
+    std::vector<unsigned long long> words_;
+    size_type size_;
+  };
+}
+#endif
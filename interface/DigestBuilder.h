@@ -0,0 +1,82 @@
+#ifndef DataFormats_Provenance_DigestBuilder_h
+#define DataFormats_Provenance_DigestBuilder_h
+
+/*----------------------------------------------------------------------
+
+DigestBuilder: Computes the MD5 digest of the text that streaming a
+sequence of fields into a std::ostringstream would produce, without
+building that text. Fields are formatted into a stack buffer, which is
+handed to the MD5 state whenever it fills up.
+
+The formatting must stay identical to that of the corresponding
+operator<<, because the resulting digests are persistent IDs:
+ - a Hash<I> is written as 32 lower case hex digits,
+ - an unsigned integer is written in decimal without padding.
+
+----------------------------------------------------------------------*/
+
+#include "DataFormats/Provenance/interface/Hash.h"
+#include "FWCore/Utilities/interface/Digest.h"
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+namespace edm {
+
+  class DigestBuilder {
+  public:
+    DigestBuilder() : digest_(), size_(0) {}
+
+    DigestBuilder& append(char c) {
+      if(size_ == kBufferSize) flush();
+      buffer_[size_++] = c;
+      return *this;
+    }
+
+    DigestBuilder& append(std::string const& s) {
+      return append(s.data(), s.size());
+    }
+
+    DigestBuilder& append(char const* data, std::size_t n) {
+      if(size_ + n > kBufferSize) {
+        flush();
+        if(n > kBufferSize) {
+          digest_.append(data, n);
+          return *this;
+        }
+      }
+      std::memcpy(buffer_ + size_, data, n);
+      size_ += n;
+      return *this;
+    }
+
+    DigestBuilder& append(unsigned int value);
+
+    template <int I>
+    DigestBuilder& append(Hash<I> const& hash) {
+      appendHex(hash.bytes());
+      return *this;
+    }
+
+    /// Digest everything appended so far.
+    hash_detail::bytes_type result();
+
+  private:
+    static std::size_t const kBufferSize = 512;
+
+    void appendHex(hash_detail::bytes_type const& bytes);
+
+    void flush() {
+      if(size_ != 0) {
+        digest_.append(buffer_, size_);
+        size_ = 0;
+      }
+    }
+
+    cms::Digest digest_;
+    std::size_t size_;
+    char buffer_[kBufferSize];
+  };
+}
+#endif
@@ -0,0 +1,102 @@
+#ifndef DataFormats_Provenance_EventBloomFilter_h
+#define DataFormats_Provenance_EventBloomFilter_h
+
+/*----------------------------------------------------------------------
+
+EventBloomFilter: A blocked Bloom filter over the run and event
+numbers of the events in a file.
+
+mayContain never returns false for an event that was inserted, and
+returns true for only about 1% of other events with the default
+number of bits. All the bits of one event are in the same 512 bit
+block, which is one cache line, so a lookup costs a single cache miss.
+
+The lumi number is not part of the key so the filter can also answer
+lookups where the lumi is not known. A false positive only means the
+normal search is done.
+
+An empty filter (the default) contains nothing and mayContain always
+returns true, so code can consult it unconditionally.
+
+toWords and fromWords convert the filter to and from a plain vector of
+64 bit words, with a format version in the first word, so it can be
+stored next to the IndexIntoFile and read back by tools that want to
+skip files without filling the event numbers.
+
+----------------------------------------------------------------------*/
+
+#include "DataFormats/Provenance/interface/EventID.h"
+#include "DataFormats/Provenance/interface/RunID.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace edm {
+
+  class EventBloomFilter {
+  public:
+    static unsigned int const defaultBitsPerEvent = 10U;
+
+    EventBloomFilter();
+
+    /// Empties the filter and sizes it for nEvents events
+    void reset(unsigned long long nEvents, unsigned int bitsPerEvent = defaultBitsPerEvent);
+
+    void clear();
+
+    bool empty() const {return words_.empty();}
+
+    void insert(RunNumber_t run, EventNumber_t event) {
+      unsigned long long hash = hashOf(run, event);
+      unsigned long long* block = &words_[blockOf(hash) * kWordsPerBlock];
+      for(unsigned int i = 0; i < kBitsPerKey; ++i, hash >>= 9) {
+        block[(hash >> 6) & 7] |= 1ULL << (hash & 63);
+      }
+    }
+
+    /// Returns false only if the event was not inserted. Always true if empty.
+    bool mayContain(RunNumber_t run, EventNumber_t event) const {
+      if(words_.empty()) return true;
+      unsigned long long hash = hashOf(run, event);
+      unsigned long long const* block = &words_[blockOf(hash) * kWordsPerBlock];
+      for(unsigned int i = 0; i < kBitsPerKey; ++i, hash >>= 9) {
+        if((block[(hash >> 6) & 7] & (1ULL << (hash & 63))) == 0) return false;
+      }
+      return true;
+    }
+
+    /// Appends the filter to words.
+    void toWords(std::vector<unsigned long long>& words) const;
+
+    /// Replaces the filter with one written by toWords. Returns false and
+    /// leaves the filter empty if the words are not in a known format.
+    bool fromWords(std::vector<unsigned long long> const& words);
+
+    /// Heap memory used, in bytes.
+    std::size_t memoryUsed() const;
+
+  private:
+    static unsigned long long const kFormatVersion = 1ULL;
+    static unsigned int const kWordsPerBlock = 8U;
+    static unsigned int const kBitsPerKey = 6U;
+
+    // The upper bits select the block, the lower 54 bits the bits set in it
+    static unsigned long long hashOf(RunNumber_t run, EventNumber_t event) {
+      unsigned long long hash = (static_cast<unsigned long long>(run) << 32) | event;
+      hash ^= hash >> 33;
+      hash *= 0xff51afd7ed558ccdULL;
+      hash ^= hash >> 33;
+      hash *= 0xc4ceb9fe1a85ec53ULL;
+      hash ^= hash >> 33;
+      return hash;
+    }
+
+    unsigned long long blockOf(unsigned long long hash) const {
+      return ((hash >> 32) * nBlocks_) >> 32;
+    }
+
+    std::vector<unsigned long long> words_;
+    unsigned long long nBlocks_;
+  };
+}
+#endif
@@ -0,0 +1,118 @@
+#ifndef DataFormats_Provenance_EventSearchIndex_h
+#define DataFormats_Provenance_EventSearchIndex_h
+
+/*----------------------------------------------------------------------
+
+EventSearchIndex: Summary levels over the sorted event numbers of
+the large lumis of an IndexIntoFile, for faster event lookups.
+
+The sorted event numbers of a lumi are the bottom level of a static
+B-tree with 16 keys per node. Each level above holds the last event
+number of every block of 16 elements of the level below, padded to
+whole nodes, up to a single root node. A node of 16 event numbers is
+one 64 byte cache line, so a lookup reads about one line per level,
+three levels for a lumi of a million events, where a binary search
+makes about twenty dependent probes spread over the whole lumi. The
+levels use about 7% of the memory of the event numbers.
+
+The event numbers themselves are not copied. lowerBound reads the
+bottom level through a function given by the caller, so the same
+levels serve lookups in the event numbers and in the event entries,
+which hold the same event numbers in the same order.
+
+----------------------------------------------------------------------*/
+
+#include "DataFormats/Provenance/interface/EventID.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace edm {
+
+  class EventSearchIndex {
+  public:
+    static long long const defaultMinimumEvents = 4096LL;
+
+    EventSearchIndex();
+
+    void clear();
+
+    bool empty() const {return ranges_.empty();}
+
+    /// Adds the levels for one lumi. events points to its nEvents sorted event
+    /// numbers, which start at beginEvents in the event vectors. The lumis
+    /// must be added in increasing order of beginEvents.
+    void addRange(long long beginEvents, EventNumber_t const* events, long long nEvents);
+
+    /// Returns the position of the first event number in [beginEvents, endEvents)
+    /// that is not less than event, or endEvents if there is none, like
+    /// std::lower_bound. eventAt(i) must return the event number at position i.
+    /// Returns -1 if there are no levels for the range, so the caller has to
+    /// do the search itself.
+    template<typename EventAt>
+    long long lowerBound(long long beginEvents, long long endEvents, EventNumber_t event, EventAt const& eventAt) const;
+
+    /// The number of event numbers in all the levels, including the padding
+    std::size_t numberOfKeys() const {return keys_.size();}
+
+    /// Heap memory used, in bytes.
+    std::size_t memoryUsed() const;
+
+  private:
+    static long long const kKeysPerNode = 16LL;
+    static unsigned int const kMaxLevels = 16U;
+
+    struct Range {
+      long long beginEvents_;
+      long long nEvents_;
+      std::vector<EventNumber_t>::size_type offset_;
+    };
+
+    // Fills sizes with the number of keys in each level, from the events
+    // at the bottom (sizes[0]) up to the root, and returns the number of
+    // levels above the events.
+    static unsigned int levelSizes(long long nEvents, long long* sizes);
+
+    static long long paddedSize(long long size) {
+      return (size + kKeysPerNode - 1) / kKeysPerNode * kKeysPerNode;
+    }
+
+    Range const* findRange(long long beginEvents) const;
+
+    std::vector<Range> ranges_;
+    // The levels of each range one after the other, the root first
+    std::vector<EventNumber_t> keys_;
+  };
+
+  template<typename EventAt>
+  long long
+  EventSearchIndex::lowerBound(long long beginEvents, long long endEvents, EventNumber_t event, EventAt const& eventAt) const {
+    Range const* range = findRange(beginEvents);
+    if(range == 0 || range->nEvents_ != endEvents - beginEvents) return -1LL;
+
+    long long sizes[kMaxLevels + 1];
+    unsigned int nLevels = levelSizes(range->nEvents_, sizes);
+    EventNumber_t const* level = keys_.data() + range->offset_;
+    long long block = 0;
+    for(unsigned int i = nLevels; i != 0; --i) {
+      EventNumber_t const* node = level + block * kKeysPerNode;
+      long long less = 0;
+      for(long long k = 0; k < kKeysPerNode; ++k) {
+        less += (node[k] < event);
+      }
+      // Only possible in the root, the last event is less than event
+      if(less == sizes[i]) return endEvents;
+      block = block * kKeysPerNode + less;
+      level += paddedSize(sizes[i]);
+    }
+
+    long long first = block * kKeysPerNode;
+    long long last = first + kKeysPerNode < range->nEvents_ ? first + kKeysPerNode : range->nEvents_;
+    long long position = beginEvents + first;
+    for(long long i = beginEvents + first; i < beginEvents + last; ++i) {
+      position += (eventAt(i) < event);
+    }
+    return position;
+  }
+}
+#endif
@@ -54,9 +54,20 @@ namespace edm {
 
       typedef std::vector<Element>::iterator iterator;
 
+      /// Both sorts give the same order as a stable sort with the corresponding
+      /// comparison. Large indexes are radix sorted on packed keys.
       void sortBy_Run_Lumi_Event();
       void sortBy_Run_Lumi_EventEntry();
 
+      /// If this is greater than one, the sorts of large indexes count and
+      /// move the elements in up to this many chunks, which run as concurrent
+      /// tasks in the framework's thread pool. The order does not depend on
+      /// the number of chunks. The default is one. This is reset by
+      /// initializeTransients.
+      void setNumberOfSortThreads(unsigned int n) const {
+        transient_.numberOfSortThreads_ = n == 0U ? 1U : n;
+      }
+
       const_iterator
       findPosition(RunNumber_t run, LuminosityBlockNumber_t lumi = 0U, EventNumber_t event = 0U) const;
 
@@ -123,6 +134,7 @@ namespace edm {
         bool allInEntryOrder_;
         bool resultCached_;
         SortState sortState_;
+        unsigned int numberOfSortThreads_;
       };
 
     private:
@@ -130,6 +142,7 @@ namespace edm {
       bool& allInEntryOrder() const {return transient_.allInEntryOrder_;}
       bool& resultCached() const {return transient_.resultCached_;}
       SortState& sortState() const {return transient_.sortState_;}
+      unsigned int numberOfSortThreads() const {return transient_.numberOfSortThreads_;}
 
       std::vector<Element> entries_;
       mutable Transients transient_;
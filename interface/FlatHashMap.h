@@ -0,0 +1,147 @@
+#ifndef DataFormats_Provenance_FlatHashMap_h
+#define DataFormats_Provenance_FlatHashMap_h
+
+/*----------------------------------------------------------------------
+
+FlatHashMap: An insert-only associative container using open
+addressing with linear probing.
+
+The probe table is a flat array of 8-byte slots, each holding the
+index of an entry plus a tag taken from the high bits of the hash, so a
+lookup usually touches one cache line of slots and dereferences a
+single entry. The entries themselves live in a std::deque in insertion
+order. Consequently, references and pointers to entries stay valid
+when more entries are inserted (iterators do not), and iteration is in
+insertion order, not key order.
+
+The hasher must distribute its output uniformly over all the bits of
+std::size_t. This is true of std::hash<edm::Hash<I> >, which is the
+intended use. Erasing single elements is not supported.
+
+----------------------------------------------------------------------*/
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace edm {
+
+  template <typename K, typename V, typename H = std::hash<K> >
+  class FlatHashMap {
+  public:
+    typedef K key_type;
+    typedef V mapped_type;
+    typedef std::pair<K const, V> value_type;
+    typedef H hasher;
+    typedef typename std::deque<value_type>::size_type size_type;
+    typedef typename std::deque<value_type>::iterator iterator;
+    typedef typename std::deque<value_type>::const_iterator const_iterator;
+
+    FlatHashMap() : entries_(), slots_(), hasher_() {}
+
+    size_type size() const {return entries_.size();}
+    bool empty() const {return entries_.empty();}
+
+    iterator begin() {return entries_.begin();}
+    iterator end() {return entries_.end();}
+    const_iterator begin() const {return entries_.begin();}
+    const_iterator end() const {return entries_.end();}
+
+    void clear() {
+      entries_.clear();
+      std::vector<Slot>().swap(slots_);
+    }
+
+    /// Size the probe table so that n entries fit without rehashing.
+    void reserve(size_type n) {
+      size_type capacity = kMinCapacity;
+      while(capacity < 2 * n) capacity *= 2;
+      if(capacity > slots_.size()) rehash(capacity);
+    }
+
+    iterator find(K const& key) {
+      std::size_t const i = findSlot(key, hasher_(key));
+      return (i == kNotFound) ? entries_.end() : entries_.begin() + (slots_[i].index_ - 1);
+    }
+
+    const_iterator find(K const& key) const {
+      std::size_t const i = findSlot(key, hasher_(key));
+      return (i == kNotFound) ? entries_.end() : entries_.begin() + (slots_[i].index_ - 1);
+    }
+
+    size_type count(K const& key) const {
+      return findSlot(key, hasher_(key)) == kNotFound ? 0U : 1U;
+    }
+
+    std::pair<iterator, bool> insert(value_type const& value) {
+      if(2 * (entries_.size() + 1) > slots_.size()) {
+        rehash(slots_.empty() ? kMinCapacity : 2 * slots_.size());
+      }
+      std::size_t const h = hasher_(value.first);
+      unsigned int const t = tag(h);
+      std::size_t const mask = slots_.size() - 1;
+      for(std::size_t i = h & mask; ; i = (i + 1) & mask) {
+        Slot& slot = slots_[i];
+        if(slot.index_ == 0) {
+          entries_.push_back(value);
+          slot.index_ = entries_.size();
+          slot.tag_ = t;
+          return std::make_pair(entries_.end() - 1, true);
+        }
+        if(slot.tag_ == t && entries_[slot.index_ - 1].first == value.first) {
+          return std::make_pair(entries_.begin() + (slot.index_ - 1), false);
+        }
+      }
+    }
+
+    V& operator[](K const& key) {
+      return insert(value_type(key, V())).first->second;
+    }
+
+  private:
+    struct Slot {
+      Slot() : index_(0), tag_(0) {}
+      // One plus the index into entries_, zero if the slot is empty.
+      unsigned int index_;
+      unsigned int tag_;
+    };
+
+    static std::size_t const kMinCapacity = 16;
+    static std::size_t const kNotFound = static_cast<std::size_t>(-1);
+
+    static unsigned int tag(std::size_t h) {
+      return static_cast<unsigned int>(h >> (sizeof(std::size_t) * 4));
+    }
+
+    std::size_t findSlot(K const& key, std::size_t h) const {
+      if(slots_.empty()) return kNotFound;
+      unsigned int const t = tag(h);
+      std::size_t const mask = slots_.size() - 1;
+      for(std::size_t i = h & mask; ; i = (i + 1) & mask) {
+        Slot const& slot = slots_[i];
+        if(slot.index_ == 0) return kNotFound;
+        if(slot.tag_ == t && entries_[slot.index_ - 1].first == key) return i;
+      }
+    }
+
+    void rehash(std::size_t capacity) {
+      std::vector<Slot> newSlots(capacity);
+      std::size_t const mask = capacity - 1;
+      for(size_type k = 0; k < entries_.size(); ++k) {
+        std::size_t const h = hasher_(entries_[k].first);
+        std::size_t i = h & mask;
+        while(newSlots[i].index_ != 0) i = (i + 1) & mask;
+        newSlots[i].index_ = k + 1;
+        newSlots[i].tag_ = tag(h);
+      }
+      slots_.swap(newSlots);
+    }
+
+    std::deque<value_type> entries_;
+    std::vector<Slot> slots_;
+    hasher hasher_;
+  };
+}
+#endif
@@ -0,0 +1,100 @@
+#ifndef DataFormats_Provenance_FrozenIndexIntoFile_h
+#define DataFormats_Provenance_FrozenIndexIntoFile_h
+
+/*----------------------------------------------------------------------
+
+FrozenIndexIntoFile: A read-only view of an IndexIntoFile stored in a
+flat binary layout, for file catalogs and sidecar caches that reopen
+the same index many times.
+
+The layout holds the persistent vectors of the IndexIntoFile and also
+the transient ones that are otherwise rebuilt and sorted after reading
+it: the sorted run and lumi indexes and, if they were filled when the
+index was frozen, the sorted event numbers and event entries. It is a
+header of 64 bit words followed by arrays of fixed size records, each
+starting on an 8 byte boundary. There are no pointers, so the layout
+can be written to a file and used from a memory mapped region or any
+other buffer at any address.
+
+The first word identifies the format and byte order, the second holds
+the format version. The constructor throws if either is not known, if
+the size does not match the counts in the header, or if an index in a
+record or the event number ranges of the sorted lumi indexes do not fit
+the other sections.
+
+The view reads the records in place. thaw fills an IndexIntoFile from
+it without any sorting, allocating each vector once, and after that
+the IndexIntoFile behaves as if its transient vectors had been filled
+by the usual functions.
+
+----------------------------------------------------------------------*/
+
+#include "DataFormats/Provenance/interface/IndexIntoFile.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace edm {
+
+  class FrozenIndexIntoFile {
+  public:
+    typedef IndexIntoFile::EntryNumber_t EntryNumber_t;
+    typedef std::vector<IndexIntoFile::RunOrLumiEntry>::size_type size_type;
+
+    static unsigned long long const formatVersion = 1ULL;
+
+    /// Appends the frozen layout of indexIntoFile to blob. The sorted run and lumi
+    /// indexes are filled if needed. The event numbers and event entries are
+    /// included only if they are already filled.
+    static void freeze(IndexIntoFile const& indexIntoFile, std::vector<char>& blob);
+
+    /// A view of the size bytes at data, which must start on an 8 byte boundary
+    /// and must outlive this object.
+    FrozenIndexIntoFile(void const* data, std::size_t size);
+
+    EntryNumber_t numberOfEvents() const;
+
+    size_type numberOfProcessHistoryIDs() const {return nProcessHistoryIDs_;}
+    ProcessHistoryID processHistoryID(size_type i) const;
+
+    size_type numberOfRunOrLumiEntries() const {return nRunOrLumiEntries_;}
+    IndexIntoFile::RunOrLumiEntry runOrLumiEntry(size_type i) const;
+
+    /// Zero if the layout does not include the sorted indexes
+    size_type numberOfRunOrLumiIndexes() const {return nRunOrLumiIndexes_;}
+    IndexIntoFile::RunOrLumiIndexes runOrLumiIndexes(size_type i) const;
+
+    /// Zero if the layout does not include the event numbers
+    size_type numberOfEventNumbers() const {return nEventNumbers_;}
+    /// The sorted event numbers, in place
+    EventNumber_t const* eventNumbers() const {return eventNumbers_;}
+
+    /// Zero if the layout does not include the event entries
+    size_type numberOfEventEntries() const {return nEventEntries_;}
+    IndexIntoFile::EventEntry eventEntry(size_type i) const;
+
+    /// Replaces the contents of indexIntoFile, including its EventFinder,
+    /// with the frozen index.
+    void thaw(IndexIntoFile& indexIntoFile) const;
+
+  private:
+    // The records of the layout, defined in the .cc file
+    struct RunOrLumiEntryRecord;
+    struct RunOrLumiIndexesRecord;
+    struct EventEntryRecord;
+
+    unsigned long long const* header_;
+    size_type nProcessHistoryIDs_;
+    size_type nRunOrLumiEntries_;
+    size_type nRunOrLumiIndexes_;
+    size_type nEventNumbers_;
+    size_type nEventEntries_;
+    unsigned char const* processHistoryIDs_;
+    RunOrLumiEntryRecord const* runOrLumiEntries_;
+    RunOrLumiIndexesRecord const* runOrLumiIndexes_;
+    EventNumber_t const* eventNumbers_;
+    EventEntryRecord const* eventEntries_;
+  };
+}
+
+#endif
@@ -26,10 +26,9 @@ in the registry (although there is nothing prevents that).
 
 */
 
+#include "DataFormats/Provenance/interface/FlatHashMap.h"
 #include "DataFormats/Provenance/interface/ProcessHistoryID.h"
 
-#include <map>
-
 namespace edm {
 
   class FullHistoryToReducedHistoryMap {
@@ -44,9 +43,10 @@ namespace edm {
     FullHistoryToReducedHistoryMap(FullHistoryToReducedHistoryMap const&);
     FullHistoryToReducedHistoryMap& operator=(FullHistoryToReducedHistoryMap const&);
 
-    typedef std::map<ProcessHistoryID, ProcessHistoryID> Map;
+    typedef FlatHashMap<ProcessHistoryID, ProcessHistoryID> Map;
     Map cache_;
-    Map::const_iterator previous_;
+    // Points into cache_, whose entries are never moved by insertions
+    Map::value_type const* previous_;
   };
 }
 #endif
@@ -1,17 +1,28 @@
 #ifndef DataFormats_Provenance_Hash_h
 #define DataFormats_Provenance_Hash_h
 
+#include <cstddef>
+#include <cstring>
+#include <iosfwd>
 #include <string>
+#ifndef __GCCXML__
+#include <array>
+#include <functional>
+#endif
 
 /*----------------------------------------------------------------------
-  
+
 Hash:
 
-  Note: The call to 'fixup' in every member function is a temporary
-  measure for backwards compatibility. It is necessary in every function
-  because Root creates instances of the class *without* using the
-  interface of the class, thus making it insufficient to assure that
-  all constructors make corrected instances.
+  The 16 bytes of the MD5 checksum are held in a fixed size array, so
+  that copying and swapping are plain 16 byte copies that never
+  allocate, and comparisons read the bytes as two 64 bit words.
+
+  Before class version 11 the checksum was stored in a std::string,
+  in either the 16-byte (compact) form or the 32 character hexified
+  form. Such data are converted when read by the ROOT I/O rules in
+  classes_def.xml, which call hash_detail::toBytes_. The constructor
+  taking a string uses the same conversion, so it accepts either form.
 
 ----------------------------------------------------------------------*/
 namespace cms {
@@ -27,14 +38,62 @@ namespace edm {
 
   namespace hash_detail {
     typedef std::string value_type;
-    value_type compactForm_(value_type const& hash);
+    typedef unsigned long long word_type;
+    std::size_t const nBytes = 16;
+
+    void toBytes_(unsigned char* bytes, value_type const& hash);
     void fixup_(value_type& hash);
     bool isCompactForm_(value_type const& hash);
-    bool isValid_(value_type const& hash);
-    void throwIfIllFormed(value_type const& hash);
-    void toString_(std::string& result, value_type const& hash);
-    void toDigest_(cms::Digest& digest, value_type const& hash);
-    std::ostream& print_(std::ostream& os, value_type const& hash);
+    void toString_(std::string& result, unsigned char const* bytes);
+    void toDigest_(cms::Digest& digest, unsigned char const* bytes);
+    std::ostream& print_(std::ostream& os, unsigned char const* bytes);
+#ifndef __GCCXML__
+    typedef std::array<unsigned char, nBytes> bytes_type;
+#endif
+
+    // The bytes of a default constructed cms::MD5Result, the MD5
+    // checksum of an empty input, which stand for an invalid Hash.
+    inline
+    unsigned char const*
+    invalidBytes_() {
+      static unsigned char const invalid[nBytes] = {0xd4, 0x1d, 0x8c, 0xd9, 0x8f, 0x00, 0xb2, 0x04,
+                                                    0xe9, 0x80, 0x09, 0x98, 0xec, 0xf8, 0x42, 0x7e};
+      return invalid;
+    }
+
+    inline
+    word_type
+    load_(unsigned char const* p) {
+      word_type word;
+      std::memcpy(&word, p, sizeof(word));
+      return word;
+    }
+
+    // Integer order of the loaded words is the byte-wise (memcmp)
+    // order of the compact form.
+    inline
+    word_type
+    loadOrdered_(unsigned char const* p) {
+      word_type word = load_(p);
+#if !defined(__GCCXML__) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+      word = __builtin_bswap64(word);
+#endif
+      return word;
+    }
+
+    inline
+    bool
+    equal_(unsigned char const* a, unsigned char const* b) {
+      return ((load_(a) ^ load_(b)) | (load_(a + 8) ^ load_(b + 8))) == 0;
+    }
+
+    inline
+    bool
+    less_(unsigned char const* a, unsigned char const* b) {
+      word_type const a0 = loadOrdered_(a);
+      word_type const b0 = loadOrdered_(b);
+      return a0 < b0 || (a0 == b0 && loadOrdered_(a + 8) < loadOrdered_(b + 8));
+    }
   }
 
   template <int I>
@@ -44,9 +103,10 @@ namespace edm {
 
     Hash();
     explicit Hash(value_type const& v);
-
-    Hash(Hash<I> const&);
-    Hash<I>& operator=(Hash<I> const& iRHS);
+#ifndef __GCCXML__
+    typedef hash_detail::bytes_type bytes_type;
+    explicit Hash(bytes_type const& v);
+#endif
 
     void reset();
 
@@ -68,37 +128,25 @@ namespace edm {
 
     // Return the 16-byte (non-printable) string form.
     value_type compactForm() const;
-    
+
+    // The in-memory representation is always the compact form.
     bool isCompactForm() const;
-    
+
+#ifndef __GCCXML__
+    // The 16 bytes of the checksum.
+    bytes_type bytes() const;
+#endif
+
+    // The bytes of an MD5 checksum are uniformly distributed, so the
+    // leading bytes serve directly as a hash value for hashed containers.
+    std::size_t smallHash() const {return static_cast<std::size_t>(hash_detail::load_(hash_));}
+
     //Used by ROOT storage
-    // CMS_CLASS_VERSION(10) // This macro is not defined here, so expand it.
-    static short Class_Version() {return 10;}
+    // CMS_CLASS_VERSION(11) // This macro is not defined here, so expand it.
+    static short Class_Version() {return 11;}
 
   private:
-
-    /// Hexified version of data *must* contain a multiple of 2
-    /// bytes. If it does not, throw an exception.
-    void throwIfIllFormed() const;
-
-    template<typename Op>
-      bool
-      compareUsing(Hash<I> const& iOther, Op op) const {
-        bool meCF = hash_detail::isCompactForm_(hash_);
-        bool otherCF = hash_detail::isCompactForm_(iOther.hash_);
-        if(meCF == otherCF) {
-          return op(this->hash_,iOther.hash_);
-        }
-        //copy constructor will do compact form conversion
-        if(meCF) {
-           Hash<I> temp(iOther);
-           return op(this->hash_,temp.hash_);
-        } 
-        Hash<I> temp(*this);
-        return op(temp.hash_,iOther.hash_);
-      }
-
-    value_type hash_;
+    unsigned char hash_[hash_detail::nBytes];
   };
 
 
@@ -110,74 +158,69 @@ namespace edm {
 
   template <int I>
   inline
-  Hash<I>::Hash() : hash_(detail::InvalidHash()) {}
-
-  template <int I>
-  inline
-  Hash<I>::Hash(typename Hash<I>::value_type const& v) : hash_(v) {
-    hash_detail::fixup_(hash_);
+  Hash<I>::Hash() {
+    std::memcpy(hash_, hash_detail::invalidBytes_(), sizeof(hash_));
   }
 
   template <int I>
   inline
-  Hash<I>::Hash(Hash<I> const& iOther) : hash_(iOther.hash_) {
-     hash_detail::fixup_(hash_);
+  Hash<I>::Hash(typename Hash<I>::value_type const& v) {
+    hash_detail::toBytes_(hash_, v);
   }
 
+#ifndef __GCCXML__
   template <int I>
   inline
-  Hash<I>& 
-  Hash<I>::operator=(Hash<I> const& iRHS) {
-    hash_ = iRHS.hash_;
-    hash_detail::fixup_(hash_);
-    return *this;
+  Hash<I>::Hash(typename Hash<I>::bytes_type const& v) {
+    std::memcpy(hash_, v.data(), sizeof(hash_));
   }
-  
+#endif
+
   template <int I>
   inline
-  void 
+  void
   Hash<I>::reset() {
-    hash_ = detail::InvalidHash();
+    std::memcpy(hash_, hash_detail::invalidBytes_(), sizeof(hash_));
   }
-  
+
   template <int I>
   inline
-  bool 
+  bool
   Hash<I>::isValid() const {
-    return hash_detail::isValid_(hash_);
+    return !hash_detail::equal_(hash_, hash_detail::invalidBytes_());
   }
-  
+
   template <int I>
   inline
   bool
   Hash<I>::operator<(Hash<I> const& other) const {
-    return this->compareUsing(other, std::less<std::string>());
+    return hash_detail::less_(hash_, other.hash_);
   }
 
   template <int I>
   inline
-  bool 
+  bool
   Hash<I>::operator>(Hash<I> const& other) const {
-    return this->compareUsing(other, std::greater<std::string>());
+    return hash_detail::less_(other.hash_, hash_);
   }
 
   template <int I>
   inline
-  bool 
+  bool
   Hash<I>::operator==(Hash<I> const& other) const {
-    return this->compareUsing(other, std::equal_to<std::string>());
+    return hash_detail::equal_(hash_, other.hash_);
   }
 
   template <int I>
   inline
-  bool 
+  bool
   Hash<I>::operator!=(Hash<I> const& other) const {
-    return this->compareUsing(other, std::not_equal_to<std::string>());
+    return !hash_detail::equal_(hash_, other.hash_);
   }
 
   template <int I>
   inline
-  std::ostream& 
+  std::ostream&
   Hash<I>::print(std::ostream& os) const {
     return hash_detail::print_(os, hash_);
   }
@@ -198,27 +241,37 @@ namespace edm {
 
   template <int I>
   inline
-  void 
+  void
   Hash<I>::swap(Hash<I>& other) {
-    hash_.swap(other.hash_);
+    unsigned char temp[hash_detail::nBytes];
+    std::memcpy(temp, hash_, sizeof(hash_));
+    std::memcpy(hash_, other.hash_, sizeof(hash_));
+    std::memcpy(other.hash_, temp, sizeof(hash_));
   }
 
   template <int I>
   inline
   typename Hash<I>::value_type
   Hash<I>::compactForm() const {
-    return hash_detail::compactForm_(hash_);
+    return value_type(hash_, hash_ + sizeof(hash_));
   }
 
-  // Note: this template is not declared 'inline' because of the
-  // switch statement.
-
   template <int I>
   inline
   bool Hash<I>::isCompactForm() const {
-    return hash_detail::isCompactForm_(hash_);
+    return true;
   }
-  
+
+#ifndef __GCCXML__
+  template <int I>
+  inline
+  typename Hash<I>::bytes_type
+  Hash<I>::bytes() const {
+    bytes_type result;
+    std::memcpy(result.data(), hash_, sizeof(hash_));
+    return result;
+  }
+#endif
 
   // Free swap function
   template <int I>
@@ -236,4 +289,17 @@ namespace edm {
   }
 
 }
+
+#ifndef __GCCXML__
+namespace std {
+  template <int I>
+  struct hash<edm::Hash<I> > {
+    typedef edm::Hash<I> argument_type;
+    typedef std::size_t result_type;
+    result_type operator()(argument_type const& h) const {
+      return h.smallHash();
+    }
+  };
+}
+#endif
 #endif
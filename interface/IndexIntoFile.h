@@ -117,12 +117,21 @@ If filled, both vectors contain the same number of
 entries with identical event numbers sorted in the
 same order.  The only difference is that one includes
 the entry numbers and thus takes more memory.
+Optionally, after eventNumbers_ is filled it can be
+replaced by a bit packed copy (see compressEventNumbers)
+which typically needs 1 to 1.5 bytes per event.
 Each element of runOrLumiIndexes_ has the indexes necessary
 to find the range inside eventNumbers_ or eventEntries_
 corresponding to its lumi.  Within that range the elements
 are sorted by event number, which is used for the
 numerical order iteration and to find an event by the
-event number.
+event number. An optional Bloom filter over the run and
+event numbers (see fillEventFilter) lets the search for
+an event that is not in the file return without filling
+either vector. For lumis with many events, summary levels
+over their sorted event numbers (see fillEventSearchIndex)
+make the search read a few cache lines instead of doing a
+binary search over the whole lumi.
 
 The details of the data structure are a little different
 when reading files written before release 3_8_0
@@ -165,17 +174,22 @@ The interface is too complex for general use.
 
 */
 
+#include "DataFormats/Provenance/interface/CompressedEventNumbers.h"
+#include "DataFormats/Provenance/interface/EventBloomFilter.h"
 #include "DataFormats/Provenance/interface/EventID.h"
+#include "DataFormats/Provenance/interface/EventSearchIndex.h"
+#include "DataFormats/Provenance/interface/LuminosityBlockRange.h"
 #include "DataFormats/Provenance/interface/ProcessHistoryID.h"
 #include "DataFormats/Provenance/interface/RunID.h"
-#include "FWCore/Utilities/interface/value_ptr.h"
 
 #include "boost/shared_ptr.hpp"
 
 #include <cassert>
+#include <cstddef>
 #include <iosfwd>
 #include <map>
 #include <set>
+#include <utility>
 #include <vector>
 
 namespace edm {
@@ -194,9 +208,13 @@ namespace edm {
       static LuminosityBlockNumber_t const invalidLumi = 0U;
       static EventNumber_t const invalidEvent = 0U;
       static EntryNumber_t const invalidEntry = -1LL;
+      static EntryNumber_t const eventNumbersChunkSize = 65536LL;
 
       enum EntryType {kRun, kLumi, kEvent, kEnd};
 
+      /// A half open range [first, second) of TTree entry numbers
+      typedef std::pair<EntryNumber_t, EntryNumber_t> EntryRange;
+
       IndexIntoFile();
       ~IndexIntoFile();
 
@@ -229,12 +247,37 @@ namespace edm {
       /// Note the argument specifies the order
       IndexIntoFileItr begin(SortOrder sortOrder) const;
 
+      /// Same as above, but the iteration only visits the lumis in lumiMask,
+      /// their events, and the runs that contain at least one of them.
+      /// Rejected lumis and runs are jumped over without being visited.
+      /// lumiMask must be sorted and without overlaps, as sortAndRemoveOverlaps
+      /// leaves it, and must outlive the iterator. operator++, skipEventForward,
+      /// skipLumiInRun, the advance functions and skipEventBackward respect
+      /// the mask. The find functions take no mask and return iterators
+      /// over the whole file. Copying a position at a rejected lumi into an
+      /// iterator with a mask with copyPosition throws.
+      IndexIntoFileItr begin(SortOrder sortOrder, std::vector<LuminosityBlockRange> const& lumiMask) const;
+
       /// Used to end an iteration over the Runs, Lumis, and Events in a file.
       IndexIntoFileItr end(SortOrder sortOrder) const;
 
       /// Used to determine whether or not to disable fast cloning.
       bool iterationWillBeInEntryOrder(SortOrder sortOrder) const;
 
+      /// Splits the iteration into at most nChunks consecutive chunks with about
+      /// the same number of events and appends their begin and end iterators to
+      /// chunks, so several streams can read the file concurrently. Chunks start
+      /// at a run or lumi, never in the middle of a lumi. A chunk starting in the
+      /// middle of a run visits the run first, so the iteration of each chunk has
+      /// the same run and lumi transitions as the full iteration. Every chunk has
+      /// at least one event unless the file has none, in which case there is a
+      /// single chunk, even if the file is empty. Nothing is appended if nChunks
+      /// is zero. Only the event counts of the entries are used, no event
+      /// numbers are read.
+      void partition(SortOrder sortOrder,
+                     unsigned int nChunks,
+                     std::vector<std::pair<IndexIntoFileItr, IndexIntoFileItr> >& chunks) const;
+
       /// True if no runs, lumis, or events are in the file.
       bool empty() const;
 
@@ -291,8 +334,23 @@ namespace edm {
       /// To be added the event must have the same ProcessHistoryID index, run number, lumi number and event number.
       void set_intersection(IndexIntoFile const& indexIntoFile, std::set<IndexRunLumiEventKey>& intersection) const;
 
+      /// Same as above, but appends the keys to the vector in increasing order instead of
+      /// inserting them in a set. There is no allocation per event, only the growth of the
+      /// vector, so with enough reserved memory large overlaps are much cheaper. If nChunks is
+      /// greater than one, the matching lumis are split into up to that many chunks which are
+      /// intersected as concurrent tasks in the framework's thread pool.
+      void set_intersection(IndexIntoFile const& indexIntoFile, std::vector<IndexRunLumiEventKey>& intersection,
+                            unsigned int nChunks = 1U) const;
+
+      /// How containsDuplicateEvents looks for duplicates. sortedDuplicateCheck compares
+      /// neighbors in the sorted event numbers, filling them if needed. hashDuplicateCheck
+      /// inserts the unsorted event numbers of each lumi in a small hash set and stops at
+      /// the first duplicate, so nothing is sorted and the sorted vector is never allocated.
+      /// If the sorted events are already filled, both use them.
+      enum DuplicateCheckMethod {sortedDuplicateCheck, hashDuplicateCheck};
+
       /// Returns true if the IndexIntoFile contains 2 events with the same ProcessHistoryID index, run number, lumi number and event number.
-      bool containsDuplicateEvents() const;
+      bool containsDuplicateEvents(DuplicateCheckMethod method = sortedDuplicateCheck) const;
 
       //*****************************************************************************
       //*****************************************************************************
@@ -478,19 +536,22 @@ namespace edm {
       //*****************************************************************************
       //*****************************************************************************
 
+      // The iteration state machine. It handles both sort orders, the
+      // functions that depend on the order dispatch on sortOrder_ instead
+      // of being virtual, so the iterator can hold it by value and copying
+      // an iterator never allocates.
       class IndexIntoFileItrImpl {
 
       public:
         IndexIntoFileItrImpl(IndexIntoFile const* indexIntoFile,
+                             SortOrder sortOrder,
                              EntryType entryType,
                              int indexToRun,
                              int indexToLumi,
                              int indexToEventRange,
                              long long indexToEvent,
-                             long long nEvents);
-         virtual ~IndexIntoFileItrImpl();
-
-        virtual IndexIntoFileItrImpl* clone() const = 0;
+                             long long nEvents,
+                             std::vector<LuminosityBlockRange> const* lumiMask = 0);
 
         EntryType getEntryType() const {return type_;}
 
@@ -506,22 +567,36 @@ namespace edm {
                                LuminosityBlockNumber_t& lumiOfEvent,
                                EntryNumber_t& eventEntry);
 
-        virtual int processHistoryIDIndex() const  = 0;
-        virtual RunNumber_t run() const = 0;
-        virtual LuminosityBlockNumber_t lumi() const = 0;
-        virtual EntryNumber_t entry() const = 0;
-        virtual LuminosityBlockNumber_t peekAheadAtLumi() const = 0;
-        virtual EntryNumber_t peekAheadAtEventEntry() const = 0;
+        int processHistoryIDIndex() const {
+          return sorted() ? processHistoryIDIndexSorted() : processHistoryIDIndexNoSort();
+        }
+        RunNumber_t run() const {return sorted() ? runSorted() : runNoSort();}
+        LuminosityBlockNumber_t lumi() const {return sorted() ? lumiSorted() : lumiNoSort();}
+        EntryNumber_t entry() const {return sorted() ? entrySorted() : entryNoSort();}
+        LuminosityBlockNumber_t peekAheadAtLumi() const {
+          return sorted() ? peekAheadAtLumiSorted() : peekAheadAtLumiNoSort();
+        }
+        EntryNumber_t peekAheadAtEventEntry() const {
+          return sorted() ? peekAheadAtEventEntrySorted() : peekAheadAtEventEntryNoSort();
+        }
         EntryNumber_t firstEventEntryThisRun();
         EntryNumber_t firstEventEntryThisLumi();
-        virtual bool skipLumiInRun() = 0;
+        bool skipLumiInRun() {return sorted() ? skipLumiInRunSorted() : skipLumiInRunNoSort();}
+        long long getEventEntryRangesInLumi(std::vector<EntryRange>& ranges) const;
+        void skipEventsInLumi();
 
         void advanceToNextRun();
         void advanceToNextLumiOrRun();
         bool skipToNextEventInLumi();
         void initializeRun();
 
-        void initializeLumi() {initializeLumi_();}
+        void initializeLumi() {
+          if(sorted()) {
+            initializeLumiSorted();
+          } else {
+            initializeLumiNoSort();
+          }
+        }
 
         bool operator==(IndexIntoFileItrImpl const& right) const;
 
@@ -538,7 +613,7 @@ namespace edm {
 
         void copyPosition(IndexIntoFileItrImpl const& position);
 
-      protected:
+      private:
 
         void setInvalid();
 
@@ -547,93 +622,79 @@ namespace edm {
         void setIndexToEvent(long long value) { indexToEvent_ = value; }
         void setNEvents(long long value) { nEvents_ = value; }
 
-      private:
+        bool sorted() const {return sortOrder_ == numericalOrder;}
 
-        virtual void initializeLumi_() = 0;
-        virtual bool nextEventRange() = 0;
-        virtual bool previousEventRange() = 0;
+        bool nextEventRange() {return sorted() ? nextEventRangeSorted() : nextEventRangeNoSort();}
+        bool previousEventRange() {return sorted() ? previousEventRangeSorted() : previousEventRangeNoSort();}
         bool previousLumiWithEvents();
-        virtual bool setToLastEventInRange(int index) = 0;
-        virtual EntryType getRunOrLumiEntryType(int index) const = 0;
-        virtual bool isSameLumi(int index1, int index2) const = 0;
-        virtual bool isSameRun(int index1, int index2) const = 0;
+        bool setToLastEventInRange(int index) {
+          return sorted() ? setToLastEventInRangeSorted(index) : setToLastEventInRangeNoSort(index);
+        }
+        EntryType getRunOrLumiEntryType(int index) const {
+          return sorted() ? getRunOrLumiEntryTypeSorted(index) : getRunOrLumiEntryTypeNoSort(index);
+        }
+        bool isSameLumi(int index1, int index2) const {
+          return sorted() ? isSameLumiSorted(index1, index2) : isSameLumiNoSort(index1, index2);
+        }
+        bool isSameRun(int index1, int index2) const {
+          return sorted() ? isSameRunSorted(index1, index2) : isSameRunNoSort(index1, index2);
+        }
+
+        // Lumi mask
+        void moveToLumiOrRun(int index);
+        int findLumiInMask(int index) {return sorted() ? findLumiInMaskSorted(index) : findLumiInMaskNoSort(index);}
+        std::vector<LuminosityBlockRange>::const_iterator maskRangeNotBefore(LuminosityBlockID const& id);
+        bool inMask(RunNumber_t run, LuminosityBlockNumber_t lumi);
+        bool lumiInMask(int index);
+        int findLumiInMaskNoSort(int index);
+        int findLumiInMaskSorted(int index);
+        int gallopSorted(int index, RunOrLumiIndexes const& key, bool orEqual) const;
+
+        // firstAppearanceOrder, iterates over runOrLumiEntries_
+        int processHistoryIDIndexNoSort() const;
+        RunNumber_t runNoSort() const;
+        LuminosityBlockNumber_t lumiNoSort() const;
+        EntryNumber_t entryNoSort() const;
+        LuminosityBlockNumber_t peekAheadAtLumiNoSort() const;
+        EntryNumber_t peekAheadAtEventEntryNoSort() const;
+        bool skipLumiInRunNoSort();
+        void initializeLumiNoSort();
+        bool nextEventRangeNoSort();
+        bool previousEventRangeNoSort();
+        bool setToLastEventInRangeNoSort(int index);
+        EntryType getRunOrLumiEntryTypeNoSort(int index) const;
+        bool isSameLumiNoSort(int index1, int index2) const;
+        bool isSameRunNoSort(int index1, int index2) const;
+
+        // numericalOrder, iterates over runOrLumiIndexes_
+        int processHistoryIDIndexSorted() const;
+        RunNumber_t runSorted() const;
+        LuminosityBlockNumber_t lumiSorted() const;
+        EntryNumber_t entrySorted() const;
+        LuminosityBlockNumber_t peekAheadAtLumiSorted() const;
+        EntryNumber_t peekAheadAtEventEntrySorted() const;
+        bool skipLumiInRunSorted();
+        void initializeLumiSorted();
+        bool nextEventRangeSorted();
+        bool previousEventRangeSorted();
+        bool setToLastEventInRangeSorted(int index);
+        EntryType getRunOrLumiEntryTypeSorted(int index) const;
+        bool isSameLumiSorted(int index1, int index2) const;
+        bool isSameRunSorted(int index1, int index2) const;
 
         IndexIntoFile const* indexIntoFile_;
         int size_;
 
+        SortOrder sortOrder_;
         EntryType type_;
         int indexToRun_;
         int indexToLumi_;
         int indexToEventRange_;
         long long indexToEvent_;
         long long nEvents_;
-      };
-
-      //*****************************************************************************
-      //*****************************************************************************
-
-      class IndexIntoFileItrNoSort : public IndexIntoFileItrImpl {
-      public:
-        IndexIntoFileItrNoSort(IndexIntoFile const* indexIntoFile,
-                               EntryType entryType,
-                               int indexToRun,
-                               int indexToLumi,
-                               int indexToEventRange,
-                               long long indexToEvent,
-                               long long nEvents);
-
-        virtual IndexIntoFileItrImpl* clone() const;
-
-        virtual int processHistoryIDIndex() const;
-        virtual RunNumber_t run() const;
-        virtual LuminosityBlockNumber_t lumi() const;
-        virtual EntryNumber_t entry() const;
-        virtual LuminosityBlockNumber_t peekAheadAtLumi() const;
-        virtual EntryNumber_t peekAheadAtEventEntry() const;
-        virtual bool skipLumiInRun();
-
-      private:
-
-        virtual void initializeLumi_();
-        virtual bool nextEventRange();
-        virtual bool previousEventRange();
-        virtual bool setToLastEventInRange(int index);
-        virtual EntryType getRunOrLumiEntryType(int index) const;
-        virtual bool isSameLumi(int index1, int index2) const;
-        virtual bool isSameRun(int index1, int index2) const;
-      };
 
-      //*****************************************************************************
-      //*****************************************************************************
-
-      class IndexIntoFileItrSorted : public IndexIntoFileItrImpl {
-      public:
-        IndexIntoFileItrSorted(IndexIntoFile const* indexIntoFile,
-                               EntryType entryType,
-                               int indexToRun,
-                               int indexToLumi,
-                               int indexToEventRange,
-                               long long indexToEvent,
-                               long long nEvents);
-
-        virtual IndexIntoFileItrImpl* clone() const;
-        virtual int processHistoryIDIndex() const;
-        virtual RunNumber_t run() const;
-        virtual LuminosityBlockNumber_t lumi() const;
-        virtual EntryNumber_t entry() const;
-        virtual LuminosityBlockNumber_t peekAheadAtLumi() const;
-        virtual EntryNumber_t peekAheadAtEventEntry() const;
-        virtual bool skipLumiInRun();
-
-      private:
-
-        virtual void initializeLumi_();
-        virtual bool nextEventRange();
-        virtual bool previousEventRange();
-        virtual bool setToLastEventInRange(int index);
-        virtual EntryType getRunOrLumiEntryType(int index) const;
-        virtual bool isSameLumi(int index1, int index2) const;
-        virtual bool isSameRun(int index1, int index2) const;
+        std::vector<LuminosityBlockRange> const* lumiMask_;
+        std::vector<LuminosityBlockRange>::size_type maskIndex_;
       };
 
       //*****************************************************************************
@@ -656,30 +717,37 @@ namespace edm {
                          int indexToLumi,
                          int indexToEventRange,
                          long long indexToEvent,
-                         long long nEvents);
+                         long long nEvents,
+                         std::vector<LuminosityBlockRange> const* lumiMask = 0);
 
 
-        EntryType getEntryType() const {return impl_->getEntryType();}
-        int processHistoryIDIndex() const {return impl_->processHistoryIDIndex();}
-        RunNumber_t run() const {return impl_->run();}
-        LuminosityBlockNumber_t lumi() const {return impl_->lumi();}
-        EntryNumber_t entry() const {return impl_->entry();}
+        EntryType getEntryType() const {return impl_.getEntryType();}
+        int processHistoryIDIndex() const {return impl_.processHistoryIDIndex();}
+        RunNumber_t run() const {return impl_.run();}
+        LuminosityBlockNumber_t lumi() const {return impl_.lumi();}
+        EntryNumber_t entry() const {return impl_.entry();}
 
         /// Same as lumi() except when the the current type is kRun.
         /// In that case instead of always returning 0 (invalid), it will return the lumi that will be processed next
-        LuminosityBlockNumber_t peekAheadAtLumi() const { return impl_->peekAheadAtLumi(); }
+        LuminosityBlockNumber_t peekAheadAtLumi() const { return impl_.peekAheadAtLumi(); }
 
         /// Same as entry() except when the the current type is kRun or kLumi.
         /// In that case instead of always returning -1 (invalid), it will return
         /// the event entry that will be processed next and which is in the current
         /// run and lumi. If there is none it still returns -1 (invalid).
-        EntryNumber_t peekAheadAtEventEntry() const { return impl_->peekAheadAtEventEntry(); }
+        EntryNumber_t peekAheadAtEventEntry() const { return impl_.peekAheadAtEventEntry(); }
 
         /// Returns the TTree entry of the first event which would be processed in the
         /// current run/lumi if all the events in the run/lumi were processed in the
         /// current processing order. If there are none it returns -1 (invalid).
-        EntryNumber_t firstEventEntryThisRun() const { return impl_->firstEventEntryThisRun(); }
-        EntryNumber_t firstEventEntryThisLumi() const { return impl_->firstEventEntryThisLumi(); }
+        EntryNumber_t firstEventEntryThisRun() const {
+          IndexIntoFileItrImpl temp(impl_);
+          return temp.firstEventEntryThisRun();
+        }
+        EntryNumber_t firstEventEntryThisLumi() const {
+          IndexIntoFileItrImpl temp(impl_);
+          return temp.firstEventEntryThisLumi();
+        }
 
         // This is intentionally not implemented.
         // It would be difficult to implement for the no sort mode,
@@ -696,7 +764,7 @@ namespace edm {
 
         /// Move to next event to be processed
         IndexIntoFileItr&  operator++() {
-          impl_->next();
+          impl_.next();
           return *this;
         }
 
@@ -709,7 +777,7 @@ namespace edm {
                               RunNumber_t& runOfSkippedEvent,
                               LuminosityBlockNumber_t& lumiOfSkippedEvent,
                               EntryNumber_t& skippedEventEntry) {
-          impl_->skipEventForward(phIndexOfSkippedEvent, runOfSkippedEvent, lumiOfSkippedEvent, skippedEventEntry);
+          impl_.skipEventForward(phIndexOfSkippedEvent, runOfSkippedEvent, lumiOfSkippedEvent, skippedEventEntry);
         }
 
         /// Move so that the event immediately preceding the
@@ -723,25 +791,41 @@ namespace edm {
                                RunNumber_t& runOfEvent,
                                LuminosityBlockNumber_t& lumiOfEvent,
                                EntryNumber_t& eventEntry) {
-          impl_->skipEventBackward(phIndexOfEvent, runOfEvent, lumiOfEvent, eventEntry);
+          impl_.skipEventBackward(phIndexOfEvent, runOfEvent, lumiOfEvent, eventEntry);
         }
 
         /// Move to the next lumi in the current run.
         /// Returns false if there is not one.
-        bool skipLumiInRun() { return impl_->skipLumiInRun(); }
+        bool skipLumiInRun() { return impl_.skipLumiInRun(); }
 
         /// Move to the next event in the current lumi.
         /// Returns false if there is not one.
-        bool skipToNextEventInLumi() { return impl_->skipToNextEventInLumi(); }
+        bool skipToNextEventInLumi() { return impl_.skipToNextEventInLumi(); }
+
+        /// Appends to ranges the TTree entries of the events in the current
+        /// lumi that have not been processed yet, in the order they would be
+        /// processed, starting with the one peekAheadAtEventEntry returns.
+        /// Consecutive entries are merged into one range, so in firstAppearanceOrder
+        /// there is usually a single range. Returns the number of events.
+        /// The iterator is not moved.
+        long long getEventEntryRangesInLumi(std::vector<EntryRange>& ranges) const {
+          return impl_.getEventEntryRangesInLumi(ranges);
+        }
+
+        /// If the current type is kEvent, move to the same position operator++
+        /// reaches after the last event in the current lumi. Together with
+        /// getEventEntryRangesInLumi, this lets a client process the events of
+        /// a lumi as a block. Does nothing for any other type.
+        void skipEventsInLumi() { impl_.skipEventsInLumi(); }
 
-        void advanceToNextRun() {impl_->advanceToNextRun();}
-        void advanceToNextLumiOrRun() {impl_->advanceToNextLumiOrRun();}
+        void advanceToNextRun() {impl_.advanceToNextRun();}
+        void advanceToNextLumiOrRun() {impl_.advanceToNextLumiOrRun();}
 
         void advanceToEvent();
         void advanceToLumi();
 
         bool operator==(IndexIntoFileItr const& right) const {
-          return *impl_ == *right.impl_;
+          return impl_ == right.impl_;
         }
 
         bool operator!=(IndexIntoFileItr const& right) const {
@@ -749,10 +833,10 @@ namespace edm {
         }
 
         /// Should only be used internally and for tests
-        void initializeRun() {impl_->initializeRun();}
+        void initializeRun() {impl_.initializeRun();}
 
         /// Should only be used internally and for tests
-        void initializeLumi() {impl_->initializeLumi();}
+        void initializeLumi() {impl_.initializeLumi();}
 
         /// Copy the position without modifying the pointer to the IndexIntoFile or size
         void copyPosition(IndexIntoFileItr const& position);
@@ -761,16 +845,16 @@ namespace edm {
 
         // The rest of these are intended to be used only by code which tests
         // this class.
-        IndexIntoFile const* indexIntoFile() const { return impl_->indexIntoFile(); }
-        int size() const { return impl_->size(); }
-        EntryType type() const { return impl_->type(); }
-        int indexToRun() const { return impl_->indexToRun(); }
-        int indexToLumi() const { return impl_->indexToLumi(); }
-        int indexToEventRange() const { return impl_->indexToEventRange(); }
-        long long indexToEvent() const { return impl_->indexToEvent(); }
-        long long nEvents() const { return impl_->nEvents(); }
-
-        value_ptr<IndexIntoFileItrImpl> impl_;
+        IndexIntoFile const* indexIntoFile() const { return impl_.indexIntoFile(); }
+        int size() const { return impl_.size(); }
+        EntryType type() const { return impl_.type(); }
+        int indexToRun() const { return impl_.indexToRun(); }
+        int indexToLumi() const { return impl_.indexToLumi(); }
+        int indexToEventRange() const { return impl_.indexToEventRange(); }
+        long long indexToEvent() const { return impl_.indexToEvent(); }
+        long long nEvents() const { return impl_.nEvents(); }
+
+        IndexIntoFileItrImpl impl_;
       };
 
       //*****************************************************************************
@@ -873,6 +957,16 @@ namespace edm {
       public:
         virtual ~EventFinder() {}
         virtual EventNumber_t getEventNumberOfEntry(EntryNumber_t entry) const = 0;
+
+        /// Writes the event numbers of the entries in [begin, end) to
+        /// out[0] through out[end - begin - 1]. IndexIntoFile calls this
+        /// with up to eventNumbersChunkSize entries at a time. Override it
+        /// if the event numbers can be read more efficiently in bulk.
+        virtual void getEventNumbersOfEntries(EntryNumber_t begin, EntryNumber_t end, EventNumber_t* out) const {
+          for(EntryNumber_t entry = begin; entry != end; ++entry) {
+            *out++ = getEventNumberOfEntry(entry);
+          }
+        }
       };
 
       //*****************************************************************************
@@ -955,9 +1049,83 @@ namespace edm {
       /// as fillEventNumbers.  If NeedEventEntries is true, then this function
       /// does the same thing as fillEventEntries.  If both are true, it fills
       /// both within the same loop and it uses less CPU than calling those
-      /// two functions separately.
+      /// two functions separately. When there are many events, groups of
+      /// whole lumis are copied and sorted as concurrent tasks in the
+      /// framework's thread pool. The vectors filled are identical to those
+      /// filled serially.
       void fillEventNumbersOrEntries(bool needEventNumbers, bool needEventEntries) const;
 
+      /// Replaces the vector of 4 byte event numbers with a bit packed
+      /// copy (filling the vector first if necessary) and frees the vector.
+      /// Lookups and duplicate checking work the same way afterwards, but
+      /// the event numbers use much less memory. This is worth doing when
+      /// the event numbers must be kept after the input file is closed,
+      /// for example when duplicate checking across all input files.
+      void compressEventNumbers() const;
+
+      /// Builds a Bloom filter over the run and event numbers of all the events,
+      /// from the unsorted event numbers (read with the EventFinder if not read yet).
+      /// Once there is a filter, findPosition, findEventPosition, containsEvent and
+      /// containsItem reject most events that are not in the file right away,
+      /// without filling or searching the event vectors.
+      void fillEventFilter(unsigned int bitsPerEvent = EventBloomFilter::defaultBitsPerEvent) const;
+
+      /// Uses a filter saved with the file instead of building one. It must have
+      /// been built for this IndexIntoFile, or events in the file may not be found.
+      void setEventFilter(EventBloomFilter const& eventFilter) const {transient_.eventFilter_ = eventFilter;}
+
+      EventBloomFilter const& eventFilter() const {return transient_.eventFilter_;}
+
+      /// Builds the summary levels of an EventSearchIndex for each lumi with at least
+      /// minimumEvents events, filling the event numbers first if neither event vector
+      /// is filled. Afterwards findPosition, findEventPosition and containsEvent use
+      /// them to find events in those lumis. The levels need about 7% of the memory
+      /// of the event numbers and are not changed by compressEventNumbers, but are
+      /// only used while the event numbers are not compressed or the event entries
+      /// are filled.
+      void fillEventSearchIndex(long long minimumEvents = EventSearchIndex::defaultMinimumEvents) const;
+
+      EventSearchIndex const& eventSearchIndex() const {return transient_.eventSearchIndex_;}
+
+      /// The heap memory held by one transient container and the time spent filling it.
+      struct TransientStatistics {
+        TransientStatistics() : bytes_(0U), elements_(0U), fills_(0U), fillSeconds_(0.0) {}
+        std::size_t bytes_;
+        std::size_t elements_;
+        /// Number of times it was filled since the transients were last reset
+        unsigned int fills_;
+        /// Real time spent filling and sorting it, summed over the fills. A call
+        /// that fills two containers at once adds its time to both. The time spent
+        /// filling the containers it is built from is not included.
+        double fillSeconds_;
+      };
+
+      struct Statistics {
+        TransientStatistics runOrLumiIndexes_;
+        TransientStatistics eventNumbers_;
+        TransientStatistics eventEntries_;
+        TransientStatistics unsortedEventNumbers_;
+        TransientStatistics compressedEventNumbers_;
+        TransientStatistics eventFilter_;
+        TransientStatistics eventSearchIndex_;
+        std::size_t totalBytes() const;
+      };
+
+      /// Reports the memory currently held by each transient container and
+      /// the time spent filling it. Cheap enough to call for every file.
+      Statistics statistics() const;
+
+      /// Lets the framework see the statistics of each file at the moment
+      /// inputFileClosed or doneFileInitialization is about to free memory.
+      class StatisticsHook {
+      public:
+        virtual ~StatisticsHook() {}
+        virtual void beforeRelease(IndexIntoFile const& indexIntoFile, Statistics const& statistics) = 0;
+      };
+
+      /// Optional, by default there is no hook. This is reset by initializeTransients.
+      void setStatisticsHook(boost::shared_ptr<StatisticsHook> hook) const {transient_.statisticsHook_ = hook;}
+
       /// If something external to IndexIntoFile is reading through the EventAuxiliary
       /// then it could use this to fill in the event numbers so that IndexIntoFile
       /// will not read through it again.
@@ -1013,18 +1181,50 @@ namespace edm {
         std::vector<EventNumber_t> eventNumbers_;
         std::vector<EventEntry> eventEntries_;
         std::vector<EventNumber_t> unsortedEventNumbers_;
+        CompressedEventNumbers compressedEventNumbers_;
+        EventBloomFilter eventFilter_;
+        EventSearchIndex eventSearchIndex_;
+        // Only the fill counts and times are kept up to date
+        Statistics statistics_;
+        boost::shared_ptr<StatisticsHook> statisticsHook_;
       };
 
     private:
 
+      // Merges the sorted event entries of several files
+      friend class MergedIndexIntoFile;
+      // Reads and writes the transient vectors directly
+      friend class FrozenIndexIntoFile;
+
       /// This function will automatically get called when needed.
       /// It depends only on the fact that the persistent data has been filled already.
       void fillRunOrLumiIndexes() const;
 
       void fillUnsortedEventNumbers() const;
+      void fillEventNumbersOrEntriesConcurrently(bool needEventNumbers, bool needEventEntries, unsigned int nChunks) const;
+      bool containsDuplicateUnsortedEvents() const;
+      void findMatchingLumis(IndexIntoFile const& indexIntoFile,
+                             std::vector<std::pair<RunOrLumiIndexes const*, RunOrLumiIndexes const*> >& matchingLumis) const;
+      bool fillEventsToIntersect(IndexIntoFile const& indexIntoFile) const;
+      template<typename OutputIterator>
+      void intersectMatchingLumis(IndexIntoFile const& indexIntoFile,
+                                  std::vector<std::pair<RunOrLumiIndexes const*, RunOrLumiIndexes const*> > const& matchingLumis,
+                                  std::vector<RunOrLumiIndexes const*>::size_type first,
+                                  std::vector<RunOrLumiIndexes const*>::size_type last,
+                                  bool useEventEntries,
+                                  OutputIterator out) const;
       void resetEventFinder() const {transient_.eventFinder_.reset();}
+      void callStatisticsHook() const;
       std::vector<EventEntry>& eventEntries() const {return transient_.eventEntries_;}
       std::vector<EventNumber_t>& eventNumbers() const {return transient_.eventNumbers_;}
+      CompressedEventNumbers& compressedEventNumbers() const {return transient_.compressedEventNumbers_;}
+      bool hasEventNumbers() const {return !eventNumbers().empty() || !compressedEventNumbers().empty();}
+      bool findEventNumber(long long beginEventNumbers, long long endEventNumbers,
+                           EventNumber_t event, long long& indexToEvent) const;
+      bool findEventEntry(long long beginEventNumbers, long long endEventNumbers,
+                          EventNumber_t event, long long& indexToEvent) const;
+      EventNumber_t const* eventNumbersInRange(long long beginEventNumbers, long long endEventNumbers,
+                                               std::vector<EventNumber_t>& buffer) const;
       void sortEvents() const;
       void sortEventEntries() const;
       int& previousAddedIndex() const {return transient_.previousAddedIndex_;}
@@ -1047,12 +1247,6 @@ namespace edm {
       std::vector<RunOrLumiEntry> runOrLumiEntries_;
   };
 
-  template <>
-  struct value_ptr_traits<IndexIntoFile::IndexIntoFileItrImpl> {
-    static IndexIntoFile::IndexIntoFileItrImpl* clone(IndexIntoFile::IndexIntoFileItrImpl const* p) {return p->clone();}
-  };
-
-
   class Compare_Index_Run {
   public:
     bool operator()(IndexIntoFile::RunOrLumiIndexes const& lh, IndexIntoFile::RunOrLumiIndexes const& rh);
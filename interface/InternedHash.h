@@ -0,0 +1,141 @@
+#ifndef DataFormats_Provenance_InternedHash_h
+#define DataFormats_Provenance_InternedHash_h
+
+/*----------------------------------------------------------------------
+
+InternedHash: A 32 bit handle standing for a Hash<I> within one
+process. HashInterner<I> is the process-wide table assigning a dense
+handle to each distinct Hash<I> the first time it is interned.
+
+Comparing handles for equality is an integer compare. Handles are
+transient: they must never be written to a file, and the ordering of
+handles is the order in which the hashes were first seen, not the
+ordering of the hashes themselves. Use the persistent ID types
+(ProcessHistoryID, ParameterSetID, ...) for anything stored.
+
+Handle 0 always stands for the default constructed (invalid) Hash.
+
+Interning takes a lock. Looking up the Hash for a handle does not,
+because the table never moves or removes an interned Hash. The tables
+are never destroyed, so a reference returned by hash() stays valid
+until the process ends, also during static destruction.
+
+Only the instances for ParameterSetType and ProcessHistoryType are
+defined (in HashInterner.cc).
+
+----------------------------------------------------------------------*/
+
+#include "DataFormats/Provenance/interface/FlatHashMap.h"
+#include "DataFormats/Provenance/interface/Hash.h"
+#include "DataFormats/Provenance/interface/HashedTypes.h"
+#include "FWCore/Utilities/interface/EDMException.h"
+
+#include <atomic>
+#include <mutex>
+
+namespace edm {
+
+  template <int I>
+  class HashInterner {
+  public:
+    typedef unsigned int handle_type;
+
+    static HashInterner* instance();
+
+    /// Return the handle for hash, assigning a new one if needed.
+    handle_type intern(Hash<I> const& hash) {
+      std::lock_guard<std::mutex> guard(mutex_);
+      typename Map::const_iterator it = handles_.find(hash);
+      if(it != handles_.end()) {
+        return it->second;
+      }
+      handle_type const next = size_.load(std::memory_order_relaxed);
+      append(hash, next);
+      handles_.insert(typename Map::value_type(hash, next));
+      return next;
+    }
+
+    /// The Hash for a handle previously returned by intern.
+    Hash<I> const& hash(handle_type handle) const {
+      return chunks_[handle >> kChunkBits].load(std::memory_order_acquire)[handle & kChunkMask];
+    }
+
+    /// The number of distinct hashes interned so far.
+    handle_type size() const {return size_.load(std::memory_order_acquire);}
+
+  private:
+    typedef FlatHashMap<Hash<I>, handle_type> Map;
+
+    static unsigned int const kChunkBits = 12;
+    static handle_type const kChunkSize = 1U << kChunkBits;
+    static handle_type const kChunkMask = kChunkSize - 1;
+    static unsigned int const kMaxChunks = 1U << 14;
+
+    HashInterner() : mutex_(), handles_(), size_(0) {
+      for(unsigned int i = 0; i < kMaxChunks; ++i) {
+        chunks_[i].store(0, std::memory_order_relaxed);
+      }
+      intern(Hash<I>());
+    }
+
+    ~HashInterner() {
+      for(unsigned int i = 0; i < kMaxChunks; ++i) {
+        delete [] chunks_[i].load(std::memory_order_relaxed);
+      }
+    }
+
+    HashInterner(HashInterner const&);
+    HashInterner& operator=(HashInterner const&);
+
+    // Called with mutex_ held.
+    void append(Hash<I> const& hash, handle_type handle) {
+      unsigned int const iChunk = handle >> kChunkBits;
+      if(iChunk >= kMaxChunks) {
+        throw Exception(errors::LogicError)
+          << "HashInterner: more than " << kMaxChunks * kChunkSize << " distinct hashes interned\n";
+      }
+      Hash<I>* chunk = chunks_[iChunk].load(std::memory_order_relaxed);
+      if(chunk == 0) {
+        chunk = new Hash<I>[kChunkSize];
+        chunks_[iChunk].store(chunk, std::memory_order_release);
+      }
+      chunk[handle & kChunkMask] = hash;
+      size_.store(handle + 1, std::memory_order_release);
+    }
+
+    std::mutex mutex_;
+    Map handles_;
+    std::atomic<handle_type> size_;
+    std::atomic<Hash<I>*> chunks_[kMaxChunks];
+  };
+
+  template <> HashInterner<ParameterSetType>* HashInterner<ParameterSetType>::instance();
+  template <> HashInterner<ProcessHistoryType>* HashInterner<ProcessHistoryType>::instance();
+
+  template <int I>
+  class InternedHash {
+  public:
+    typedef typename HashInterner<I>::handle_type handle_type;
+
+    /// The handle of the invalid Hash. Does not touch the table.
+    InternedHash() : handle_(0) {}
+
+    explicit InternedHash(Hash<I> const& hash) : handle_(HashInterner<I>::instance()->intern(hash)) {}
+
+    Hash<I> const& hash() const {return HashInterner<I>::instance()->hash(handle_);}
+    handle_type handle() const {return handle_;}
+    bool isValid() const {return handle_ != 0;}
+
+    bool operator==(InternedHash<I> const& other) const {return handle_ == other.handle_;}
+    bool operator!=(InternedHash<I> const& other) const {return handle_ != other.handle_;}
+    // Order of first interning, NOT the order of the hashes.
+    bool operator<(InternedHash<I> const& other) const {return handle_ < other.handle_;}
+
+  private:
+    handle_type handle_;
+  };
+
+  typedef InternedHash<ParameterSetType> InternedParameterSetID;
+  typedef InternedHash<ProcessHistoryType> InternedProcessHistoryID;
+}
+#endif
@@ -0,0 +1,136 @@
+#ifndef DataFormats_Provenance_MergedIndexIntoFile_h
+#define DataFormats_Provenance_MergedIndexIntoFile_h
+
+/*----------------------------------------------------------------------
+
+MergedIndexIntoFile: Numerical order iteration over the events of
+several IndexIntoFile objects, as if they were a single file.
+
+Each IndexIntoFile already knows its own events in numerical order
+(ProcessHistoryID index, run, lumi, event). This class merges those
+sorted streams with a heap, so getting the next event costs
+O(log(number of files)) and nothing is copied or sorted again. Events
+with the same key are returned in file order.
+
+The same merge detects duplicate events across all the files in one
+pass, instead of intersecting every pair of files.
+
+The ProcessHistoryID indexes must be consistent across the files, as
+they are after calling IndexIntoFile::fixIndexes on each file with the
+same vector (PoolSource does this when duplicate checking across
+files). The constructor throws if they are not. The event entries of
+every file are filled when needed, so either they must already be
+filled or the EventFinder of the file must still be usable.
+
+The IndexIntoFile objects must outlive this object and must not be
+modified while it is in use.
+
+----------------------------------------------------------------------*/
+
+#include "DataFormats/Provenance/interface/IndexIntoFile.h"
+
+#include <vector>
+
+namespace edm {
+
+  class MergedIndexIntoFile {
+  public:
+    typedef IndexIntoFile::EntryNumber_t EntryNumber_t;
+
+    class Event {
+    public:
+      Event() : fileIndex_(-1),
+                processHistoryIDIndex_(IndexIntoFile::invalidIndex),
+                run_(IndexIntoFile::invalidRun),
+                lumi_(IndexIntoFile::invalidLumi),
+                event_(IndexIntoFile::invalidEvent),
+                entry_(IndexIntoFile::invalidEntry) {}
+      Event(int fileIndex, int processHistoryIDIndex, RunNumber_t run,
+            LuminosityBlockNumber_t lumi, EventNumber_t event, EntryNumber_t entry) :
+        fileIndex_(fileIndex),
+        processHistoryIDIndex_(processHistoryIDIndex),
+        run_(run),
+        lumi_(lumi),
+        event_(event),
+        entry_(entry) {}
+
+      /// Position of the file in the vector passed to the constructor
+      int fileIndex() const {return fileIndex_;}
+      int processHistoryIDIndex() const {return processHistoryIDIndex_;}
+      RunNumber_t run() const {return run_;}
+      LuminosityBlockNumber_t lumi() const {return lumi_;}
+      EventNumber_t event() const {return event_;}
+      /// TTree entry of the event in its file
+      EntryNumber_t entry() const {return entry_;}
+
+    private:
+      int fileIndex_;
+      int processHistoryIDIndex_;
+      RunNumber_t run_;
+      LuminosityBlockNumber_t lumi_;
+      EventNumber_t event_;
+      EntryNumber_t entry_;
+    };
+
+    explicit MergedIndexIntoFile(std::vector<IndexIntoFile const*> const& indexIntoFiles);
+
+    /// Go back to the first event.
+    void rewind();
+
+    /// Sets event to the next event in numerical order and returns true,
+    /// or returns false if there are no more events.
+    bool next(Event& event);
+
+    /// Appends to duplicates every event with the same ProcessHistoryID,
+    /// run, lumi and event number as an event that comes before it, in an
+    /// earlier file or earlier in the same file. These are the events a
+    /// duplicate checker reading the files in order would skip.
+    /// Does not affect the iteration with next.
+    void findDuplicateEvents(std::vector<Event>& duplicates) const;
+
+  private:
+    // The sorted events of one file
+    class FileStream {
+    public:
+      FileStream(IndexIntoFile const* indexIntoFile, int fileIndex);
+
+      /// Moves to the first event
+      bool begin();
+      /// Moves to the next event
+      bool advance();
+
+      Event event() const;
+      bool operator<(FileStream const& right) const;
+
+    private:
+      bool nextLumiWithEvents();
+
+      IndexIntoFile const* indexIntoFile_;
+      int fileIndex_;
+      IndexIntoFile::SortedRunOrLumiItr runOrLumi_;
+      IndexIntoFile::SortedRunOrLumiItr runOrLumiEnd_;
+      IndexIntoFile::RunOrLumiIndexes const* lumi_;
+      long long indexToEvent_;
+      long long endEventNumbers_;
+    };
+
+    // Min-heap of the streams which still have events
+    class Merge {
+    public:
+      explicit Merge(std::vector<FileStream> const& files);
+      bool next(Event& event);
+
+    private:
+      std::vector<FileStream> heap_;
+      // Greater, so the std heap algorithms keep the smallest on top
+      struct Later {
+        bool operator()(FileStream const& left, FileStream const& right) const {return right < left;}
+      };
+    };
+
+    std::vector<FileStream> files_;
+    Merge merge_;
+  };
+}
+
+#endif
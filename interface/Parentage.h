@@ -49,6 +49,8 @@ namespace edm {
 
 
   private:
+    friend void fillParentageIDs(std::vector<Parentage> const& parentages);
+
     ParentageID& parentageID() const {return transient_.parentageID_;}
     // The Branch IDs of the parents
     std::vector<BranchID> parents_;
@@ -70,6 +72,11 @@ namespace edm {
     return os;
   }
 
+  // Compute and cache the IDs of all the Parentage objects in the
+  // vector. Each distinct list of parents is digested only once, which
+  // pays off because many products in an event share their parents.
+  void fillParentageIDs(std::vector<Parentage> const& parentages);
+
   // Only the 'salient attributes' are testing in equality comparison.
   bool operator==(Parentage const& a, Parentage const& b);
   inline bool operator!=(Parentage const& a, Parentage const& b) { return !(a == b); }
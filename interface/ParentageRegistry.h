@@ -5,6 +5,7 @@
 #include "DataFormats/Provenance/interface/Parentage.h"
 #include "DataFormats/Provenance/interface/ParentageID.h"
 
+#include <vector>
 
 // Note that this registry is *not* directly persistable. The contents
 // are persisted, but not the container.
@@ -12,6 +13,10 @@ namespace edm
 {
   typedef edm::detail::ThreadSafeRegistry<edm::ParentageID, edm::Parentage> ParentageRegistry;
   typedef ParentageRegistry::collection_type ParentageMap;
+
+  // Compute the IDs of all the Parentage objects (see fillParentageIDs)
+  // and insert them all into the registry with a single call.
+  void registerParentages(std::vector<Parentage> const& parentages);
 }
 
 #endif
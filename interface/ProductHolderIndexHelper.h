@@ -57,7 +57,6 @@ ProductRegistry is frozen.
 
 #include <iosfwd>
 #include <memory>
-#include <set>
 #include <string>
 #include <vector>
 
@@ -129,6 +128,46 @@ namespace edm {
     relatedIndexes(KindOfType kindOfType,
                    TypeID const& typeID) const;
 
+    // The arguments of one lookup for the batch functions
+    // below. The pointers must remain valid during the call
+    // and follow the same rules as the arguments of index.
+    class IndexRequest {
+    public:
+      IndexRequest(KindOfType kindOfType,
+                   TypeID const& typeID,
+                   char const* moduleLabel,
+                   char const* instance,
+                   char const* process = 0) :
+        kindOfType_(kindOfType), typeID_(typeID),
+        moduleLabel_(moduleLabel), instance_(instance), process_(process) { }
+      KindOfType kindOfType() const { return kindOfType_; }
+      TypeID const& typeID() const { return typeID_; }
+      char const* moduleLabel() const { return moduleLabel_; }
+      char const* instance() const { return instance_; }
+      char const* process() const { return process_; }
+    private:
+      KindOfType kindOfType_;
+      TypeID typeID_;
+      char const* moduleLabel_;
+      char const* instance_;
+      char const* process_;
+    };
+
+    // Batch versions of index and of the relatedIndexes function
+    // taking a label and instance, for resolving many requests at
+    // once (for example all the InputTags of the modules in a
+    // process). The results are the same as calling the single
+    // lookups for each request in order, and are returned in the
+    // order of the requests. The requests are sorted and then
+    // resolved with one merge pass over the sorted tables, or with
+    // the hash table if there is one. relatedIndexes ignores the
+    // process of the requests.
+    void indexes(std::vector<IndexRequest> const& requests,
+                 std::vector<ProductHolderIndex>& results) const;
+
+    void relatedIndexes(std::vector<IndexRequest> const& requests,
+                        std::vector<Matches>& results) const;
+
     // This will throw if called after the object is frozen.
     // The typeID must be for a type with a dictionary
     // (the calling function is expected to check that)
@@ -160,7 +199,15 @@ namespace edm {
     // Before the object is frozen the accessors above will
     // fail to find a match. Once frozen, no more new entries
     // can be added with insert.
-    void setFrozen();
+    // If hashedLookup is true, this also builds a minimal perfect
+    // hash table over the type, label, instance and process of all
+    // the entries. After that index and the relatedIndexes function
+    // taking a label and instance find an entry with one hash table
+    // lookup and one comparison of the key instead of the binary
+    // searches. The results are the same either way.
+    void setFrozen(bool hashedLookup = false);
+
+    bool hasHashedLookup() const { return !hashSlots_.empty(); }
 
     std::vector<std::string> const& lookupProcessNames() const;
 
@@ -206,6 +253,21 @@ namespace edm {
     // int value if the type is not there.
     unsigned int indexToType(KindOfType kindOfType, TypeID const& typeID) const;
 
+    // Same as indexToIndexAndNames, using the hash table. Must
+    // only be called if hasHashedLookup() is true.
+    unsigned int hashedIndexToIndexAndNames(KindOfType kindOfType,
+                                            TypeID const& typeID,
+                                            char const* moduleLabel,
+                                            char const* instance,
+                                            char const* process) const;
+
+    // Fills iToIndexAndNames with the result of indexToIndexAndNames
+    // for each request, ignoring the process of the requests if
+    // useProcess is false.
+    void indexesToIndexAndNames(std::vector<IndexRequest> const& requests,
+                                bool useProcess,
+                                std::vector<unsigned int>& iToIndexAndNames) const;
+
     // Returns the index of the process name in processNames_. Returns the
     // maximum unsigned int value if the process name is not found.
     unsigned int processIndex(char const* process) const;
@@ -222,6 +284,10 @@ namespace edm {
 
   private:
 
+    // The matches of relatedIndexes starting with the entry
+    // with an empty process at startInIndexAndNames
+    Matches matchesWithSameNames(unsigned int startInIndexAndNames) const;
+
     // Next available value for a ProductHolderIndex. This just
     // increments by one each time a new value is assigned.
     ProductHolderIndex nextIndexValue_;
@@ -274,41 +340,113 @@ namespace edm {
     // a convenient format.
     std::vector<std::string> lookupProcessNames_;
 
+    // The optional minimal perfect hash table. The hash of a key
+    // selects a bucket, and the seed of that bucket selects the slot
+    // of the key. The seeds are chosen by fillHashedLookup so that each
+    // entry in indexAndNames_ has a slot of its own. The slot also holds
+    // the full hash of its key, so most lookups of keys that are not
+    // in the table are rejected without comparing names.
+    class HashSlot {
+    public:
+      HashSlot() : hash_(0), indexToIndexAndNames_(0), indexToType_(0) { }
+      HashSlot(unsigned long long hash, unsigned int iToIndexAndNames, unsigned int iToType) :
+        hash_(hash), indexToIndexAndNames_(iToIndexAndNames), indexToType_(iToType) { }
+      unsigned long long hash() const { return hash_; }
+      unsigned int indexToIndexAndNames() const { return indexToIndexAndNames_; }
+      unsigned int indexToType() const { return indexToType_; }
+    private:
+      unsigned long long hash_;
+      unsigned int indexToIndexAndNames_;
+      unsigned int indexToType_;
+    };
+
+    void fillHashedLookup();
+
+    unsigned long long hashSalt_;
+    std::vector<unsigned int> hashSeeds_;
+    std::vector<HashSlot> hashSlots_;
+
     // The rest of the data members are for temporary use
     // while the data structure is being filled.
 
+    // One Item is appended for each entry that insert makes. The
+    // names are ids of strings in Items. Entries of element types
+    // with a process name can repeat, setFrozen marks those ambiguous.
     class Item {
     public:
       Item(KindOfType kindOfType,
            TypeID const& typeID,
-           std::string const& moduleLabel,
-           std::string const& instance,
-           std::string const& process,
-           ProductHolderIndex index);
+           unsigned int moduleLabel,
+           unsigned int instance,
+           unsigned int process,
+           ProductHolderIndex index) :
+        typeID_(typeID), kindOfType_(kindOfType), moduleLabel_(moduleLabel),
+        instance_(instance), process_(process), index_(index) { }
       KindOfType kindOfType() const { return kindOfType_; }
       TypeID const& typeID() const { return typeID_; }
-      std::string const& moduleLabel() const { return moduleLabel_; }
-      std::string const& instance() const { return instance_; }
-      std::string const& process() const { return process_; }
+      unsigned int moduleLabel() const { return moduleLabel_; }
+      unsigned int instance() const { return instance_; }
+      unsigned int process() const { return process_; }
       ProductHolderIndex index() const { return index_; }
 
-      void clearProcess() { process_.clear(); }
-      void setIndex(ProductHolderIndex v) { index_ = v; }
-
-      bool operator<(Item const& right) const;
+      bool sameKey(Item const& right) const {
+        return kindOfType_ == right.kindOfType_ && typeID_ == right.typeID_ &&
+          moduleLabel_ == right.moduleLabel_ && instance_ == right.instance_ &&
+          process_ == right.process_;
+      }
 
     private:
-      KindOfType kindOfType_;
       TypeID typeID_;
-      std::string moduleLabel_;
-      std::string instance_;
-      std::string process_;
+      KindOfType kindOfType_;
+      unsigned int moduleLabel_;
+      unsigned int instance_;
+      unsigned int process_;
       ProductHolderIndex index_;
     };
 
-    std::unique_ptr<std::set<Item> > items_;
+    // Holds the Items and the strings they refer to, each string
+    // stored once. Both are found through small open addressing
+    // hash tables.
+    class Items {
+    public:
+      Items();
+
+      // The id of the empty string
+      static unsigned int const emptyString = 0;
+
+      // Returns the id of the string, adding it if it is new
+      unsigned int stringID(char const* string);
+
+      char const* string(unsigned int id) const { return &characters_[starts_[id]]; }
+      unsigned int stringSize(unsigned int id) const { return starts_[id + 1] - starts_[id] - 1; }
+      unsigned int numberOfStrings() const { return starts_.size() - 1; }
+
+      // Appends the item unless an item with the same key was
+      // added by this function before. Returns true if it appended it.
+      bool insertUnique(Item const& item);
+
+      void append(Item const& item) { items_.push_back(item); }
+
+      std::vector<Item>& items() { return items_; }
+      std::vector<Item> const& items() const { return items_; }
+
+    private:
+      unsigned long long hash(Item const& item) const;
+
+      // The strings are concatenated with their terminating '\0'
+      // in characters_. starts_ has one extra element at the end.
+      std::vector<char> characters_;
+      std::vector<unsigned int> starts_;
+      // Zero for an empty slot, otherwise one plus the id
+      std::vector<unsigned int> stringSlots_;
+
+      std::vector<Item> items_;
+      // Zero for an empty slot, otherwise one plus the position in items_
+      std::vector<unsigned int> itemSlots_;
+      unsigned int numberOfUniqueItems_;
+    };
 
-    std::unique_ptr<std::set<std::string> > processItems_;
+    std::unique_ptr<Items> items_;
   };
 }
 #endif
@@ -0,0 +1,33 @@
+#ifndef DataFormats_Provenance_ChunkTasks_h
+#define DataFormats_Provenance_ChunkTasks_h
+
+/*----------------------------------------------------------------------
+
+forEachChunk: Private to the package. Calls work(chunk) for each chunk
+in [0, nChunks) as tasks of a tbb::task_group, so the chunks run on the
+threads of the framework's thread pool, as many at a time as it allows,
+and returns when all of them have finished. If any chunk throws, the
+exception is rethrown after the others have finished or been cancelled.
+With one chunk, work(0) is called directly.
+
+----------------------------------------------------------------------*/
+
+#include "tbb/task_group.h"
+
+namespace edm {
+  namespace detail {
+    template<typename Work>
+    void forEachChunk(unsigned int nChunks, Work const& work) {
+      if(nChunks < 2U) {
+        if(nChunks == 1U) work(0U);
+        return;
+      }
+      tbb::task_group group;
+      for(unsigned int chunk = 1; chunk < nChunks; ++chunk) {
+        group.run([&work, chunk]() {work(chunk);});
+      }
+      group.run_and_wait([&work]() {work(0U);});
+    }
+  }
+}
+#endif
@@ -0,0 +1,242 @@
+#include "DataFormats/Provenance/interface/ColumnarFileIndex.h"
+#include "DataFormats/Provenance/interface/IndexIntoFile.h"
+#include "FWCore/Utilities/interface/EDMException.h"
+
+#include <algorithm>
+
+namespace edm {
+
+  ColumnarFileIndex::ColumnarFileIndex(FileIndex const& fileIndex) :
+    runs_(),
+    lumis_(),
+    events_(),
+    entries_(),
+    directory_(),
+    numberOfEvents_(0U),
+    allEventsInEntryOrder_(true) {
+
+    // Files are written sorted by run, lumi and event. Otherwise a sorted copy is used.
+    std::vector<FileIndex::Element> sorted;
+    FileIndex::const_iterator begin = fileIndex.begin();
+    FileIndex::const_iterator end = fileIndex.end();
+    if(!std::is_sorted(begin, end)) {
+      sorted.assign(begin, end);
+      std::stable_sort(sorted.begin(), sorted.end());
+      begin = sorted.begin();
+      end = sorted.end();
+    }
+
+    size_type n = end - begin;
+    runs_.reserve(n);
+    lumis_.reserve(n);
+    events_.reserve(n);
+    entries_.reserve(n);
+    EntryNumber_t maxEventEntry = FileIndex::Element::invalidEntry;
+    for(FileIndex::const_iterator it = begin; it != end; ++it) {
+      size_type i = runs_.size();
+      if(directory_.empty() || directory_.back().run_ != it->run_ || directory_.back().lumi_ != it->lumi_) {
+        if(!directory_.empty()) directory_.back().end_ = i;
+        Group group;
+        group.run_ = it->run_;
+        group.lumi_ = it->lumi_;
+        group.begin_ = i;
+        group.beginEvents_ = i;
+        group.end_ = i;
+        directory_.push_back(group);
+      }
+      // Within a run or lumi the elements with event 0 sort first
+      if(it->event_ == 0U) {
+        directory_.back().beginEvents_ = i + 1;
+      } else {
+        ++numberOfEvents_;
+        if(it->entry_ < maxEventEntry) allEventsInEntryOrder_ = false;
+        maxEventEntry = std::max(maxEventEntry, it->entry_);
+      }
+      runs_.push_back(it->run_);
+      lumis_.push_back(it->lumi_);
+      events_.push_back(it->event_);
+      entries_.push_back(it->entry_);
+    }
+    if(!directory_.empty()) directory_.back().end_ = runs_.size();
+  }
+
+  std::vector<ColumnarFileIndex::Group>::const_iterator
+  ColumnarFileIndex::findGroup(RunNumber_t run, LuminosityBlockNumber_t lumi) const {
+    std::vector<Group>::const_iterator it = std::lower_bound(directory_.begin(), directory_.end(), run,
+      [lumi](Group const& group, RunNumber_t run) {
+        return group.run_ < run || (group.run_ == run && group.lumi_ < lumi);
+      });
+    if(it == directory_.end() || it->run_ != run || it->lumi_ != lumi) return directory_.end();
+    return it;
+  }
+
+  ColumnarFileIndex::size_type
+  ColumnarFileIndex::findEventInGroup(Group const& group, EventNumber_t event) const {
+    return std::lower_bound(events_.begin() + group.beginEvents_, events_.begin() + group.end_, event) - events_.begin();
+  }
+
+  ColumnarFileIndex::size_type
+  ColumnarFileIndex::findEventPosition(RunNumber_t run, LuminosityBlockNumber_t lumi, EventNumber_t event) const {
+    if(lumi != 0U) {
+      std::vector<Group>::const_iterator group = findGroup(run, lumi);
+      if(group == directory_.end()) return size();
+      size_type i = findEventInGroup(*group, event);
+      return (i != group->end_ && events_[i] == event) ? i : size();
+    }
+    // Like FileIndex, stop at the first event of the run whose event number is not
+    // less than event, looking through the lumis in order, and check only that one.
+    std::vector<Group>::const_iterator group = std::lower_bound(directory_.begin(), directory_.end(), run,
+      [](Group const& group, RunNumber_t run) {return group.run_ < run;});
+    for(; group != directory_.end() && group->run_ == run; ++group) {
+      size_type i = findEventInGroup(*group, event);
+      if(i != group->end_) return events_[i] == event ? i : size();
+    }
+    return size();
+  }
+
+  ColumnarFileIndex::size_type
+  ColumnarFileIndex::findLumiPosition(RunNumber_t run, LuminosityBlockNumber_t lumi) const {
+    if(lumi == 0U) return size();
+    std::vector<Group>::const_iterator group = findGroup(run, lumi);
+    if(group == directory_.end() || group->begin_ == group->beginEvents_) return size();
+    return group->begin_;
+  }
+
+  ColumnarFileIndex::size_type
+  ColumnarFileIndex::findRunPosition(RunNumber_t run) const {
+    std::vector<Group>::const_iterator group = findGroup(run, 0U);
+    if(group == directory_.end()) return size();
+    return group->begin_;
+  }
+
+  namespace {
+    // Events with consecutive entries in the same lumi
+    struct EventRange {
+      std::vector<int>::size_type group_;
+      FileIndex::EntryNumber_t beginEvents_;
+      FileIndex::EntryNumber_t endEvents_;
+    };
+
+    void throwMissingEntry(char const* what) {
+      throw Exception(errors::LogicError)
+        << "In ColumnarFileIndex::fillIndexIntoFile. " << what << " is missing.\n"
+        << "The FileIndex of the input file is not consistent.\n";
+    }
+  }
+
+  void
+  ColumnarFileIndex::fillIndexIntoFile(IndexIntoFile& indexIntoFile, ProcessHistoryID const& processHistoryID) const {
+    if(!indexIntoFile.runOrLumiEntries().empty()) {
+      throw Exception(errors::LogicError)
+        << "In ColumnarFileIndex::fillIndexIntoFile. The IndexIntoFile is not empty.\n";
+    }
+    typedef std::vector<Group>::size_type group_type;
+    group_type const nGroups = directory_.size();
+    EntryNumber_t const invalidEntry = IndexIntoFile::invalidEntry;
+
+    // The first entry of each run and lumi orders the runs and lumis
+    std::vector<EntryNumber_t> firstEntry(nGroups, invalidEntry);
+    EntryNumber_t maxEventEntry = invalidEntry;
+    for(group_type g = 0; g < nGroups; ++g) {
+      Group const& group = directory_[g];
+      for(size_type i = group.begin_; i < group.beginEvents_; ++i) {
+        if(firstEntry[g] == invalidEntry || entries_[i] < firstEntry[g]) firstEntry[g] = entries_[i];
+      }
+      if(group.lumi_ == 0U) continue;
+      if(firstEntry[g] == invalidEntry) throwMissingEntry("A lumi entry");
+      for(size_type i = group.beginEvents_; i < group.end_; ++i) {
+        if(entries_[i] < 0) throwMissingEntry("An event entry");
+        maxEventEntry = std::max(maxEventEntry, entries_[i]);
+      }
+    }
+
+    // One pass over the event entries in order finds the event ranges
+    std::vector<group_type> groupOfEntry(maxEventEntry + 1, nGroups);
+    for(group_type g = 0; g < nGroups; ++g) {
+      for(size_type i = directory_[g].beginEvents_; i < directory_[g].end_; ++i) {
+        groupOfEntry[entries_[i]] = g;
+      }
+    }
+    std::vector<EventRange> ranges;
+    std::vector<size_type> rangesOfGroup(nGroups + 1, 0U);
+    for(EntryNumber_t entry = 0; entry <= maxEventEntry; ++entry) {
+      group_type g = groupOfEntry[entry];
+      if(g == nGroups) continue;
+      if(!ranges.empty() && ranges.back().group_ == g && ranges.back().endEvents_ == entry) {
+        ++ranges.back().endEvents_;
+      } else {
+        EventRange range = {g, entry, entry + 1};
+        ranges.push_back(range);
+        ++rangesOfGroup[g + 1];
+      }
+    }
+    // Group the ranges by lumi, keeping their order, with a counting sort
+    for(group_type g = 0; g < nGroups; ++g) {
+      rangesOfGroup[g + 1] += rangesOfGroup[g];
+    }
+    std::vector<EventRange> rangesByGroup(ranges.size());
+    {
+      std::vector<size_type> next(rangesOfGroup.begin(), rangesOfGroup.end() - 1);
+      for(std::vector<EventRange>::const_iterator it = ranges.begin(), itEnd = ranges.end(); it != itEnd; ++it) {
+        rangesByGroup[next[it->group_]++] = *it;
+      }
+    }
+
+    // The runs, each followed by the directory positions of its lumis
+    std::vector<group_type> runGroups;
+    for(group_type g = 0; g < nGroups; ++g) {
+      if(directory_[g].lumi_ == 0U) {
+        runGroups.push_back(g);
+      } else if(runGroups.empty() || directory_[runGroups.back()].run_ != directory_[g].run_) {
+        throwMissingEntry("A run entry");
+      }
+    }
+    std::vector<group_type> runOrder(runGroups);
+    std::stable_sort(runOrder.begin(), runOrder.end(),
+      [&firstEntry](group_type left, group_type right) {return firstEntry[left] < firstEntry[right];});
+
+    std::vector<IndexIntoFile::RunOrLumiEntry> runOrLumiEntries;
+    runOrLumiEntries.reserve(size() - numberOfEvents_ + ranges.size());
+    std::vector<EntryNumber_t> sortedEntries;
+    std::vector<group_type> lumiOrder;
+    for(std::vector<group_type>::const_iterator it = runOrder.begin(), itEnd = runOrder.end(); it != itEnd; ++it) {
+      Group const& runGroup = directory_[*it];
+      EntryNumber_t orderPHIDRun = firstEntry[*it];
+
+      sortedEntries.assign(entries_.begin() + runGroup.begin_, entries_.begin() + runGroup.beginEvents_);
+      std::sort(sortedEntries.begin(), sortedEntries.end());
+      for(std::vector<EntryNumber_t>::const_iterator entry = sortedEntries.begin(); entry != sortedEntries.end(); ++entry) {
+        runOrLumiEntries.emplace_back(orderPHIDRun, invalidEntry, *entry, 0, runGroup.run_, 0U, invalidEntry, invalidEntry);
+      }
+
+      lumiOrder.clear();
+      for(group_type g = *it + 1; g < nGroups && directory_[g].lumi_ != 0U; ++g) {
+        lumiOrder.push_back(g);
+      }
+      std::stable_sort(lumiOrder.begin(), lumiOrder.end(),
+        [&firstEntry](group_type left, group_type right) {return firstEntry[left] < firstEntry[right];});
+
+      for(std::vector<group_type>::const_iterator g = lumiOrder.begin(), gEnd = lumiOrder.end(); g != gEnd; ++g) {
+        Group const& lumiGroup = directory_[*g];
+        EntryNumber_t orderPHIDRunLumi = firstEntry[*g];
+        for(size_type r = rangesOfGroup[*g]; r < rangesOfGroup[*g + 1]; ++r) {
+          runOrLumiEntries.emplace_back(orderPHIDRun, orderPHIDRunLumi, orderPHIDRunLumi, 0, lumiGroup.run_, lumiGroup.lumi_,
+                                        rangesByGroup[r].beginEvents_, rangesByGroup[r].endEvents_);
+        }
+        // The other lumi entries, or all of them if the lumi has no events
+        sortedEntries.assign(entries_.begin() + lumiGroup.begin_, entries_.begin() + lumiGroup.beginEvents_);
+        std::sort(sortedEntries.begin(), sortedEntries.end());
+        std::vector<EntryNumber_t>::const_iterator entry = sortedEntries.begin();
+        if(rangesOfGroup[*g] != rangesOfGroup[*g + 1]) ++entry;
+        for(; entry != sortedEntries.end(); ++entry) {
+          runOrLumiEntries.emplace_back(orderPHIDRun, orderPHIDRunLumi, *entry, 0, lumiGroup.run_, lumiGroup.lumi_,
+                                        invalidEntry, invalidEntry);
+        }
+      }
+    }
+
+    indexIntoFile.setProcessHistoryIDs().assign(1U, processHistoryID);
+    indexIntoFile.setRunOrLumiEntries().swap(runOrLumiEntries);
+    indexIntoFile.setNumberOfEvents(numberOfEvents_);
+  }
+}
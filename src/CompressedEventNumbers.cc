@@ -0,0 +1,108 @@
+#include "DataFormats/Provenance/interface/CompressedEventNumbers.h"
+
+#include <algorithm>
+
+namespace edm {
+
+  CompressedEventNumbers::size_type const CompressedEventNumbers::kBlockSize;
+
+  CompressedEventNumbers::CompressedEventNumbers() : blocks_(), words_(), size_(0U) {
+  }
+
+  void
+  CompressedEventNumbers::assign(std::vector<EventNumber_t> const& eventNumbers) {
+    clear();
+    size_ = eventNumbers.size();
+    size_type nBlocks = (size_ + kBlockSize - 1) / kBlockSize;
+    blocks_.resize(nBlocks);
+
+    // First pass sizes every block so words_ is allocated only once
+    unsigned long long nWords = 0;
+    for(size_type iBlock = 0; iBlock < nBlocks; ++iBlock) {
+      std::vector<EventNumber_t>::const_iterator first = eventNumbers.begin() + iBlock * kBlockSize;
+      std::vector<EventNumber_t>::const_iterator last = eventNumbers.begin() + std::min(size_, (iBlock + 1) * kBlockSize);
+      std::pair<std::vector<EventNumber_t>::const_iterator,
+                std::vector<EventNumber_t>::const_iterator> minMax = std::minmax_element(first, last);
+      EventNumber_t range = *minMax.second - *minMax.first;
+      unsigned int width = 0;
+      while(width < 32 && (range >> width) != 0) ++width;
+
+      Block& block = blocks_[iBlock];
+      block.offset_ = nWords;
+      block.base_ = *minMax.first;
+      block.width_ = width;
+      nWords += ((last - first) * width + 63) / 64;
+    }
+    // One spare word so that operator[] may always read word[1]
+    words_.assign(nWords + 1, 0ULL);
+
+    for(size_type iBlock = 0; iBlock < nBlocks; ++iBlock) {
+      Block const& block = blocks_[iBlock];
+      if(block.width_ == 0) continue;
+      size_type iEnd = std::min(size_, (iBlock + 1) * kBlockSize);
+      unsigned long long bit = 0;
+      for(size_type i = iBlock * kBlockSize; i < iEnd; ++i, bit += block.width_) {
+        unsigned long long value = eventNumbers[i] - block.base_;
+        unsigned long long* word = &words_[block.offset_ + (bit >> 6)];
+        unsigned int shift = bit & 63;
+        word[0] |= value << shift;
+        if(shift + block.width_ > 64) {
+          word[1] |= value >> (64 - shift);
+        }
+      }
+    }
+  }
+
+  void
+  CompressedEventNumbers::clear() {
+    std::vector<Block>().swap(blocks_);
+    std::vector<unsigned long long>().swap(words_);
+    size_ = 0U;
+  }
+
+  CompressedEventNumbers::size_type
+  CompressedEventNumbers::lower_bound(size_type begin, size_type end, EventNumber_t event) const {
+    if(begin >= end) return end;
+
+    // Use the first element of each block starting inside (begin, end)
+    // to narrow the search to at most one block worth of elements.
+    size_type low = begin;
+    size_type high = end;
+    size_type firstBlock = begin / kBlockSize + 1;
+    size_type lastBlock = (end - 1) / kBlockSize + 1;
+    while(firstBlock < lastBlock) {
+      size_type middle = firstBlock + (lastBlock - firstBlock) / 2;
+      if((*this)[middle * kBlockSize] < event) {
+        low = middle * kBlockSize + 1;
+        firstBlock = middle + 1;
+      } else {
+        high = middle * kBlockSize;
+        lastBlock = middle;
+      }
+    }
+
+    size_type count = high - low;
+    while(count > 0) {
+      size_type step = count / 2;
+      if((*this)[low + step] < event) {
+        low += step + 1;
+        count -= step + 1;
+      } else {
+        count = step;
+      }
+    }
+    return low;
+  }
+
+  void
+  CompressedEventNumbers::copy(size_type begin, size_type end, EventNumber_t* out) const {
+    for(size_type i = begin; i < end; ++i) {
+      *out++ = (*this)[i];
+    }
+  }
+
+  std::size_t
+  CompressedEventNumbers::memoryUsed() const {
+    return blocks_.capacity() * sizeof(Block) + words_.capacity() * sizeof(unsigned long long);
+  }
+}
@@ -0,0 +1,43 @@
+#include "DataFormats/Provenance/interface/DigestBuilder.h"
+
+#include <algorithm>
+
+namespace edm {
+
+  namespace {
+    char const hexDigits[] = "0123456789abcdef";
+  }
+
+  DigestBuilder&
+  DigestBuilder::append(unsigned int value) {
+    // Enough for the decimal digits of a 32 bit unsigned integer
+    char digits[10];
+    char* p = digits + sizeof(digits);
+    do {
+      *--p = static_cast<char>('0' + value % 10);
+      value /= 10;
+    } while(value != 0);
+    return append(p, digits + sizeof(digits) - p);
+  }
+
+  void
+  DigestBuilder::appendHex(hash_detail::bytes_type const& bytes) {
+    std::size_t const nChars = 2 * bytes.size();
+    if(size_ + nChars > kBufferSize) flush();
+    char* out = buffer_ + size_;
+    for(hash_detail::bytes_type::const_iterator i = bytes.begin(), e = bytes.end(); i != e; ++i) {
+      *out++ = hexDigits[*i >> 4];
+      *out++ = hexDigits[*i & 0x0f];
+    }
+    size_ += nChars;
+  }
+
+  hash_detail::bytes_type
+  DigestBuilder::result() {
+    flush();
+    cms::MD5Result md5 = digest_.digest();
+    hash_detail::bytes_type bytes;
+    std::copy(md5.bytes, md5.bytes + sizeof(md5.bytes), bytes.begin());
+    return bytes;
+  }
+}
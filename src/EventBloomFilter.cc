@@ -0,0 +1,52 @@
+#include "DataFormats/Provenance/interface/EventBloomFilter.h"
+
+namespace edm {
+
+  unsigned int const EventBloomFilter::defaultBitsPerEvent;
+  unsigned long long const EventBloomFilter::kFormatVersion;
+  unsigned int const EventBloomFilter::kWordsPerBlock;
+  unsigned int const EventBloomFilter::kBitsPerKey;
+
+  EventBloomFilter::EventBloomFilter() : words_(), nBlocks_(0ULL) {
+  }
+
+  void
+  EventBloomFilter::reset(unsigned long long nEvents, unsigned int bitsPerEvent) {
+    unsigned long long nBits = nEvents * bitsPerEvent;
+    nBlocks_ = (nBits + 64 * kWordsPerBlock - 1) / (64 * kWordsPerBlock);
+    if(nBlocks_ == 0) nBlocks_ = 1;
+    words_.assign(nBlocks_ * kWordsPerBlock, 0ULL);
+  }
+
+  void
+  EventBloomFilter::clear() {
+    std::vector<unsigned long long>().swap(words_);
+    nBlocks_ = 0ULL;
+  }
+
+  void
+  EventBloomFilter::toWords(std::vector<unsigned long long>& words) const {
+    words.reserve(words.size() + 2 + words_.size());
+    words.push_back(kFormatVersion);
+    words.push_back(nBlocks_);
+    words.insert(words.end(), words_.begin(), words_.end());
+  }
+
+  bool
+  EventBloomFilter::fromWords(std::vector<unsigned long long> const& words) {
+    clear();
+    if(words.size() < 2 || words[0] != kFormatVersion ||
+       (words.size() - 2) % kWordsPerBlock != 0 ||
+       words[1] != (words.size() - 2) / kWordsPerBlock) {
+      return false;
+    }
+    nBlocks_ = words[1];
+    words_.assign(words.begin() + 2, words.end());
+    return true;
+  }
+
+  std::size_t
+  EventBloomFilter::memoryUsed() const {
+    return words_.capacity() * sizeof(unsigned long long);
+  }
+}
@@ -0,0 +1,77 @@
+#include "DataFormats/Provenance/interface/EventSearchIndex.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace edm {
+
+  long long const EventSearchIndex::defaultMinimumEvents;
+  long long const EventSearchIndex::kKeysPerNode;
+  unsigned int const EventSearchIndex::kMaxLevels;
+
+  EventSearchIndex::EventSearchIndex() : ranges_(), keys_() {
+  }
+
+  void
+  EventSearchIndex::clear() {
+    std::vector<Range>().swap(ranges_);
+    std::vector<EventNumber_t>().swap(keys_);
+  }
+
+  unsigned int
+  EventSearchIndex::levelSizes(long long nEvents, long long* sizes) {
+    unsigned int nLevels = 0;
+    sizes[0] = nEvents;
+    while(sizes[nLevels] > kKeysPerNode) {
+      sizes[nLevels + 1] = (sizes[nLevels] + kKeysPerNode - 1) / kKeysPerNode;
+      ++nLevels;
+    }
+    // Lumis that fit into one node only need the scan of the events
+    return nLevels;
+  }
+
+  void
+  EventSearchIndex::addRange(long long beginEvents, EventNumber_t const* events, long long nEvents) {
+    assert(ranges_.empty() || ranges_.back().beginEvents_ < beginEvents);
+    long long sizes[kMaxLevels + 1];
+    unsigned int nLevels = levelSizes(nEvents, sizes);
+
+    Range range;
+    range.beginEvents_ = beginEvents;
+    range.nEvents_ = nEvents;
+    range.offset_ = keys_.size();
+    ranges_.push_back(range);
+
+    // Each level is built from the one below it, so the levels are built
+    // bottom up into place, after reserving the space for all of them.
+    std::vector<EventNumber_t>::size_type total = 0;
+    for(unsigned int i = 1; i <= nLevels; ++i) {
+      total += paddedSize(sizes[i]);
+    }
+    keys_.resize(keys_.size() + total, static_cast<EventNumber_t>(-1));
+
+    std::vector<EventNumber_t>::size_type levelEnd = keys_.size();
+    EventNumber_t const* below = events;
+    for(unsigned int i = 1; i <= nLevels; ++i) {
+      std::vector<EventNumber_t>::size_type levelBegin = levelEnd - paddedSize(sizes[i]);
+      for(long long j = 0; j < sizes[i]; ++j) {
+        keys_[levelBegin + j] = below[std::min((j + 1) * kKeysPerNode, sizes[i - 1]) - 1];
+      }
+      below = &keys_[levelBegin];
+      levelEnd = levelBegin;
+    }
+  }
+
+  EventSearchIndex::Range const*
+  EventSearchIndex::findRange(long long beginEvents) const {
+    std::vector<Range>::const_iterator it = std::lower_bound(ranges_.begin(), ranges_.end(), beginEvents,
+      [](Range const& range, long long begin) {return range.beginEvents_ < begin;});
+    if(it == ranges_.end() || it->beginEvents_ != beginEvents) return 0;
+    return &*it;
+  }
+
+  std::size_t
+  EventSearchIndex::memoryUsed() const {
+    return ranges_.capacity() * sizeof(Range) + keys_.capacity() * sizeof(EventNumber_t);
+  }
+}
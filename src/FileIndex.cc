@@ -1,4 +1,5 @@
 #include "DataFormats/Provenance/interface/FileIndex.h"
+#include "DataFormats/Provenance/src/ChunkTasks.h"
 #include "FWCore/Utilities/interface/Algorithms.h"
 
 #include <algorithm>
@@ -16,13 +17,15 @@ namespace edm {
   // vector is empty, which is consistent with it having been
   // sorted.
 
-  FileIndex::Transients::Transients() : allInEntryOrder_(false), resultCached_(false), sortState_(kSorted_Run_Lumi_Event) {}
+  FileIndex::Transients::Transients() : allInEntryOrder_(false), resultCached_(false), sortState_(kSorted_Run_Lumi_Event),
+                                        numberOfSortThreads_(1U) {}
 
   void
   FileIndex::Transients::reset() {
     allInEntryOrder_ = false;
     resultCached_ = false;
     sortState_ = kSorted_Run_Lumi_Event;
+    numberOfSortThreads_ = 1U;
   }
 
   void
@@ -32,14 +35,196 @@ namespace edm {
     sortState() = kNotSorted;
   }
 
+  namespace {
+    typedef std::vector<FileIndex::Element>::size_type size_type;
+
+    // Below this size the comparison sort is faster
+    size_type const minimumToRadixSort = 1024;
+    // Each sort thread gets at least this many elements
+    size_type const minimumPerThread = 1 << 16;
+
+    // Each pass over the elements moves all of them, so the digits are
+    // made as wide as this if that saves a pass.
+    unsigned int const maxDigitBits = 13;
+
+    // Fields compared by operator<, least significant first: event, lumi and run.
+    // Fields compared by Compare_Run_Lumi_EventEntry: the entry of an event,
+    // whether it is an event, lumi and run. Signed entries are mapped to unsigned
+    // values in the same order. The run and lumi elements all use the entry of
+    // one of the events, so the entries do not widen the key.
+    template<bool ByEntry>
+    struct SortFields {
+      static unsigned int const nFields = ByEntry ? 4 : 3;
+      unsigned long long nonEventEntry_;
+
+      unsigned long long value(FileIndex::Element const& element, unsigned int field) const {
+        if(ByEntry) {
+          switch(field) {
+            case 0: return element.event_ == 0U ? nonEventEntry_ : static_cast<unsigned long long>(element.entry_) ^ (1ULL << 63);
+            case 1: return element.event_ == 0U ? 0ULL : 1ULL;
+            case 2: return element.lumi_;
+            default: return element.run_;
+          }
+        }
+        switch(field) {
+          case 0: return element.event_;
+          case 1: return element.lumi_;
+          default: return element.run_;
+        }
+      }
+    };
+
+    // A key of up to 64 bits built from the fields [firstField, endField),
+    // each offset by its minimum, the least significant in the low bits.
+    template<bool ByEntry>
+    struct PackedKey {
+      SortFields<ByEntry> fields_;
+      unsigned int firstField_;
+      unsigned int endField_;
+      unsigned long long low_[SortFields<ByEntry>::nFields];
+      unsigned int shift_[SortFields<ByEntry>::nFields];
+
+      unsigned long long operator()(FileIndex::Element const& element) const {
+        unsigned long long key = 0ULL;
+        for(unsigned int field = firstField_; field < endField_; ++field) {
+          key |= (fields_.value(element, field) - low_[field]) << shift_[field];
+        }
+        return key;
+      }
+    };
+
+    // LSD radix sort of the elements on the low keyBits bits of keyOf. For
+    // each digit every chunk counts its elements and then moves them, and
+    // within a bucket the elements of earlier chunks go first, so the sort
+    // is stable for any number of chunks. With one chunk the counts of all
+    // digits are taken in one pass. Digits that are the same for all
+    // elements are skipped.
+    template<typename KeyOf>
+    void stableRadixSort(std::vector<FileIndex::Element>& elements,
+                         std::vector<FileIndex::Element>& buffer,
+                         KeyOf const& keyOf,
+                         unsigned int keyBits,
+                         unsigned int nChunks) {
+      size_type const n = elements.size();
+      unsigned int const nDigits = (keyBits + maxDigitBits - 1) / maxDigitBits;
+      if(nDigits == 0) return;
+      unsigned int const digitBits = (keyBits + nDigits - 1) / nDigits;
+      size_type const radix = size_type(1) << digitBits;
+      unsigned long long const digitMask = radix - 1;
+
+      std::vector<size_type> bounds(nChunks + 1);
+      for(unsigned int chunk = 0; chunk <= nChunks; ++chunk) {
+        bounds[chunk] = n / nChunks * chunk + std::min<size_type>(chunk, n % nChunks);
+      }
+      unsigned int const nCounted = nChunks == 1 ? nDigits : 1;
+      std::vector<size_type> counts(nChunks * nCounted * radix);
+      for(unsigned int digit = 0; digit < nDigits; ++digit) {
+        unsigned int const shift = digit * digitBits;
+        if(nChunks != 1 || digit == 0) {
+          std::fill(counts.begin(), counts.end(), 0);
+          detail::forEachChunk(nChunks, [&](unsigned int chunk) {
+            size_type* count = &counts[chunk * nCounted * radix];
+            for(size_type i = bounds[chunk], iEnd = bounds[chunk + 1]; i < iEnd; ++i) {
+              unsigned long long key = keyOf(elements[i]) >> shift;
+              for(unsigned int counted = 0; counted < nCounted; ++counted, key >>= digitBits) {
+                ++count[counted * radix + (key & digitMask)];
+              }
+            }
+          });
+        }
+        unsigned int const counted = nChunks == 1 ? digit : 0;
+        size_type offset = 0;
+        bool constantDigit = false;
+        for(size_type value = 0; value < radix; ++value) {
+          size_type total = 0;
+          for(unsigned int chunk = 0; chunk < nChunks; ++chunk) {
+            size_type& count = counts[(chunk * nCounted + counted) * radix + value];
+            size_type c = count;
+            count = offset;
+            offset += c;
+            total += c;
+          }
+          if(total == n) constantDigit = true;
+        }
+        if(constantDigit) continue;
+        detail::forEachChunk(nChunks, [&](unsigned int chunk) {
+          size_type* next = &counts[(chunk * nCounted + counted) * radix];
+          for(size_type i = bounds[chunk], iEnd = bounds[chunk + 1]; i < iEnd; ++i) {
+            buffer[next[(keyOf(elements[i]) >> shift) & digitMask]++] = elements[i];
+          }
+        });
+        elements.swap(buffer);
+      }
+    }
+
+    // Each field is offset by its minimum and as many fields as fit are packed
+    // into one 64 bit key. Usually all of them fit and there is one radix sort;
+    // otherwise the keys with the less significant fields are sorted first.
+    template<bool ByEntry>
+    void radixSortElements(std::vector<FileIndex::Element>& elements, unsigned int nThreads) {
+      typedef SortFields<ByEntry> Fields;
+      size_type const n = elements.size();
+      unsigned int nChunks = static_cast<unsigned int>(std::min<size_type>(nThreads, std::max<size_type>(n / minimumPerThread, 1)));
+
+      PackedKey<ByEntry> key;
+      key.fields_.nonEventEntry_ = 0ULL;
+      for(size_type i = 0; i < n; ++i) {
+        if(elements[i].event_ != 0U) {
+          key.fields_.nonEventEntry_ = key.fields_.value(elements[i], 0);
+          break;
+        }
+      }
+      unsigned long long high[Fields::nFields];
+      for(unsigned int field = 0; field < Fields::nFields; ++field) {
+        key.low_[field] = high[field] = key.fields_.value(elements[0], field);
+      }
+      for(size_type i = 1; i < n; ++i) {
+        for(unsigned int field = 0; field < Fields::nFields; ++field) {
+          unsigned long long value = key.fields_.value(elements[i], field);
+          if(value < key.low_[field]) key.low_[field] = value;
+          if(value > high[field]) high[field] = value;
+        }
+      }
+      unsigned int bits[Fields::nFields];
+      for(unsigned int field = 0; field < Fields::nFields; ++field) {
+        bits[field] = 0;
+        for(unsigned long long range = high[field] - key.low_[field]; range != 0ULL; range >>= 1) {
+          ++bits[field];
+        }
+      }
+
+      std::vector<FileIndex::Element> buffer(n);
+      key.firstField_ = 0;
+      while(key.firstField_ < Fields::nFields) {
+        unsigned int keyBits = 0;
+        key.endField_ = key.firstField_;
+        while(key.endField_ < Fields::nFields && (key.endField_ == key.firstField_ || keyBits + bits[key.endField_] <= 64)) {
+          key.shift_[key.endField_] = bits[key.endField_] == 0 ? 0 : keyBits;
+          keyBits += bits[key.endField_];
+          ++key.endField_;
+        }
+        stableRadixSort(elements, buffer, key, keyBits, nChunks);
+        key.firstField_ = key.endField_;
+      }
+    }
+  }
+
   void FileIndex::sortBy_Run_Lumi_Event() {
-    stable_sort_all(entries_);
+    if(entries_.size() < minimumToRadixSort) {
+      stable_sort_all(entries_);
+    } else if(!std::is_sorted(entries_.begin(), entries_.end())) {
+      radixSortElements<false>(entries_, numberOfSortThreads());
+    }
     resultCached() = false;
     sortState() = kSorted_Run_Lumi_Event;
   }
 
   void FileIndex::sortBy_Run_Lumi_EventEntry() {
-    stable_sort_all(entries_, Compare_Run_Lumi_EventEntry());
+    if(entries_.size() < minimumToRadixSort) {
+      stable_sort_all(entries_, Compare_Run_Lumi_EventEntry());
+    } else if(!std::is_sorted(entries_.begin(), entries_.end(), Compare_Run_Lumi_EventEntry())) {
+      radixSortElements<true>(entries_, numberOfSortThreads());
+    }
     resultCached() = false;
     sortState() = kSorted_Run_Lumi_EventEntry;
   }
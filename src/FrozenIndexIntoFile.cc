@@ -0,0 +1,311 @@
+#include "DataFormats/Provenance/interface/FrozenIndexIntoFile.h"
+#include "FWCore/Utilities/interface/EDMException.h"
+
+#include <cstdint>
+#include <cstring>
+
+namespace edm {
+
+  struct FrozenIndexIntoFile::RunOrLumiEntryRecord {
+    std::int64_t orderPHIDRun_;
+    std::int64_t orderPHIDRunLumi_;
+    std::int64_t entry_;
+    std::int64_t beginEvents_;
+    std::int64_t endEvents_;
+    std::int32_t processHistoryIDIndex_;
+    std::uint32_t run_;
+    std::uint32_t lumi_;
+    std::uint32_t unused_;
+  };
+
+  struct FrozenIndexIntoFile::RunOrLumiIndexesRecord {
+    std::int64_t beginEventNumbers_;
+    std::int64_t endEventNumbers_;
+    std::int32_t processHistoryIDIndex_;
+    std::uint32_t run_;
+    std::uint32_t lumi_;
+    std::int32_t indexToGetEntry_;
+  };
+
+  struct FrozenIndexIntoFile::EventEntryRecord {
+    std::int64_t entry_;
+    std::uint32_t event_;
+    std::uint32_t unused_;
+  };
+
+  namespace {
+    // "EDMIIF" followed by two zero bytes when read on a little endian machine
+    unsigned long long const kMagic = 0x00004649494d4445ULL;
+    unsigned long long const kSwappedMagic = 0x45444d4949460000ULL;
+
+    enum HeaderWord {
+      kMagicWord, kVersionWord, kNumberOfEventsWord, kProcessHistoryIDsWord,
+      kRunOrLumiEntriesWord, kRunOrLumiIndexesWord, kEventNumbersWord, kEventEntriesWord,
+      kHeaderWords
+    };
+
+    std::size_t const kProcessHistoryIDBytes = sizeof(ProcessHistoryID::bytes_type);
+
+    static_assert(sizeof(EventNumber_t) == 4, "The layout stores 32 bit event numbers");
+    static_assert(kProcessHistoryIDBytes % 8 == 0, "Each section must start on an 8 byte boundary");
+
+    std::size_t padded(std::size_t bytes) {
+      return (bytes + 7) & ~static_cast<std::size_t>(7);
+    }
+  }
+
+  void
+  FrozenIndexIntoFile::freeze(IndexIntoFile const& indexIntoFile, std::vector<char>& blob) {
+    static_assert(sizeof(RunOrLumiEntryRecord) % 8 == 0, "Each section must start on an 8 byte boundary");
+    static_assert(sizeof(RunOrLumiIndexesRecord) % 8 == 0, "Each section must start on an 8 byte boundary");
+    static_assert(sizeof(EventEntryRecord) % 8 == 0, "Each section must start on an 8 byte boundary");
+
+    indexIntoFile.fillRunOrLumiIndexes();
+    std::vector<ProcessHistoryID> const& processHistoryIDs = indexIntoFile.processHistoryIDs();
+    std::vector<IndexIntoFile::RunOrLumiEntry> const& runOrLumiEntries = indexIntoFile.runOrLumiEntries();
+    std::vector<IndexIntoFile::RunOrLumiIndexes> const& runOrLumiIndexes = indexIntoFile.runOrLumiIndexes();
+    std::vector<EventNumber_t> const& eventNumbers = indexIntoFile.eventNumbers();
+    CompressedEventNumbers const& compressedEventNumbers = indexIntoFile.compressedEventNumbers();
+    std::vector<IndexIntoFile::EventEntry> const& eventEntries = indexIntoFile.eventEntries();
+    std::size_t nEventNumbers = eventNumbers.empty() ? compressedEventNumbers.size() : eventNumbers.size();
+
+    unsigned long long header[kHeaderWords];
+    header[kMagicWord] = kMagic;
+    header[kVersionWord] = formatVersion;
+    header[kNumberOfEventsWord] = indexIntoFile.numberOfEvents();
+    header[kProcessHistoryIDsWord] = processHistoryIDs.size();
+    header[kRunOrLumiEntriesWord] = runOrLumiEntries.size();
+    header[kRunOrLumiIndexesWord] = runOrLumiIndexes.size();
+    header[kEventNumbersWord] = nEventNumbers;
+    header[kEventEntriesWord] = eventEntries.size();
+
+    std::size_t offset = blob.size();
+    blob.resize(offset +
+                sizeof(header) +
+                processHistoryIDs.size() * kProcessHistoryIDBytes +
+                runOrLumiEntries.size() * sizeof(RunOrLumiEntryRecord) +
+                runOrLumiIndexes.size() * sizeof(RunOrLumiIndexesRecord) +
+                padded(nEventNumbers * sizeof(EventNumber_t)) +
+                eventEntries.size() * sizeof(EventEntryRecord), 0);
+    char* out = &blob[offset];
+
+    std::memcpy(out, header, sizeof(header));
+    out += sizeof(header);
+
+    for(std::vector<ProcessHistoryID>::const_iterator it = processHistoryIDs.begin(), itEnd = processHistoryIDs.end();
+        it != itEnd; ++it) {
+      std::memcpy(out, it->bytes().data(), kProcessHistoryIDBytes);
+      out += kProcessHistoryIDBytes;
+    }
+
+    for(std::vector<IndexIntoFile::RunOrLumiEntry>::const_iterator it = runOrLumiEntries.begin(),
+                                                                   itEnd = runOrLumiEntries.end();
+        it != itEnd; ++it) {
+      RunOrLumiEntryRecord record = {it->orderPHIDRun(), it->orderPHIDRunLumi(), it->entry(),
+                                     it->beginEvents(), it->endEvents(),
+                                     it->processHistoryIDIndex(), it->run(), it->lumi(), 0U};
+      std::memcpy(out, &record, sizeof(record));
+      out += sizeof(record);
+    }
+
+    for(std::vector<IndexIntoFile::RunOrLumiIndexes>::const_iterator it = runOrLumiIndexes.begin(),
+                                                                     itEnd = runOrLumiIndexes.end();
+        it != itEnd; ++it) {
+      RunOrLumiIndexesRecord record = {it->beginEventNumbers(), it->endEventNumbers(),
+                                       it->processHistoryIDIndex(), it->run(), it->lumi(), it->indexToGetEntry()};
+      std::memcpy(out, &record, sizeof(record));
+      out += sizeof(record);
+    }
+
+    if(!eventNumbers.empty()) {
+      std::memcpy(out, &eventNumbers[0], nEventNumbers * sizeof(EventNumber_t));
+    } else if(nEventNumbers != 0) {
+      std::vector<EventNumber_t> buffer(nEventNumbers);
+      compressedEventNumbers.copy(0, nEventNumbers, &buffer[0]);
+      std::memcpy(out, &buffer[0], nEventNumbers * sizeof(EventNumber_t));
+    }
+    out += padded(nEventNumbers * sizeof(EventNumber_t));
+
+    for(std::vector<IndexIntoFile::EventEntry>::const_iterator it = eventEntries.begin(), itEnd = eventEntries.end();
+        it != itEnd; ++it) {
+      EventEntryRecord record = {it->entry(), it->event(), 0U};
+      std::memcpy(out, &record, sizeof(record));
+      out += sizeof(record);
+    }
+  }
+
+  FrozenIndexIntoFile::FrozenIndexIntoFile(void const* data, std::size_t size) :
+    header_(static_cast<unsigned long long const*>(data)),
+    nProcessHistoryIDs_(0),
+    nRunOrLumiEntries_(0),
+    nRunOrLumiIndexes_(0),
+    nEventNumbers_(0),
+    nEventEntries_(0),
+    processHistoryIDs_(0),
+    runOrLumiEntries_(0),
+    runOrLumiIndexes_(0),
+    eventNumbers_(0),
+    eventEntries_(0) {
+
+    if(reinterpret_cast<std::uintptr_t>(data) % 8 != 0) {
+      throw Exception(errors::LogicError)
+        << "In FrozenIndexIntoFile constructor. The data do not start on an 8 byte boundary.\n";
+    }
+    if(size < kHeaderWords * sizeof(unsigned long long) ||
+       (header_[kMagicWord] != kMagic && header_[kMagicWord] != kSwappedMagic)) {
+      throw Exception(errors::FormatIncompatibility)
+        << "In FrozenIndexIntoFile constructor. The data are not a frozen IndexIntoFile.\n";
+    }
+    if(header_[kMagicWord] == kSwappedMagic) {
+      throw Exception(errors::FormatIncompatibility)
+        << "In FrozenIndexIntoFile constructor. The frozen IndexIntoFile was written with the other byte order.\n";
+    }
+    if(header_[kVersionWord] != formatVersion) {
+      throw Exception(errors::FormatIncompatibility)
+        << "In FrozenIndexIntoFile constructor. Unknown format version " << header_[kVersionWord] << ".\n";
+    }
+
+    nProcessHistoryIDs_ = header_[kProcessHistoryIDsWord];
+    nRunOrLumiEntries_ = header_[kRunOrLumiEntriesWord];
+    nRunOrLumiIndexes_ = header_[kRunOrLumiIndexesWord];
+    nEventNumbers_ = header_[kEventNumbersWord];
+    nEventEntries_ = header_[kEventEntriesWord];
+
+    // Checked one section at a time so a corrupt count cannot overflow the sum
+    char const* begin = static_cast<char const*>(data);
+    std::size_t offset = kHeaderWords * sizeof(unsigned long long);
+    std::size_t const sizes[] = {kProcessHistoryIDBytes, sizeof(RunOrLumiEntryRecord), sizeof(RunOrLumiIndexesRecord),
+                                 sizeof(EventNumber_t), sizeof(EventEntryRecord)};
+    size_type const counts[] = {nProcessHistoryIDs_, nRunOrLumiEntries_, nRunOrLumiIndexes_,
+                                nEventNumbers_, nEventEntries_};
+    std::size_t offsets[5];
+    for(int i = 0; i < 5; ++i) {
+      if(offset > size || counts[i] > (size - offset) / sizes[i]) {
+        throw Exception(errors::FormatIncompatibility)
+          << "In FrozenIndexIntoFile constructor. The data are shorter than the frozen IndexIntoFile.\n";
+      }
+      offsets[i] = offset;
+      offset += padded(counts[i] * sizes[i]);
+    }
+    if(offset != size ||
+       (nRunOrLumiIndexes_ != 0 && nRunOrLumiIndexes_ != nRunOrLumiEntries_)) {
+      throw Exception(errors::FormatIncompatibility)
+        << "In FrozenIndexIntoFile constructor. The size of the data does not match the frozen IndexIntoFile.\n";
+    }
+
+    processHistoryIDs_ = reinterpret_cast<unsigned char const*>(begin + offsets[0]);
+    runOrLumiEntries_ = reinterpret_cast<RunOrLumiEntryRecord const*>(begin + offsets[1]);
+    runOrLumiIndexes_ = reinterpret_cast<RunOrLumiIndexesRecord const*>(begin + offsets[2]);
+    eventNumbers_ = reinterpret_cast<EventNumber_t const*>(begin + offsets[3]);
+    eventEntries_ = reinterpret_cast<EventEntryRecord const*>(begin + offsets[4]);
+
+    // The records are used as indexes into the other sections, so check them
+    // here once rather than on every access
+    for(size_type i = 0; i < nRunOrLumiEntries_; ++i) {
+      std::int32_t phidIndex = runOrLumiEntries_[i].processHistoryIDIndex_;
+      if(phidIndex < 0 || static_cast<size_type>(phidIndex) >= nProcessHistoryIDs_) {
+        throw Exception(errors::FormatIncompatibility)
+          << "In FrozenIndexIntoFile constructor. A run or lumi entry has a process history ID index out of range.\n";
+      }
+    }
+    long long nEvents = 0;
+    for(size_type i = 0; i < nRunOrLumiIndexes_; ++i) {
+      RunOrLumiIndexesRecord const& record = runOrLumiIndexes_[i];
+      if(record.processHistoryIDIndex_ < 0 ||
+         static_cast<size_type>(record.processHistoryIDIndex_) >= nProcessHistoryIDs_ ||
+         record.indexToGetEntry_ < 0 ||
+         static_cast<size_type>(record.indexToGetEntry_) >= nRunOrLumiEntries_) {
+        throw Exception(errors::FormatIncompatibility)
+          << "In FrozenIndexIntoFile constructor. A sorted run or lumi index has an index out of range.\n";
+      }
+      // Runs have no range. Each lumi starts where the previous one ended,
+      // except that the indexes of a lumi in several entries share one range.
+      if(record.lumi_ != 0U) {
+        bool startsHere = record.beginEventNumbers_ == nEvents && record.endEventNumbers_ >= nEvents;
+        bool sameAsPrevious = i != 0 && runOrLumiIndexes_[i - 1].lumi_ != 0U &&
+                              record.beginEventNumbers_ == runOrLumiIndexes_[i - 1].beginEventNumbers_ &&
+                              record.endEventNumbers_ == runOrLumiIndexes_[i - 1].endEventNumbers_;
+        if(!startsHere && !sameAsPrevious) {
+          throw Exception(errors::FormatIncompatibility)
+            << "In FrozenIndexIntoFile constructor. The event number ranges of the sorted lumi indexes are not consistent.\n";
+        }
+        nEvents = record.endEventNumbers_;
+      }
+    }
+    if((nEventNumbers_ != 0 && static_cast<long long>(nEventNumbers_) != nEvents) ||
+       (nEventEntries_ != 0 && static_cast<long long>(nEventEntries_) != nEvents)) {
+      throw Exception(errors::FormatIncompatibility)
+        << "In FrozenIndexIntoFile constructor. The number of event numbers or entries does not match the sorted lumi indexes.\n";
+    }
+  }
+
+  FrozenIndexIntoFile::EntryNumber_t
+  FrozenIndexIntoFile::numberOfEvents() const {
+    return header_[kNumberOfEventsWord];
+  }
+
+  ProcessHistoryID
+  FrozenIndexIntoFile::processHistoryID(size_type i) const {
+    ProcessHistoryID::bytes_type bytes;
+    std::memcpy(bytes.data(), processHistoryIDs_ + i * kProcessHistoryIDBytes, kProcessHistoryIDBytes);
+    return ProcessHistoryID(bytes);
+  }
+
+  IndexIntoFile::RunOrLumiEntry
+  FrozenIndexIntoFile::runOrLumiEntry(size_type i) const {
+    RunOrLumiEntryRecord const& record = runOrLumiEntries_[i];
+    return IndexIntoFile::RunOrLumiEntry(record.orderPHIDRun_, record.orderPHIDRunLumi_, record.entry_,
+                                         record.processHistoryIDIndex_, record.run_, record.lumi_,
+                                         record.beginEvents_, record.endEvents_);
+  }
+
+  IndexIntoFile::RunOrLumiIndexes
+  FrozenIndexIntoFile::runOrLumiIndexes(size_type i) const {
+    RunOrLumiIndexesRecord const& record = runOrLumiIndexes_[i];
+    IndexIntoFile::RunOrLumiIndexes indexes(record.processHistoryIDIndex_, record.run_, record.lumi_,
+                                            record.indexToGetEntry_);
+    indexes.setBeginEventNumbers(record.beginEventNumbers_);
+    indexes.setEndEventNumbers(record.endEventNumbers_);
+    return indexes;
+  }
+
+  IndexIntoFile::EventEntry
+  FrozenIndexIntoFile::eventEntry(size_type i) const {
+    return IndexIntoFile::EventEntry(eventEntries_[i].event_, eventEntries_[i].entry_);
+  }
+
+  void
+  FrozenIndexIntoFile::thaw(IndexIntoFile& indexIntoFile) const {
+    indexIntoFile.transient_.reset();
+
+    std::vector<ProcessHistoryID>& processHistoryIDs = indexIntoFile.setProcessHistoryIDs();
+    processHistoryIDs.clear();
+    processHistoryIDs.reserve(nProcessHistoryIDs_);
+    for(size_type i = 0; i < nProcessHistoryIDs_; ++i) {
+      processHistoryIDs.push_back(processHistoryID(i));
+    }
+
+    std::vector<IndexIntoFile::RunOrLumiEntry>& runOrLumiEntries = indexIntoFile.setRunOrLumiEntries();
+    runOrLumiEntries.clear();
+    runOrLumiEntries.reserve(nRunOrLumiEntries_);
+    for(size_type i = 0; i < nRunOrLumiEntries_; ++i) {
+      runOrLumiEntries.push_back(runOrLumiEntry(i));
+    }
+
+    indexIntoFile.setNumberOfEvents(numberOfEvents());
+
+    std::vector<IndexIntoFile::RunOrLumiIndexes>& runOrLumiIndexes = indexIntoFile.runOrLumiIndexes();
+    runOrLumiIndexes.reserve(nRunOrLumiIndexes_);
+    for(size_type i = 0; i < nRunOrLumiIndexes_; ++i) {
+      runOrLumiIndexes.push_back(this->runOrLumiIndexes(i));
+    }
+
+    indexIntoFile.eventNumbers().assign(eventNumbers_, eventNumbers_ + nEventNumbers_);
+
+    std::vector<IndexIntoFile::EventEntry>& eventEntries = indexIntoFile.eventEntries();
+    eventEntries.reserve(nEventEntries_);
+    for(size_type i = 0; i < nEventEntries_; ++i) {
+      eventEntries.push_back(eventEntry(i));
+    }
+  }
+}
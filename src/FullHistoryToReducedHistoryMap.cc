@@ -14,9 +14,9 @@ namespace edm {
     // ProcessHistoryID is strangely also defined as the ID of the empty
     // Process History (maybe that should be fixed ...).
     ProcessHistory ph;
-    std::pair<ProcessHistoryID, ProcessHistoryID> newEntry(ph.id(), ph.id());
+    Map::value_type newEntry(ph.id(), ph.id());
     std::pair<Map::iterator, bool> result = cache_.insert(newEntry);
-    previous_ = result.first;
+    previous_ = &*result.first;
   }
 
   ProcessHistoryID const&
@@ -24,7 +24,7 @@ namespace edm {
     if (previous_->first == fullID) return previous_->second;
     Map::const_iterator iter = cache_.find(fullID);
     if (iter != cache_.end()) {
-      previous_ = iter;
+      previous_ = &*iter;
       return iter->second;
     }
     ProcessHistoryRegistry* registry = ProcessHistoryRegistry::instance();
@@ -36,9 +36,9 @@ namespace edm {
         << "Contact a Framework developer\n";
     }
     ph.reduce();
-    std::pair<ProcessHistoryID, ProcessHistoryID> newEntry(fullID, ph.id());
+    Map::value_type newEntry(fullID, ph.id());
     std::pair<Map::iterator, bool> result = cache_.insert(newEntry);
-    previous_ = result.first;
+    previous_ = &*result.first;
     return result.first->second;
   }
 }
@@ -1,8 +1,10 @@
 #include "DataFormats/Provenance/interface/Hash.h"
-#include "FWCore/Utilities/interface/Algorithms.h"
 #include "FWCore/Utilities/interface/Digest.h"
 #include "FWCore/Utilities/interface/EDMException.h"
 
+#include <algorithm>
+#include <ostream>
+
 namespace edm {
   namespace detail {
     // This string is the 16-byte, non-printable version.
@@ -13,35 +15,34 @@ namespace edm {
   }
 
   namespace hash_detail {
-    value_type
-    compactForm_(value_type const& hash) {
-      if (isCompactForm_(hash)) {
-	return hash;
+    namespace {
+      void
+      toMD5Result(cms::MD5Result& result, unsigned char const* bytes) {
+        std::copy(bytes, bytes + nBytes, result.bytes);
       }
-      value_type temp(hash);
-      fixup_(temp);
-      return temp;
     }
 
-    // 'Fix' the string data member of this Hash, i.e., if it is in
-    // the hexified (32 byte) representation, make it be in the
-    // 16-byte (unhexified) representation.
+    // Convert either the 16-byte (unhexified) or the 32 byte
+    // (hexified) string representation into the 16 bytes of the
+    // checksum. Used by the ROOT I/O rules for data written before
+    // class version 11.
     void
-    fixup_(value_type& hash) {
+    toBytes_(unsigned char* bytes, value_type const& hash) {
       switch (hash.size()) {
         case 16: {
+          std::copy(hash.begin(), hash.end(), bytes);
           break;
         }
         case 32: {
           cms::MD5Result temp;
           temp.fromHexifiedString(hash);
-          hash = temp.compactForm();
+          std::copy(temp.bytes, temp.bytes + sizeof(temp.bytes), bytes);
           break;
         }
         case 0: {
           throw Exception(errors::LogicError)
             << "Empty edm::Hash<> instance:\n" << "\nPlease report this to the core framework developers";
-        }	
+        }
         default: {
           throw Exception(errors::LogicError)
             << "edm::Hash<> instance with data in illegal state:\n"
@@ -51,51 +52,42 @@ namespace edm {
       }
     }
 
-    bool
-    isCompactForm_(value_type const& hash) {
-      return 16 == hash.size();
+    // 'Fix' a string representation of a Hash, i.e., if it is in
+    // the hexified (32 byte) representation, make it be in the
+    // 16-byte (unhexified) representation.
+    void
+    fixup_(value_type& hash) {
+      if (isCompactForm_(hash)) {
+        return;
+      }
+      unsigned char bytes[nBytes];
+      toBytes_(bytes, hash);
+      hash.assign(bytes, bytes + nBytes);
     }
 
     bool
-    isValid_(value_type const& hash) {
-      return isCompactForm_(hash) ? (hash != detail::InvalidHash()) : (!hash.empty());
-    }
-
-    void
-    throwIfIllFormed(value_type const& hash) {
-      // Fixup not needed here.
-      if (hash.size() % 2 == 1) {
-	throw Exception(errors::LogicError)
-	  << "Ill-formed Hash instance. "
-	  << "Please report this to the core framework developers";
-      }
+    isCompactForm_(value_type const& hash) {
+      return 16 == hash.size();
     }
 
     void
-    toString_(std::string& result, value_type const& hash) {
-      value_type temp1(hash);
-      fixup_(temp1);
+    toString_(std::string& result, unsigned char const* bytes) {
       cms::MD5Result temp;
-      copy_all(temp1, temp.bytes);
+      toMD5Result(temp, bytes);
       result += temp.toString();
     }
-    
+
     void
-    toDigest_(cms::Digest& digest, value_type const& hash) {
-      // FIXME: do we really need to go through a temporary value_type???
-      value_type temp1(hash);
-      fixup_(temp1);
+    toDigest_(cms::Digest& digest, unsigned char const* bytes) {
       cms::MD5Result temp;
-      copy_all(temp1, temp.bytes);
+      toMD5Result(temp, bytes);
       digest.append(temp.toString());
     }
 
     std::ostream&
-    print_(std::ostream& os, value_type const& hash) {
-      value_type temp1(hash);
-      fixup_(temp1);
+    print_(std::ostream& os, unsigned char const* bytes) {
       cms::MD5Result temp;
-      copy_all(temp1, temp.bytes);
+      toMD5Result(temp, bytes);
       os << temp.toString();
       return os;
     }
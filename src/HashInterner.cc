@@ -0,0 +1,17 @@
+#include "DataFormats/Provenance/interface/InternedHash.h"
+
+namespace edm {
+  template <>
+  HashInterner<ParameterSetType>*
+  HashInterner<ParameterSetType>::instance() {
+    static HashInterner<ParameterSetType>* const me = new HashInterner<ParameterSetType>;
+    return me;
+  }
+
+  template <>
+  HashInterner<ProcessHistoryType>*
+  HashInterner<ProcessHistoryType>::instance() {
+    static HashInterner<ProcessHistoryType>* const me = new HashInterner<ProcessHistoryType>;
+    return me;
+  }
+}
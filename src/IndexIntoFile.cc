@@ -1,11 +1,16 @@
 #include "DataFormats/Provenance/interface/IndexIntoFile.h"
+#include "DataFormats/Provenance/interface/FlatHashMap.h"
 #include "DataFormats/Provenance/interface/FullHistoryToReducedHistoryMap.h"
 #include "DataFormats/Provenance/interface/ProcessHistoryRegistry.h"
+#include "DataFormats/Provenance/src/ChunkTasks.h"
 #include "FWCore/Utilities/interface/Algorithms.h"
 #include "FWCore/Utilities/interface/EDMException.h"
 
 #include <algorithm>
+#include <chrono>
+#include <functional>
 #include <iomanip>
+#include <iterator>
 #include <ostream>
 
 namespace edm {
@@ -15,6 +20,7 @@ namespace edm {
   LuminosityBlockNumber_t const IndexIntoFile::invalidLumi;
   EventNumber_t const IndexIntoFile::invalidEvent;
   IndexIntoFile::EntryNumber_t const IndexIntoFile::invalidEntry;
+  IndexIntoFile::EntryNumber_t const IndexIntoFile::eventNumbersChunkSize;
 
   IndexIntoFile::Transients::Transients() : previousAddedIndex_(invalidIndex),
                                             runToFirstEntry_(),
@@ -29,7 +35,12 @@ namespace edm {
                                             runOrLumiIndexes_(),
                                             eventNumbers_(),
                                             eventEntries_(),
-                                            unsortedEventNumbers_() {
+                                            unsortedEventNumbers_(),
+                                            compressedEventNumbers_(),
+                                            eventFilter_(),
+                                            eventSearchIndex_(),
+                                            statistics_(),
+                                            statisticsHook_() {
   }
 
   void
@@ -48,6 +59,71 @@ namespace edm {
     eventNumbers_.clear();
     eventEntries_.clear();
     unsortedEventNumbers_.clear();
+    compressedEventNumbers_.clear();
+    eventFilter_.clear();
+    eventSearchIndex_.clear();
+    statistics_ = Statistics();
+    statisticsHook_.reset();
+  }
+
+  namespace {
+    // Adds the real time from its construction to its destruction, and
+    // one fill, to the statistics of the containers being filled.
+    // Either pointer can be null.
+    class FillTimer {
+    public:
+      FillTimer(IndexIntoFile::TransientStatistics* first, IndexIntoFile::TransientStatistics* second = 0) :
+        first_(first), second_(second), start_(std::chrono::steady_clock::now()) {}
+      ~FillTimer() {
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+        if(first_ != 0) {
+          ++first_->fills_;
+          first_->fillSeconds_ += seconds;
+        }
+        if(second_ != 0) {
+          ++second_->fills_;
+          second_->fillSeconds_ += seconds;
+        }
+      }
+    private:
+      IndexIntoFile::TransientStatistics* first_;
+      IndexIntoFile::TransientStatistics* second_;
+      std::chrono::steady_clock::time_point start_;
+    };
+  }
+
+  std::size_t
+  IndexIntoFile::Statistics::totalBytes() const {
+    return runOrLumiIndexes_.bytes_ + eventNumbers_.bytes_ + eventEntries_.bytes_ +
+           unsortedEventNumbers_.bytes_ + compressedEventNumbers_.bytes_ +
+           eventFilter_.bytes_ + eventSearchIndex_.bytes_;
+  }
+
+  IndexIntoFile::Statistics
+  IndexIntoFile::statistics() const {
+    Statistics result = transient_.statistics_;
+    result.runOrLumiIndexes_.bytes_ = runOrLumiIndexes().capacity() * sizeof(RunOrLumiIndexes);
+    result.runOrLumiIndexes_.elements_ = runOrLumiIndexes().size();
+    result.eventNumbers_.bytes_ = eventNumbers().capacity() * sizeof(EventNumber_t);
+    result.eventNumbers_.elements_ = eventNumbers().size();
+    result.eventEntries_.bytes_ = eventEntries().capacity() * sizeof(EventEntry);
+    result.eventEntries_.elements_ = eventEntries().size();
+    result.unsortedEventNumbers_.bytes_ = unsortedEventNumbers().capacity() * sizeof(EventNumber_t);
+    result.unsortedEventNumbers_.elements_ = unsortedEventNumbers().size();
+    result.compressedEventNumbers_.bytes_ = compressedEventNumbers().memoryUsed();
+    result.compressedEventNumbers_.elements_ = compressedEventNumbers().size();
+    result.eventFilter_.bytes_ = eventFilter().memoryUsed();
+    result.eventFilter_.elements_ = eventFilter().empty() ? 0U : numberOfEvents();
+    result.eventSearchIndex_.bytes_ = eventSearchIndex().memoryUsed();
+    result.eventSearchIndex_.elements_ = eventSearchIndex().numberOfKeys();
+    return result;
+  }
+
+  void
+  IndexIntoFile::callStatisticsHook() const {
+    if(transient_.statisticsHook_) {
+      transient_.statisticsHook_->beforeRelease(*this, statistics());
+    }
   }
 
   IndexIntoFile::IndexIntoFile() : transient_(),
@@ -148,6 +224,7 @@ namespace edm {
     if(runOrLumiEntries_.empty() || !runOrLumiIndexes().empty()) {
       return;
     }
+    FillTimer timer(&transient_.statistics_.runOrLumiIndexes_);
     runOrLumiIndexes().reserve(runOrLumiEntries_.size());
 
     int index = 0;
@@ -211,13 +288,25 @@ namespace edm {
     fillEventNumbersOrEntries(false, true);
   }
 
+  namespace {
+    // Below this many events per chunk, starting tasks costs more than
+    // copying and sorting the events serially.
+    long long const minimumEventsPerFillChunk = 1LL << 16;
+    unsigned int const maximumFillChunks = 64U;
+
+    inline unsigned int numberOfFillChunks(long long nEvents) {
+      return static_cast<unsigned int>(std::min(nEvents / minimumEventsPerFillChunk,
+                                                static_cast<long long>(maximumFillChunks)));
+    }
+  }
+
   void
   IndexIntoFile::fillEventNumbersOrEntries(bool needEventNumbers, bool needEventEntries) const {
     if(numberOfEvents() == 0) {
       return;
     }
 
-    if(needEventNumbers && !eventNumbers().empty()) {
+    if(needEventNumbers && hasEventNumbers()) {
       needEventNumbers = false;
     }
 
@@ -226,6 +315,7 @@ namespace edm {
     }
 
     if(needEventNumbers && !eventEntries().empty()) {
+      FillTimer timer(&transient_.statistics_.eventNumbers_);
       assert(numberOfEvents() == eventEntries().size());
       eventNumbers().reserve(eventEntries().size());
       for(std::vector<EventNumber_t>::size_type entry = 0U; entry < numberOfEvents(); ++entry) {
@@ -238,7 +328,11 @@ namespace edm {
       return;
     }
 
+    // The containers filled on the way are timed separately
     fillUnsortedEventNumbers();
+    fillRunOrLumiIndexes();
+    FillTimer timer(needEventNumbers ? &transient_.statistics_.eventNumbers_ : 0,
+                    needEventEntries ? &transient_.statistics_.eventEntries_ : 0);
 
     if(needEventNumbers) {
       eventNumbers().resize(numberOfEvents(), IndexIntoFile::invalidEvent);
@@ -247,6 +341,12 @@ namespace edm {
       eventEntries().resize(numberOfEvents());
     }
 
+    unsigned int nChunks = numberOfFillChunks(numberOfEvents());
+    if(nChunks > 1U) {
+      fillEventNumbersOrEntriesConcurrently(needEventNumbers, needEventEntries, nChunks);
+      return;
+    }
+
     long long offset = 0;
     long long previousBeginEventNumbers = -1LL;
 
@@ -288,22 +388,202 @@ namespace edm {
     }
   }
 
+  namespace {
+    // One range of event entries from a RunOrLumiEntry and the place
+    // in the event vectors its events are copied to. All the ranges of
+    // one lumi have the same beginEventNumbers_ and endEventNumbers_.
+    struct EventRangeToFill {
+      long long destination_;
+      IndexIntoFile::EntryNumber_t beginEventEntry_;
+      IndexIntoFile::EntryNumber_t endEventEntry_;
+      long long beginEventNumbers_;
+      long long endEventNumbers_;
+    };
+
+    // An empty lumi has the same beginEventNumbers_ as the lumi after
+    // it, so the ranges of one lumi are recognized by both ends.
+    inline bool sameLumi(EventRangeToFill const& left, EventRangeToFill const& right) {
+      return left.beginEventNumbers_ == right.beginEventNumbers_ &&
+             left.endEventNumbers_ == right.endEventNumbers_;
+    }
+  }
+
+  // Produces exactly the same vectors as the serial loop in
+  // fillEventNumbersOrEntries. The ranges of different lumis do not
+  // overlap, so each chunk of whole lumis is copied and sorted by a
+  // separate task without any synchronization.
+  void
+  IndexIntoFile::fillEventNumbersOrEntriesConcurrently(bool needEventNumbers, bool needEventEntries,
+                                                       unsigned int nChunks) const {
+    assert(unsortedEventNumbers().size() == numberOfEvents());
+
+    std::vector<EventRangeToFill> ranges;
+    long long offset = 0;
+    long long previousBeginEventNumbers = -1LL;
+
+    for(SortedRunOrLumiItr runOrLumi = beginRunOrLumi(), runOrLumiEnd = endRunOrLumi();
+        runOrLumi != runOrLumiEnd; ++runOrLumi) {
+
+      if(runOrLumi.isRun()) continue;
+
+      EventRangeToFill range;
+      runOrLumi.getRange(range.beginEventNumbers_, range.endEventNumbers_, range.beginEventEntry_, range.endEventEntry_);
+
+      // Lumis without events have nothing to copy or sort
+      if(range.beginEventNumbers_ == range.endEventNumbers_) continue;
+
+      if(range.beginEventNumbers_ != previousBeginEventNumbers) offset = 0;
+      range.destination_ = range.beginEventNumbers_ + offset;
+      ranges.push_back(range);
+
+      previousBeginEventNumbers = range.beginEventNumbers_;
+      offset += range.endEventEntry_ - range.beginEventEntry_;
+    }
+
+    // Split the ranges into contiguous chunks with about the same number
+    // of events. A lumi is never split between two chunks.
+    long long eventsPerChunk = (numberOfEvents() + nChunks - 1) / nChunks;
+    std::vector<std::vector<EventRangeToFill>::size_type> chunkBoundaries(1, 0U);
+    long long eventsInChunk = 0;
+    for(std::vector<EventRangeToFill>::size_type i = 0; i < ranges.size(); ++i) {
+      if(eventsInChunk >= eventsPerChunk && !sameLumi(ranges[i], ranges[i - 1])) {
+        chunkBoundaries.push_back(i);
+        eventsInChunk = 0;
+      }
+      eventsInChunk += ranges[i].endEventEntry_ - ranges[i].beginEventEntry_;
+    }
+    chunkBoundaries.push_back(ranges.size());
+
+    std::vector<EventNumber_t>& numbers = eventNumbers();
+    std::vector<EventEntry>& entries = eventEntries();
+    std::vector<EventNumber_t> const& unsorted = unsortedEventNumbers();
+
+    auto fillChunk = [&](std::vector<EventRangeToFill>::size_type first,
+                         std::vector<EventRangeToFill>::size_type last) {
+      for(std::vector<EventRangeToFill>::size_type i = first; i != last; ++i) {
+        EventRangeToFill const& range = ranges[i];
+        for(EntryNumber_t entry = range.beginEventEntry_; entry != range.endEventEntry_; ++entry) {
+          long long destination = range.destination_ + (entry - range.beginEventEntry_);
+          if(needEventNumbers) {
+            numbers[destination] = unsorted[entry];
+          }
+          if(needEventEntries) {
+            entries[destination] = EventEntry(unsorted[entry], entry);
+          }
+        }
+      }
+      for(std::vector<EventRangeToFill>::size_type i = first; i != last; ++i) {
+        if(i != first && sameLumi(ranges[i], ranges[i - 1])) continue;
+        if(needEventNumbers) {
+          std::sort(numbers.begin() + ranges[i].beginEventNumbers_,
+                    numbers.begin() + ranges[i].endEventNumbers_);
+        }
+        if(needEventEntries) {
+          std::sort(entries.begin() + ranges[i].beginEventNumbers_,
+                    entries.begin() + ranges[i].endEventNumbers_);
+        }
+      }
+    };
+
+    detail::forEachChunk(chunkBoundaries.size() - 1, [&](unsigned int chunk) {
+      fillChunk(chunkBoundaries[chunk], chunkBoundaries[chunk + 1]);
+    });
+    assert(!needEventNumbers || numberOfEvents() == eventNumbers().size());
+    assert(!needEventEntries || numberOfEvents() == eventEntries().size());
+  }
+
+  void
+  IndexIntoFile::compressEventNumbers() const {
+    if(!compressedEventNumbers().empty()) {
+      return;
+    }
+    fillEventNumbers();
+    if(eventNumbers().empty()) {
+      return;
+    }
+    FillTimer timer(&transient_.statistics_.compressedEventNumbers_);
+    compressedEventNumbers().assign(eventNumbers());
+    std::vector<EventNumber_t>().swap(eventNumbers());
+  }
+
+  void
+  IndexIntoFile::fillEventFilter(unsigned int bitsPerEvent) const {
+    fillUnsortedEventNumbers();
+    FillTimer timer(&transient_.statistics_.eventFilter_);
+    std::vector<EventNumber_t> const& unsorted = unsortedEventNumbers();
+    assert(unsorted.size() == numberOfEvents());
+    EventBloomFilter& filter = transient_.eventFilter_;
+    filter.reset(numberOfEvents(), bitsPerEvent);
+    for(std::vector<RunOrLumiEntry>::const_iterator iter = runOrLumiEntries_.begin(),
+                                                    iEnd = runOrLumiEntries_.end();
+         iter != iEnd;
+         ++iter) {
+      if(iter->isRun() || iter->beginEvents() == invalidEntry) continue;
+      for(EntryNumber_t entry = iter->beginEvents(); entry != iter->endEvents(); ++entry) {
+        filter.insert(iter->run(), unsorted[entry]);
+      }
+    }
+  }
+
+  void
+  IndexIntoFile::fillEventSearchIndex(long long minimumEvents) const {
+    if(eventEntries().empty()) {
+      fillEventNumbers();
+    }
+    fillRunOrLumiIndexes();
+    FillTimer timer(&transient_.statistics_.eventSearchIndex_);
+    EventSearchIndex& searchIndex = transient_.eventSearchIndex_;
+    searchIndex.clear();
+    std::vector<EventNumber_t> buffer;
+    long long previousBeginEventNumbers = invalidEntry;
+    for(std::vector<RunOrLumiIndexes>::const_iterator iter = runOrLumiIndexes().begin(),
+                                                      iEnd = runOrLumiIndexes().end();
+         iter != iEnd;
+         ++iter) {
+      // All the entries of a lumi are next to each other and have the same range.
+      // A lumi without events has the same beginning as the lumi after it.
+      long long beginEventNumbers = iter->beginEventNumbers();
+      long long endEventNumbers = iter->endEventNumbers();
+      if(endEventNumbers == beginEventNumbers ||
+         endEventNumbers - beginEventNumbers < minimumEvents ||
+         beginEventNumbers == previousBeginEventNumbers) continue;
+      previousBeginEventNumbers = beginEventNumbers;
+
+      EventNumber_t const* events;
+      if(hasEventNumbers()) {
+        events = eventNumbersInRange(beginEventNumbers, endEventNumbers, buffer);
+      } else {
+        buffer.clear();
+        for(long long i = beginEventNumbers; i < endEventNumbers; ++i) {
+          buffer.push_back(eventEntries()[i].event());
+        }
+        events = buffer.data();
+      }
+      searchIndex.addRange(beginEventNumbers, events, endEventNumbers - beginEventNumbers);
+    }
+  }
+
   void
   IndexIntoFile::fillUnsortedEventNumbers() const {
     if(numberOfEvents() == 0 || !unsortedEventNumbers().empty()) {
       return;
     }
-    unsortedEventNumbers().reserve(numberOfEvents());
+    FillTimer timer(&transient_.statistics_.unsortedEventNumbers_);
+    std::vector<EventNumber_t> eventNumbers(numberOfEvents());
 
     // The main purpose for the existence of the unsortedEventNumbers
     // vector is that it can easily be filled by reading through
     // the EventAuxiliary branch in the same order as the TTree
     // entries. fillEventNumbersOrEntries can then use this information
     // instead of using getEventNumberOfEntry directly and reading
-    // the branch in a different order.
-    for(std::vector<EventNumber_t>::size_type entry = 0U; entry < numberOfEvents(); ++entry) {
-      unsortedEventNumbers().push_back(getEventNumberOfEntry(entry));
+    // the branch in a different order. The entries are requested in
+    // large chunks so the EventFinder can read them in bulk.
+    EntryNumber_t nEvents = numberOfEvents();
+    for(EntryNumber_t begin = 0; begin < nEvents; begin += eventNumbersChunkSize) {
+      EntryNumber_t end = std::min(begin + eventNumbersChunkSize, nEvents);
+      transient_.eventFinder_->getEventNumbersOfEntries(begin, end, &eventNumbers[begin]);
     }
+    unsortedEventNumbers().swap(eventNumbers);
   }
 
   // We are closing the input file, but we need to keep event numbers.
@@ -311,6 +591,7 @@ namespace edm {
 
   void
   IndexIntoFile::inputFileClosed() const {
+    callStatisticsHook();
     std::vector<EventEntry>().swap(eventEntries());
     std::vector<RunOrLumiIndexes>().swap(runOrLumiIndexes());
     std::vector<EventNumber_t>().swap(unsortedEventNumbers());
@@ -319,9 +600,122 @@ namespace edm {
 
   void
   IndexIntoFile::doneFileInitialization() const {
+    callStatisticsHook();
     std::vector<EventNumber_t>().swap(unsortedEventNumbers());
   }
 
+  namespace {
+    // A sort key and the position in the vector of the element it belongs to
+    typedef std::pair<unsigned long long, unsigned int> KeyAndPosition;
+
+    // Sorts items by key, keeping the relative order of items with equal
+    // keys. This is a least significant digit first radix sort with 11 bit
+    // digits, whose counts fit in the L1 cache. The digits that are the same
+    // in all keys are skipped, so small keys take only a pass or two.
+    void stableRadixSort(std::vector<KeyAndPosition>& items) {
+      typedef std::vector<KeyAndPosition>::size_type size_type;
+      size_type const n = items.size();
+      if(n < 2) return;
+      unsigned int const digitBits = 11;
+      unsigned int const nDigits = (64 + digitBits - 1) / digitBits;
+      unsigned long long const radix = 1ULL << digitBits;
+      unsigned long long const mask = radix - 1;
+      std::vector<size_type> counts(nDigits * radix, 0);
+      for(size_type i = 0; i < n; ++i) {
+        unsigned long long key = items[i].first;
+        for(unsigned int digit = 0; digit < nDigits; ++digit, key >>= digitBits) {
+          ++counts[digit * radix + (key & mask)];
+        }
+      }
+      std::vector<KeyAndPosition> buffer(n);
+      for(unsigned int digit = 0; digit < nDigits; ++digit) {
+        size_type* count = &counts[digit * radix];
+        unsigned int const shift = digit * digitBits;
+        if(count[(items[0].first >> shift) & mask] == n) continue;
+        size_type offset = 0;
+        for(unsigned long long value = 0; value < radix; ++value) {
+          size_type c = count[value];
+          count[value] = offset;
+          offset += c;
+        }
+        for(size_type i = 0; i < n; ++i) {
+          buffer[count[(items[i].first >> shift) & mask]++] = items[i];
+        }
+        items.swap(buffer);
+      }
+    }
+
+    // The fields compared by RunOrLumiEntry::operator<, least significant first
+    IndexIntoFile::EntryNumber_t sortField(IndexIntoFile::RunOrLumiEntry const& entry, unsigned int field) {
+      return field == 0 ? entry.entry() : (field == 1 ? entry.orderPHIDRunLumi() : entry.orderPHIDRun());
+    }
+
+    // Sorts the entries into the same order std::stable_sort gives with
+    // RunOrLumiEntry::operator<. Each field is offset by its minimum and
+    // as many fields as fit are packed into one 64 bit key. In the usual
+    // case all three fit and there is one radix sort; otherwise the keys
+    // with the less significant fields are sorted first.
+    void radixSortRunOrLumiEntries(std::vector<IndexIntoFile::RunOrLumiEntry>& entries) {
+      typedef std::vector<IndexIntoFile::RunOrLumiEntry>::size_type size_type;
+      size_type const n = entries.size();
+      if(n < 2) return;
+      unsigned int const nFields = 3;
+
+      IndexIntoFile::EntryNumber_t low[nFields];
+      IndexIntoFile::EntryNumber_t high[nFields];
+      for(unsigned int field = 0; field < nFields; ++field) {
+        low[field] = high[field] = sortField(entries[0], field);
+      }
+      for(size_type i = 1; i < n; ++i) {
+        for(unsigned int field = 0; field < nFields; ++field) {
+          IndexIntoFile::EntryNumber_t value = sortField(entries[i], field);
+          if(value < low[field]) low[field] = value;
+          if(value > high[field]) high[field] = value;
+        }
+      }
+      unsigned long long minimum[nFields];
+      unsigned int width[nFields];
+      for(unsigned int field = 0; field < nFields; ++field) {
+        minimum[field] = static_cast<unsigned long long>(low[field]);
+        unsigned long long range = static_cast<unsigned long long>(high[field]) - minimum[field];
+        width[field] = 0;
+        for(; range != 0; range >>= 1) ++width[field];
+      }
+
+      std::vector<KeyAndPosition> items(n);
+      for(size_type i = 0; i < n; ++i) items[i].second = i;
+      for(unsigned int firstField = 0; firstField < nFields;) {
+        unsigned int endField = firstField + 1;
+        unsigned int bits = width[firstField];
+        while(endField < nFields && bits + width[endField] <= 64) {
+          bits += width[endField];
+          ++endField;
+        }
+        for(size_type i = 0; i < n; ++i) {
+          IndexIntoFile::RunOrLumiEntry const& entry = entries[items[i].second];
+          unsigned long long key = 0;
+          unsigned int shift = 0;
+          for(unsigned int field = firstField; field < endField; ++field) {
+            if(width[field] != 0) {
+              key |= (static_cast<unsigned long long>(sortField(entry, field)) - minimum[field]) << shift;
+              shift += width[field];
+            }
+          }
+          items[i].first = key;
+        }
+        stableRadixSort(items);
+        firstField = endField;
+      }
+
+      std::vector<IndexIntoFile::RunOrLumiEntry> sorted;
+      sorted.reserve(n);
+      for(size_type i = 0; i < n; ++i) {
+        sorted.push_back(entries[items[i].second]);
+      }
+      entries.swap(sorted);
+    }
+  }
+
   void
   IndexIntoFile::reduceProcessHistoryIDs() {
 
@@ -329,9 +723,10 @@ namespace edm {
 
     std::vector<ProcessHistoryID> reducedPHIDs;
 
-    std::map<ProcessHistoryID, int> reducedPHIDToIndex;
-    std::pair<ProcessHistoryID, int> mapEntry(ProcessHistoryID(), 0);
-    std::pair<std::map<ProcessHistoryID, int>::iterator, bool> insertResult;
+    typedef FlatHashMap<ProcessHistoryID, int> PHIDToIndex;
+    PHIDToIndex reducedPHIDToIndex;
+    reducedPHIDToIndex.reserve(processHistoryIDs_.size());
+    std::pair<PHIDToIndex::iterator, bool> insertResult;
 
     std::vector<int> phidIndexConverter;
     for(std::vector<ProcessHistoryID>::const_iterator phid = processHistoryIDs_.begin(),
@@ -339,8 +734,7 @@ namespace edm {
          phid != iEnd; ++phid) {
 
       ProcessHistoryID const& reducedPHID = phidConverter.reduceProcessHistoryID(*phid);
-      mapEntry.first = reducedPHID;
-      insertResult = reducedPHIDToIndex.insert(mapEntry);
+      insertResult = reducedPHIDToIndex.insert(PHIDToIndex::value_type(reducedPHID, 0));
 
       if(insertResult.second) {
         insertResult.first->second = reducedPHIDs.size();
@@ -357,59 +751,75 @@ namespace edm {
       return;
     }
 
-    std::map<IndexIntoFile::IndexRunKey, int> runOrderMap;
-    std::pair<std::map<IndexIntoFile::IndexRunKey, int>::iterator, bool> runInsertResult;
-
-    std::map<IndexIntoFile::IndexRunLumiKey, int> lumiOrderMap;
-    std::pair<std::map<IndexIntoFile::IndexRunLumiKey, int>::iterator, bool> lumiInsertResult;
-
-    // loop over all the RunOrLumiEntry's
-    for(std::vector<RunOrLumiEntry>::iterator i = runOrLumiEntries_.begin(),
-         iterEnd = runOrLumiEntries_.end();
-         i != iterEnd; ++i) {
-
-      // Convert the process history index so it points into the new vector of reduced IDs
-      i->setProcessHistoryIDIndex(phidIndexConverter.at(i->processHistoryIDIndex()));
-
-      // Convert the phid-run order
-      IndexIntoFile::IndexRunKey runKey(i->processHistoryIDIndex(), i->run());
-      runInsertResult = runOrderMap.insert(std::pair<IndexIntoFile::IndexRunKey, int>(runKey,0));
-      if(runInsertResult.second) {
-        runInsertResult.first->second = i->orderPHIDRun();
+    // Convert the process history indexes so they point into the new vector of reduced IDs.
+    // All the entries with the same phid and run take the phid-run order of the first
+    // of them and all the lumi entries with the same phid, run and lumi take the
+    // phid-run-lumi order of the first of them. The equal keys are grouped by a stable
+    // radix sort, so the first of each group is also the first in runOrLumiEntries_.
+    typedef std::vector<RunOrLumiEntry>::size_type size_type;
+    size_type const n = runOrLumiEntries_.size();
+    std::vector<KeyAndPosition> runItems(n);
+    for(size_type i = 0; i < n; ++i) {
+      RunOrLumiEntry& entry = runOrLumiEntries_[i];
+      entry.setProcessHistoryIDIndex(phidIndexConverter.at(entry.processHistoryIDIndex()));
+      runItems[i].first = (static_cast<unsigned long long>(entry.processHistoryIDIndex()) << 32) | entry.run();
+      runItems[i].second = i;
+    }
+    stableRadixSort(runItems);
+
+    // The lumi keys use the rank of the phid-run group in place of the phid and run.
+    // Within a group the lumi entries are still in the order of runOrLumiEntries_.
+    std::vector<KeyAndPosition> lumiItems;
+    lumiItems.reserve(n);
+    unsigned long long runRank = 0;
+    EntryNumber_t orderPHIDRun = invalidEntry;
+    for(size_type j = 0; j < n; ++j) {
+      RunOrLumiEntry& entry = runOrLumiEntries_[runItems[j].second];
+      if(j == 0 || runItems[j].first != runItems[j - 1].first) {
+        if(j != 0) ++runRank;
+        orderPHIDRun = entry.orderPHIDRun();
       } else {
-        i->setOrderPHIDRun(runInsertResult.first->second);
+        entry.setOrderPHIDRun(orderPHIDRun);
+      }
+      if(entry.lumi() != 0) {
+        lumiItems.push_back(KeyAndPosition((runRank << 32) | entry.lumi(), runItems[j].second));
       }
+    }
+    stableRadixSort(lumiItems);
 
-      // Convert the phid-run-lumi order for the lumi entries
-      if(i->lumi() != 0) {
-        IndexIntoFile::IndexRunLumiKey lumiKey(i->processHistoryIDIndex(), i->run(), i->lumi());
-        lumiInsertResult = lumiOrderMap.insert(std::pair<IndexIntoFile::IndexRunLumiKey, int>(lumiKey,0));
-        if(lumiInsertResult.second) {
-          lumiInsertResult.first->second = i->orderPHIDRunLumi();
-        } else {
-          i->setOrderPHIDRunLumi(lumiInsertResult.first->second);
-        }
+    EntryNumber_t orderPHIDRunLumi = invalidEntry;
+    for(size_type j = 0; j < lumiItems.size(); ++j) {
+      RunOrLumiEntry& entry = runOrLumiEntries_[lumiItems[j].second];
+      if(j == 0 || lumiItems[j].first != lumiItems[j - 1].first) {
+        orderPHIDRunLumi = entry.orderPHIDRunLumi();
+      } else {
+        entry.setOrderPHIDRunLumi(orderPHIDRunLumi);
       }
     }
-    std::stable_sort(runOrLumiEntries_.begin(), runOrLumiEntries_.end());
+    radixSortRunOrLumiEntries(runOrLumiEntries_);
   }
 
   void
   IndexIntoFile::fixIndexes(std::vector<ProcessHistoryID> & processHistoryIDs) {
 
+    typedef FlatHashMap<ProcessHistoryID, int> PHIDToIndex;
+    PHIDToIndex existingIndexes;
+    existingIndexes.reserve(processHistoryIDs.size() + processHistoryIDs_.size());
+    for(std::vector<ProcessHistoryID>::size_type i = 0; i < processHistoryIDs.size(); ++i) {
+      existingIndexes.insert(PHIDToIndex::value_type(processHistoryIDs[i], i));
+    }
+
     std::map<int, int> oldToNewIndex;
     for(std::vector<ProcessHistoryID>::const_iterator iter = processHistoryIDs_.begin(),
                                                       iEnd = processHistoryIDs_.end();
          iter != iEnd;
          ++iter) {
-      std::vector<ProcessHistoryID>::const_iterator iterExisting =
-        std::find(processHistoryIDs.begin(), processHistoryIDs.end(), *iter);
-      if(iterExisting == processHistoryIDs.end()) {
-        oldToNewIndex[iter - processHistoryIDs_.begin()] = processHistoryIDs.size();
+      std::pair<PHIDToIndex::iterator, bool> insertResult =
+        existingIndexes.insert(PHIDToIndex::value_type(*iter, processHistoryIDs.size()));
+      if(insertResult.second) {
         processHistoryIDs.push_back(*iter);
-      } else {
-        oldToNewIndex[iter - processHistoryIDs_.begin()] = iterExisting - processHistoryIDs.begin();
       }
+      oldToNewIndex[iter - processHistoryIDs_.begin()] = insertResult.first->second;
     }
     processHistoryIDs_ = processHistoryIDs;
 
@@ -422,12 +832,17 @@ namespace edm {
   }
 
   void IndexIntoFile::sortVector_Run_Or_Lumi_Entries() {
+    // The entries of a run are usually next to each other, so the last lookup is reused
+    std::map<IndexRunKey, EntryNumber_t>::const_iterator firstRunEntry = runToFirstEntry().end();
     for(std::vector<RunOrLumiEntry>::iterator iter = runOrLumiEntries_.begin(),
                                                iEnd = runOrLumiEntries_.end();
          iter != iEnd;
          ++iter) {
-      std::map<IndexRunKey, EntryNumber_t>::const_iterator firstRunEntry =
-        runToFirstEntry().find(IndexRunKey(iter->processHistoryIDIndex(), iter->run()));
+      if(firstRunEntry == runToFirstEntry().end() ||
+         firstRunEntry->first.processHistoryIDIndex() != iter->processHistoryIDIndex() ||
+         firstRunEntry->first.run() != iter->run()) {
+        firstRunEntry = runToFirstEntry().find(IndexRunKey(iter->processHistoryIDIndex(), iter->run()));
+      }
       if(firstRunEntry == runToFirstEntry().end()) {
         throw Exception(errors::LogicError)
           << "In IndexIntoFile::sortVector_Run_Or_Lumi_Entries. A run entry is missing.\n"
@@ -440,7 +855,7 @@ namespace edm {
       }
       iter->setOrderPHIDRun(firstRunEntry->second);
     }
-    stable_sort_all(runOrLumiEntries_);
+    radixSortRunOrLumiEntries(runOrLumiEntries_);
   }
 
   void IndexIntoFile::sortEvents() const {
@@ -511,6 +926,24 @@ namespace edm {
     return iter;
   }
 
+  IndexIntoFile::IndexIntoFileItr IndexIntoFile::begin(SortOrder sortOrder,
+                                                       std::vector<LuminosityBlockRange> const& lumiMask) const {
+    if(empty()) {
+      return end(sortOrder);
+    }
+    IndexIntoFileItr iter(this,
+                          sortOrder,
+                          kRun,
+                          0,
+                          invalidIndex,
+                          invalidIndex,
+                          0,
+                          0,
+                          &lumiMask);
+    iter.initializeRun();
+    return iter;
+  }
+
   IndexIntoFile::IndexIntoFileItr IndexIntoFile::end(SortOrder sortOrder) const {
     return IndexIntoFileItr(this,
                             sortOrder,
@@ -535,12 +968,129 @@ namespace edm {
     return true;
   }
 
+  namespace {
+    // A place where a chunk of a partition can start, the first entry of
+    // a run or of a lumi, and the number of events before it
+    struct ChunkBoundary {
+      ChunkBoundary(int indexToFirstRun, int indexToLastRun, int indexToLumi, long long nEventsBefore) :
+        indexToFirstRun_(indexToFirstRun),
+        indexToLastRun_(indexToLastRun),
+        indexToLumi_(indexToLumi),
+        nEventsBefore_(nEventsBefore) {}
+      int indexToFirstRun_;
+      int indexToLastRun_;
+      int indexToLumi_;  // invalidIndex at the start of a run
+      long long nEventsBefore_;
+    };
+
+    bool beforeEventCount(ChunkBoundary const& boundary, long long nEvents) {
+      return boundary.nEventsBefore_ < nEvents;
+    }
+  }
+
+  void IndexIntoFile::partition(SortOrder sortOrder,
+                                unsigned int nChunks,
+                                std::vector<std::pair<IndexIntoFileItr, IndexIntoFileItr> >& chunks) const {
+    if(nChunks == 0) return;
+    if(empty()) {
+      chunks.emplace_back(begin(sortOrder), end(sortOrder));
+      return;
+    }
+
+    bool sorted = (sortOrder == numericalOrder);
+    if(sorted) fillRunOrLumiIndexes();
+    std::vector<RunOrLumiIndexes> const& indexes = runOrLumiIndexes();
+    auto isRun = [&](int i) {return sorted ? indexes[i].isRun() : runOrLumiEntries_[i].isRun();};
+    auto isSameRun = [&](int i, int j) {
+      return sorted ? indexes[i].run() == indexes[j].run() &&
+                      indexes[i].processHistoryIDIndex() == indexes[j].processHistoryIDIndex()
+                    : runOrLumiEntries_[i].run() == runOrLumiEntries_[j].run() &&
+                      runOrLumiEntries_[i].processHistoryIDIndex() == runOrLumiEntries_[j].processHistoryIDIndex();
+    };
+    auto isSameLumi = [&](int i, int j) {
+      return sorted ? indexes[i].lumi() == indexes[j].lumi() : runOrLumiEntries_[i].lumi() == runOrLumiEntries_[j].lumi();
+    };
+
+    // The run and lumi transitions are the same as in IndexIntoFileItrImpl::next.
+    // All the entries of a lumi share one range of event numbers in numerical order.
+    std::vector<ChunkBoundary> boundaries;
+    long long nEvents = 0;
+    int firstRunEntry = 0;
+    int lastRunEntry = 0;
+    int size = static_cast<int>(runOrLumiEntries_.size());
+    for(int i = 0; i < size; ++i) {
+      if(isRun(i)) {
+        if(i == 0 || !isRun(i - 1) || !isSameRun(i - 1, i)) {
+          if(i != 0) boundaries.emplace_back(i, i, invalidIndex, nEvents);
+          firstRunEntry = i;
+        }
+        lastRunEntry = i;
+      } else {
+        bool newLumi = isRun(i - 1) || !isSameLumi(i - 1, i);
+        if(newLumi && !isRun(i - 1)) boundaries.emplace_back(firstRunEntry, lastRunEntry, i, nEvents);
+        if(sorted) {
+          if(newLumi) nEvents += indexes[i].endEventNumbers() - indexes[i].beginEventNumbers();
+        } else if(runOrLumiEntries_[i].beginEvents() != invalidEntry) {
+          nEvents += runOrLumiEntries_[i].endEvents() - runOrLumiEntries_[i].beginEvents();
+        }
+      }
+    }
+
+    // For each target event count pick the closest boundary, skipping
+    // those that would leave a chunk without events
+    std::vector<ChunkBoundary const*> selected;
+    std::vector<ChunkBoundary>::const_iterator next = boundaries.begin();
+    long long previousEvents = 0;
+    for(unsigned int k = 1; k < nChunks; ++k) {
+      long long target = nEvents * k / nChunks;
+      std::vector<ChunkBoundary>::const_iterator boundary =
+        std::lower_bound(next, boundaries.cend(), target, beforeEventCount);
+      if(boundary != next &&
+         (boundary == boundaries.end() || target - (boundary - 1)->nEventsBefore_ < boundary->nEventsBefore_ - target)) {
+        --boundary;
+      }
+      if(boundary == boundaries.end() ||
+         boundary->nEventsBefore_ <= previousEvents ||
+         boundary->nEventsBefore_ >= nEvents) {
+        continue;
+      }
+      selected.push_back(&*boundary);
+      previousEvents = boundary->nEventsBefore_;
+      next = boundary + 1;
+    }
+
+    // At a run the chunks end and begin where the iteration reaches it. In the
+    // middle of a run the next chunk begins at the run and then goes to the lumi.
+    IndexIntoFileItr chunkBegin = begin(sortOrder);
+    for(std::vector<ChunkBoundary const*>::const_iterator it = selected.begin(), itEnd = selected.end();
+        it != itEnd; ++it) {
+      ChunkBoundary const& boundary = **it;
+      if(boundary.indexToLumi_ == invalidIndex) {
+        IndexIntoFileItr atRun(this, sortOrder, kRun, boundary.indexToFirstRun_, invalidIndex, invalidIndex, 0, 0);
+        atRun.initializeRun();
+        chunks.emplace_back(chunkBegin, atRun);
+        chunkBegin = atRun;
+      } else {
+        IndexIntoFileItr atLumi(this, sortOrder, kLumi, boundary.indexToLastRun_, boundary.indexToLumi_, invalidIndex, 0, 0);
+        atLumi.initializeLumi();
+        chunks.emplace_back(chunkBegin, atLumi);
+        IndexIntoFileItr atRun(this, sortOrder, kRun, boundary.indexToFirstRun_, boundary.indexToLumi_, invalidIndex, 0, 0);
+        atRun.initializeLumi();
+        chunkBegin = atRun;
+      }
+    }
+    chunks.emplace_back(chunkBegin, end(sortOrder));
+  }
+
   bool IndexIntoFile::empty() const {
     return runOrLumiEntries().empty();
   }
 
   IndexIntoFile::IndexIntoFileItr
   IndexIntoFile::findPosition(RunNumber_t run, LuminosityBlockNumber_t lumi, EventNumber_t event) const {
+    if(event != invalidEvent && !eventFilter().mayContain(run, event)) {
+      return end(numericalOrder);
+    }
     fillRunOrLumiIndexes();
 
     bool lumiMissing = (lumi == 0 && event != 0);
@@ -600,22 +1150,10 @@ namespace edm {
 
         long long indexToEvent = 0;
         if(!eventEntries().empty()) {
-          std::vector<EventEntry>::const_iterator eventIter = std::lower_bound(eventEntries().begin() + beginEventNumbers,
-                                                                               eventEntries().begin() + endEventNumbers,
-                                                                               EventEntry(event, invalidEntry));
-          if(eventIter == (eventEntries().begin() + endEventNumbers) ||
-              eventIter->event() != event) continue;
-
-          indexToEvent = eventIter - eventEntries().begin() - beginEventNumbers;
+          if(!findEventEntry(beginEventNumbers, endEventNumbers, event, indexToEvent)) continue;
         } else {
           fillEventNumbers();
-          std::vector<EventNumber_t>::const_iterator eventIter = std::lower_bound(eventNumbers().begin() + beginEventNumbers,
-                                                                                  eventNumbers().begin() + endEventNumbers,
-                                                                                  event);
-          if(eventIter == (eventNumbers().begin() + endEventNumbers) ||
-              *eventIter != event) continue;
-
-          indexToEvent = eventIter - eventNumbers().begin() - beginEventNumbers;
+          if(!findEventNumber(beginEventNumbers, endEventNumbers, event, indexToEvent)) continue;
         }
         return IndexIntoFileItr(this,
                                 numericalOrder,
@@ -648,20 +1186,10 @@ namespace edm {
 
           long long indexToEvent = 0;
           if(!eventEntries().empty()) {
-            std::vector<EventEntry>::const_iterator eventIter = std::lower_bound(eventEntries().begin() + beginEventNumbers,
-                                                                                 eventEntries().begin() + endEventNumbers,
-                                                                                 EventEntry(event, invalidEntry));
-            if(eventIter == (eventEntries().begin() + endEventNumbers) ||
-                eventIter->event() != event) continue;
-            indexToEvent = eventIter - eventEntries().begin() - beginEventNumbers;
+            if(!findEventEntry(beginEventNumbers, endEventNumbers, event, indexToEvent)) continue;
           } else {
             fillEventNumbers();
-            std::vector<EventNumber_t>::const_iterator eventIter = std::lower_bound(eventNumbers().begin() + beginEventNumbers,
-                                                                                    eventNumbers().begin() + endEventNumbers,
-                                                                                    event);
-            if(eventIter == (eventNumbers().begin() + endEventNumbers) ||
-                *eventIter != event) continue;
-            indexToEvent = eventIter - eventNumbers().begin() - beginEventNumbers;
+            if(!findEventNumber(beginEventNumbers, endEventNumbers, event, indexToEvent)) continue;
           }
           return IndexIntoFileItr(this,
                                   numericalOrder,
@@ -686,6 +1214,56 @@ namespace edm {
 
   }
 
+  bool
+  IndexIntoFile::findEventNumber(long long beginEventNumbers, long long endEventNumbers,
+                                 EventNumber_t event, long long& indexToEvent) const {
+    if(!compressedEventNumbers().empty()) {
+      CompressedEventNumbers::size_type i = compressedEventNumbers().lower_bound(beginEventNumbers, endEventNumbers, event);
+      if(i == static_cast<CompressedEventNumbers::size_type>(endEventNumbers) ||
+          compressedEventNumbers()[i] != event) return false;
+      indexToEvent = i - beginEventNumbers;
+      return true;
+    }
+    std::vector<EventNumber_t> const& events = eventNumbers();
+    long long i = eventSearchIndex().lowerBound(beginEventNumbers, endEventNumbers, event,
+                                                [&events](long long j) {return events[j];});
+    if(i < 0) {
+      i = std::lower_bound(events.begin() + beginEventNumbers, events.begin() + endEventNumbers, event) - events.begin();
+    }
+    if(i == endEventNumbers || events[i] != event) return false;
+    indexToEvent = i - beginEventNumbers;
+    return true;
+  }
+
+  bool
+  IndexIntoFile::findEventEntry(long long beginEventNumbers, long long endEventNumbers,
+                                EventNumber_t event, long long& indexToEvent) const {
+    std::vector<EventEntry> const& entries = eventEntries();
+    long long i = eventSearchIndex().lowerBound(beginEventNumbers, endEventNumbers, event,
+                                                [&entries](long long j) {return entries[j].event();});
+    if(i < 0) {
+      i = std::lower_bound(entries.begin() + beginEventNumbers, entries.begin() + endEventNumbers,
+                           EventEntry(event, invalidEntry)) - entries.begin();
+    }
+    if(i == endEventNumbers || entries[i].event() != event) return false;
+    indexToEvent = i - beginEventNumbers;
+    return true;
+  }
+
+  // Returns a pointer to the event numbers in the range, decoding them
+  // into buffer first if the event numbers have been compressed. The
+  // range may be empty, even at the end of the vector.
+  EventNumber_t const*
+  IndexIntoFile::eventNumbersInRange(long long beginEventNumbers, long long endEventNumbers,
+                                     std::vector<EventNumber_t>& buffer) const {
+    if(compressedEventNumbers().empty()) {
+      return eventNumbers().data() + beginEventNumbers;
+    }
+    buffer.resize(endEventNumbers - beginEventNumbers);
+    compressedEventNumbers().copy(beginEventNumbers, endEventNumbers, buffer.data());
+    return buffer.data();
+  }
+
   IndexIntoFile::IndexIntoFileItr
   IndexIntoFile::findPosition(SortOrder sortOrder, RunNumber_t run, LuminosityBlockNumber_t lumi, EventNumber_t event) const {
     if(sortOrder == IndexIntoFile::numericalOrder) {
@@ -774,9 +1352,169 @@ namespace edm {
     return SortedRunOrLumiItr(this, runOrLumiEntries().size());
   }
 
+  namespace {
+    // Inserts into a set with end() as the hint. The intersection produces the
+    // keys in increasing order, so each insertion takes constant time. Unlike
+    // std::insert_iterator it does not increment the hint after each insertion,
+    // which walks up the tree from the last node.
+    template<typename Set>
+    class EndInsertIterator {
+    public:
+      typedef std::output_iterator_tag iterator_category;
+      typedef void value_type;
+      typedef void difference_type;
+      typedef void pointer;
+      typedef void reference;
+
+      explicit EndInsertIterator(Set& set) : set_(&set) {}
+      EndInsertIterator& operator=(typename Set::value_type const& value) {
+        set_->insert(set_->end(), value);
+        return *this;
+      }
+      EndInsertIterator& operator*() {return *this;}
+      EndInsertIterator& operator++() {return *this;}
+      EndInsertIterator& operator++(int) {return *this;}
+
+    private:
+      Set* set_;
+    };
+  }
+
   void IndexIntoFile::set_intersection(IndexIntoFile const& indexIntoFile,
                                        std::set<IndexRunLumiEventKey> & intersection) const {
 
+    std::vector<std::pair<RunOrLumiIndexes const*, RunOrLumiIndexes const*> > matchingLumis;
+    findMatchingLumis(indexIntoFile, matchingLumis);
+    if(matchingLumis.empty()) return;
+
+    bool const useEventEntries = fillEventsToIntersect(indexIntoFile);
+    intersectMatchingLumis(indexIntoFile, matchingLumis, 0, matchingLumis.size(), useEventEntries,
+                           EndInsertIterator<std::set<IndexRunLumiEventKey> >(intersection));
+  }
+
+  void IndexIntoFile::set_intersection(IndexIntoFile const& indexIntoFile,
+                                       std::vector<IndexRunLumiEventKey> & intersection,
+                                       unsigned int nChunks) const {
+
+    std::vector<std::pair<RunOrLumiIndexes const*, RunOrLumiIndexes const*> > matchingLumis;
+    findMatchingLumis(indexIntoFile, matchingLumis);
+    if(matchingLumis.empty()) return;
+
+    bool const useEventEntries = fillEventsToIntersect(indexIntoFile);
+    if(nChunks < 2 || matchingLumis.size() < 2) {
+      intersectMatchingLumis(indexIntoFile, matchingLumis, 0, matchingLumis.size(), useEventEntries,
+                             std::back_inserter(intersection));
+      return;
+    }
+
+    // Split the lumis into contiguous chunks with about the same number of events.
+    // The smaller of the two lumis bounds the number of keys it can add.
+    long long nEvents = 0;
+    std::vector<long long> maxKeys(matchingLumis.size());
+    for(std::vector<RunOrLumiIndexes const*>::size_type i = 0; i < matchingLumis.size(); ++i) {
+      maxKeys[i] = std::min(matchingLumis[i].first->endEventNumbers() - matchingLumis[i].first->beginEventNumbers(),
+                            matchingLumis[i].second->endEventNumbers() - matchingLumis[i].second->beginEventNumbers());
+      nEvents += maxKeys[i];
+    }
+    long long eventsPerChunk = (nEvents + nChunks - 1) / nChunks;
+    std::vector<std::vector<RunOrLumiIndexes const*>::size_type> chunkBoundaries(1, 0U);
+    std::vector<long long> maxKeysInChunk(1, 0LL);
+    for(std::vector<RunOrLumiIndexes const*>::size_type i = 0; i < matchingLumis.size(); ++i) {
+      if(maxKeysInChunk.back() >= eventsPerChunk) {
+        chunkBoundaries.push_back(i);
+        maxKeysInChunk.push_back(0LL);
+      }
+      maxKeysInChunk.back() += maxKeys[i];
+    }
+    chunkBoundaries.push_back(matchingLumis.size());
+
+    // The first chunk appends to intersection directly, the others
+    // are appended in order after all chunks finish.
+    std::vector<std::vector<IndexRunLumiEventKey> > chunkKeys(chunkBoundaries.size() - 2);
+    for(std::vector<std::vector<IndexRunLumiEventKey> >::size_type chunk = 0; chunk < chunkKeys.size(); ++chunk) {
+      chunkKeys[chunk].reserve(maxKeysInChunk[chunk + 1]);
+    }
+    detail::forEachChunk(chunkBoundaries.size() - 1, [&](unsigned int chunk) {
+      std::vector<IndexRunLumiEventKey>& keys = chunk == 0 ? intersection : chunkKeys[chunk - 1];
+      intersectMatchingLumis(indexIntoFile, matchingLumis, chunkBoundaries[chunk], chunkBoundaries[chunk + 1],
+                             useEventEntries, std::back_inserter(keys));
+    });
+    for(std::vector<std::vector<IndexRunLumiEventKey> >::const_iterator it = chunkKeys.begin(), itEnd = chunkKeys.end();
+         it != itEnd; ++it) {
+      intersection.insert(intersection.end(), it->begin(), it->end());
+    }
+  }
+
+  bool IndexIntoFile::fillEventsToIntersect(IndexIntoFile const& indexIntoFile) const {
+    if(!eventEntries().empty() && !indexIntoFile.eventEntries().empty()) {
+      return true;
+    }
+    fillEventNumbers();
+    indexIntoFile.fillEventNumbers();
+    return false;
+  }
+
+  // Writes the keys of the events in both files for the lumis in [first, last)
+  // to out. Only reads the event vectors, so different ranges can be done
+  // concurrently.
+  template<typename OutputIterator>
+  void IndexIntoFile::intersectMatchingLumis(IndexIntoFile const& indexIntoFile,
+                                             std::vector<std::pair<RunOrLumiIndexes const*, RunOrLumiIndexes const*> > const& matchingLumis,
+                                             std::vector<RunOrLumiIndexes const*>::size_type first,
+                                             std::vector<RunOrLumiIndexes const*>::size_type last,
+                                             bool useEventEntries,
+                                             OutputIterator out) const {
+    std::vector<EventNumber_t> buffer1;
+    std::vector<EventNumber_t> buffer2;
+    std::vector<EventEntry> matchingEntries;
+    std::vector<EventNumber_t> matchingEvents;
+    for(std::vector<RunOrLumiIndexes const*>::size_type i = first; i != last; ++i) {
+      RunOrLumiIndexes const& indexes1 = *matchingLumis[i].first;
+      RunOrLumiIndexes const& indexes2 = *matchingLumis[i].second;
+      long long beginEventNumbers1 = indexes1.beginEventNumbers();
+      long long endEventNumbers1 = indexes1.endEventNumbers();
+      long long beginEventNumbers2 = indexes2.beginEventNumbers();
+      long long endEventNumbers2 = indexes2.endEventNumbers();
+
+      matchingEvents.clear();
+      if(useEventEntries) {
+        matchingEntries.clear();
+        std::set_intersection(eventEntries().begin() + beginEventNumbers1,
+                              eventEntries().begin() + endEventNumbers1,
+                              indexIntoFile.eventEntries().begin() + beginEventNumbers2,
+                              indexIntoFile.eventEntries().begin() + endEventNumbers2,
+                              std::back_inserter(matchingEntries));
+        for(std::vector<EventEntry>::const_iterator iEvent = matchingEntries.begin(),
+                                                       iEnd = matchingEntries.end();
+             iEvent != iEnd; ++iEvent) {
+          matchingEvents.push_back(iEvent->event());
+        }
+      } else {
+        EventNumber_t const* events1 = eventNumbersInRange(beginEventNumbers1, endEventNumbers1, buffer1);
+        EventNumber_t const* events2 = indexIntoFile.eventNumbersInRange(beginEventNumbers2, endEventNumbers2, buffer2);
+        std::set_intersection(events1,
+                              events1 + (endEventNumbers1 - beginEventNumbers1),
+                              events2,
+                              events2 + (endEventNumbers2 - beginEventNumbers2),
+                              std::back_inserter(matchingEvents));
+      }
+
+      // An event duplicated in both files appears more than once
+      for(std::vector<EventNumber_t>::const_iterator iEvent = matchingEvents.begin(),
+                                                        iEnd = matchingEvents.end();
+           iEvent != iEnd; ++iEvent) {
+        if(iEvent != matchingEvents.begin() && *iEvent == *(iEvent - 1)) continue;
+        *out++ = IndexRunLumiEventKey(indexes1.processHistoryIDIndex(),
+                                      indexes1.run(),
+                                      indexes1.lumi(),
+                                      *iEvent);
+      }
+    }
+  }
+
+  void IndexIntoFile::findMatchingLumis(IndexIntoFile const& indexIntoFile,
+                                        std::vector<std::pair<RunOrLumiIndexes const*, RunOrLumiIndexes const*> >& matchingLumis) const {
+
     if(empty() || indexIntoFile.empty()) return;
     fillRunOrLumiIndexes();
     indexIntoFile.fillRunOrLumiIndexes();
@@ -816,72 +1554,30 @@ namespace edm {
       } else { // they are equal
 
         // Skip them if it is a run or the same lumi
-        if(indexes1.isRun() ||
-            (previousIndexes && !(*previousIndexes < indexes1))) {
-          ++iter1;
-          ++iter2;
-        } else {
+        if(!indexes1.isRun() &&
+            !(previousIndexes && !(*previousIndexes < indexes1))) {
           previousIndexes = &indexes1;
 
-          // Found a matching lumi, now look for matching events
-
-          long long beginEventNumbers1 = indexes1.beginEventNumbers();
-          long long endEventNumbers1 = indexes1.endEventNumbers();
-
-          long long beginEventNumbers2 = indexes2.beginEventNumbers();
-          long long endEventNumbers2 = indexes2.endEventNumbers();
-
           // there must be at least 1 event in each lumi for there to be any matches
-          if((beginEventNumbers1 >= endEventNumbers1) ||
-              (beginEventNumbers2 >= endEventNumbers2)) {
-            ++iter1;
-            ++iter2;
-            continue;
-          }
-
-          if(!eventEntries().empty() && !indexIntoFile.eventEntries().empty()) {
-            std::vector<EventEntry> matchingEvents;
-            std::insert_iterator<std::vector<EventEntry> > insertIter(matchingEvents, matchingEvents.begin());
-            std::set_intersection(eventEntries().begin() + beginEventNumbers1,
-                                  eventEntries().begin() + endEventNumbers1,
-                                  indexIntoFile.eventEntries().begin() + beginEventNumbers2,
-                                  indexIntoFile.eventEntries().begin() + endEventNumbers2,
-                                  insertIter);
-            for(std::vector<EventEntry>::const_iterator iEvent = matchingEvents.begin(),
-                                                           iEnd = matchingEvents.end();
-                 iEvent != iEnd; ++iEvent) {
-              intersection.insert(IndexRunLumiEventKey(indexes1.processHistoryIDIndex(),
-                                                       indexes1.run(),
-                                                       indexes1.lumi(),
-                                                       iEvent->event()));
-            }
-          } else {
-            fillEventNumbers();
-            indexIntoFile.fillEventNumbers();
-            std::vector<EventNumber_t> matchingEvents;
-            std::insert_iterator<std::vector<EventNumber_t> > insertIter(matchingEvents, matchingEvents.begin());
-            std::set_intersection(eventNumbers().begin() + beginEventNumbers1,
-                                  eventNumbers().begin() + endEventNumbers1,
-                                  indexIntoFile.eventNumbers().begin() + beginEventNumbers2,
-                                  indexIntoFile.eventNumbers().begin() + endEventNumbers2,
-                                  insertIter);
-            for(std::vector<EventNumber_t>::const_iterator iEvent = matchingEvents.begin(),
-                                                              iEnd = matchingEvents.end();
-                 iEvent != iEnd; ++iEvent) {
-              intersection.insert(IndexRunLumiEventKey(indexes1.processHistoryIDIndex(),
-                                                       indexes1.run(),
-                                                       indexes1.lumi(),
-                                                       *iEvent));
-            }
+          if((indexes1.beginEventNumbers() < indexes1.endEventNumbers()) &&
+              (indexes2.beginEventNumbers() < indexes2.endEventNumbers())) {
+            matchingLumis.push_back(std::make_pair(&indexes1, &indexes2));
           }
         }
+        ++iter1;
+        ++iter2;
       }
     }
   }
 
-  bool IndexIntoFile::containsDuplicateEvents() const {
+  bool IndexIntoFile::containsDuplicateEvents(DuplicateCheckMethod method) const {
+
+    if(method == hashDuplicateCheck && eventEntries().empty() && !hasEventNumbers()) {
+      return containsDuplicateUnsortedEvents();
+    }
 
     RunOrLumiIndexes const* previousIndexes = 0;
+    std::vector<EventNumber_t> buffer;
 
     for(SortedRunOrLumiItr iter = beginRunOrLumi(),
                             iEnd = endRunOrLumi();
@@ -909,8 +1605,9 @@ namespace edm {
         }
       } else {
         fillEventNumbers();
-        std::vector<EventNumber_t>::iterator last = eventNumbers().begin() + endEventNumbers;
-        if(std::adjacent_find(eventNumbers().begin() + beginEventNumbers, last) != last) {
+        EventNumber_t const* first = eventNumbersInRange(beginEventNumbers, endEventNumbers, buffer);
+        EventNumber_t const* last = first + (endEventNumbers - beginEventNumbers);
+        if(std::adjacent_find(first, last) != last) {
            return true;
         }
       }
@@ -918,6 +1615,78 @@ namespace edm {
     return false;
   }
 
+  namespace {
+    // Open addressing set of event numbers, reused for every lumi.
+    // Event numbers are never invalidEvent, so it marks an empty slot.
+    class EventNumberSet {
+    public:
+      EventNumberSet() : slots_(), mask_(0U), shift_(64U) {}
+
+      // Empties the set and sizes it for at most nEvents events
+      void reset(long long nEvents) {
+        std::vector<EventNumber_t>::size_type capacity = 16U;
+        unsigned int shift = 60U;
+        while(capacity < 2U * static_cast<unsigned long long>(nEvents)) {
+          capacity *= 2U;
+          --shift;
+        }
+        if(capacity > slots_.size()) {
+          slots_.assign(capacity, IndexIntoFile::invalidEvent);
+        } else {
+          std::fill(slots_.begin(), slots_.begin() + capacity, IndexIntoFile::invalidEvent);
+        }
+        mask_ = capacity - 1U;
+        shift_ = shift;
+      }
+
+      // Returns false if the event was already in the set
+      bool insert(EventNumber_t event) {
+        std::vector<EventNumber_t>::size_type slot = (event * 0x9E3779B97F4A7C15ULL) >> shift_;
+        while(slots_[slot] != IndexIntoFile::invalidEvent) {
+          if(slots_[slot] == event) return false;
+          slot = (slot + 1U) & mask_;
+        }
+        slots_[slot] = event;
+        return true;
+      }
+
+    private:
+      std::vector<EventNumber_t> slots_;
+      std::vector<EventNumber_t>::size_type mask_;
+      unsigned int shift_;
+    };
+  }
+
+  bool IndexIntoFile::containsDuplicateUnsortedEvents() const {
+    fillRunOrLumiIndexes();
+    fillUnsortedEventNumbers();
+    std::vector<EventNumber_t> const& unsorted = unsortedEventNumbers();
+    EventNumberSet events;
+
+    std::vector<RunOrLumiIndexes>::const_iterator iter = runOrLumiIndexes().begin();
+    std::vector<RunOrLumiIndexes>::const_iterator iEnd = runOrLumiIndexes().end();
+    while(iter != iEnd) {
+
+      // there must be more than 1 event in the lumi for there to be any duplicates
+      if(iter->isRun() || iter->beginEventNumbers() + 1 >= iter->endEventNumbers()) {
+        ++iter;
+        continue;
+      }
+      assert(unsorted.size() == numberOfEvents());
+      events.reset(iter->endEventNumbers() - iter->beginEventNumbers());
+
+      // All the entries of the same lumi are next to each other
+      for(std::vector<RunOrLumiIndexes>::const_iterator lumi = iter; iter != iEnd && !(*lumi < *iter); ++iter) {
+        RunOrLumiEntry const& runOrLumiEntry = runOrLumiEntries_[iter->indexToGetEntry()];
+        if(runOrLumiEntry.beginEvents() == invalidEntry) continue;
+        for(EntryNumber_t entry = runOrLumiEntry.beginEvents(); entry != runOrLumiEntry.endEvents(); ++entry) {
+          if(!events.insert(unsorted[entry])) return true;
+        }
+      }
+    }
+    return false;
+  }
+
   IndexIntoFile::RunOrLumiEntry::RunOrLumiEntry() :
     orderPHIDRun_(invalidEntry),
     orderPHIDRunLumi_(invalidEntry),
@@ -1005,24 +1774,30 @@ namespace edm {
   }
 
   IndexIntoFile::IndexIntoFileItrImpl::IndexIntoFileItrImpl(IndexIntoFile const* indexIntoFile,
+                       SortOrder sortOrder,
                        EntryType entryType,
                        int indexToRun,
                        int indexToLumi,
                        int indexToEventRange,
                        long long indexToEvent,
-                       long long nEvents) :
+                       long long nEvents,
+                       std::vector<LuminosityBlockRange> const* lumiMask) :
     indexIntoFile_(indexIntoFile),
     size_(static_cast<int>(indexIntoFile_->runOrLumiEntries_.size())),
+    sortOrder_(sortOrder),
     type_(entryType),
     indexToRun_(indexToRun),
     indexToLumi_(indexToLumi),
     indexToEventRange_(indexToEventRange),
     indexToEvent_(indexToEvent),
-    nEvents_(nEvents) {
+    nEvents_(nEvents),
+    lumiMask_(lumiMask),
+    maskIndex_(0) {
+    if(sorted()) {
+      indexIntoFile->fillRunOrLumiIndexes();
+    }
   }
 
-  IndexIntoFile::IndexIntoFileItrImpl::~IndexIntoFileItrImpl() {}
-
   void IndexIntoFile::IndexIntoFileItrImpl::next() {
 
     if(type_ == kEvent) {
@@ -1032,17 +1807,7 @@ namespace edm {
         bool found = nextEventRange();
 
         if(!found) {
-          type_ = getRunOrLumiEntryType(indexToLumi_ + 1);
-
-          if(type_ == kLumi) {
-            ++indexToLumi_;
-            initializeLumi();
-          } else if(type_ == kRun) {
-            indexToRun_ = indexToLumi_ + 1;
-            initializeRun();
-          } else {
-            setInvalid(); // type_ is kEnd
-          }
+          moveToLumiOrRun(indexToLumi_ + 1);
         }
       }
     } else if(type_ == kLumi) {
@@ -1066,8 +1831,7 @@ namespace edm {
           indexToRun_ = indexToLumi_ + 1;
           initializeRun();
         } else {
-          ++indexToLumi_;
-          initializeLumi();
+          moveToLumiOrRun(indexToLumi_ + 1);
         }
       }
     } else if(type_ == kRun) {
@@ -1193,11 +1957,14 @@ namespace edm {
     }
     if(newLumi <= 0) return false;
 
-    // Look backwards for a lumi with events
+    // Look backwards for a lumi with events, jumping over lumis rejected by the mask
     for( ; newLumi > 0; --newLumi) {
       if(getRunOrLumiEntryType(newLumi) == kRun) {
         continue;
       }
+      if(lumiMask_ != 0 && !lumiInMask(newLumi)) {
+        continue;
+      }
       if(setToLastEventInRange(newLumi)) {
         break;  // found it
       }
@@ -1336,9 +2103,7 @@ namespace edm {
         }
       } else if(indexToLumi_ != invalidIndex) {
         if(!isSameLumi(indexToLumi_, startSearch + i)) {
-          type_ = kLumi;
-          indexToLumi_ = startSearch + i;
-          initializeLumi();
+          moveToLumiOrRun(startSearch + i);
           return;
         }
       }
@@ -1355,29 +2120,215 @@ namespace edm {
     return nextEventRange();
   }
 
-  void IndexIntoFile::IndexIntoFileItrImpl::initializeRun() {
-
-    indexToLumi_ = invalidIndex;
-    indexToEventRange_ = invalidIndex;
-    indexToEvent_ = 0;
-    nEvents_ = 0;
+  long long IndexIntoFile::IndexIntoFileItrImpl::getEventEntryRangesInLumi(std::vector<EntryRange>& ranges) const {
+    if(indexToEventRange_ == invalidIndex || indexToEvent_ >= nEvents_) return 0;
 
-    for(int i = 1; (i + indexToRun_) < size_; ++i) {
-      EntryType entryType = getRunOrLumiEntryType(indexToRun_ + i);
-      bool sameRun = isSameRun(indexToRun_, indexToRun_ + i);
+    std::vector<EntryRange>::size_type firstNewRange = ranges.size();
 
-      if(entryType == kRun) {
-        if(sameRun) {
-          continue;
+    if(sorted()) {
+      indexIntoFile_->fillEventEntries();
+      std::vector<EventEntry> const& eventEntries = indexIntoFile_->eventEntries();
+      long long beginEventNumbers = indexIntoFile_->runOrLumiIndexes()[indexToEventRange_].beginEventNumbers();
+      for(long long i = beginEventNumbers + indexToEvent_, iEnd = beginEventNumbers + nEvents_; i != iEnd; ++i) {
+        EntryNumber_t entry = eventEntries[i].entry();
+        if(ranges.size() > firstNewRange && ranges.back().second == entry) {
+          ++ranges.back().second;
         } else {
-          break;
+          ranges.push_back(EntryRange(entry, entry + 1));
         }
+      }
+      return nEvents_ - indexToEvent_;
+    }
+
+    long long nEventsInRanges = 0;
+    IndexIntoFileItrImpl position(*this);
+    do {
+      RunOrLumiEntry const& runOrLumiEntry = indexIntoFile_->runOrLumiEntries()[position.indexToEventRange_];
+      EntryNumber_t beginEntry = runOrLumiEntry.beginEvents() + position.indexToEvent_;
+      EntryNumber_t endEntry = runOrLumiEntry.endEvents();
+      if(ranges.size() > firstNewRange && ranges.back().second == beginEntry) {
+        ranges.back().second = endEntry;
       } else {
-        indexToLumi_ = indexToRun_ + i;
-        initializeLumi();
+        ranges.push_back(EntryRange(beginEntry, endEntry));
+      }
+      nEventsInRanges += endEntry - beginEntry;
+    } while(position.nextEventRange());
+    return nEventsInRanges;
+  }
+
+  void IndexIntoFile::IndexIntoFileItrImpl::skipEventsInLumi() {
+    if(type_ != kEvent) return;
+    while(nextEventRange()) {}
+    indexToEvent_ = nEvents_ - 1;
+    next();
+  }
+
+  void IndexIntoFile::IndexIntoFileItrImpl::initializeRun() {
+
+    while(true) {
+      indexToLumi_ = invalidIndex;
+      indexToEventRange_ = invalidIndex;
+      indexToEvent_ = 0;
+      nEvents_ = 0;
+
+      int i = 1;
+      for(; (i + indexToRun_) < size_; ++i) {
+        EntryType entryType = getRunOrLumiEntryType(indexToRun_ + i);
+        bool sameRun = isSameRun(indexToRun_, indexToRun_ + i);
+
+        if(entryType == kRun) {
+          if(sameRun) {
+            continue;
+          } else {
+            break;
+          }
+        } else {
+          int index = indexToRun_ + i;
+          if(lumiMask_ != 0) {
+            index = findLumiInMask(index);
+            if(getRunOrLumiEntryType(index) != kLumi) {
+              i = index - indexToRun_;
+              break;
+            }
+          }
+          indexToLumi_ = index;
+          initializeLumi();
+          return;
+        }
+      }
+      if(lumiMask_ == 0) return;
+
+      // With a lumi mask, a run without accepted lumis is not visited
+      if(indexToRun_ + i >= size_) {
+        setInvalid();
         return;
       }
+      indexToRun_ += i;
+    }
+  }
+
+  // Moves to the lumi or run at index, or to the end if index is past
+  // the last entry. With a lumi mask, rejected lumis are jumped over.
+  void IndexIntoFile::IndexIntoFileItrImpl::moveToLumiOrRun(int index) {
+    if(lumiMask_ != 0) index = findLumiInMask(index);
+    type_ = getRunOrLumiEntryType(index);
+    if(type_ == kLumi) {
+      indexToLumi_ = index;
+      initializeLumi();
+    } else if(type_ == kRun) {
+      indexToRun_ = index;
+      initializeRun();
+    } else {
+      setInvalid(); // type_ is kEnd
+    }
+  }
+
+  // The first range in the mask that does not end before id. The mask is
+  // sorted, so the ranges end in increasing order. The search gallops
+  // forward from the previous result, which makes a sequence of increasing
+  // lookups cost about the log of the distance between them.
+  std::vector<LuminosityBlockRange>::const_iterator
+  IndexIntoFile::IndexIntoFileItrImpl::maskRangeNotBefore(LuminosityBlockID const& id) {
+    std::vector<LuminosityBlockRange> const& mask = *lumiMask_;
+    if(maskIndex_ > 0 && !(mask[maskIndex_ - 1].endLumiID() < id)) {
+      maskIndex_ = 0;
+    }
+    std::vector<LuminosityBlockRange>::size_type low = maskIndex_;
+    std::vector<LuminosityBlockRange>::size_type high = maskIndex_;
+    std::vector<LuminosityBlockRange>::size_type step = 1;
+    while(high < mask.size() && mask[high].endLumiID() < id) {
+      low = high + 1;
+      high += step;
+      step *= 2;
+    }
+    if(high > mask.size()) high = mask.size();
+    while(low < high) {
+      std::vector<LuminosityBlockRange>::size_type middle = low + (high - low) / 2;
+      if(mask[middle].endLumiID() < id) {
+        low = middle + 1;
+      } else {
+        high = middle;
+      }
+    }
+    maskIndex_ = low;
+    return mask.begin() + low;
+  }
+
+  bool IndexIntoFile::IndexIntoFileItrImpl::inMask(RunNumber_t run, LuminosityBlockNumber_t lumi) {
+    LuminosityBlockID id(run, lumi);
+    std::vector<LuminosityBlockRange>::const_iterator range = maskRangeNotBefore(id);
+    return range != lumiMask_->end() && !(id < range->startLumiID());
+  }
+
+  bool IndexIntoFile::IndexIntoFileItrImpl::lumiInMask(int index) {
+    if(sorted()) {
+      RunOrLumiIndexes const& lumi = indexIntoFile_->runOrLumiIndexes()[index];
+      return inMask(lumi.run(), lumi.lumi());
+    }
+    RunOrLumiEntry const& lumi = indexIntoFile_->runOrLumiEntries()[index];
+    return inMask(lumi.run(), lumi.lumi());
+  }
+
+  // Returns index if it is an accepted lumi, else the first accepted lumi
+  // after it in the same run, else the index of the next run entry or size_.
+  int IndexIntoFile::IndexIntoFileItrImpl::findLumiInMaskNoSort(int index) {
+    std::vector<RunOrLumiEntry> const& entries = indexIntoFile_->runOrLumiEntries();
+    while(index < size_ && !entries[index].isRun()) {
+      if(inMask(entries[index].run(), entries[index].lumi())) return index;
+      int next = index + 1;
+      while(next < size_ && isSameLumiNoSort(index, next)) ++next;
+      index = next;
+    }
+    return index;
+  }
+
+  // Same as above. In numerical order the lumis of a run are sorted, so the
+  // next candidate is found with a galloping search for the start of the next
+  // range in the mask, or the end of the run if that is in a later run.
+  int IndexIntoFile::IndexIntoFileItrImpl::findLumiInMaskSorted(int index) {
+    std::vector<RunOrLumiIndexes> const& indexes = indexIntoFile_->runOrLumiIndexes();
+    while(index < size_ && !indexes[index].isRun()) {
+      RunOrLumiIndexes const& lumi = indexes[index];
+      LuminosityBlockID id(lumi.run(), lumi.lumi());
+      std::vector<LuminosityBlockRange>::const_iterator range = maskRangeNotBefore(id);
+      if(range != lumiMask_->end() && !(id < range->startLumiID())) return index;
+      if(range != lumiMask_->end() && range->startRun() == lumi.run()) {
+        index = gallopSorted(index,
+                             RunOrLumiIndexes(lumi.processHistoryIDIndex(), lumi.run(), range->startLumi(), 0),
+                             false);
+      } else {
+        index = gallopSorted(index,
+                             RunOrLumiIndexes(lumi.processHistoryIDIndex(), lumi.run(),
+                                              LuminosityBlockID::maxLuminosityBlockNumber(), 0),
+                             true);
+      }
+    }
+    return index;
+  }
+
+  // The first index not before index whose entry is not less than key,
+  // or if orEqual is true, greater than key.
+  int IndexIntoFile::IndexIntoFileItrImpl::gallopSorted(int index, RunOrLumiIndexes const& key, bool orEqual) const {
+    std::vector<RunOrLumiIndexes> const& indexes = indexIntoFile_->runOrLumiIndexes();
+    auto before = [&](int i) {return orEqual ? !(key < indexes[i]) : indexes[i] < key;};
+    int low = index;
+    int high = index;
+    int step = 1;
+    while(high < size_ && before(high)) {
+      low = high + 1;
+      high += step;
+      step *= 2;
+    }
+    if(high > size_) high = size_;
+    while(low < high) {
+      int middle = low + (high - low) / 2;
+      if(before(middle)) {
+        low = middle + 1;
+      } else {
+        high = middle;
+      }
     }
+    return low;
   }
 
   bool IndexIntoFile::IndexIntoFileItrImpl::operator==(IndexIntoFileItrImpl const& right) const {
@@ -1393,6 +2344,10 @@ namespace edm {
 
   void
   IndexIntoFile::IndexIntoFileItrImpl::copyPosition(IndexIntoFileItrImpl const& position) {
+    if(lumiMask_ != 0 && position.indexToLumi_ != invalidIndex && !lumiInMask(position.indexToLumi_)) {
+      throw Exception(errors::LogicError)
+        << "In IndexIntoFile::IndexIntoFileItr::copyPosition. The position is at a lumi rejected by the lumi mask.\n";
+    }
     type_ = position.type_;
     indexToRun_ = position.indexToRun_;
     indexToLumi_ = position.indexToLumi_;
@@ -1410,45 +2365,23 @@ namespace edm {
     nEvents_ = 0;
   }
 
-  IndexIntoFile::IndexIntoFileItrNoSort::IndexIntoFileItrNoSort(IndexIntoFile const* indexIntoFile,
-                         EntryType entryType,
-                         int indexToRun,
-                         int indexToLumi,
-                         int indexToEventRange,
-                         long long indexToEvent,
-                         long long nEvents) :
-    IndexIntoFileItrImpl(indexIntoFile,
-                         entryType,
-                         indexToRun,
-                         indexToLumi,
-                         indexToEventRange,
-                         indexToEvent,
-                         nEvents)
-  {
-  }
-
-  IndexIntoFile::IndexIntoFileItrImpl*
-  IndexIntoFile::IndexIntoFileItrNoSort::clone() const {
-    return new IndexIntoFileItrNoSort(*this);
-  }
-
   int
-  IndexIntoFile::IndexIntoFileItrNoSort::processHistoryIDIndex() const {
+  IndexIntoFile::IndexIntoFileItrImpl::processHistoryIDIndexNoSort() const {
     if(type() == kEnd) return invalidIndex;
     return indexIntoFile()->runOrLumiEntries()[indexToRun()].processHistoryIDIndex();
   }
 
-  RunNumber_t IndexIntoFile::IndexIntoFileItrNoSort::run() const {
+  RunNumber_t IndexIntoFile::IndexIntoFileItrImpl::runNoSort() const {
     if(type() == kEnd) return invalidRun;
     return indexIntoFile()->runOrLumiEntries()[indexToRun()].run();
   }
 
-  LuminosityBlockNumber_t IndexIntoFile::IndexIntoFileItrNoSort::lumi() const {
+  LuminosityBlockNumber_t IndexIntoFile::IndexIntoFileItrImpl::lumiNoSort() const {
     if(type() == kEnd || type() == kRun) return invalidLumi;
     return indexIntoFile()->runOrLumiEntries()[indexToLumi()].lumi();
   }
 
-  IndexIntoFile::EntryNumber_t IndexIntoFile::IndexIntoFileItrNoSort::entry() const {
+  IndexIntoFile::EntryNumber_t IndexIntoFile::IndexIntoFileItrImpl::entryNoSort() const {
     if(type() == kEnd) return invalidEntry;
     if(type() == kRun) return indexIntoFile()->runOrLumiEntries()[indexToRun()].entry();
     if(type() == kLumi) return indexIntoFile()->runOrLumiEntries()[indexToLumi()].entry();
@@ -1457,12 +2390,12 @@ namespace edm {
       indexToEvent();
   }
 
-  LuminosityBlockNumber_t IndexIntoFile::IndexIntoFileItrNoSort::peekAheadAtLumi() const {
+  LuminosityBlockNumber_t IndexIntoFile::IndexIntoFileItrImpl::peekAheadAtLumiNoSort() const {
     if(indexToLumi() == invalidIndex) return invalidLumi;
     return indexIntoFile()->runOrLumiEntries()[indexToLumi()].lumi();
   }
 
-  IndexIntoFile::EntryNumber_t IndexIntoFile::IndexIntoFileItrNoSort::peekAheadAtEventEntry() const {
+  IndexIntoFile::EntryNumber_t IndexIntoFile::IndexIntoFileItrImpl::peekAheadAtEventEntryNoSort() const {
     if(indexToLumi() == invalidIndex) return invalidEntry;
     if(indexToEvent() >= nEvents()) return invalidEntry;
     return
@@ -1470,7 +2403,7 @@ namespace edm {
       indexToEvent();
   }
 
-  void IndexIntoFile::IndexIntoFileItrNoSort::initializeLumi_() {
+  void IndexIntoFile::IndexIntoFileItrImpl::initializeLumiNoSort() {
     assert(indexToLumi() != invalidIndex);
 
     setIndexToEventRange(invalidIndex);
@@ -1496,7 +2429,7 @@ namespace edm {
     }
   }
 
-  bool IndexIntoFile::IndexIntoFileItrNoSort::nextEventRange() {
+  bool IndexIntoFile::IndexIntoFileItrImpl::nextEventRangeNoSort() {
     if(indexToEventRange() == invalidIndex) return false;
 
     // Look for the next event range, same lumi but different entry
@@ -1519,7 +2452,7 @@ namespace edm {
     return false; // hit the end of the IndexIntoFile
   }
 
-  bool IndexIntoFile::IndexIntoFileItrNoSort::previousEventRange() {
+  bool IndexIntoFile::IndexIntoFileItrImpl::previousEventRangeNoSort() {
     if(indexToEventRange() == invalidIndex) return false;
     assert(indexToEventRange() < size());
 
@@ -1543,7 +2476,7 @@ namespace edm {
     return false; // hit the beginning of the IndexIntoFile, 0th entry has to be a run
   }
 
-  bool IndexIntoFile::IndexIntoFileItrNoSort::setToLastEventInRange(int index) {
+  bool IndexIntoFile::IndexIntoFileItrImpl::setToLastEventInRangeNoSort(int index) {
     if(indexIntoFile()->runOrLumiEntries()[index].beginEvents() == invalidEntry) {
       return false;
     }
@@ -1555,7 +2488,7 @@ namespace edm {
     return true;
   }
 
-  bool IndexIntoFile::IndexIntoFileItrNoSort::skipLumiInRun() {
+  bool IndexIntoFile::IndexIntoFileItrImpl::skipLumiInRunNoSort() {
     if(indexToLumi() == invalidIndex) return false;
     for(int i = 1; indexToLumi() + i < size(); ++i) {
       int newLumi = indexToLumi() + i;
@@ -1565,6 +2498,10 @@ namespace edm {
                indexIntoFile()->runOrLumiEntries()[indexToLumi()].lumi()) {
         continue;
       }
+      if(lumiMask_ != 0) {
+        newLumi = findLumiInMask(newLumi);
+        if(getRunOrLumiEntryType(newLumi) != kLumi) return false; // no more accepted lumis in this run
+      }
       setIndexToLumi(newLumi);
       initializeLumi();
       return true; // hit next lumi
@@ -1572,7 +2509,7 @@ namespace edm {
     return false; // hit the end of the IndexIntoFile
   }
 
-  IndexIntoFile::EntryType IndexIntoFile::IndexIntoFileItrNoSort::getRunOrLumiEntryType(int index) const {
+  IndexIntoFile::EntryType IndexIntoFile::IndexIntoFileItrImpl::getRunOrLumiEntryTypeNoSort(int index) const {
     if(index < 0 || index >= size()) {
       return kEnd;
     } else if(indexIntoFile()->runOrLumiEntries()[index].isRun()) {
@@ -1581,7 +2518,7 @@ namespace edm {
     return kLumi;
   }
 
-  bool IndexIntoFile::IndexIntoFileItrNoSort::isSameLumi(int index1, int index2) const {
+  bool IndexIntoFile::IndexIntoFileItrImpl::isSameLumiNoSort(int index1, int index2) const {
     if(index1 < 0 || index1 >= size() || index2 < 0 || index2 >= size()) {
       return false;
     }
@@ -1589,7 +2526,7 @@ namespace edm {
            indexIntoFile()->runOrLumiEntries()[index2].lumi();
   }
 
-  bool IndexIntoFile::IndexIntoFileItrNoSort::isSameRun(int index1, int index2) const {
+  bool IndexIntoFile::IndexIntoFileItrImpl::isSameRunNoSort(int index1, int index2) const {
     if(index1 < 0 || index1 >= size() || index2 < 0 || index2 >= size()) {
       return false;
     }
@@ -1599,43 +2536,22 @@ namespace edm {
            indexIntoFile()->runOrLumiEntries()[index2].processHistoryIDIndex();
   }
 
-  IndexIntoFile::IndexIntoFileItrSorted::IndexIntoFileItrSorted(IndexIntoFile const* indexIntoFile,
-                         EntryType entryType,
-                         int indexToRun,
-                         int indexToLumi,
-                         int indexToEventRange,
-                         long long indexToEvent,
-                         long long nEvents) :
-    IndexIntoFileItrImpl(indexIntoFile,
-                         entryType,
-                         indexToRun,
-                         indexToLumi,
-                         indexToEventRange,
-                         indexToEvent,
-                         nEvents) {
-    indexIntoFile->fillRunOrLumiIndexes();
-  }
-
-  IndexIntoFile::IndexIntoFileItrImpl* IndexIntoFile::IndexIntoFileItrSorted::clone() const {
-    return new IndexIntoFileItrSorted(*this);
-  }
-
-  int IndexIntoFile::IndexIntoFileItrSorted::processHistoryIDIndex() const {
+  int IndexIntoFile::IndexIntoFileItrImpl::processHistoryIDIndexSorted() const {
     if(type() == kEnd) return invalidIndex;
     return indexIntoFile()->runOrLumiIndexes()[indexToRun()].processHistoryIDIndex();
   }
 
-  RunNumber_t IndexIntoFile::IndexIntoFileItrSorted::run() const {
+  RunNumber_t IndexIntoFile::IndexIntoFileItrImpl::runSorted() const {
     if(type() == kEnd) return invalidRun;
     return indexIntoFile()->runOrLumiIndexes()[indexToRun()].run();
   }
 
-  LuminosityBlockNumber_t IndexIntoFile::IndexIntoFileItrSorted::lumi() const {
+  LuminosityBlockNumber_t IndexIntoFile::IndexIntoFileItrImpl::lumiSorted() const {
     if(type() == kEnd || type() == kRun) return invalidLumi;
     return indexIntoFile()->runOrLumiIndexes()[indexToLumi()].lumi();
   }
 
-  IndexIntoFile::EntryNumber_t IndexIntoFile::IndexIntoFileItrSorted::entry() const {
+  IndexIntoFile::EntryNumber_t IndexIntoFile::IndexIntoFileItrImpl::entrySorted() const {
     if(type() == kEnd) return invalidEntry;
     if(type() == kRun) {
       int i =  indexIntoFile()->runOrLumiIndexes()[indexToRun()].indexToGetEntry();
@@ -1652,12 +2568,12 @@ namespace edm {
     return indexIntoFile()->eventEntries().at(eventNumberIndex).entry();
   }
 
-  LuminosityBlockNumber_t IndexIntoFile::IndexIntoFileItrSorted::peekAheadAtLumi() const {
+  LuminosityBlockNumber_t IndexIntoFile::IndexIntoFileItrImpl::peekAheadAtLumiSorted() const {
     if(indexToLumi() == invalidIndex) return invalidLumi;
     return indexIntoFile()->runOrLumiIndexes()[indexToLumi()].lumi();
   }
 
-  IndexIntoFile::EntryNumber_t IndexIntoFile::IndexIntoFileItrSorted::peekAheadAtEventEntry() const {
+  IndexIntoFile::EntryNumber_t IndexIntoFile::IndexIntoFileItrImpl::peekAheadAtEventEntrySorted() const {
     if(indexToLumi() == invalidIndex) return invalidEntry;
     if(indexToEvent() >= nEvents()) return invalidEntry;
     long long eventNumberIndex =
@@ -1667,7 +2583,7 @@ namespace edm {
     return indexIntoFile()->eventEntries().at(eventNumberIndex).entry();
   }
 
-  void IndexIntoFile::IndexIntoFileItrSorted::initializeLumi_() {
+  void IndexIntoFile::IndexIntoFileItrImpl::initializeLumiSorted() {
     assert(indexToLumi() != invalidIndex);
     setIndexToEventRange(indexToLumi());
     setIndexToEvent(0);
@@ -1679,15 +2595,15 @@ namespace edm {
     }
   }
 
-  bool IndexIntoFile::IndexIntoFileItrSorted::nextEventRange() {
+  bool IndexIntoFile::IndexIntoFileItrImpl::nextEventRangeSorted() {
     return false;
   }
 
-  bool IndexIntoFile::IndexIntoFileItrSorted::previousEventRange() {
+  bool IndexIntoFile::IndexIntoFileItrImpl::previousEventRangeSorted() {
     return false;
   }
 
-  bool IndexIntoFile::IndexIntoFileItrSorted::setToLastEventInRange(int index) {
+  bool IndexIntoFile::IndexIntoFileItrImpl::setToLastEventInRangeSorted(int index) {
     long long nEventsInRange =
       indexIntoFile()->runOrLumiIndexes()[index].endEventNumbers() -
       indexIntoFile()->runOrLumiIndexes()[index].beginEventNumbers();
@@ -1710,7 +2626,7 @@ namespace edm {
     return true;
   }
 
-  bool IndexIntoFile::IndexIntoFileItrSorted::skipLumiInRun() {
+  bool IndexIntoFile::IndexIntoFileItrImpl::skipLumiInRunSorted() {
     if(indexToLumi() == invalidIndex) return false;
     for(int i = 1; indexToLumi() + i < size(); ++i) {
       int newLumi = indexToLumi() + i;
@@ -1720,6 +2636,10 @@ namespace edm {
                 indexIntoFile()->runOrLumiIndexes()[indexToLumi()].lumi()) {
         continue;
       }
+      if(lumiMask_ != 0) {
+        newLumi = findLumiInMask(newLumi);
+        if(getRunOrLumiEntryType(newLumi) != kLumi) return false; // no more accepted lumis in this run
+      }
       setIndexToLumi(newLumi);
       initializeLumi();
       return true; // hit next lumi
@@ -1727,7 +2647,7 @@ namespace edm {
     return false; // hit the end of the IndexIntoFile
   }
 
-  IndexIntoFile::EntryType IndexIntoFile::IndexIntoFileItrSorted::getRunOrLumiEntryType(int index) const {
+  IndexIntoFile::EntryType IndexIntoFile::IndexIntoFileItrImpl::getRunOrLumiEntryTypeSorted(int index) const {
     if(index < 0 || index >= size()) {
       return kEnd;
     } else if(indexIntoFile()->runOrLumiIndexes()[index].isRun()) {
@@ -1736,7 +2656,7 @@ namespace edm {
     return kLumi;
   }
 
-  bool IndexIntoFile::IndexIntoFileItrSorted::isSameLumi(int index1, int index2) const {
+  bool IndexIntoFile::IndexIntoFileItrImpl::isSameLumiSorted(int index1, int index2) const {
     if(index1 < 0 || index1 >= size() || index2 < 0 || index2 >= size()) {
       return false;
     }
@@ -1744,7 +2664,7 @@ namespace edm {
            indexIntoFile()->runOrLumiIndexes()[index2].lumi();
   }
 
-  bool IndexIntoFile::IndexIntoFileItrSorted::isSameRun(int index1, int index2) const {
+  bool IndexIntoFile::IndexIntoFileItrImpl::isSameRunSorted(int index1, int index2) const {
     if(index1 < 0 || index1 >= size() || index2 < 0 || index2 >= size()) {
       return false;
     }
@@ -1761,35 +2681,24 @@ namespace edm {
                    int indexToLumi,
                    int indexToEventRange,
                    long long indexToEvent,
-                   long long nEvents) :
-    impl_() {
-    if(sortOrder == numericalOrder) {
-      value_ptr<IndexIntoFileItrImpl> temp(new IndexIntoFileItrSorted(indexIntoFile,
-                                                                      entryType,
-                                                                      indexToRun,
-                                                                      indexToLumi,
-                                                                      indexToEventRange,
-                                                                      indexToEvent,
-                                                                      nEvents
-                                                                     ));
-      swap(temp, impl_);
-    } else {
-      value_ptr<IndexIntoFileItrImpl> temp(new IndexIntoFileItrNoSort(indexIntoFile,
-                                                                      entryType,
-                                                                      indexToRun,
-                                                                      indexToLumi,
-                                                                      indexToEventRange,
-                                                                      indexToEvent,
-                                                                      nEvents));
-      swap(temp, impl_);
-    }
+                   long long nEvents,
+                   std::vector<LuminosityBlockRange> const* lumiMask) :
+    impl_(indexIntoFile,
+          sortOrder,
+          entryType,
+          indexToRun,
+          indexToLumi,
+          indexToEventRange,
+          indexToEvent,
+          nEvents,
+          lumiMask) {
   }
 
   void IndexIntoFile::IndexIntoFileItr::advanceToEvent() {
     for(EntryType entryType = getEntryType();
         entryType != kEnd && entryType != kEvent;
         entryType = getEntryType()) {
-            impl_->next();
+            impl_.next();
     }
   }
 
@@ -1797,13 +2706,13 @@ namespace edm {
     for(EntryType entryType = getEntryType();
         entryType != kEnd && entryType != kLumi;
         entryType = getEntryType()) {
-            impl_->next();
+            impl_.next();
     }
   }
 
   void
   IndexIntoFile::IndexIntoFileItr::copyPosition(IndexIntoFileItr const& position) {
-    impl_->copyPosition(*position.impl_);
+    impl_.copyPosition(position.impl_);
   }
 
   bool Compare_Index_Run::operator()(IndexIntoFile::RunOrLumiIndexes const& lh, IndexIntoFile::RunOrLumiIndexes const& rh) {
@@ -0,0 +1,163 @@
+#include "DataFormats/Provenance/interface/MergedIndexIntoFile.h"
+#include "FWCore/Utilities/interface/EDMException.h"
+
+#include <algorithm>
+
+namespace edm {
+
+  MergedIndexIntoFile::MergedIndexIntoFile(std::vector<IndexIntoFile const*> const& indexIntoFiles) :
+    files_(),
+    merge_(files_) {
+
+    std::vector<ProcessHistoryID> const* longest = 0;
+    for(std::vector<IndexIntoFile const*>::const_iterator iter = indexIntoFiles.begin(),
+                                                          iEnd = indexIntoFiles.end();
+         iter != iEnd;
+         ++iter) {
+      if(longest == 0 || (*iter)->processHistoryIDs().size() > longest->size()) {
+        longest = &(*iter)->processHistoryIDs();
+      }
+    }
+
+    files_.reserve(indexIntoFiles.size());
+    for(std::vector<IndexIntoFile const*>::size_type i = 0; i < indexIntoFiles.size(); ++i) {
+      IndexIntoFile const* indexIntoFile = indexIntoFiles[i];
+      std::vector<ProcessHistoryID> const& processHistoryIDs = indexIntoFile->processHistoryIDs();
+      if(!std::equal(processHistoryIDs.begin(), processHistoryIDs.end(), longest->begin())) {
+        throw Exception(errors::LogicError)
+          << "In MergedIndexIntoFile constructor. The ProcessHistoryID indexes of file " << i << "\n"
+          << "are not consistent with those of the other files. Call IndexIntoFile::fixIndexes\n"
+          << "on each file with the same vector before merging them.\n";
+      }
+
+      indexIntoFile->fillRunOrLumiIndexes();
+      indexIntoFile->fillEventEntries();
+      long long nEvents = 0;
+      if(!indexIntoFile->runOrLumiIndexes().empty()) {
+        nEvents = indexIntoFile->runOrLumiIndexes().back().endEventNumbers();
+      }
+      if(static_cast<long long>(indexIntoFile->eventEntries().size()) != nEvents) {
+        throw Exception(errors::LogicError)
+          << "In MergedIndexIntoFile constructor. The event entries of file " << i << " are not filled.\n"
+          << "Set the number of events and the EventFinder before merging.\n";
+      }
+      files_.emplace_back(indexIntoFile, i);
+    }
+    rewind();
+  }
+
+  void
+  MergedIndexIntoFile::rewind() {
+    merge_ = Merge(files_);
+  }
+
+  bool
+  MergedIndexIntoFile::next(Event& event) {
+    return merge_.next(event);
+  }
+
+  void
+  MergedIndexIntoFile::findDuplicateEvents(std::vector<Event>& duplicates) const {
+    Merge merge(files_);
+    Event previous;
+    Event event;
+    while(merge.next(event)) {
+      if(event.event() == previous.event() &&
+         event.lumi() == previous.lumi() &&
+         event.run() == previous.run() &&
+         event.processHistoryIDIndex() == previous.processHistoryIDIndex()) {
+        duplicates.push_back(event);
+      } else {
+        previous = event;
+      }
+    }
+  }
+
+  MergedIndexIntoFile::FileStream::FileStream(IndexIntoFile const* indexIntoFile, int fileIndex) :
+    indexIntoFile_(indexIntoFile),
+    fileIndex_(fileIndex),
+    runOrLumi_(indexIntoFile->beginRunOrLumi()),
+    runOrLumiEnd_(indexIntoFile->endRunOrLumi()),
+    lumi_(0),
+    indexToEvent_(0),
+    endEventNumbers_(0) {
+  }
+
+  bool
+  MergedIndexIntoFile::FileStream::begin() {
+    runOrLumi_ = indexIntoFile_->beginRunOrLumi();
+    lumi_ = 0;
+    indexToEvent_ = 0;
+    endEventNumbers_ = 0;
+    return nextLumiWithEvents();
+  }
+
+  bool
+  MergedIndexIntoFile::FileStream::advance() {
+    ++indexToEvent_;
+    if(indexToEvent_ < endEventNumbers_) return true;
+    return nextLumiWithEvents();
+  }
+
+  // The event ranges of the lumis are contiguous in the sorted order
+  // and all entries of the same lumi share one range, so a lumi has
+  // events not yet seen exactly when its range ends after indexToEvent_.
+  bool
+  MergedIndexIntoFile::FileStream::nextLumiWithEvents() {
+    for(; runOrLumi_ != runOrLumiEnd_; ++runOrLumi_) {
+      if(runOrLumi_.isRun()) continue;
+      IndexIntoFile::RunOrLumiIndexes const& lumi = runOrLumi_.runOrLumiIndexes();
+      if(lumi.endEventNumbers() > indexToEvent_) {
+        lumi_ = &lumi;
+        indexToEvent_ = lumi.beginEventNumbers();
+        endEventNumbers_ = lumi.endEventNumbers();
+        ++runOrLumi_;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  MergedIndexIntoFile::Event
+  MergedIndexIntoFile::FileStream::event() const {
+    IndexIntoFile::EventEntry const& eventEntry = indexIntoFile_->eventEntries()[indexToEvent_];
+    return Event(fileIndex_, lumi_->processHistoryIDIndex(), lumi_->run(), lumi_->lumi(),
+                 eventEntry.event(), eventEntry.entry());
+  }
+
+  bool
+  MergedIndexIntoFile::FileStream::operator<(FileStream const& right) const {
+    IndexIntoFile::RunOrLumiIndexes const& rightLumi = *right.lumi_;
+    if(lumi_->processHistoryIDIndex() != rightLumi.processHistoryIDIndex()) {
+      return lumi_->processHistoryIDIndex() < rightLumi.processHistoryIDIndex();
+    }
+    if(lumi_->run() != rightLumi.run()) return lumi_->run() < rightLumi.run();
+    if(lumi_->lumi() != rightLumi.lumi()) return lumi_->lumi() < rightLumi.lumi();
+    EventNumber_t event = indexIntoFile_->eventEntries()[indexToEvent_].event();
+    EventNumber_t rightEvent = right.indexIntoFile_->eventEntries()[right.indexToEvent_].event();
+    if(event != rightEvent) return event < rightEvent;
+    return fileIndex_ < right.fileIndex_;
+  }
+
+  MergedIndexIntoFile::Merge::Merge(std::vector<FileStream> const& files) : heap_() {
+    heap_.reserve(files.size());
+    for(std::vector<FileStream>::const_iterator iter = files.begin(), iEnd = files.end(); iter != iEnd; ++iter) {
+      heap_.push_back(*iter);
+      if(!heap_.back().begin()) heap_.pop_back();
+    }
+    std::make_heap(heap_.begin(), heap_.end(), Later());
+  }
+
+  bool
+  MergedIndexIntoFile::Merge::next(Event& event) {
+    if(heap_.empty()) return false;
+    std::pop_heap(heap_.begin(), heap_.end(), Later());
+    event = heap_.back().event();
+    if(heap_.back().advance()) {
+      std::push_heap(heap_.begin(), heap_.end(), Later());
+    } else {
+      heap_.pop_back();
+    }
+    return true;
+  }
+}
@@ -1,7 +1,7 @@
 #include "DataFormats/Provenance/interface/Parentage.h"
-#include "FWCore/Utilities/interface/Digest.h"
+#include "DataFormats/Provenance/interface/DigestBuilder.h"
+#include <algorithm>
 #include <ostream>
-#include <sstream>
 
 /*----------------------------------------------------------------------
 
@@ -18,27 +18,59 @@ namespace edm {
 
   ParentageID
   Parentage::id() const {
-    // This implementation is ripe for optimization.
     if(parentageID().isValid()) {
       return parentageID();
     }
-    std::ostringstream oss;
+    // Digests the same text as streaming each BranchID followed by a space.
+    DigestBuilder builder;
     for (std::vector<BranchID>::const_iterator 
 	   i = parents_.begin(),
 	   e = parents_.end();
 	 i != e;
 	 ++i)
       {
-	oss << *i << ' ';
+	builder.append(i->id()).append(' ');
       }
     
-    std::string stringrep = oss.str();
-    cms::Digest md5alg(stringrep);
-    ParentageID tmp(md5alg.digest().toString());
+    ParentageID tmp(builder.result());
     parentageID().swap(tmp);
     return parentageID();
   }
 
+  namespace {
+    struct LessParents {
+      explicit LessParents(std::vector<Parentage> const& parentages) : parentages_(parentages) {}
+      bool operator()(std::size_t a, std::size_t b) const {
+        return parentages_[a].parents() < parentages_[b].parents();
+      }
+      std::vector<Parentage> const& parentages_;
+    };
+  }
+
+  void
+  fillParentageIDs(std::vector<Parentage> const& parentages) {
+    // Order the indexes so that equal lists of parents are adjacent.
+    std::vector<std::size_t> order(parentages.size());
+    for (std::size_t i = 0; i < order.size(); ++i) {
+      order[i] = i;
+    }
+    LessParents lessParents(parentages);
+    std::sort(order.begin(), order.end(), lessParents);
+
+    std::vector<std::size_t>::const_iterator i = order.begin(), e = order.end();
+    while (i != e) {
+      std::vector<std::size_t>::const_iterator runEnd = i + 1;
+      while (runEnd != e && !lessParents(*i, *runEnd)) {
+        ++runEnd;
+      }
+      ParentageID const id = parentages[*i].id();
+      for (std::vector<std::size_t>::const_iterator j = i + 1; j != runEnd; ++j) {
+        parentages[*j].parentageID() = id;
+      }
+      i = runEnd;
+    }
+  }
+
   void
   Parentage::write(std::ostream&) const {
     // This is grossly inadequate, but it is not critical for the
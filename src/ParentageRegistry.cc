@@ -2,3 +2,11 @@
 #include "FWCore/Utilities/interface/ThreadSafeRegistry.icc"
 
 DEFINE_THREAD_SAFE_REGISTRY_INSTANCE(ParentageRegistry)
+
+namespace edm {
+  void
+  registerParentages(std::vector<Parentage> const& parentages) {
+    fillParentageIDs(parentages);
+    ParentageRegistry::instance()->insertCollection(parentages);
+  }
+}
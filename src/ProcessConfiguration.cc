@@ -1,10 +1,9 @@
 #include "DataFormats/Provenance/interface/ProcessConfiguration.h"
-#include "FWCore/Utilities/interface/Digest.h"
+#include "DataFormats/Provenance/interface/DigestBuilder.h"
 #include "FWCore/Utilities/interface/EDMException.h"
 
 #include <ostream>
 #include <cassert>
-#include <sstream>
 #include <cctype>
 
 /*----------------------------------------------------------------------
@@ -55,12 +54,13 @@ namespace edm {
     if(pcid().isValid()) {
       return pcid();
     }
-    // This implementation is ripe for optimization.
-    std::ostringstream oss;
-    oss << *this;
-    std::string stringrep = oss.str();
-    cms::Digest md5alg(stringrep);
-    ProcessConfigurationID tmp(md5alg.digest().toString());
+    // Digests the same text that operator<< writes.
+    DigestBuilder builder;
+    builder.append(processName()).append(' ')
+           .append(parameterSetID()).append(' ')
+           .append(releaseVersion()).append(' ')
+           .append(passID());
+    ProcessConfigurationID tmp(builder.result());
     pcid().swap(tmp);
     return pcid();
   }
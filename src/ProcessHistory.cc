@@ -1,9 +1,8 @@
 #include <iterator>
 #include <ostream>
-#include <sstream>
-#include "FWCore/Utilities/interface/Digest.h"
 #include "FWCore/Utilities/interface/Algorithms.h"
 
+#include "DataFormats/Provenance/interface/DigestBuilder.h"
 #include "DataFormats/Provenance/interface/ProcessHistory.h"
 
 
@@ -13,18 +12,16 @@ namespace edm {
     if(phid().isValid()) {
       return phid();
     }
-    // This implementation is ripe for optimization.
     // We do not use operator<< because it does not write out everything.
-    std::ostringstream oss;
+    // The digested text is the same as if we did, with a trailing space.
+    DigestBuilder builder;
     for (const_iterator i = begin(), e = end(); i != e; ++i) {
-      oss << i->processName() << ' '
-	  << i->parameterSetID() << ' ' 
-	  << i->releaseVersion() << ' '
-	  << i->passID() << ' ';
+      builder.append(i->processName()).append(' ')
+             .append(i->parameterSetID()).append(' ')
+             .append(i->releaseVersion()).append(' ')
+             .append(i->passID()).append(' ');
     }
-    std::string stringrep = oss.str();
-    cms::Digest md5alg(stringrep);
-    ProcessHistoryID tmp(md5alg.digest().toString());
+    ProcessHistoryID tmp(builder.result());
     phid().swap(tmp);
     return phid();
   }
@@ -4,6 +4,8 @@
 #include "FWCore/Utilities/interface/EDMException.h"
 #include "FWCore/Utilities/interface/TypeWithDict.h"
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <limits>
 
@@ -12,8 +14,8 @@ namespace edm {
   ProductHolderIndexHelper::ProductHolderIndexHelper() :
     nextIndexValue_(0),
     beginElements_(0),
-    items_(new std::set<ProductHolderIndexHelper::Item>),
-    processItems_(new std::set<std::string>) {
+    hashSalt_(0),
+    items_(new Items) {
   }
 
   ProductHolderIndex
@@ -76,6 +78,12 @@ namespace edm {
                                                              moduleLabel,
                                                              instance,
                                                              0);
+    return matchesWithSameNames(startInIndexAndNames);
+  }
+
+  ProductHolderIndexHelper::Matches
+  ProductHolderIndexHelper::matchesWithSameNames(unsigned int startInIndexAndNames) const {
+
     unsigned int numberOfMatches = 1;
 
     if (startInIndexAndNames == std::numeric_limits<unsigned int>::max()) {
@@ -91,6 +99,34 @@ namespace edm {
     return Matches(this, startInIndexAndNames, numberOfMatches);
   }
 
+  void
+  ProductHolderIndexHelper::indexes(std::vector<IndexRequest> const& requests,
+                                    std::vector<ProductHolderIndex>& results) const {
+
+    std::vector<unsigned int> iToIndexAndNames;
+    indexesToIndexAndNames(requests, true, iToIndexAndNames);
+
+    results.clear();
+    results.reserve(requests.size());
+    for (auto i : iToIndexAndNames) {
+      results.push_back(i == std::numeric_limits<unsigned int>::max() ? ProductHolderIndexInvalid : indexAndNames_[i].index());
+    }
+  }
+
+  void
+  ProductHolderIndexHelper::relatedIndexes(std::vector<IndexRequest> const& requests,
+                                           std::vector<Matches>& results) const {
+
+    std::vector<unsigned int> iToIndexAndNames;
+    indexesToIndexAndNames(requests, false, iToIndexAndNames);
+
+    results.clear();
+    results.reserve(requests.size());
+    for (auto i : iToIndexAndNames) {
+      results.push_back(matchesWithSameNames(i));
+    }
+  }
+
   ProductHolderIndexHelper::Matches
   ProductHolderIndexHelper::relatedIndexes(KindOfType kindOfType,
                                            TypeID const& typeID) const {
@@ -127,33 +163,28 @@ namespace edm {
     }
 
     TypeID typeID(typeWithDict.typeInfo());
+    unsigned int labelID = items_->stringID(moduleLabel);
+    unsigned int instanceID = items_->stringID(instance);
+    unsigned int processID = items_->stringID(process);
 
     // Throw if this has already been inserted
-    Item item(PRODUCT_TYPE, typeID, moduleLabel, instance, process, 0);
-    std::set<Item>::iterator iter = items_->find(item);
-    if (iter != items_->end()) {
+    Item item(PRODUCT_TYPE, typeID, labelID, instanceID, processID, nextIndexValue_);
+    if (!items_->insertUnique(item)) {
       throw Exception(errors::LogicError)
         << "ProductHolderIndexHelper::insert - Attempt to insert duplicate entry.\n";
     }
-
-    // Put in an entry for the product
-    item.setIndex(nextIndexValue_);
     unsigned int savedProductIndex = nextIndexValue_;
     ++nextIndexValue_;
-    items_->insert(item);
 
     // Put in an entry for the product with an empty process name
     // if it is not already there
-    item.clearProcess();
-    iter = items_->find(item);
-    if (iter == items_->end()) {
-      item.setIndex(nextIndexValue_);
+    if (items_->insertUnique(Item(PRODUCT_TYPE, typeID, labelID, instanceID, Items::emptyString, nextIndexValue_))) {
       ++nextIndexValue_;
-      items_->insert(item);
     }
 
     // Now put in entries for a contained class if this is a
-    // recognized container.
+    // recognized container. If an entry with the same process
+    // name is already there, setFrozen will mark it ambiguous.
     TypeWithDict containedType;
     if((is_RefVector(typeWithDict, containedType) ||
         is_PtrVector(typeWithDict, containedType) ||
@@ -162,20 +193,9 @@ namespace edm {
         && bool(containedType)) {
 
       TypeID containedTypeID(containedType.typeInfo());
-      Item containedItem(ELEMENT_TYPE, containedTypeID, moduleLabel, instance, process, savedProductIndex);
-      iter = items_->find(containedItem);
-      if (iter != items_->end()) {
-        containedItem.setIndex(ProductHolderIndexAmbiguous);
-        items_->erase(iter);
-      }
-      items_->insert(containedItem);
-
-      containedItem.clearProcess();
-      iter = items_->find(containedItem);
-      if (iter == items_->end()) {
-        containedItem.setIndex(nextIndexValue_);
+      items_->append(Item(ELEMENT_TYPE, containedTypeID, labelID, instanceID, processID, savedProductIndex));
+      if (items_->insertUnique(Item(ELEMENT_TYPE, containedTypeID, labelID, instanceID, Items::emptyString, nextIndexValue_))) {
         ++nextIndexValue_;
-        items_->insert(containedItem);
       }
 
       // Repeat this for all public base classes of the contained type
@@ -185,154 +205,140 @@ namespace edm {
       for(TypeWithDict const& baseType : baseTypes) {
 
         TypeID baseTypeID(baseType.typeInfo());
-        Item baseItem(ELEMENT_TYPE, baseTypeID, moduleLabel, instance, process, savedProductIndex);
-        iter = items_->find(baseItem);
-        if (iter != items_->end()) {
-          baseItem.setIndex(ProductHolderIndexAmbiguous);
-          items_->erase(iter);
-        }
-        items_->insert(baseItem);
-
-        baseItem.clearProcess();
-        iter = items_->find(baseItem);
-        if (iter == items_->end()) {
-          baseItem.setIndex(nextIndexValue_);
+        items_->append(Item(ELEMENT_TYPE, baseTypeID, labelID, instanceID, processID, savedProductIndex));
+        if (items_->insertUnique(Item(ELEMENT_TYPE, baseTypeID, labelID, instanceID, Items::emptyString, nextIndexValue_))) {
           ++nextIndexValue_;
-          items_->insert(baseItem);
         }
       }
     }
     return savedProductIndex;
   }
 
-  void ProductHolderIndexHelper::setFrozen() {
+  void ProductHolderIndexHelper::setFrozen(bool hashedLookup) {
 
     if (!items_) return;
 
+    std::vector<Item>& items = items_->items();
+    unsigned int nStrings = items_->numberOfStrings();
+
+    // Order the strings once, so sorting the items only
+    // compares numbers. The empty string always comes first.
+    std::vector<unsigned int> sortedStrings(nStrings);
+    for (unsigned int i = 0; i < nStrings; ++i) {
+      sortedStrings[i] = i;
+    }
+    Items const& constItems = *items_;
+    std::sort(sortedStrings.begin(), sortedStrings.end(), [&constItems](unsigned int left, unsigned int right) {
+      return std::strcmp(constItems.string(left), constItems.string(right)) < 0;
+    });
+    std::vector<unsigned int> stringOrder(nStrings);
+    for (unsigned int i = 0; i < nStrings; ++i) {
+      stringOrder[sortedStrings[i]] = i;
+    }
+
+    // Size and fill the process name vector, which holds the
+    // process names of all the items in alphabetical order
+    std::vector<unsigned int> processStarts(nStrings, std::numeric_limits<unsigned int>::max());
+    for (auto const& item : items) {
+      processStarts[item.process()] = 0;
+    }
+    unsigned int processNamesSize = 0;
+    unsigned int nProcesses = 0;
+    for (unsigned int i = 0; i < nStrings; ++i) {
+      if (processStarts[i] == 0) {
+        processNamesSize += items_->stringSize(i) + 1;
+        ++nProcesses;
+      }
+    }
+    processNames_.reserve(processNamesSize);
+    lookupProcessNames_.reserve(nProcesses);
+    for (auto id : sortedStrings) {
+      if (processStarts[id] == 0) {
+        processStarts[id] = processNames_.size();
+        char const* name = items_->string(id);
+        processNames_.insert(processNames_.end(), name, name + items_->stringSize(id) + 1);
+        lookupProcessNames_.emplace_back(name);
+      }
+    }
+
+    std::sort(items.begin(), items.end(), [&stringOrder](Item const& left, Item const& right) {
+      if (left.kindOfType() != right.kindOfType()) return left.kindOfType() < right.kindOfType();
+      if (left.typeID() != right.typeID()) return left.typeID() < right.typeID();
+      if (left.moduleLabel() != right.moduleLabel()) return stringOrder[left.moduleLabel()] < stringOrder[right.moduleLabel()];
+      if (left.instance() != right.instance()) return stringOrder[left.instance()] < stringOrder[right.instance()];
+      return stringOrder[left.process()] < stringOrder[right.process()];
+    });
+
     // Make a first pass and count things so we
-    // can reserve memory in the vectors. Also
-    // fill processItems_ on the first pass.
-    bool iFirstThisType = true;
-    bool beginElementsWasSet = false;
-    TypeID previousTypeID;
-    KindOfType previousKindOfType = PRODUCT_TYPE;
-    std::string previousModuleLabel;
-    std::string previousInstance;
+    // can reserve memory in the vectors. Items with
+    // the same key are one entry.
     unsigned int iCountTypes = 0;
+    unsigned int iCountEntries = 0;
     unsigned int iCountCharacters = 0;
-    for (auto const& item : *items_) {
-
-      if (iFirstThisType || item.typeID() != previousTypeID || item.kindOfType() != previousKindOfType) {
+    beginElements_ = 0;
+    for (unsigned int i = 0; i < items.size(); ++i) {
+      Item const& item = items[i];
+      bool newType = (i == 0 || item.typeID() != items[i - 1].typeID() || item.kindOfType() != items[i - 1].kindOfType());
+      if (newType) {
         ++iCountTypes;
-        iFirstThisType = true;
-
-        if (!beginElementsWasSet) {
-          if (item.kindOfType() == ELEMENT_TYPE) {
-            beginElementsWasSet = true;
-          } else {
-            beginElements_ = iCountTypes;
-          }
+        if (item.kindOfType() == PRODUCT_TYPE) {
+          beginElements_ = iCountTypes;
         }
       }
-
-      processItems_->insert(item.process());
-
-      if (iFirstThisType ||
-          item.moduleLabel() != previousModuleLabel ||
-          item.instance() != previousInstance) {
-        iCountCharacters += item.moduleLabel().size();
-        iCountCharacters += item.instance().size();
+      if (newType ||
+          item.moduleLabel() != items[i - 1].moduleLabel() ||
+          item.instance() != items[i - 1].instance()) {
+        iCountCharacters += items_->stringSize(item.moduleLabel());
+        iCountCharacters += items_->stringSize(item.instance());
         iCountCharacters += 2;
       }
-
-      iFirstThisType = false;
-      previousTypeID = item.typeID();
-      previousKindOfType = item.kindOfType();
-      previousModuleLabel = item.moduleLabel();
-      previousInstance = item.instance();
-    }
-
-    // Size and fill the process name vector
-    unsigned int processNamesSize = 0;
-    for (auto const& processItem : *processItems_) {
-      processNamesSize += processItem.size();
-      ++processNamesSize;
-    }
-    processNames_.reserve(processNamesSize);
-    for (auto const& processItem : *processItems_) {
-      for (auto const& c : processItem) {
-        processNames_.push_back(c);
+      if (i == 0 || !item.sameKey(items[i - 1])) {
+        ++iCountEntries;
       }
-      processNames_.push_back('\0');
-      lookupProcessNames_.push_back(processItem);
     }
 
     // Reserve memory in the vectors
     sortedTypeIDs_.reserve(iCountTypes);
     ranges_.reserve(iCountTypes);
-    indexAndNames_.reserve(items_->size());
+    indexAndNames_.reserve(iCountEntries);
     bigNamesContainer_.reserve(iCountCharacters);
 
     // Second pass. Really fill the vectors this time.
-    bool iFirstType = true;
-    iFirstThisType = true;
-    previousTypeID = TypeID();
-    unsigned int iCount = 0;
     unsigned int iBeginning = 0;
-    iCountCharacters = 0;
     unsigned int previousCharacterCount = 0;
-    if (!items_->empty()) {
-      for (auto const& item : *items_) {
-
-        if (iFirstThisType || item.typeID() != previousTypeID || item.kindOfType() != previousKindOfType) {
-          iFirstThisType = true;
-          sortedTypeIDs_.push_back(item.typeID());
-          if (iFirstType) {
-            iFirstType = false;
-          } else {
-            ranges_.push_back(Range(iBeginning, iCount));
-          }
-          iBeginning = iCount;
-        }
-        ++iCount;
-
-        if (iFirstThisType ||
-            item.moduleLabel() != previousModuleLabel ||
-            item.instance() != previousInstance) {
-
-          unsigned int labelSize = item.moduleLabel().size();
-          for (unsigned int j = 0; j < labelSize; ++j) {
-            bigNamesContainer_.push_back(item.moduleLabel()[j]);
-          }
-          bigNamesContainer_.push_back('\0');
-
-          unsigned int instanceSize = item.instance().size();
-          for (unsigned int j = 0; j < instanceSize; ++j) {
-            bigNamesContainer_.push_back(item.instance()[j]);
-          }
-          bigNamesContainer_.push_back('\0');
-
-          previousCharacterCount = iCountCharacters;
-
-          iCountCharacters += labelSize;
-          iCountCharacters += instanceSize;
-          iCountCharacters += 2;
+    unsigned int i = 0;
+    while (i < items.size()) {
+      Item const& item = items[i];
+      bool newType = (i == 0 || item.typeID() != items[i - 1].typeID() || item.kindOfType() != items[i - 1].kindOfType());
+      if (newType) {
+        sortedTypeIDs_.push_back(item.typeID());
+        if (i != 0) {
+          ranges_.push_back(Range(iBeginning, indexAndNames_.size()));
         }
+        iBeginning = indexAndNames_.size();
+      }
 
-        unsigned int processStart = processIndex(item.process().c_str());
-        if (processStart == std::numeric_limits<unsigned int>::max()) {
-          throw Exception(errors::LogicError)
-            << "ProductHolderIndexHelper::setFrozen - Process not found in processNames_.\n";
-        }
-        indexAndNames_.emplace_back(item.index(), previousCharacterCount, processStart);
+      if (newType ||
+          item.moduleLabel() != items[i - 1].moduleLabel() ||
+          item.instance() != items[i - 1].instance()) {
+        previousCharacterCount = bigNamesContainer_.size();
+        char const* label = items_->string(item.moduleLabel());
+        bigNamesContainer_.insert(bigNamesContainer_.end(), label, label + items_->stringSize(item.moduleLabel()) + 1);
+        char const* instance = items_->string(item.instance());
+        bigNamesContainer_.insert(bigNamesContainer_.end(), instance, instance + items_->stringSize(item.instance()) + 1);
+      }
 
-        iFirstThisType = false;
-        previousTypeID = item.typeID();
-        previousKindOfType = item.kindOfType();
-        previousModuleLabel = item.moduleLabel();
-        previousInstance = item.instance();
+      // Repeated entries for an element type are ambiguous
+      unsigned int iEnd = i + 1;
+      while (iEnd < items.size() && items[iEnd].sameKey(item)) {
+        ++iEnd;
       }
-      ranges_.push_back(Range(iBeginning, iCount));
+      ProductHolderIndex index = (iEnd - i == 1) ? item.index() : ProductHolderIndexAmbiguous;
+      indexAndNames_.emplace_back(index, previousCharacterCount, processStarts[item.process()]);
+      i = iEnd;
+    }
+    if (!items.empty()) {
+      ranges_.push_back(Range(iBeginning, indexAndNames_.size()));
     }
 
     // Some sanity checks to protect against out of bounds vector accesses
@@ -340,9 +346,12 @@ namespace edm {
     // them to be expensive one might delete them.
     sanityCheck();
 
+    if (hashedLookup) {
+      fillHashedLookup();
+    }
+
     // Cleanup, do not need the temporary containers anymore
     items_.reset();
-    processItems_.reset();
   }
 
   std::vector<std::string> const& ProductHolderIndexHelper::lookupProcessNames() const {
@@ -353,6 +362,300 @@ namespace edm {
     return lookupProcessNames_;
   }
 
+  namespace {
+
+    unsigned long long const fnvPrime = 1099511628211ULL;
+
+    // The 64 bit finalizer of MurmurHash3
+    inline unsigned long long mix(unsigned long long h) {
+      h ^= h >> 33;
+      h *= 0xff51afd7ed558ccdULL;
+      h ^= h >> 33;
+      h *= 0xc4ceb9fe1a85ec53ULL;
+      h ^= h >> 33;
+      return h;
+    }
+
+    // FNV-1a over the characters of a C style string and its terminating
+    // '\0'. A null pointer hashes the same as an empty string.
+    inline unsigned long long hashString(unsigned long long hash, char const* s) {
+      if (s) {
+        for (; *s; ++s) {
+          hash ^= static_cast<unsigned char>(*s);
+          hash *= fnvPrime;
+        }
+      }
+      return hash * fnvPrime;
+    }
+
+    inline unsigned long long hashKey(unsigned long long salt,
+                                      KindOfType kindOfType,
+                                      TypeID const& typeID,
+                                      char const* moduleLabel,
+                                      char const* instance,
+                                      char const* process) {
+      unsigned long long hash = 14695981039346656037ULL ^ salt;
+      hash ^= mix(typeID.typeInfo().hash_code() + kindOfType);
+      hash *= fnvPrime;
+      hash = hashString(hash, moduleLabel);
+      hash = hashString(hash, instance);
+      hash = hashString(hash, process);
+      return mix(hash);
+    }
+
+    inline unsigned int hashBucket(unsigned long long hash, unsigned int nBuckets) {
+      return hash % nBuckets;
+    }
+
+    inline unsigned int hashSlot(unsigned long long hash, unsigned int seed, unsigned int nSlots) {
+      return mix(hash + seed * 0x9e3779b97f4a7c15ULL) % nSlots;
+    }
+
+    // On average each bucket holds this many keys
+    unsigned int const keysPerBucket = 3;
+    // Bounds on the search for seeds. Unless two keys have the same
+    // hash, the first attempt always succeeds in practice.
+    unsigned int const maxSeed = 1U << 24;
+    unsigned int const maxAttempts = 4;
+  }
+
+  void ProductHolderIndexHelper::fillHashedLookup() {
+
+    unsigned int const nEntries = indexAndNames_.size();
+    if (nEntries == 0) return;
+    unsigned int const nBuckets = (nEntries + keysPerBucket - 1) / keysPerBucket;
+
+    std::vector<unsigned int> typeOfEntry(nEntries);
+    for (unsigned int iType = 0; iType < ranges_.size(); ++iType) {
+      for (unsigned int j = ranges_[iType].begin(); j < ranges_[iType].end(); ++j) {
+        typeOfEntry[j] = iType;
+      }
+    }
+
+    std::vector<unsigned long long> hashes(nEntries);
+    std::vector<unsigned int> bucketBegin(nBuckets + 1);
+    std::vector<unsigned int> entriesByBucket(nEntries);
+    std::vector<unsigned int> bucketOrder(nBuckets);
+    std::vector<bool> slotUsed(nEntries);
+    std::vector<unsigned int> bucketSlots;
+
+    for (unsigned int attempt = 0; attempt < maxAttempts; ++attempt) {
+      hashSalt_ = mix(attempt);
+
+      // Hash all the keys and group them by bucket
+      std::fill(bucketBegin.begin(), bucketBegin.end(), 0);
+      for (unsigned int i = 0; i < nEntries; ++i) {
+        IndexAndNames const& entry = indexAndNames_[i];
+        char const* moduleLabel = &bigNamesContainer_[entry.startInBigNamesContainer()];
+        char const* instance = moduleLabel + std::strlen(moduleLabel) + 1;
+        hashes[i] = hashKey(hashSalt_,
+                            typeOfEntry[i] < beginElements_ ? PRODUCT_TYPE : ELEMENT_TYPE,
+                            sortedTypeIDs_[typeOfEntry[i]],
+                            moduleLabel,
+                            instance,
+                            &processNames_[entry.startInProcessNames()]);
+        ++bucketBegin[hashBucket(hashes[i], nBuckets) + 1];
+      }
+      for (unsigned int b = 0; b < nBuckets; ++b) {
+        bucketBegin[b + 1] += bucketBegin[b];
+      }
+      {
+        std::vector<unsigned int> next(bucketBegin.begin(), bucketBegin.end() - 1);
+        for (unsigned int i = 0; i < nEntries; ++i) {
+          entriesByBucket[next[hashBucket(hashes[i], nBuckets)]++] = i;
+        }
+      }
+
+      // Place the largest buckets first, while most slots are free
+      for (unsigned int b = 0; b < nBuckets; ++b) {
+        bucketOrder[b] = b;
+      }
+      std::stable_sort(bucketOrder.begin(), bucketOrder.end(), [&bucketBegin](unsigned int left, unsigned int right) {
+        return bucketBegin[left + 1] - bucketBegin[left] > bucketBegin[right + 1] - bucketBegin[right];
+      });
+
+      hashSeeds_.assign(nBuckets, 0);
+      slotUsed.assign(nEntries, false);
+      bool placedAll = true;
+      for (auto bucket : bucketOrder) {
+        unsigned int const begin = bucketBegin[bucket];
+        unsigned int const end = bucketBegin[bucket + 1];
+        if (begin == end) break;
+
+        // Keys with the same hash can never be separated
+        for (unsigned int i = begin; i < end && placedAll; ++i) {
+          for (unsigned int j = i + 1; j < end; ++j) {
+            if (hashes[entriesByBucket[i]] == hashes[entriesByBucket[j]]) {
+              placedAll = false;
+              break;
+            }
+          }
+        }
+        if (!placedAll) break;
+
+        unsigned int seed = 0;
+        for (; seed < maxSeed; ++seed) {
+          bucketSlots.clear();
+          for (unsigned int i = begin; i < end; ++i) {
+            unsigned int slot = hashSlot(hashes[entriesByBucket[i]], seed, nEntries);
+            if (slotUsed[slot] || std::find(bucketSlots.begin(), bucketSlots.end(), slot) != bucketSlots.end()) {
+              break;
+            }
+            bucketSlots.push_back(slot);
+          }
+          if (bucketSlots.size() == end - begin) break;
+        }
+        if (seed == maxSeed) {
+          placedAll = false;
+          break;
+        }
+        hashSeeds_[bucket] = seed;
+        for (auto slot : bucketSlots) {
+          slotUsed[slot] = true;
+        }
+      }
+
+      if (placedAll) {
+        hashSlots_.resize(nEntries);
+        for (unsigned int i = 0; i < nEntries; ++i) {
+          unsigned int seed = hashSeeds_[hashBucket(hashes[i], nBuckets)];
+          hashSlots_[hashSlot(hashes[i], seed, nEntries)] = HashSlot(hashes[i], i, typeOfEntry[i]);
+        }
+        return;
+      }
+    }
+    // Should never happen, the lookups use the binary searches
+    hashSeeds_.clear();
+  }
+
+  unsigned int
+  ProductHolderIndexHelper::hashedIndexToIndexAndNames(KindOfType kindOfType,
+                                                       TypeID const& typeID,
+                                                       char const* moduleLabel,
+                                                       char const* instance,
+                                                       char const* process) const {
+
+    unsigned long long hash = hashKey(hashSalt_, kindOfType, typeID, moduleLabel, instance, process);
+    unsigned int seed = hashSeeds_[hashBucket(hash, hashSeeds_.size())];
+    HashSlot const& slot = hashSlots_[hashSlot(hash, seed, hashSlots_.size())];
+
+    // The slot of a key that is not in the table belongs to some other key
+    if (slot.hash() != hash) {
+      return std::numeric_limits<unsigned int>::max();
+    }
+    unsigned int iType = slot.indexToType();
+    if ((iType < beginElements_) != (kindOfType == PRODUCT_TYPE) || sortedTypeIDs_[iType] != typeID) {
+      return std::numeric_limits<unsigned int>::max();
+    }
+    IndexAndNames const& entry = indexAndNames_[slot.indexToIndexAndNames()];
+    char const* namePtr = &bigNamesContainer_[entry.startInBigNamesContainer()];
+    if (std::strcmp(namePtr, moduleLabel) != 0) {
+      return std::numeric_limits<unsigned int>::max();
+    }
+    namePtr += std::strlen(moduleLabel) + 1;
+    if (std::strcmp(namePtr, instance) != 0 ||
+        std::strcmp(&processNames_[entry.startInProcessNames()], process ? process : "") != 0) {
+      return std::numeric_limits<unsigned int>::max();
+    }
+    return slot.indexToIndexAndNames();
+  }
+
+  void
+  ProductHolderIndexHelper::indexesToIndexAndNames(std::vector<IndexRequest> const& requests,
+                                                   bool useProcess,
+                                                   std::vector<unsigned int>& iToIndexAndNames) const {
+
+    unsigned int const notFound = std::numeric_limits<unsigned int>::max();
+    iToIndexAndNames.assign(requests.size(), notFound);
+
+    if (hasHashedLookup()) {
+      for (unsigned int i = 0; i < requests.size(); ++i) {
+        IndexRequest const& request = requests[i];
+        iToIndexAndNames[i] = hashedIndexToIndexAndNames(request.kindOfType(),
+                                                         request.typeID(),
+                                                         request.moduleLabel(),
+                                                         request.instance(),
+                                                         useProcess ? request.process() : 0);
+      }
+      return;
+    }
+    if (sortedTypeIDs_.empty()) return;
+
+    // Put the requests in the order of indexAndNames_, without the process
+    std::vector<unsigned int> order(requests.size());
+    for (unsigned int i = 0; i < order.size(); ++i) {
+      order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&requests](unsigned int left, unsigned int right) {
+      IndexRequest const& l = requests[left];
+      IndexRequest const& r = requests[right];
+      if (l.kindOfType() != r.kindOfType()) return l.kindOfType() < r.kindOfType();
+      if (l.typeID() != r.typeID()) return l.typeID() < r.typeID();
+      int labelOrder = std::strcmp(l.moduleLabel(), r.moduleLabel());
+      if (labelOrder != 0) return labelOrder < 0;
+      return std::strcmp(l.instance(), r.instance()) < 0;
+    });
+
+    // Then walk through sortedTypeIDs_ and indexAndNames_ once. Both
+    // positions only move forward. Within a type, the entries with the
+    // same label and instance share their names in bigNamesContainer_.
+    unsigned int iType = 0;
+    unsigned int iEntry = 0;
+    unsigned int iTypeOfEntry = notFound;
+    for (auto i : order) {
+      IndexRequest const& request = requests[i];
+
+      unsigned int endType = beginElements_;
+      if (request.kindOfType() == ELEMENT_TYPE) {
+        endType = sortedTypeIDs_.size();
+        if (iType < beginElements_) iType = beginElements_;
+      }
+      while (iType < endType && sortedTypeIDs_[iType] < request.typeID()) {
+        ++iType;
+      }
+      if (iType == endType || sortedTypeIDs_[iType] != request.typeID()) continue;
+
+      Range const& range = ranges_[iType];
+      if (iType != iTypeOfEntry) {
+        iEntry = range.begin();
+        iTypeOfEntry = iType;
+      }
+      bool sameNames = false;
+      while (iEntry < range.end()) {
+        char const* label = &bigNamesContainer_[indexAndNames_[iEntry].startInBigNamesContainer()];
+        int namesOrder = std::strcmp(label, request.moduleLabel());
+        if (namesOrder == 0) {
+          namesOrder = std::strcmp(label + std::strlen(label) + 1, request.instance());
+        }
+        if (namesOrder > 0) break;
+        if (namesOrder == 0) {
+          sameNames = true;
+          break;
+        }
+        unsigned int start = indexAndNames_[iEntry].startInBigNamesContainer();
+        while (iEntry < range.end() && indexAndNames_[iEntry].startInBigNamesContainer() == start) {
+          ++iEntry;
+        }
+      }
+      if (!sameNames) continue;
+
+      unsigned int startProcess = 0;
+      if (useProcess && request.process()) {
+        startProcess = processIndex(request.process());
+        if (startProcess == notFound) continue;
+      }
+      unsigned int start = indexAndNames_[iEntry].startInBigNamesContainer();
+      for (unsigned int j = iEntry;
+           j < range.end() && indexAndNames_[j].startInBigNamesContainer() == start;
+           ++j) {
+        if (indexAndNames_[j].startInProcessNames() == startProcess) {
+          iToIndexAndNames[i] = j;
+          break;
+        }
+      }
+    }
+  }
+
   unsigned int
   ProductHolderIndexHelper::indexToIndexAndNames(KindOfType kindOfType,
                                                  TypeID const& typeID,
@@ -360,6 +663,10 @@ namespace edm {
                                                  char const* instance,
                                                  char const* process) const {
 
+    if (!hashSlots_.empty()) {
+      return hashedIndexToIndexAndNames(kindOfType, typeID, moduleLabel, instance, process);
+    }
+
     // Look for the type and check to see if it found it
     unsigned iType = indexToType(kindOfType, typeID);
     if (iType != std::numeric_limits<unsigned int>::max()) {
@@ -538,31 +845,89 @@ namespace edm {
     }
   }
 
-  ProductHolderIndexHelper::Item::Item(KindOfType kindOfType,
-                                       TypeID const& typeID,
-                                       std::string const& moduleLabel,
-                                       std::string const& instance,
-                                       std::string const& process,
-                                       ProductHolderIndex index) :
-    kindOfType_(kindOfType),
-    typeID_(typeID),
-    moduleLabel_(moduleLabel),
-    instance_(instance),
-    process_(process),
-    index_(index) {
+  unsigned int const ProductHolderIndexHelper::Items::emptyString;
+
+  ProductHolderIndexHelper::Items::Items() :
+    starts_(1, 0),
+    stringSlots_(64, 0),
+    itemSlots_(1024, 0),
+    numberOfUniqueItems_(0) {
+    stringID("");
+  }
+
+  unsigned int
+  ProductHolderIndexHelper::Items::stringID(char const* string) {
+    unsigned int size = std::strlen(string);
+    unsigned long long mask = stringSlots_.size() - 1;
+    unsigned long long slot = mix(hashString(0, string)) & mask;
+    while (stringSlots_[slot] != 0) {
+      unsigned int id = stringSlots_[slot] - 1;
+      if (stringSize(id) == size && std::memcmp(this->string(id), string, size) == 0) {
+        return id;
+      }
+      slot = (slot + 1) & mask;
+    }
+
+    unsigned int id = numberOfStrings();
+    characters_.insert(characters_.end(), string, string + size + 1);
+    starts_.push_back(characters_.size());
+    stringSlots_[slot] = id + 1;
+
+    // Keep the table at most half full
+    if (2 * numberOfStrings() > stringSlots_.size()) {
+      std::vector<unsigned int> slots(2 * stringSlots_.size(), 0);
+      mask = slots.size() - 1;
+      for (unsigned int i = 0; i < numberOfStrings(); ++i) {
+        slot = mix(hashString(0, this->string(i))) & mask;
+        while (slots[slot] != 0) {
+          slot = (slot + 1) & mask;
+        }
+        slots[slot] = i + 1;
+      }
+      stringSlots_.swap(slots);
+    }
+    return id;
+  }
+
+  unsigned long long
+  ProductHolderIndexHelper::Items::hash(Item const& item) const {
+    unsigned long long h = mix(item.typeID().typeInfo().hash_code() + item.kindOfType());
+    h = mix(h ^ item.moduleLabel());
+    h = mix(h ^ (static_cast<unsigned long long>(item.instance()) << 32 | item.process()));
+    return h;
   }
 
   bool
-  ProductHolderIndexHelper::Item::operator<(Item const& right) const {
-    if (kindOfType_ < right.kindOfType_) return true;
-    if (kindOfType_ > right.kindOfType_) return false;
-    if (typeID_ < right.typeID_) return true;
-    if (typeID_ > right.typeID_) return false;
-    if (moduleLabel_ < right.moduleLabel_) return true;
-    if (moduleLabel_ > right.moduleLabel_) return false;
-    if (instance_ < right.instance_) return true;
-    if (instance_ > right.instance_) return false;
-    return process_ < right.process_;
+  ProductHolderIndexHelper::Items::insertUnique(Item const& item) {
+    unsigned long long mask = itemSlots_.size() - 1;
+    unsigned long long slot = hash(item) & mask;
+    while (itemSlots_[slot] != 0) {
+      if (items_[itemSlots_[slot] - 1].sameKey(item)) {
+        return false;
+      }
+      slot = (slot + 1) & mask;
+    }
+
+    items_.push_back(item);
+    itemSlots_[slot] = items_.size();
+    ++numberOfUniqueItems_;
+
+    // Keep the table at most half full. Only the items
+    // added by this function go back in the table.
+    if (2 * numberOfUniqueItems_ > itemSlots_.size()) {
+      std::vector<unsigned int> slots(2 * itemSlots_.size(), 0);
+      mask = slots.size() - 1;
+      for (auto i : itemSlots_) {
+        if (i == 0) continue;
+        slot = hash(items_[i - 1]) & mask;
+        while (slots[slot] != 0) {
+          slot = (slot + 1) & mask;
+        }
+        slots[slot] = i;
+      }
+      itemSlots_.swap(slots);
+    }
+    return true;
   }
 
   void ProductHolderIndexHelper::print(std::ostream& os) const {
@@ -616,20 +981,15 @@ namespace edm {
     if (!processNames_.empty()) os << "\n";
     if (items_) {
       os << "******* items_ \n";
-      for (auto const& item : *items_) {
-        std:: cout << item.kindOfType() << " " << item.moduleLabel() << " " << item.instance() << " " << item.process() << " " << item.index() << " " << item.typeID() << "\n";
-      }
-    }
-    if (processItems_) {
-      os << "******* processItems_ \n";
-      for (auto const& item : *processItems_) {
-        os << item << "\n";
+      for (auto const& item : items_->items()) {
+        os << item.kindOfType() << " " << items_->string(item.moduleLabel()) << " " << items_->string(item.instance()) << " " << items_->string(item.process()) << " " << item.index() << " " << item.typeID() << "\n";
       }
     }
     os << "sortedTypeIDs_.size() = " << sortedTypeIDs_.size() << "\n";
     os << "indexAndNames_.size() = " << indexAndNames_.size() << "\n";
     os << "bigNamesContainer_.size() = " << bigNamesContainer_.size() << "\n"; 
     os << "processNames_.size() = " << processNames_.size() << "\n"; 
+    os << "hashSlots_.size() = " << hashSlots_.size() << "\n";
     os << "\n";
   }
 }
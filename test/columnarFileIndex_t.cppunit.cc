@@ -0,0 +1,260 @@
+/*
+ *  columnarFileIndex_t.cppunit.cc
+ *  CMSSW
+ *
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "DataFormats/Provenance/interface/ColumnarFileIndex.h"
+#include "DataFormats/Provenance/interface/FileIndex.h"
+#include "DataFormats/Provenance/interface/IndexIntoFile.h"
+#include "DataFormats/Provenance/interface/ProcessHistoryID.h"
+#include "FWCore/Utilities/interface/EDMException.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <utility>
+#include <vector>
+
+class testColumnarFileIndex: public CppUnit::TestFixture
+{
+  CPPUNIT_TEST_SUITE(testColumnarFileIndex);
+  CPPUNIT_TEST(emptyTest);
+  CPPUNIT_TEST(findTest);
+  CPPUNIT_TEST(fillIndexIntoFileTest);
+  CPPUNIT_TEST_SUITE_END();
+
+ public:
+  void setUp(){}
+  void tearDown(){}
+
+  void emptyTest();
+  void findTest();
+  void fillIndexIntoFileTest();
+};
+
+///registration of the test so that the runner can find it
+CPPUNIT_TEST_SUITE_REGISTRATION(testColumnarFileIndex);
+
+namespace {
+  typedef edm::IndexIntoFile::EntryNumber_t EntryNumber_t;
+
+  // A file with runs, lumis and events written in a random order, with some
+  // lumis split by events of other lumis and some lumis without events.
+  void fillRandomFileIndex(edm::FileIndex& fileIndex, unsigned int seed) {
+    std::srand(seed);
+    EntryNumber_t runEntry = 0;
+    EntryNumber_t lumiEntry = 0;
+    EntryNumber_t eventEntry = 0;
+    for(edm::RunNumber_t run = 1; run < 8; run += 1 + std::rand() % 2) {
+      // Lumis still open in this run and their next event number
+      std::vector<std::pair<edm::LuminosityBlockNumber_t, edm::EventNumber_t> > open;
+      for(edm::LuminosityBlockNumber_t lumi = 1; lumi < 12; lumi += 1 + std::rand() % 3) {
+        open.push_back(std::make_pair(lumi, edm::EventNumber_t(1 + std::rand() % 5)));
+      }
+      std::random_shuffle(open.begin(), open.end());
+      while(!open.empty()) {
+        unsigned int i = std::rand() % open.size();
+        int nEvents = std::rand() % 6;
+        for(int j = 0; j < nEvents; ++j) {
+          fileIndex.addEntry(run, open[i].first, open[i].second, eventEntry++);
+          open[i].second += 1 + std::rand() % 3;
+        }
+        if(std::rand() % 3 == 0) {
+          fileIndex.addEntry(run, open[i].first, 0U, lumiEntry++);
+          if(std::rand() % 2 == 0) {
+            open.erase(open.begin() + i);
+          }
+        }
+      }
+      fileIndex.addEntry(run, 0U, 0U, runEntry++);
+      if(std::rand() % 4 == 0) {
+        fileIndex.addEntry(run, 0U, 0U, runEntry++);
+      }
+    }
+    fileIndex.sortBy_Run_Lumi_Event();
+  }
+
+  // The same IndexIntoFile built directly and then sorted
+  void fillReference(edm::FileIndex const& fileIndex, edm::IndexIntoFile& indexIntoFile, edm::ProcessHistoryID const& phid) {
+    typedef std::pair<edm::RunNumber_t, edm::LuminosityBlockNumber_t> RunLumi;
+    std::map<RunLumi, EntryNumber_t> firstEntry;
+    std::map<EntryNumber_t, RunLumi> events;
+    for(edm::FileIndex::const_iterator it = fileIndex.begin(); it != fileIndex.end(); ++it) {
+      RunLumi key(it->run_, it->lumi_);
+      if(it->event_ != 0U) {
+        events[it->entry_] = key;
+      } else if(firstEntry.find(key) == firstEntry.end() || it->entry_ < firstEntry[key]) {
+        firstEntry[key] = it->entry_;
+      }
+    }
+    std::vector<edm::IndexIntoFile::RunOrLumiEntry>& entries = indexIntoFile.setRunOrLumiEntries();
+    std::map<RunLumi, bool> hasEvents;
+    for(std::map<EntryNumber_t, RunLumi>::const_iterator it = events.begin(); it != events.end();) {
+      std::map<EntryNumber_t, RunLumi>::const_iterator next = it;
+      EntryNumber_t end = it->first;
+      while(next != events.end() && next->first == end && next->second == it->second) {
+        ++next;
+        ++end;
+      }
+      EntryNumber_t orderLumi = firstEntry[it->second];
+      entries.push_back(edm::IndexIntoFile::RunOrLumiEntry(firstEntry[RunLumi(it->second.first, 0U)], orderLumi, orderLumi, 0,
+                                                           it->second.first, it->second.second, it->first, end));
+      hasEvents[it->second] = true;
+      it = next;
+    }
+    for(edm::FileIndex::const_iterator it = fileIndex.begin(); it != fileIndex.end(); ++it) {
+      if(it->event_ != 0U) continue;
+      RunLumi key(it->run_, it->lumi_);
+      EntryNumber_t orderRun = firstEntry[RunLumi(it->run_, 0U)];
+      if(it->lumi_ == 0U) {
+        entries.push_back(edm::IndexIntoFile::RunOrLumiEntry(orderRun, -1, it->entry_, 0, it->run_, 0U, -1, -1));
+      } else if(!hasEvents[key] || it->entry_ != firstEntry[key]) {
+        entries.push_back(edm::IndexIntoFile::RunOrLumiEntry(orderRun, firstEntry[key], it->entry_, 0, it->run_, it->lumi_, -1, -1));
+      }
+    }
+    std::stable_sort(entries.begin(), entries.end());
+    indexIntoFile.setProcessHistoryIDs().push_back(phid);
+    indexIntoFile.setNumberOfEvents(events.size());
+  }
+
+  bool sameEntries(edm::IndexIntoFile const& left, edm::IndexIntoFile const& right) {
+    if(left.runOrLumiEntries().size() != right.runOrLumiEntries().size()) return false;
+    for(unsigned int i = 0; i < left.runOrLumiEntries().size(); ++i) {
+      edm::IndexIntoFile::RunOrLumiEntry const& l = left.runOrLumiEntries()[i];
+      edm::IndexIntoFile::RunOrLumiEntry const& r = right.runOrLumiEntries()[i];
+      if(l.orderPHIDRun() != r.orderPHIDRun() ||
+         l.orderPHIDRunLumi() != r.orderPHIDRunLumi() ||
+         l.entry() != r.entry() ||
+         l.processHistoryIDIndex() != r.processHistoryIDIndex() ||
+         l.run() != r.run() ||
+         l.lumi() != r.lumi() ||
+         l.beginEvents() != r.beginEvents() ||
+         l.endEvents() != r.endEvents()) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  edm::ColumnarFileIndex::size_type
+  position(edm::FileIndex const& fileIndex, edm::FileIndex::const_iterator it) {
+    return it - fileIndex.begin();
+  }
+}
+
+void testColumnarFileIndex::emptyTest()
+{
+  edm::FileIndex fileIndex;
+  edm::ColumnarFileIndex columnar(fileIndex);
+  CPPUNIT_ASSERT(columnar.empty());
+  CPPUNIT_ASSERT(columnar.numberOfEvents() == 0U);
+  CPPUNIT_ASSERT(columnar.allEventsInEntryOrder());
+  CPPUNIT_ASSERT(!columnar.containsItem(1, 1, 1));
+  CPPUNIT_ASSERT(!columnar.containsItem(1, 1, 0));
+  CPPUNIT_ASSERT(!columnar.containsItem(1, 0, 0));
+
+  edm::IndexIntoFile indexIntoFile;
+  columnar.fillIndexIntoFile(indexIntoFile, edm::ProcessHistoryID());
+  CPPUNIT_ASSERT(indexIntoFile.runOrLumiEntries().empty());
+}
+
+void testColumnarFileIndex::findTest()
+{
+  for(unsigned int seed = 1; seed < 20; ++seed) {
+    edm::FileIndex fileIndex;
+    fillRandomFileIndex(fileIndex, seed);
+    edm::ColumnarFileIndex columnar(fileIndex);
+    CPPUNIT_ASSERT(columnar.size() == fileIndex.size());
+    CPPUNIT_ASSERT(columnar.allEventsInEntryOrder() == fileIndex.allEventsInEntryOrder());
+    for(edm::ColumnarFileIndex::size_type i = 0; i < columnar.size(); ++i) {
+      edm::FileIndex::Element const& element = *(fileIndex.begin() + i);
+      CPPUNIT_ASSERT(columnar.run(i) == element.run_);
+      CPPUNIT_ASSERT(columnar.lumi(i) == element.lumi_);
+      CPPUNIT_ASSERT(columnar.event(i) == element.event_);
+      CPPUNIT_ASSERT(columnar.entry(i) == element.entry_);
+      CPPUNIT_ASSERT(columnar.getEntryType(i) == element.getEntryType());
+    }
+    for(edm::RunNumber_t run = 0; run < 10; ++run) {
+      CPPUNIT_ASSERT(columnar.findRunPosition(run) == position(fileIndex, fileIndex.findRunPosition(run)));
+      for(edm::LuminosityBlockNumber_t lumi = 0; lumi < 14; ++lumi) {
+        CPPUNIT_ASSERT(columnar.findLumiPosition(run, lumi) == position(fileIndex, fileIndex.findLumiPosition(run, lumi)));
+        CPPUNIT_ASSERT(columnar.containsItem(run, lumi, 0U) == fileIndex.containsItem(run, lumi, 0U));
+        for(edm::EventNumber_t event = 1; event < 40; ++event) {
+          CPPUNIT_ASSERT(columnar.findEventPosition(run, lumi, event) ==
+                         position(fileIndex, fileIndex.findEventPosition(run, lumi, event)));
+          CPPUNIT_ASSERT(columnar.containsItem(run, lumi, event) == fileIndex.containsItem(run, lumi, event));
+        }
+      }
+    }
+  }
+
+  // Events written in event order
+  edm::FileIndex fileIndex;
+  fileIndex.addEntry(1, 1, 5, 0);
+  fileIndex.addEntry(1, 1, 6, 1);
+  fileIndex.addEntry(1, 2, 7, 2);
+  fileIndex.addEntry(1, 1, 0, 0);
+  fileIndex.addEntry(1, 2, 0, 1);
+  fileIndex.addEntry(1, 0, 0, 0);
+  fileIndex.sortBy_Run_Lumi_Event();
+  edm::ColumnarFileIndex columnar(fileIndex);
+  CPPUNIT_ASSERT(columnar.allEventsInEntryOrder());
+  CPPUNIT_ASSERT(columnar.numberOfEvents() == 3U);
+  CPPUNIT_ASSERT(columnar.findEventPosition(1, 0, 7) == 5U);
+}
+
+void testColumnarFileIndex::fillIndexIntoFileTest()
+{
+  edm::ProcessHistoryID phid;
+  for(unsigned int seed = 1; seed < 20; ++seed) {
+    edm::FileIndex fileIndex;
+    fillRandomFileIndex(fileIndex, seed);
+    edm::ColumnarFileIndex columnar(fileIndex);
+
+    edm::IndexIntoFile indexIntoFile;
+    columnar.fillIndexIntoFile(indexIntoFile, phid);
+    edm::IndexIntoFile reference;
+    fillReference(fileIndex, reference, phid);
+    CPPUNIT_ASSERT(sameEntries(indexIntoFile, reference));
+    CPPUNIT_ASSERT(indexIntoFile.processHistoryIDs().size() == 1U);
+
+    // The converted index can be iterated and searched
+    edm::IndexIntoFile::EntryNumber_t nEvents = 0;
+    edm::IndexIntoFile::IndexIntoFileItr iterEnd = indexIntoFile.end(edm::IndexIntoFile::firstAppearanceOrder);
+    for(edm::IndexIntoFile::IndexIntoFileItr iter = indexIntoFile.begin(edm::IndexIntoFile::firstAppearanceOrder);
+        iter != iterEnd; ++iter) {
+      if(iter.getEntryType() == edm::IndexIntoFile::kEvent) ++nEvents;
+    }
+    CPPUNIT_ASSERT(nEvents == static_cast<edm::IndexIntoFile::EntryNumber_t>(columnar.numberOfEvents()));
+    for(edm::ColumnarFileIndex::size_type i = 0; i < columnar.size(); ++i) {
+      CPPUNIT_ASSERT(indexIntoFile.containsItem(columnar.run(i), columnar.lumi(i), 0U));
+    }
+
+    // Only an empty IndexIntoFile is filled
+    bool threw = false;
+    try {
+      columnar.fillIndexIntoFile(indexIntoFile, phid);
+    } catch(edm::Exception const&) {
+      threw = true;
+    }
+    CPPUNIT_ASSERT(threw);
+  }
+
+  // A lumi with events but no lumi entry
+  edm::FileIndex fileIndex;
+  fileIndex.addEntry(1, 1, 5, 0);
+  fileIndex.addEntry(1, 0, 0, 0);
+  fileIndex.sortBy_Run_Lumi_Event();
+  edm::ColumnarFileIndex columnar(fileIndex);
+  edm::IndexIntoFile indexIntoFile;
+  bool threw = false;
+  try {
+    columnar.fillIndexIntoFile(indexIntoFile, phid);
+  } catch(edm::Exception const&) {
+    threw = true;
+  }
+  CPPUNIT_ASSERT(threw);
+}
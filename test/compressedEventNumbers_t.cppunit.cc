@@ -0,0 +1,112 @@
+/*
+ *  compressedEventNumbers_t.cppunit.cc
+ *  CMSSW
+ *
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "DataFormats/Provenance/interface/CompressedEventNumbers.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+class testCompressedEventNumbers: public CppUnit::TestFixture
+{
+  CPPUNIT_TEST_SUITE(testCompressedEventNumbers);
+  CPPUNIT_TEST(emptyTest);
+  CPPUNIT_TEST(randomAccessTest);
+  CPPUNIT_TEST(lowerBoundTest);
+  CPPUNIT_TEST_SUITE_END();
+
+ public:
+  void setUp(){}
+  void tearDown(){}
+
+  void emptyTest();
+  void randomAccessTest();
+  void lowerBoundTest();
+};
+
+///registration of the test so that the runner can find it
+CPPUNIT_TEST_SUITE_REGISTRATION(testCompressedEventNumbers);
+
+namespace {
+  // Lumis of random length, each sorted, with dense but irregular event numbers
+  void makeLumis(std::vector<edm::EventNumber_t>& events, std::vector<std::size_t>& lumiBegins) {
+    std::srand(11);
+    edm::EventNumber_t event = 1U;
+    while(events.size() < 5000) {
+      lumiBegins.push_back(events.size());
+      int nEvents = std::rand() % 700;
+      if(std::rand() % 5 == 0) event = std::rand(); // jump, as when the run changes
+      for(int i = 0; i < nEvents; ++i) {
+        event += std::rand() % 4; // includes duplicates
+        events.push_back(event);
+      }
+    }
+    lumiBegins.push_back(events.size());
+  }
+}
+
+void testCompressedEventNumbers::emptyTest()
+{
+  edm::CompressedEventNumbers compressed;
+  CPPUNIT_ASSERT(compressed.empty());
+  compressed.assign(std::vector<edm::EventNumber_t>());
+  CPPUNIT_ASSERT(compressed.empty());
+  CPPUNIT_ASSERT(compressed.lower_bound(0, 0, 5U) == 0);
+}
+
+void testCompressedEventNumbers::randomAccessTest()
+{
+  std::vector<edm::EventNumber_t> events;
+  // constant, full 32 bit and unsorted blocks
+  events.resize(300, 42U);
+  events.push_back(0U);
+  events.push_back(0xffffffffU);
+  std::srand(3);
+  for(int i = 0; i < 1000; ++i) {
+    events.push_back(std::rand());
+  }
+  std::vector<std::size_t> lumiBegins;
+  makeLumis(events, lumiBegins);
+
+  edm::CompressedEventNumbers compressed;
+  compressed.assign(events);
+  CPPUNIT_ASSERT(compressed.size() == events.size());
+  for(std::size_t i = 0; i < events.size(); ++i) {
+    CPPUNIT_ASSERT(compressed[i] == events[i]);
+  }
+
+  std::vector<edm::EventNumber_t> decoded(events.size() - 100);
+  compressed.copy(50, events.size() - 50, &decoded[0]);
+  CPPUNIT_ASSERT(std::equal(decoded.begin(), decoded.end(), events.begin() + 50));
+}
+
+void testCompressedEventNumbers::lowerBoundTest()
+{
+  std::vector<edm::EventNumber_t> events;
+  std::vector<std::size_t> lumiBegins;
+  makeLumis(events, lumiBegins);
+
+  edm::CompressedEventNumbers compressed;
+  compressed.assign(events);
+  CPPUNIT_ASSERT(compressed.memoryUsed() < events.size() * sizeof(edm::EventNumber_t) / 2);
+
+  for(std::size_t lumi = 0; lumi + 1 < lumiBegins.size(); ++lumi) {
+    std::size_t begin = lumiBegins[lumi];
+    std::size_t end = lumiBegins[lumi + 1];
+    if(begin == end) {
+      CPPUNIT_ASSERT(compressed.lower_bound(begin, end, 7U) == end);
+      continue;
+    }
+    edm::EventNumber_t first = events[begin];
+    edm::EventNumber_t last = events[end - 1];
+    for(edm::EventNumber_t event = (first > 2 ? first - 2 : 0); event <= last + 2; ++event) {
+      std::size_t expected = std::lower_bound(events.begin() + begin, events.begin() + end, event) - events.begin();
+      CPPUNIT_ASSERT(compressed.lower_bound(begin, end, event) == expected);
+    }
+  }
+}
@@ -0,0 +1,184 @@
+/*
+ *  digestBuilder_t.cppunit.cc
+ *  CMSSW
+ *
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "DataFormats/Provenance/interface/DigestBuilder.h"
+#include "DataFormats/Provenance/interface/Parentage.h"
+#include "DataFormats/Provenance/interface/ParentageRegistry.h"
+#include "DataFormats/Provenance/interface/ProcessConfiguration.h"
+#include "DataFormats/Provenance/interface/ProcessHistory.h"
+#include "FWCore/Utilities/interface/Digest.h"
+
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+class testDigestBuilder: public CppUnit::TestFixture
+{
+  CPPUNIT_TEST_SUITE(testDigestBuilder);
+  CPPUNIT_TEST(formattingTest);
+  CPPUNIT_TEST(processConfigurationTest);
+  CPPUNIT_TEST(processHistoryTest);
+  CPPUNIT_TEST(parentageTest);
+  CPPUNIT_TEST(parentageBatchTest);
+  CPPUNIT_TEST_SUITE_END();
+
+ public:
+  void setUp(){}
+  void tearDown(){}
+
+  void formattingTest();
+  void processConfigurationTest();
+  void processHistoryTest();
+  void parentageTest();
+  void parentageBatchTest();
+};
+
+///registration of the test so that the runner can find it
+CPPUNIT_TEST_SUITE_REGISTRATION(testDigestBuilder);
+
+// The ostringstream based implementations that DigestBuilder replaced.
+// The IDs are persistent, so the new ones must be bit for bit identical.
+namespace {
+  std::string digestOf(std::string const& s) {
+    cms::Digest md5alg(s);
+    return md5alg.digest().compactForm();
+  }
+
+  std::string referenceID(edm::ProcessConfiguration const& pc) {
+    std::ostringstream oss;
+    oss << pc;
+    return digestOf(oss.str());
+  }
+
+  std::string referenceID(edm::ProcessHistory const& ph) {
+    std::ostringstream oss;
+    for (edm::ProcessHistory::const_iterator i = ph.begin(), e = ph.end(); i != e; ++i) {
+      oss << i->processName() << ' '
+          << i->parameterSetID() << ' '
+          << i->releaseVersion() << ' '
+          << i->passID() << ' ';
+    }
+    return digestOf(oss.str());
+  }
+
+  std::string referenceID(edm::Parentage const& p) {
+    std::ostringstream oss;
+    for (std::vector<edm::BranchID>::const_iterator i = p.parents().begin(), e = p.parents().end(); i != e; ++i) {
+      oss << *i << ' ';
+    }
+    return digestOf(oss.str());
+  }
+
+  class RandomInputs {
+  public:
+    RandomInputs() : engine_(20130917U) {}
+
+    unsigned int number(unsigned int max) {
+      return std::uniform_int_distribution<unsigned int>(0U, max)(engine_);
+    }
+
+    std::string text(unsigned int maxLength) {
+      std::string result(number(maxLength), ' ');
+      for (std::string::iterator i = result.begin(), e = result.end(); i != e; ++i) {
+        *i = static_cast<char>(number(94U) + 32U);
+      }
+      return result;
+    }
+
+    edm::ParameterSetID id() {
+      std::string compact(16, '\0');
+      for (std::string::iterator i = compact.begin(), e = compact.end(); i != e; ++i) {
+        *i = static_cast<char>(number(255U));
+      }
+      return edm::ParameterSetID(compact);
+    }
+
+    edm::ProcessConfiguration processConfiguration() {
+      return edm::ProcessConfiguration(text(12U), id(), text(20U), text(3U));
+    }
+
+  private:
+    std::mt19937 engine_;
+  };
+}
+
+void testDigestBuilder::formattingTest()
+{
+  edm::ParameterSetID id(std::string("0123456789abcdef0123456789abcdef"));
+  std::ostringstream oss;
+  oss << 0U << ' ' << 4294967295U << ' ' << 1234567U << id << std::string(2000, 'x') << '!';
+
+  edm::DigestBuilder builder;
+  builder.append(0U).append(' ').append(4294967295U).append(' ').append(1234567U)
+         .append(id).append(std::string(2000, 'x')).append('!');
+  edm::ParameterSetID fromBuilder(builder.result());
+  CPPUNIT_ASSERT(fromBuilder.compactForm() == digestOf(oss.str()));
+
+  // Nothing appended gives the digest of the empty string
+  edm::DigestBuilder empty;
+  CPPUNIT_ASSERT(edm::ParameterSetID(empty.result()).compactForm() == digestOf(std::string()));
+}
+
+void testDigestBuilder::processConfigurationTest()
+{
+  RandomInputs random;
+  for (int i = 0; i < 1000; ++i) {
+    edm::ProcessConfiguration pc = random.processConfiguration();
+    CPPUNIT_ASSERT(pc.id().compactForm() == referenceID(pc));
+  }
+}
+
+void testDigestBuilder::processHistoryTest()
+{
+  RandomInputs random;
+  for (int i = 0; i < 500; ++i) {
+    edm::ProcessHistory ph;
+    for (unsigned int j = 0, n = random.number(30U); j < n; ++j) {
+      ph.push_back(random.processConfiguration());
+    }
+    CPPUNIT_ASSERT(ph.id().compactForm() == referenceID(ph));
+  }
+}
+
+void testDigestBuilder::parentageTest()
+{
+  RandomInputs random;
+  for (int i = 0; i < 1000; ++i) {
+    std::vector<edm::BranchID> parents;
+    for (unsigned int j = 0, n = random.number(300U); j < n; ++j) {
+      parents.push_back(edm::BranchID(random.number(0xffffffffU)));
+    }
+    edm::Parentage parentage(parents);
+    CPPUNIT_ASSERT(parentage.id().compactForm() == referenceID(parentage));
+  }
+}
+
+void testDigestBuilder::parentageBatchTest()
+{
+  RandomInputs random;
+  std::vector<std::vector<edm::BranchID> > parentLists(20);
+  for (unsigned int i = 1; i < parentLists.size(); ++i) {
+    for (unsigned int j = 0, n = random.number(10U); j < n; ++j) {
+      parentLists[i].push_back(edm::BranchID(random.number(1000U)));
+    }
+  }
+  // Many products share the same parents
+  std::vector<edm::Parentage> parentages;
+  for (unsigned int i = 0; i < 500; ++i) {
+    parentages.push_back(edm::Parentage(parentLists[random.number(parentLists.size() - 1)]));
+  }
+
+  edm::registerParentages(parentages);
+  for (std::vector<edm::Parentage>::const_iterator i = parentages.begin(), e = parentages.end(); i != e; ++i) {
+    CPPUNIT_ASSERT(i->id().compactForm() == referenceID(*i));
+    edm::Parentage fromRegistry;
+    CPPUNIT_ASSERT(edm::ParentageRegistry::instance()->getMapped(i->id(), fromRegistry));
+    CPPUNIT_ASSERT(fromRegistry == *i);
+  }
+}
@@ -0,0 +1,166 @@
+/*
+ *  eventBloomFilter_t.cppunit.cc
+ *  CMSSW
+ *
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "DataFormats/Provenance/interface/EventBloomFilter.h"
+#include "DataFormats/Provenance/interface/IndexIntoFile.h"
+#include "DataFormats/Provenance/interface/ProcessHistoryID.h"
+
+#include "boost/shared_ptr.hpp"
+
+#include <vector>
+
+class testEventBloomFilter: public CppUnit::TestFixture
+{
+  CPPUNIT_TEST_SUITE(testEventBloomFilter);
+  CPPUNIT_TEST(emptyTest);
+  CPPUNIT_TEST(membershipTest);
+  CPPUNIT_TEST(wordsTest);
+  CPPUNIT_TEST(indexIntoFileTest);
+  CPPUNIT_TEST_SUITE_END();
+
+ public:
+  void setUp(){}
+  void tearDown(){}
+
+  void emptyTest();
+  void membershipTest();
+  void wordsTest();
+  void indexIntoFileTest();
+};
+
+///registration of the test so that the runner can find it
+CPPUNIT_TEST_SUITE_REGISTRATION(testEventBloomFilter);
+
+namespace {
+  class TestEventFinder : public edm::IndexIntoFile::EventFinder {
+  public:
+    virtual edm::EventNumber_t getEventNumberOfEntry(edm::IndexIntoFile::EntryNumber_t entry) const {
+      return testData_.at(entry);
+    }
+    void push_back(edm::EventNumber_t e) {testData_.push_back(e);}
+  private:
+    std::vector<edm::EventNumber_t> testData_;
+  };
+
+  // Events 1, 3, 5, ... in runs 1 and 2
+  void fillFilter(edm::EventBloomFilter& filter, unsigned int nEvents) {
+    filter.reset(2 * nEvents);
+    for(edm::EventNumber_t i = 0; i < nEvents; ++i) {
+      filter.insert(1, 2 * i + 1);
+      filter.insert(2, 2 * i + 1);
+    }
+  }
+}
+
+void testEventBloomFilter::emptyTest()
+{
+  edm::EventBloomFilter filter;
+  CPPUNIT_ASSERT(filter.empty());
+  CPPUNIT_ASSERT(filter.mayContain(1, 1));
+
+  // A filter for no events rejects everything
+  filter.reset(0);
+  CPPUNIT_ASSERT(!filter.empty());
+  CPPUNIT_ASSERT(!filter.mayContain(1, 1));
+}
+
+void testEventBloomFilter::membershipTest()
+{
+  unsigned int const nEvents = 50000;
+  edm::EventBloomFilter filter;
+  fillFilter(filter, nEvents);
+
+  for(edm::EventNumber_t i = 0; i < nEvents; ++i) {
+    CPPUNIT_ASSERT(filter.mayContain(1, 2 * i + 1));
+    CPPUNIT_ASSERT(filter.mayContain(2, 2 * i + 1));
+  }
+  unsigned int nFalsePositives = 0;
+  for(edm::EventNumber_t i = 0; i < nEvents; ++i) {
+    if(filter.mayContain(1, 2 * i + 2)) ++nFalsePositives;
+    if(filter.mayContain(3, 2 * i + 1)) ++nFalsePositives;
+  }
+  CPPUNIT_ASSERT(nFalsePositives < 2 * nEvents / 50);
+}
+
+void testEventBloomFilter::wordsTest()
+{
+  edm::EventBloomFilter filter;
+  fillFilter(filter, 1000);
+  std::vector<unsigned long long> words(1, 42ULL);
+  filter.toWords(words);
+
+  edm::EventBloomFilter copy;
+  CPPUNIT_ASSERT(!copy.fromWords(words));
+  CPPUNIT_ASSERT(copy.empty());
+  words.erase(words.begin());
+  CPPUNIT_ASSERT(copy.fromWords(words));
+  for(edm::EventNumber_t event = 1; event < 3000; ++event) {
+    CPPUNIT_ASSERT(copy.mayContain(1, event) == filter.mayContain(1, event));
+  }
+
+  words.pop_back();
+  CPPUNIT_ASSERT(!copy.fromWords(words));
+  CPPUNIT_ASSERT(copy.empty());
+}
+
+void testEventBloomFilter::indexIntoFileTest()
+{
+  edm::ProcessHistoryID phid;
+  edm::IndexIntoFile indexIntoFile;
+  TestEventFinder* ptr(new TestEventFinder);
+  boost::shared_ptr<edm::IndexIntoFile::EventFinder> shptr(ptr);
+  edm::IndexIntoFile::EntryNumber_t eventEntry = 0;
+  for(edm::LuminosityBlockNumber_t lumi = 1; lumi < 4; ++lumi) {
+    for(edm::EventNumber_t event = 10 * lumi; event < 10 * lumi + 5; ++event) {
+      indexIntoFile.addEntry(phid, 1, lumi, event, eventEntry++);
+      ptr->push_back(event);
+    }
+    indexIntoFile.addEntry(phid, 1, lumi, 0, lumi - 1);
+  }
+  indexIntoFile.addEntry(phid, 1, 0, 0, 0);
+  indexIntoFile.sortVector_Run_Or_Lumi_Entries();
+  indexIntoFile.setNumberOfEvents(eventEntry);
+  indexIntoFile.setEventFinder(shptr);
+
+  indexIntoFile.fillEventFilter();
+  CPPUNIT_ASSERT(!indexIntoFile.eventFilter().empty());
+  std::vector<unsigned long long> words;
+  indexIntoFile.eventFilter().toWords(words);
+
+  for(edm::EventNumber_t event = 1; event < 50; ++event) {
+    bool inFile = event >= 10 && event < 40 && event % 10 < 5;
+    CPPUNIT_ASSERT(indexIntoFile.containsEvent(1, event / 10, event) == inFile);
+    CPPUNIT_ASSERT(indexIntoFile.containsItem(1, 0, event) == inFile);
+    CPPUNIT_ASSERT(!indexIntoFile.containsEvent(2, event / 10, event));
+  }
+
+  // A new index with the saved filter and no EventFinder, as in a file
+  // selection tool. Events not in the file are rejected without reading
+  // any event numbers.
+  edm::IndexIntoFile reread;
+  for(edm::LuminosityBlockNumber_t lumi = 1; lumi < 4; ++lumi) {
+    for(edm::EventNumber_t event = 10 * lumi; event < 10 * lumi + 5; ++event) {
+      reread.addEntry(phid, 1, lumi, event, event);
+    }
+    reread.addEntry(phid, 1, lumi, 0, lumi - 1);
+  }
+  reread.addEntry(phid, 1, 0, 0, 0);
+  reread.sortVector_Run_Or_Lumi_Entries();
+  reread.setNumberOfEvents(eventEntry);
+  edm::EventBloomFilter filter;
+  CPPUNIT_ASSERT(filter.fromWords(words));
+  reread.setEventFilter(filter);
+  int nRejected = 0;
+  for(edm::EventNumber_t event = 1000; event < 1100; ++event) {
+    if(!indexIntoFile.eventFilter().mayContain(1, event)) {
+      CPPUNIT_ASSERT(!reread.containsEvent(1, 1, event));
+      ++nRejected;
+    }
+  }
+  CPPUNIT_ASSERT(nRejected > 90);
+}
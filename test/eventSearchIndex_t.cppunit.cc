@@ -0,0 +1,218 @@
+/*
+ *  eventSearchIndex_t.cppunit.cc
+ *  CMSSW
+ *
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "DataFormats/Provenance/interface/EventSearchIndex.h"
+#include "DataFormats/Provenance/interface/IndexIntoFile.h"
+#include "DataFormats/Provenance/interface/ProcessHistoryID.h"
+
+#include "boost/shared_ptr.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+class testEventSearchIndex: public CppUnit::TestFixture
+{
+  CPPUNIT_TEST_SUITE(testEventSearchIndex);
+  CPPUNIT_TEST(emptyTest);
+  CPPUNIT_TEST(lowerBoundTest);
+  CPPUNIT_TEST(indexIntoFileTest);
+  CPPUNIT_TEST(emptyLumiTest);
+  CPPUNIT_TEST_SUITE_END();
+
+ public:
+  void setUp(){}
+  void tearDown(){}
+
+  void emptyTest();
+  void lowerBoundTest();
+  void indexIntoFileTest();
+  void emptyLumiTest();
+};
+
+///registration of the test so that the runner can find it
+CPPUNIT_TEST_SUITE_REGISTRATION(testEventSearchIndex);
+
+namespace {
+  class TestEventFinder : public edm::IndexIntoFile::EventFinder {
+  public:
+    virtual edm::EventNumber_t getEventNumberOfEntry(edm::IndexIntoFile::EntryNumber_t entry) const {
+      return testData_.at(entry);
+    }
+    void push_back(edm::EventNumber_t e) {testData_.push_back(e);}
+  private:
+    std::vector<edm::EventNumber_t> testData_;
+  };
+
+  struct EventAt {
+    explicit EventAt(std::vector<edm::EventNumber_t> const& events) : events_(events) {}
+    edm::EventNumber_t operator()(long long i) const {return events_[i];}
+    std::vector<edm::EventNumber_t> const& events_;
+  };
+}
+
+void testEventSearchIndex::emptyTest()
+{
+  edm::EventSearchIndex searchIndex;
+  CPPUNIT_ASSERT(searchIndex.empty());
+  std::vector<edm::EventNumber_t> events(1, 5);
+  CPPUNIT_ASSERT(searchIndex.lowerBound(0, 1, 5, EventAt(events)) == -1);
+}
+
+void testEventSearchIndex::lowerBoundTest()
+{
+  // Ranges of sizes around the node boundaries, one after the other in
+  // one vector, with duplicate events and gaps between them
+  long long const sizes[] = {1, 2, 15, 16, 17, 255, 256, 257, 4095, 4096, 4097, 70000};
+  unsigned int const nSizes = sizeof(sizes) / sizeof(sizes[0]);
+  std::srand(17);
+  std::vector<edm::EventNumber_t> events;
+  std::vector<long long> begins;
+  for(unsigned int i = 0; i < nSizes; ++i) {
+    begins.push_back(events.size());
+    edm::EventNumber_t event = 1 + std::rand() % 10;
+    for(long long j = 0; j < sizes[i]; ++j) {
+      events.push_back(event);
+      event += std::rand() % 4;
+    }
+  }
+  begins.push_back(events.size());
+
+  edm::EventSearchIndex searchIndex;
+  for(unsigned int i = 0; i < nSizes; ++i) {
+    searchIndex.addRange(begins[i], &events[begins[i]], begins[i + 1] - begins[i]);
+  }
+  CPPUNIT_ASSERT(!searchIndex.empty());
+  CPPUNIT_ASSERT(searchIndex.memoryUsed() > 0);
+
+  EventAt eventAt(events);
+  for(unsigned int i = 0; i < nSizes; ++i) {
+    long long begin = begins[i];
+    long long end = begins[i + 1];
+    edm::EventNumber_t last = events[end - 1];
+    for(edm::EventNumber_t event = 0; event < last + 3; event += (last > 3000 ? 7 : 1)) {
+      long long expected = std::lower_bound(events.begin() + begin, events.begin() + end, event) - events.begin();
+      CPPUNIT_ASSERT(searchIndex.lowerBound(begin, end, event, eventAt) == expected);
+    }
+    CPPUNIT_ASSERT(searchIndex.lowerBound(begin, end, 0xffffffffU, eventAt) == end);
+  }
+  // A range that was not added, or does not match an added range
+  CPPUNIT_ASSERT(searchIndex.lowerBound(1, 2, 5, eventAt) == -1);
+  CPPUNIT_ASSERT(searchIndex.lowerBound(begins[5], begins[6] - 1, 5, eventAt) == -1);
+
+  searchIndex.clear();
+  CPPUNIT_ASSERT(searchIndex.empty());
+}
+
+void testEventSearchIndex::indexIntoFileTest()
+{
+  // Lumis of 3 to 3000 events, with the event numbers of each lumi
+  // added in a shuffled order
+  edm::ProcessHistoryID phid;
+  edm::IndexIntoFile indexIntoFile;
+  TestEventFinder* ptr(new TestEventFinder);
+  boost::shared_ptr<edm::IndexIntoFile::EventFinder> shptr(ptr);
+  std::srand(5);
+  edm::IndexIntoFile::EntryNumber_t eventEntry = 0;
+  edm::LuminosityBlockNumber_t const nLumis = 6;
+  for(edm::LuminosityBlockNumber_t lumi = 1; lumi <= nLumis; ++lumi) {
+    std::vector<edm::EventNumber_t> lumiEvents;
+    for(edm::EventNumber_t event = 1; event <= (lumi % 2 == 0 ? 3000U : 3U); ++event) {
+      lumiEvents.push_back(3 * event + lumi);
+    }
+    std::random_shuffle(lumiEvents.begin(), lumiEvents.end());
+    for(std::vector<edm::EventNumber_t>::const_iterator event = lumiEvents.begin(); event != lumiEvents.end(); ++event) {
+      indexIntoFile.addEntry(phid, 1, lumi, *event, eventEntry++);
+      ptr->push_back(*event);
+    }
+    indexIntoFile.addEntry(phid, 1, lumi, 0, lumi - 1);
+  }
+  indexIntoFile.addEntry(phid, 1, 0, 0, 0);
+  indexIntoFile.sortVector_Run_Or_Lumi_Entries();
+  indexIntoFile.setNumberOfEvents(eventEntry);
+  indexIntoFile.setEventFinder(shptr);
+
+  // Without the levels
+  std::vector<edm::IndexIntoFile::EntryNumber_t> expected;
+  for(edm::LuminosityBlockNumber_t lumi = 1; lumi <= nLumis; ++lumi) {
+    for(edm::EventNumber_t event = 1; event < 9010; ++event) {
+      edm::IndexIntoFile::IndexIntoFileItr iter = indexIntoFile.findEventPosition(1, lumi, event);
+      expected.push_back(iter.getEntryType() == edm::IndexIntoFile::kEvent ? iter.entry() : -1);
+    }
+  }
+
+  // The lumis of 3000 events get levels, with the event numbers or with the event entries
+  for(int useEntries = 0; useEntries < 2; ++useEntries) {
+    if(useEntries) {
+      indexIntoFile.inputFileClosed();
+      indexIntoFile.setEventFinder(shptr);
+      indexIntoFile.fillEventEntries();
+    }
+    indexIntoFile.fillEventSearchIndex(1000);
+    CPPUNIT_ASSERT(!indexIntoFile.eventSearchIndex().empty());
+    std::vector<edm::IndexIntoFile::EntryNumber_t>::const_iterator expectedEntry = expected.begin();
+    for(edm::LuminosityBlockNumber_t lumi = 1; lumi <= nLumis; ++lumi) {
+      for(edm::EventNumber_t event = 1; event < 9010; ++event, ++expectedEntry) {
+        edm::IndexIntoFile::IndexIntoFileItr iter = indexIntoFile.findEventPosition(1, lumi, event);
+        CPPUNIT_ASSERT((iter.getEntryType() == edm::IndexIntoFile::kEvent ? iter.entry() : -1) == *expectedEntry);
+      }
+    }
+  }
+}
+
+namespace {
+  // Lumis 1 and 3 have 3000 events, lumis 2 and 4 have none
+  void fillWithEmptyLumis(edm::IndexIntoFile& indexIntoFile, boost::shared_ptr<edm::IndexIntoFile::EventFinder>& shptr) {
+    edm::ProcessHistoryID phid;
+    TestEventFinder* ptr(new TestEventFinder);
+    shptr.reset(ptr);
+    edm::IndexIntoFile::EntryNumber_t eventEntry = 0;
+    for(edm::LuminosityBlockNumber_t lumi = 1; lumi <= 4; ++lumi) {
+      for(edm::EventNumber_t event = (lumi % 2 == 0 ? 0U : 3000U); event > 0; --event) {
+        indexIntoFile.addEntry(phid, 1, lumi, 2 * event, eventEntry++);
+        ptr->push_back(2 * event);
+      }
+      indexIntoFile.addEntry(phid, 1, lumi, 0, lumi - 1);
+    }
+    indexIntoFile.addEntry(phid, 1, 0, 0, 0);
+    indexIntoFile.sortVector_Run_Or_Lumi_Entries();
+    indexIntoFile.setNumberOfEvents(eventEntry);
+    indexIntoFile.setEventFinder(shptr);
+  }
+}
+
+void testEventSearchIndex::emptyLumiTest()
+{
+  // A lumi without events starts where the lumi after it starts. With
+  // a minimum of zero events it must neither get levels nor hide the
+  // levels of that lumi.
+  boost::shared_ptr<edm::IndexIntoFile::EventFinder> shptr;
+  edm::IndexIntoFile withoutEmpty;
+  fillWithEmptyLumis(withoutEmpty, shptr);
+  withoutEmpty.fillEventSearchIndex(1);
+
+  for(int useEntries = 0; useEntries < 2; ++useEntries) {
+    edm::IndexIntoFile indexIntoFile;
+    fillWithEmptyLumis(indexIntoFile, shptr);
+    if(useEntries) {
+      indexIntoFile.fillEventEntries();
+    }
+    indexIntoFile.fillEventSearchIndex(0);
+    CPPUNIT_ASSERT(indexIntoFile.eventSearchIndex().numberOfKeys() == withoutEmpty.eventSearchIndex().numberOfKeys());
+    for(edm::LuminosityBlockNumber_t lumi = 1; lumi <= 4; ++lumi) {
+      for(edm::EventNumber_t event = 1; event < 6010; ++event) {
+        edm::IndexIntoFile::IndexIntoFileItr iter = indexIntoFile.findEventPosition(1, lumi, event);
+        bool found = lumi % 2 == 1 && event % 2 == 0 && event <= 6000;
+        CPPUNIT_ASSERT((iter.getEntryType() == edm::IndexIntoFile::kEvent) == found);
+        if(found) {
+          CPPUNIT_ASSERT(iter.entry() == static_cast<long long>((lumi - 1) / 2 * 3000 + 3000 - event / 2));
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,95 @@
+#include "DataFormats/Provenance/interface/FileIndex.h"
+#include "FWCore/Utilities/interface/CPUTimer.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+// This program times FileIndex::sortBy_Run_Lumi_Event and
+// FileIndex::sortBy_Run_Lumi_EventEntry against std::stable_sort with
+// the same comparisons, for indexes of 10^6 elements up to a maximum
+// size, multiplying the size by 10 each time.
+
+// Just running the program prints the timing info to std::cout.
+// The optional arguments set the maximum size (default 100000000) and
+// the number of sort threads (default 4). The largest size needs about
+// 5 GB of memory.
+
+using namespace edm;
+
+namespace edmtestfileindex {
+
+  // A file of 10 runs with lumis of 1000 events each, where the events
+  // of a lumi were written in a scrambled order.
+  void fillFileIndex(FileIndex& fileIndex, long long nElements) {
+    long long const nEventsPerLumi = 1000;
+    long long const nLumis = nElements / (nEventsPerLumi + 1) + 1;
+    long long const nLumisPerRun = nLumis / 10 + 1;
+    std::srand(11);
+    FileIndex::EntryNumber_t eventEntry = 0;
+    for(long long lumi = 0; lumi < nLumis && static_cast<long long>(fileIndex.size()) < nElements; ++lumi) {
+      RunNumber_t run = 100 + lumi / nLumisPerRun;
+      LuminosityBlockNumber_t lumiNumber = 1 + lumi % nLumisPerRun;
+      for(long long i = 0; i < nEventsPerLumi && static_cast<long long>(fileIndex.size()) < nElements; ++i) {
+        EventNumber_t event = 1 + (lumi * nEventsPerLumi + (i * 7919) % nEventsPerLumi) * 3 + std::rand() % 3;
+        fileIndex.addEntry(run, lumiNumber, event, eventEntry++);
+      }
+      fileIndex.addEntry(run, lumiNumber, 0U, lumi);
+      if(lumi % nLumisPerRun == 0) {
+        fileIndex.addEntry(run, 0U, 0U, lumi / nLumisPerRun);
+      }
+    }
+  }
+
+  template<typename Sort>
+  double timeSort(FileIndex const& fileIndex, Sort sort) {
+    FileIndex copy(fileIndex);
+    edm::CPUTimer timer;
+    timer.start();
+    sort(copy);
+    timer.stop();
+    return timer.realTime();
+  }
+}
+
+using namespace edmtestfileindex;
+
+int main(int argc, char* argv[]) {
+
+  long long maxElements = 100000000LL;
+  unsigned int nThreads = 4;
+  if(argc > 1) maxElements = std::atoll(argv[1]);
+  if(argc > 2) nThreads = std::atoi(argv[2]);
+
+  for(long long nElements = 1000000LL; nElements <= maxElements; nElements *= 10) {
+    FileIndex fileIndex;
+    fillFileIndex(fileIndex, nElements);
+    std::cout << "Sorting " << fileIndex.size() << " elements\n";
+
+    double stableEvent = timeSort(fileIndex, [](FileIndex& f) {
+      std::stable_sort(f.begin(), f.end());
+    });
+    double radixEvent = timeSort(fileIndex, [](FileIndex& f) {f.sortBy_Run_Lumi_Event();});
+    double threadsEvent = timeSort(fileIndex, [nThreads](FileIndex& f) {
+      f.setNumberOfSortThreads(nThreads);
+      f.sortBy_Run_Lumi_Event();
+    });
+    std::cout << "  Run_Lumi_Event       stable_sort " << stableEvent
+              << " s, radix sort " << radixEvent
+              << " s, with " << nThreads << " threads " << threadsEvent << " s\n";
+
+    double stableEntry = timeSort(fileIndex, [](FileIndex& f) {
+      std::stable_sort(f.begin(), f.end(), Compare_Run_Lumi_EventEntry());
+    });
+    double radixEntry = timeSort(fileIndex, [](FileIndex& f) {f.sortBy_Run_Lumi_EventEntry();});
+    double threadsEntry = timeSort(fileIndex, [nThreads](FileIndex& f) {
+      f.setNumberOfSortThreads(nThreads);
+      f.sortBy_Run_Lumi_EventEntry();
+    });
+    std::cout << "  Run_Lumi_EventEntry  stable_sort " << stableEntry
+              << " s, radix sort " << radixEntry
+              << " s, with " << nThreads << " threads " << threadsEntry << " s\n";
+  }
+  return 0;
+}
@@ -0,0 +1,145 @@
+/*
+ *  fileIndex_t.cppunit.cc
+ *  CMSSW
+ *
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "DataFormats/Provenance/interface/FileIndex.h"
+#include "FWCore/Utilities/interface/Algorithms.h"
+
+#include <cstdlib>
+#include <vector>
+
+class testFileIndex: public CppUnit::TestFixture
+{
+  CPPUNIT_TEST_SUITE(testFileIndex);
+  CPPUNIT_TEST(sortSmallTest);
+  CPPUNIT_TEST(sortLargeTest);
+  CPPUNIT_TEST(sortWideKeysTest);
+  CPPUNIT_TEST_SUITE_END();
+
+ public:
+  void setUp(){}
+  void tearDown(){}
+
+  void sortSmallTest();
+  void sortLargeTest();
+  void sortWideKeysTest();
+};
+
+///registration of the test so that the runner can find it
+CPPUNIT_TEST_SUITE_REGISTRATION(testFileIndex);
+
+namespace {
+  typedef edm::FileIndex::EntryNumber_t EntryNumber_t;
+
+  // Runs, lumis and events with many duplicates, with the given ranges of
+  // numbers. Duplicates with different entries check that the sorts are stable.
+  void fillRandomFileIndex(edm::FileIndex& fileIndex, unsigned int n,
+                           unsigned int runs, unsigned int lumis, unsigned int events,
+                           EntryNumber_t firstEntry, EntryNumber_t entryStep) {
+    EntryNumber_t entry = firstEntry;
+    for(unsigned int i = 0; i < n; ++i) {
+      edm::RunNumber_t run = 1 + std::rand() % runs;
+      int type = std::rand() % 8;
+      if(type == 0) {
+        fileIndex.addEntry(run, 0U, 0U, entry);
+      } else if(type == 1) {
+        fileIndex.addEntry(run, 1 + std::rand() % lumis, 0U, entry);
+      } else {
+        fileIndex.addEntry(run, 1 + std::rand() % lumis, 1 + std::rand() % events, entry);
+      }
+      // Some entries repeat
+      if(std::rand() % 4 != 0) entry += entryStep;
+    }
+  }
+
+  bool sameElements(edm::FileIndex const& fileIndex, std::vector<edm::FileIndex::Element> const& reference) {
+    if(fileIndex.size() != reference.size()) return false;
+    std::vector<edm::FileIndex::Element>::const_iterator ref = reference.begin();
+    for(edm::FileIndex::const_iterator it = fileIndex.begin(); it != fileIndex.end(); ++it, ++ref) {
+      if(it->run_ != ref->run_ || it->lumi_ != ref->lumi_ || it->event_ != ref->event_ || it->entry_ != ref->entry_) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Sorts a copy of fileIndex both ways with each number of threads and
+  // compares the results with stable_sort_all.
+  void checkSorts(edm::FileIndex const& fileIndex) {
+    std::vector<edm::FileIndex::Element> byEvent(fileIndex.begin(), fileIndex.end());
+    edm::stable_sort_all(byEvent);
+    std::vector<edm::FileIndex::Element> byEntry(fileIndex.begin(), fileIndex.end());
+    edm::stable_sort_all(byEntry, edm::Compare_Run_Lumi_EventEntry());
+    // Elements that compare equal keep the order of the previous sort
+    std::vector<edm::FileIndex::Element> byEventThenEntry(byEvent);
+    edm::stable_sort_all(byEventThenEntry, edm::Compare_Run_Lumi_EventEntry());
+    std::vector<edm::FileIndex::Element> byEntryThenEvent(byEntry);
+    edm::stable_sort_all(byEntryThenEvent);
+
+    for(unsigned int nThreads = 1; nThreads <= 4; nThreads += 3) {
+      edm::FileIndex sorted(fileIndex);
+      sorted.setNumberOfSortThreads(nThreads);
+      sorted.sortBy_Run_Lumi_Event();
+      CPPUNIT_ASSERT(sameElements(sorted, byEvent));
+      sorted.sortBy_Run_Lumi_EventEntry();
+      CPPUNIT_ASSERT(sameElements(sorted, byEventThenEntry));
+
+      edm::FileIndex sortedByEntry(fileIndex);
+      sortedByEntry.setNumberOfSortThreads(nThreads);
+      sortedByEntry.sortBy_Run_Lumi_EventEntry();
+      CPPUNIT_ASSERT(sameElements(sortedByEntry, byEntry));
+      sortedByEntry.sortBy_Run_Lumi_Event();
+      CPPUNIT_ASSERT(sameElements(sortedByEntry, byEntryThenEvent));
+    }
+  }
+}
+
+void testFileIndex::sortSmallTest()
+{
+  std::srand(3);
+  edm::FileIndex empty;
+  empty.sortBy_Run_Lumi_Event();
+  CPPUNIT_ASSERT(empty.empty());
+  for(unsigned int n = 1; n < 3000; n = n * 3 + 1) {
+    edm::FileIndex fileIndex;
+    fillRandomFileIndex(fileIndex, n, 3, 10, 50, 0, 1);
+    checkSorts(fileIndex);
+  }
+}
+
+void testFileIndex::sortLargeTest()
+{
+  std::srand(5);
+  edm::FileIndex fileIndex;
+  fillRandomFileIndex(fileIndex, 300000, 20, 200, 100000, 0, 1);
+  checkSorts(fileIndex);
+
+  // All elements in one run and lumi, in reverse entry order
+  edm::FileIndex oneLumi;
+  for(EntryNumber_t entry = 200000; entry > 0; --entry) {
+    oneLumi.addEntry(7, 3, 1 + std::rand() % 1000, entry);
+  }
+  oneLumi.addEntry(7, 3, 0, 0);
+  oneLumi.addEntry(7, 0, 0, 0);
+  checkSorts(oneLumi);
+}
+
+void testFileIndex::sortWideKeysTest()
+{
+  // Numbers across their whole ranges and negative entries spread over
+  // the whole 64 bit range, so the fields do not fit in one key
+  std::srand(7);
+  edm::FileIndex fileIndex;
+  EntryNumber_t const step = 1LL << 44;
+  fillRandomFileIndex(fileIndex, 100000, 1000, 1000, 1000, -(1LL << 62), step);
+  for(unsigned int i = 0; i < 1000; ++i) {
+    unsigned int big = 0xffffffffU - std::rand() % 16;
+    fileIndex.addEntry(big, big, big, step * i);
+    fileIndex.addEntry(big, 0U, 0U, -(1LL << 62) - i);
+  }
+  checkSorts(fileIndex);
+}
@@ -0,0 +1,111 @@
+/*
+ *  flatHashMap_t.cppunit.cc
+ *  CMSSW
+ *
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "DataFormats/Provenance/interface/FlatHashMap.h"
+#include "DataFormats/Provenance/interface/ParameterSetID.h"
+
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+class testFlatHashMap: public CppUnit::TestFixture
+{
+  CPPUNIT_TEST_SUITE(testFlatHashMap);
+  CPPUNIT_TEST(hashTest);
+  CPPUNIT_TEST(insertFindTest);
+  CPPUNIT_TEST(stableReferenceTest);
+  CPPUNIT_TEST_SUITE_END();
+
+ public:
+  void setUp(){}
+  void tearDown(){}
+
+  void hashTest();
+  void insertFindTest();
+  void stableReferenceTest();
+};
+
+///registration of the test so that the runner can find it
+CPPUNIT_TEST_SUITE_REGISTRATION(testFlatHashMap);
+
+namespace {
+  edm::ParameterSetID makeID(unsigned int i) {
+    char buffer[33];
+    std::snprintf(buffer, sizeof(buffer), "%08x%08x%08x%08x", i * 2654435761U, i, i ^ 0x5bd1e995U, i + 7U);
+    return edm::ParameterSetID(std::string(buffer));
+  }
+}
+
+void testFlatHashMap::hashTest()
+{
+  std::hash<edm::ParameterSetID> hasher;
+  edm::ParameterSetID a = makeID(1);
+  edm::ParameterSetID b(a);
+  CPPUNIT_ASSERT(hasher(a) == hasher(b));
+  CPPUNIT_ASSERT(hasher(a) != hasher(makeID(2)));
+  CPPUNIT_ASSERT(hasher(edm::ParameterSetID()) == hasher(edm::ParameterSetID()));
+}
+
+void testFlatHashMap::insertFindTest()
+{
+  typedef edm::FlatHashMap<edm::ParameterSetID, int> Map;
+  Map m;
+  CPPUNIT_ASSERT(m.empty());
+  CPPUNIT_ASSERT(m.find(makeID(0)) == m.end());
+
+  std::map<edm::ParameterSetID, int> reference;
+  for(unsigned int i = 0; i < 1000; ++i) {
+    std::pair<Map::iterator, bool> result = m.insert(Map::value_type(makeID(i), i));
+    CPPUNIT_ASSERT(result.second);
+    CPPUNIT_ASSERT(result.first->second == static_cast<int>(i));
+    reference[makeID(i)] = i;
+  }
+  CPPUNIT_ASSERT(m.size() == reference.size());
+
+  // Inserting an existing key must not change the value
+  std::pair<Map::iterator, bool> result = m.insert(Map::value_type(makeID(10), -1));
+  CPPUNIT_ASSERT(!result.second);
+  CPPUNIT_ASSERT(result.first->second == 10);
+  CPPUNIT_ASSERT(m.size() == 1000U);
+
+  for(std::map<edm::ParameterSetID, int>::const_iterator it = reference.begin(); it != reference.end(); ++it) {
+    Map::const_iterator found = m.find(it->first);
+    CPPUNIT_ASSERT(found != m.end());
+    CPPUNIT_ASSERT(found->second == it->second);
+    CPPUNIT_ASSERT(m.count(it->first) == 1U);
+  }
+  CPPUNIT_ASSERT(m.find(makeID(5000)) == m.end());
+  CPPUNIT_ASSERT(m.count(makeID(5000)) == 0U);
+
+  // Iteration is in insertion order
+  unsigned int i = 0;
+  for(Map::const_iterator it = m.begin(); it != m.end(); ++it, ++i) {
+    CPPUNIT_ASSERT(it->first == makeID(i));
+  }
+
+  m[makeID(5000)] = 3;
+  CPPUNIT_ASSERT(m[makeID(5000)] == 3);
+  CPPUNIT_ASSERT(m.size() == 1001U);
+
+  m.clear();
+  CPPUNIT_ASSERT(m.empty());
+  CPPUNIT_ASSERT(m.find(makeID(10)) == m.end());
+}
+
+void testFlatHashMap::stableReferenceTest()
+{
+  typedef edm::FlatHashMap<edm::ParameterSetID, edm::ParameterSetID> Map;
+  Map m;
+  Map::value_type const* first = &*m.insert(Map::value_type(makeID(0), makeID(1))).first;
+  for(unsigned int i = 1; i < 500; ++i) {
+    m.insert(Map::value_type(makeID(i), makeID(i + 1)));
+  }
+  CPPUNIT_ASSERT(first == &*m.find(makeID(0)));
+  CPPUNIT_ASSERT(first->second == makeID(1));
+}
@@ -0,0 +1,368 @@
+/*
+ *  frozenIndexIntoFile_t.cppunit.cc
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "DataFormats/Provenance/interface/ProcessHistoryID.h"
+#include "DataFormats/Provenance/interface/ProcessConfiguration.h"
+#include "DataFormats/Provenance/interface/ProcessHistory.h"
+#include "DataFormats/Provenance/interface/ProcessHistoryRegistry.h"
+#include "FWCore/Utilities/interface/EDMException.h"
+
+// This is very ugly, but I am told OK for white box  unit tests
+#define private public
+#include "DataFormats/Provenance/interface/IndexIntoFile.h"
+#include "DataFormats/Provenance/interface/FrozenIndexIntoFile.h"
+#undef private
+
+#include "boost/shared_ptr.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+using namespace edm;
+
+class TestFrozenIndexIntoFile: public CppUnit::TestFixture
+{
+  CPPUNIT_TEST_SUITE(TestFrozenIndexIntoFile);
+  CPPUNIT_TEST(testRoundTrip);
+  CPPUNIT_TEST(testWithoutEventNumbers);
+  CPPUNIT_TEST(testCompressedEventNumbers);
+  CPPUNIT_TEST(testBadData);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+
+  void setUp() {
+    ProcessConfiguration pc;
+    std::unique_ptr<ProcessHistory> processHistory1(new ProcessHistory);
+    processHistory1->push_back(pc);
+    ProcessHistoryRegistry::instance()->insertMapped(*processHistory1);
+    fakePHID1 = processHistory1->id();
+
+    std::unique_ptr<ProcessHistory> processHistory2(new ProcessHistory);
+    processHistory2->push_back(pc);
+    processHistory2->push_back(pc);
+    ProcessHistoryRegistry::instance()->insertMapped(*processHistory2);
+    fakePHID2 = processHistory2->id();
+  }
+
+  void tearDown() { }
+
+  void testRoundTrip();
+  void testWithoutEventNumbers();
+  void testCompressedEventNumbers();
+  void testBadData();
+
+  ProcessHistoryID fakePHID1;
+  ProcessHistoryID fakePHID2;
+
+  class TestEventFinder : public IndexIntoFile::EventFinder {
+  public:
+    explicit TestEventFinder() {}
+    virtual ~TestEventFinder() {}
+    virtual EventNumber_t getEventNumberOfEntry(IndexIntoFile::EntryNumber_t entry) const {
+      return testData_.at(entry);
+    }
+    void push_back(EventNumber_t e) {testData_.push_back(e); }
+
+  private:
+    std::vector<EventNumber_t> testData_;
+  };
+
+  // Random runs and lumis, some lumis appearing twice in a run
+  void fillIndex(IndexIntoFile& indexIntoFile);
+
+  // The persistent vectors and whatever transient vectors are filled must be the same
+  void checkSame(IndexIntoFile const& left, IndexIntoFile const& right);
+
+  // Iterating and finding give the same results
+  void checkSameIteration(IndexIntoFile const& left, IndexIntoFile const& right);
+};
+
+///registration of the test so that the runner can find it
+CPPUNIT_TEST_SUITE_REGISTRATION(TestFrozenIndexIntoFile);
+
+namespace {
+  // A blob copied to memory that starts on an 8 byte boundary,
+  // as a file read or memory mapped into a page would
+  std::vector<unsigned long long> copyAligned(std::vector<char> const& blob) {
+    std::vector<unsigned long long> aligned((blob.size() + 7) / 8);
+    if (!blob.empty()) std::memcpy(&aligned[0], &blob[0], blob.size());
+    return aligned;
+  }
+
+  bool throwsOnView(void const* data, std::size_t size) {
+    try {
+      FrozenIndexIntoFile frozen(data, size);
+    } catch (edm::Exception const&) {
+      return true;
+    }
+    return false;
+  }
+}
+
+void TestFrozenIndexIntoFile::fillIndex(IndexIntoFile& indexIntoFile) {
+  TestEventFinder* ptr(new TestEventFinder);
+  boost::shared_ptr<IndexIntoFile::EventFinder> shptr(ptr);
+  std::srand(7);
+  IndexIntoFile::EntryNumber_t eventEntry = 0;
+  IndexIntoFile::EntryNumber_t lumiEntry = 0;
+  IndexIntoFile::EntryNumber_t runEntry = 0;
+  ProcessHistoryID phids[] = {fakePHID2, fakePHID1};
+  for (int iph = 0; iph < 2; ++iph) {
+    for (RunNumber_t run = 1 + std::rand() % 2; run < 5; ++run) {
+      for (int pass = 0; pass < 2; ++pass) {
+        for (LuminosityBlockNumber_t lumi = 1 + std::rand() % 3; lumi < 9; lumi += 1 + std::rand() % 2) {
+          int nEvents = std::rand() % 5;
+          for (int i = 0; i < nEvents; ++i) {
+            EventNumber_t event = 1 + std::rand() % 50;
+            indexIntoFile.addEntry(phids[iph], run, lumi, event, eventEntry++); // Event
+            ptr->push_back(event);
+          }
+          indexIntoFile.addEntry(phids[iph], run, lumi, 0, lumiEntry++); // Lumi
+        }
+      }
+      indexIntoFile.addEntry(phids[iph], run, 0, 0, runEntry++); // Run
+    }
+  }
+  indexIntoFile.sortVector_Run_Or_Lumi_Entries();
+  indexIntoFile.setNumberOfEvents(eventEntry);
+  indexIntoFile.setEventFinder(shptr);
+}
+
+void TestFrozenIndexIntoFile::checkSame(IndexIntoFile const& left, IndexIntoFile const& right) {
+  CPPUNIT_ASSERT(left.processHistoryIDs() == right.processHistoryIDs());
+  CPPUNIT_ASSERT(left.numberOfEvents() == right.numberOfEvents());
+
+  CPPUNIT_ASSERT(left.runOrLumiEntries().size() == right.runOrLumiEntries().size());
+  for (size_t i = 0; i < left.runOrLumiEntries().size(); ++i) {
+    IndexIntoFile::RunOrLumiEntry const& l = left.runOrLumiEntries()[i];
+    IndexIntoFile::RunOrLumiEntry const& r = right.runOrLumiEntries()[i];
+    CPPUNIT_ASSERT(l.orderPHIDRun() == r.orderPHIDRun() &&
+                   l.orderPHIDRunLumi() == r.orderPHIDRunLumi() &&
+                   l.entry() == r.entry() &&
+                   l.processHistoryIDIndex() == r.processHistoryIDIndex() &&
+                   l.run() == r.run() &&
+                   l.lumi() == r.lumi() &&
+                   l.beginEvents() == r.beginEvents() &&
+                   l.endEvents() == r.endEvents());
+  }
+
+  CPPUNIT_ASSERT(left.runOrLumiIndexes().size() == right.runOrLumiIndexes().size());
+  for (size_t i = 0; i < left.runOrLumiIndexes().size(); ++i) {
+    IndexIntoFile::RunOrLumiIndexes const& l = left.runOrLumiIndexes()[i];
+    IndexIntoFile::RunOrLumiIndexes const& r = right.runOrLumiIndexes()[i];
+    CPPUNIT_ASSERT(l.processHistoryIDIndex() == r.processHistoryIDIndex() &&
+                   l.run() == r.run() &&
+                   l.lumi() == r.lumi() &&
+                   l.indexToGetEntry() == r.indexToGetEntry() &&
+                   l.beginEventNumbers() == r.beginEventNumbers() &&
+                   l.endEventNumbers() == r.endEventNumbers());
+  }
+
+  CPPUNIT_ASSERT(left.eventNumbers() == right.eventNumbers());
+  CPPUNIT_ASSERT(left.eventEntries().size() == right.eventEntries().size());
+  for (size_t i = 0; i < left.eventEntries().size(); ++i) {
+    CPPUNIT_ASSERT(left.eventEntries()[i].event() == right.eventEntries()[i].event());
+    CPPUNIT_ASSERT(left.eventEntries()[i].entry() == right.eventEntries()[i].entry());
+  }
+}
+
+void TestFrozenIndexIntoFile::checkSameIteration(IndexIntoFile const& left, IndexIntoFile const& right) {
+  IndexIntoFile::SortOrder sortOrders[] = {IndexIntoFile::numericalOrder, IndexIntoFile::firstAppearanceOrder};
+  for (int i = 0; i < 2; ++i) {
+    IndexIntoFile::IndexIntoFileItr l = left.begin(sortOrders[i]);
+    IndexIntoFile::IndexIntoFileItr lEnd = left.end(sortOrders[i]);
+    IndexIntoFile::IndexIntoFileItr r = right.begin(sortOrders[i]);
+    IndexIntoFile::IndexIntoFileItr rEnd = right.end(sortOrders[i]);
+    for (; l != lEnd && r != rEnd; ++l, ++r) {
+      CPPUNIT_ASSERT(l.getEntryType() == r.getEntryType());
+      CPPUNIT_ASSERT(l.processHistoryIDIndex() == r.processHistoryIDIndex());
+      CPPUNIT_ASSERT(l.run() == r.run());
+      CPPUNIT_ASSERT(l.lumi() == r.lumi());
+      CPPUNIT_ASSERT(l.entry() == r.entry());
+    }
+    CPPUNIT_ASSERT(l == lEnd && r == rEnd);
+  }
+
+  for (RunNumber_t run = 1; run < 5; ++run) {
+    for (LuminosityBlockNumber_t lumi = 0; lumi < 9; ++lumi) {
+      for (EventNumber_t event = 0; event < 52; ++event) {
+        if (lumi == 0 && event == 0) continue;
+        IndexIntoFile::IndexIntoFileItr l = left.findPosition(run, lumi, event);
+        IndexIntoFile::IndexIntoFileItr r = right.findPosition(run, lumi, event);
+        CPPUNIT_ASSERT(l.getEntryType() == r.getEntryType());
+        CPPUNIT_ASSERT(l.entry() == r.entry());
+        CPPUNIT_ASSERT(l.peekAheadAtEventEntry() == r.peekAheadAtEventEntry());
+      }
+    }
+  }
+}
+
+void TestFrozenIndexIntoFile::testRoundTrip() {
+  IndexIntoFile indexIntoFile;
+  fillIndex(indexIntoFile);
+  indexIntoFile.fillEventNumbers();
+  indexIntoFile.fillEventEntries();
+
+  std::vector<char> blob(3, 'x');
+  FrozenIndexIntoFile::freeze(indexIntoFile, blob);
+  blob.erase(blob.begin(), blob.begin() + 3);
+  std::vector<unsigned long long> aligned = copyAligned(blob);
+
+  // Read in place
+  FrozenIndexIntoFile frozen(&aligned[0], blob.size());
+  CPPUNIT_ASSERT(frozen.numberOfEvents() == static_cast<IndexIntoFile::EntryNumber_t>(indexIntoFile.numberOfEvents()));
+  CPPUNIT_ASSERT(frozen.numberOfProcessHistoryIDs() == 2);
+  CPPUNIT_ASSERT(frozen.processHistoryID(0) == fakePHID2);
+  CPPUNIT_ASSERT(frozen.processHistoryID(1) == fakePHID1);
+  CPPUNIT_ASSERT(frozen.numberOfRunOrLumiEntries() == indexIntoFile.runOrLumiEntries().size());
+  CPPUNIT_ASSERT(frozen.numberOfRunOrLumiIndexes() == indexIntoFile.runOrLumiIndexes().size());
+  CPPUNIT_ASSERT(frozen.numberOfEventNumbers() == indexIntoFile.eventNumbers().size());
+  CPPUNIT_ASSERT(frozen.numberOfEventEntries() == indexIntoFile.eventEntries().size());
+  CPPUNIT_ASSERT(std::equal(indexIntoFile.eventNumbers().begin(), indexIntoFile.eventNumbers().end(),
+                            frozen.eventNumbers()));
+
+  // The thawed index is the same and needs neither sorting nor the EventFinder
+  IndexIntoFile thawed;
+  frozen.thaw(thawed);
+  checkSame(indexIntoFile, thawed);
+  CPPUNIT_ASSERT(!thawed.transient_.eventFinder_);
+  checkSameIteration(indexIntoFile, thawed);
+  checkSame(indexIntoFile, thawed);
+
+  // Position independent: the same bytes work anywhere
+  std::vector<unsigned long long> moved(aligned);
+  aligned.assign(aligned.size(), 0ULL);
+  IndexIntoFile thawedAgain;
+  FrozenIndexIntoFile(&moved[0], blob.size()).thaw(thawedAgain);
+  checkSame(indexIntoFile, thawedAgain);
+
+  // Freezing a thawed index gives the same bytes
+  std::vector<char> blobAgain;
+  FrozenIndexIntoFile::freeze(thawedAgain, blobAgain);
+  CPPUNIT_ASSERT(blobAgain == blob);
+
+  // An empty index
+  IndexIntoFile empty;
+  blob.clear();
+  FrozenIndexIntoFile::freeze(empty, blob);
+  aligned = copyAligned(blob);
+  IndexIntoFile thawedEmpty;
+  FrozenIndexIntoFile(&aligned[0], blob.size()).thaw(thawedEmpty);
+  CPPUNIT_ASSERT(thawedEmpty.empty());
+  CPPUNIT_ASSERT(thawedEmpty.begin(IndexIntoFile::numericalOrder) == thawedEmpty.end(IndexIntoFile::numericalOrder));
+}
+
+void TestFrozenIndexIntoFile::testWithoutEventNumbers() {
+  IndexIntoFile indexIntoFile;
+  fillIndex(indexIntoFile);
+
+  std::vector<char> blob;
+  FrozenIndexIntoFile::freeze(indexIntoFile, blob);
+  std::vector<unsigned long long> aligned = copyAligned(blob);
+  FrozenIndexIntoFile frozen(&aligned[0], blob.size());
+  CPPUNIT_ASSERT(frozen.numberOfRunOrLumiIndexes() == frozen.numberOfRunOrLumiEntries());
+  CPPUNIT_ASSERT(frozen.numberOfEventNumbers() == 0);
+  CPPUNIT_ASSERT(frozen.numberOfEventEntries() == 0);
+
+  // The event numbers are filled later from the EventFinder as usual
+  IndexIntoFile thawed;
+  frozen.thaw(thawed);
+  checkSame(indexIntoFile, thawed);
+  thawed.setEventFinder(indexIntoFile.transient_.eventFinder_);
+  checkSameIteration(indexIntoFile, thawed);
+}
+
+void TestFrozenIndexIntoFile::testCompressedEventNumbers() {
+  IndexIntoFile indexIntoFile;
+  fillIndex(indexIntoFile);
+  indexIntoFile.fillEventNumbers();
+  std::vector<EventNumber_t> eventNumbers = indexIntoFile.eventNumbers();
+  indexIntoFile.compressEventNumbers();
+  CPPUNIT_ASSERT(indexIntoFile.eventNumbers().empty());
+
+  // Stored uncompressed
+  std::vector<char> blob;
+  FrozenIndexIntoFile::freeze(indexIntoFile, blob);
+  std::vector<unsigned long long> aligned = copyAligned(blob);
+  IndexIntoFile thawed;
+  FrozenIndexIntoFile(&aligned[0], blob.size()).thaw(thawed);
+  CPPUNIT_ASSERT(thawed.eventNumbers() == eventNumbers);
+}
+
+void TestFrozenIndexIntoFile::testBadData() {
+  IndexIntoFile indexIntoFile;
+  fillIndex(indexIntoFile);
+  indexIntoFile.fillEventNumbers();
+  indexIntoFile.fillEventEntries();
+  std::vector<char> blob;
+  FrozenIndexIntoFile::freeze(indexIntoFile, blob);
+  std::vector<unsigned long long> aligned = copyAligned(blob);
+  CPPUNIT_ASSERT(!throwsOnView(&aligned[0], blob.size()));
+
+  // Truncated or too long
+  CPPUNIT_ASSERT(throwsOnView(&aligned[0], 0));
+  CPPUNIT_ASSERT(throwsOnView(&aligned[0], 32));
+  CPPUNIT_ASSERT(throwsOnView(&aligned[0], blob.size() - 8));
+  std::vector<unsigned long long> longer(aligned);
+  longer.push_back(0ULL);
+  CPPUNIT_ASSERT(throwsOnView(&longer[0], blob.size() + 8));
+
+  // Not aligned
+  std::vector<unsigned long long> shifted(aligned.size() + 1);
+  char* shiftedData = reinterpret_cast<char*>(&shifted[0]) + 4;
+  std::memcpy(shiftedData, &blob[0], blob.size());
+  CPPUNIT_ASSERT(throwsOnView(shiftedData, blob.size()));
+
+  // Wrong magic, byte order, version or counts
+  std::vector<unsigned long long> bad(aligned);
+  bad[0] = 0ULL;
+  CPPUNIT_ASSERT(throwsOnView(&bad[0], blob.size()));
+  bad = aligned;
+  unsigned char* bytes = reinterpret_cast<unsigned char*>(&bad[0]);
+  std::reverse(bytes, bytes + 8);
+  CPPUNIT_ASSERT(throwsOnView(&bad[0], blob.size()));
+  bad = aligned;
+  bad[1] = FrozenIndexIntoFile::formatVersion + 1;
+  CPPUNIT_ASSERT(throwsOnView(&bad[0], blob.size()));
+  bad = aligned;
+  bad[4] = ~0ULL;
+  CPPUNIT_ASSERT(throwsOnView(&bad[0], blob.size()));
+
+  // Indexes out of range or inconsistent event number ranges, with a consistent size.
+  // The header is 8 words, each process history ID 2 words, each run or lumi
+  // entry 7 words and each sorted index 4 words.
+  std::size_t nPHIDs = aligned[3];
+  std::size_t nEntries = aligned[4];
+  CPPUNIT_ASSERT(aligned[5] == nEntries && aligned[6] != 0 && aligned[7] == aligned[6]);
+  std::size_t firstEntry = 8 + 2 * nPHIDs;
+  std::size_t lastIndex = firstEntry + 7 * nEntries + 4 * (nEntries - 1);
+  std::int32_t const outOfRange[] = {-1, static_cast<std::int32_t>(nPHIDs)};
+  for (std::int32_t value : outOfRange) {
+    bad = aligned;
+    std::memcpy(reinterpret_cast<char*>(&bad[firstEntry + 5]), &value, sizeof(value));
+    CPPUNIT_ASSERT(throwsOnView(&bad[0], blob.size()));
+    bad = aligned;
+    std::memcpy(reinterpret_cast<char*>(&bad[lastIndex + 2]), &value, sizeof(value));
+    CPPUNIT_ASSERT(throwsOnView(&bad[0], blob.size()));
+  }
+  std::int32_t const badEntries[] = {-1, static_cast<std::int32_t>(nEntries)};
+  for (std::int32_t value : badEntries) {
+    bad = aligned;
+    std::memcpy(reinterpret_cast<char*>(&bad[lastIndex + 3]) + 4, &value, sizeof(value));
+    CPPUNIT_ASSERT(throwsOnView(&bad[0], blob.size()));
+  }
+  bad = aligned;
+  bad[lastIndex + 1] -= 1;
+  CPPUNIT_ASSERT(throwsOnView(&bad[0], blob.size()));
+  bad = aligned;
+  bad[lastIndex] += 1;
+  CPPUNIT_ASSERT(throwsOnView(&bad[0], blob.size()));
+}
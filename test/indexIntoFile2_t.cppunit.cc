@@ -14,6 +14,9 @@
 #include "DataFormats/Provenance/interface/IndexIntoFile.h"
 #undef private
 
+#include <algorithm>
+#include <cstdlib>
+#include <map>
 #include <string>
 #include <iostream>
 #include <memory>
@@ -24,6 +27,7 @@ class TestIndexIntoFile2: public CppUnit::TestFixture
 {
   CPPUNIT_TEST_SUITE(TestIndexIntoFile2);  
   CPPUNIT_TEST(testAddEntryAndFixAndSort);
+  CPPUNIT_TEST(testReduceAndSortLargeIndex);
   CPPUNIT_TEST_SUITE_END();
   
 public:
@@ -63,6 +67,11 @@ public:
   void tearDown() { }
 
   void testAddEntryAndFixAndSort();
+  void testReduceAndSortLargeIndex();
+
+  void fillRandomEntries(std::vector<IndexIntoFile::RunOrLumiEntry>& entries, int nPHIDs);
+  void checkSameEntries(std::vector<IndexIntoFile::RunOrLumiEntry> const& left,
+                        std::vector<IndexIntoFile::RunOrLumiEntry> const& right);
 
   ProcessHistoryID nullPHID;
   ProcessHistoryID fakePHID1;
@@ -456,3 +465,98 @@ void TestIndexIntoFile2::testAddEntryAndFixAndSort() {
   CPPUNIT_ASSERT(indexIntoFile.runOrLumiIndexes().empty());
   CPPUNIT_ASSERT(indexIntoFile.transient_.eventFinder_.get() == 0);
 }
+
+// Entries for a few thousand runs and lumis in a random order, with
+// duplicated keys, as in a file merged from many files
+void TestIndexIntoFile2::fillRandomEntries(std::vector<IndexIntoFile::RunOrLumiEntry>& entries, int nPHIDs) {
+  IndexIntoFile::EntryNumber_t runEntry = 0;
+  IndexIntoFile::EntryNumber_t lumiEntry = 0;
+  for (int i = 0; i < 20000; ++i) {
+    int phidIndex = std::rand() % nPHIDs;
+    RunNumber_t run = 1 + std::rand() % 50;
+    if (std::rand() % 10 == 0) {
+      entries.push_back(IndexIntoFile::RunOrLumiEntry(std::rand() % 1000, IndexIntoFile::invalidEntry, runEntry++,
+                                                      phidIndex, run, 0, IndexIntoFile::invalidEntry, IndexIntoFile::invalidEntry));
+    } else {
+      LuminosityBlockNumber_t lumi = 1 + std::rand() % 100;
+      entries.push_back(IndexIntoFile::RunOrLumiEntry(std::rand() % 1000, std::rand() % 20000, lumiEntry++,
+                                                      phidIndex, run, lumi, i, i + 1));
+    }
+  }
+}
+
+void TestIndexIntoFile2::checkSameEntries(std::vector<IndexIntoFile::RunOrLumiEntry> const& left,
+                                          std::vector<IndexIntoFile::RunOrLumiEntry> const& right) {
+  CPPUNIT_ASSERT(left.size() == right.size());
+  for (std::vector<IndexIntoFile::RunOrLumiEntry>::size_type i = 0; i < left.size(); ++i) {
+    CPPUNIT_ASSERT(left[i].orderPHIDRun() == right[i].orderPHIDRun());
+    CPPUNIT_ASSERT(left[i].orderPHIDRunLumi() == right[i].orderPHIDRunLumi());
+    CPPUNIT_ASSERT(left[i].entry() == right[i].entry());
+    CPPUNIT_ASSERT(left[i].processHistoryIDIndex() == right[i].processHistoryIDIndex());
+    CPPUNIT_ASSERT(left[i].run() == right[i].run());
+    CPPUNIT_ASSERT(left[i].lumi() == right[i].lumi());
+    CPPUNIT_ASSERT(left[i].beginEvents() == right[i].beginEvents());
+    CPPUNIT_ASSERT(left[i].endEvents() == right[i].endEvents());
+  }
+}
+
+// The radix sorts must give exactly the order std::stable_sort gives
+void TestIndexIntoFile2::testReduceAndSortLargeIndex() {
+  std::srand(7);
+
+  // Four process histories that differ only in the release version and reduce to two
+  std::vector<ProcessHistoryID> phids;
+  char const* releases[] = {"CMSSW_5_3_1", "CMSSW_5_3_2", "CMSSW_6_1_0", "CMSSW_6_1_1"};
+  for (int i = 0; i < 4; ++i) {
+    ProcessHistory ph;
+    ph.push_back(ProcessConfiguration("HLT", ParameterSetID(), releases[i], ""));
+    ph.push_back(ProcessConfiguration("PROD", ParameterSetID(), releases[i], ""));
+    ProcessHistoryRegistry::instance()->insertMapped(ph);
+    phids.push_back(ph.id());
+  }
+
+  edm::IndexIntoFile indexIntoFile;
+  indexIntoFile.setProcessHistoryIDs() = phids;
+  fillRandomEntries(indexIntoFile.setRunOrLumiEntries(), 4);
+
+  // What reduceProcessHistoryIDs did with maps and std::stable_sort
+  std::vector<IndexIntoFile::RunOrLumiEntry> expected = indexIntoFile.runOrLumiEntries();
+  std::map<IndexIntoFile::IndexRunKey, IndexIntoFile::EntryNumber_t> runOrderMap;
+  std::map<IndexIntoFile::IndexRunLumiKey, IndexIntoFile::EntryNumber_t> lumiOrderMap;
+  for (std::vector<IndexIntoFile::RunOrLumiEntry>::iterator i = expected.begin(); i != expected.end(); ++i) {
+    i->setProcessHistoryIDIndex(i->processHistoryIDIndex() / 2);
+    IndexIntoFile::IndexRunKey runKey(i->processHistoryIDIndex(), i->run());
+    if (runOrderMap.find(runKey) == runOrderMap.end()) runOrderMap[runKey] = i->orderPHIDRun();
+    i->setOrderPHIDRun(runOrderMap[runKey]);
+    if (i->lumi() != 0) {
+      IndexIntoFile::IndexRunLumiKey lumiKey(i->processHistoryIDIndex(), i->run(), i->lumi());
+      if (lumiOrderMap.find(lumiKey) == lumiOrderMap.end()) lumiOrderMap[lumiKey] = i->orderPHIDRunLumi();
+      i->setOrderPHIDRunLumi(lumiOrderMap[lumiKey]);
+    }
+  }
+  std::stable_sort(expected.begin(), expected.end());
+
+  indexIntoFile.reduceProcessHistoryIDs();
+  CPPUNIT_ASSERT(indexIntoFile.processHistoryIDs().size() == 2);
+  checkSameEntries(indexIntoFile.runOrLumiEntries(), expected);
+
+  // sortVector_Run_Or_Lumi_Entries takes the phid-run order from runToFirstEntry
+  edm::IndexIntoFile indexIntoFile2;
+  indexIntoFile2.setProcessHistoryIDs() = phids;
+  fillRandomEntries(indexIntoFile2.setRunOrLumiEntries(), 4);
+  for (std::vector<IndexIntoFile::RunOrLumiEntry>::const_iterator i = indexIntoFile2.runOrLumiEntries().begin();
+       i != indexIntoFile2.runOrLumiEntries().end(); ++i) {
+    IndexIntoFile::IndexRunKey runKey(i->processHistoryIDIndex(), i->run());
+    if (indexIntoFile2.runToFirstEntry().find(runKey) == indexIntoFile2.runToFirstEntry().end()) {
+      indexIntoFile2.runToFirstEntry()[runKey] = std::rand() % 5000 - 1;
+    }
+  }
+  expected = indexIntoFile2.runOrLumiEntries();
+  for (std::vector<IndexIntoFile::RunOrLumiEntry>::iterator i = expected.begin(); i != expected.end(); ++i) {
+    i->setOrderPHIDRun(indexIntoFile2.runToFirstEntry()[IndexIntoFile::IndexRunKey(i->processHistoryIDIndex(), i->run())]);
+  }
+  std::stable_sort(expected.begin(), expected.end());
+
+  indexIntoFile2.sortVector_Run_Or_Lumi_Entries();
+  checkSameEntries(indexIntoFile2.runOrLumiEntries(), expected);
+}
@@ -8,15 +8,19 @@
 #include "DataFormats/Provenance/interface/ProcessConfiguration.h"
 #include "DataFormats/Provenance/interface/ProcessHistory.h"
 #include "DataFormats/Provenance/interface/ProcessHistoryRegistry.h"
+#include "FWCore/Utilities/interface/EDMException.h"
 
 // This is very ugly, but I am told OK for white box  unit tests 
 #define private public
 #include "DataFormats/Provenance/interface/IndexIntoFile.h"
 #undef private
 
+#include <algorithm>
+#include <cstdlib>
 #include <string>
 #include <iostream>
 #include <memory>
+#include <vector>
 
 using namespace edm;
 
@@ -24,6 +28,9 @@ class TestIndexIntoFile3: public CppUnit::TestFixture
 {
   CPPUNIT_TEST_SUITE(TestIndexIntoFile3);  
   CPPUNIT_TEST(testIterEndWithEvent);
+  CPPUNIT_TEST(testEventEntryRanges);
+  CPPUNIT_TEST(testLumiMask);
+  CPPUNIT_TEST(testPartition);
   CPPUNIT_TEST_SUITE_END();
   
 public:
@@ -77,6 +84,9 @@ public:
   void tearDown() { }
 
   void testIterEndWithEvent();
+  void testEventEntryRanges();
+  void testLumiMask();
+  void testPartition();
 
   ProcessHistoryID nullPHID;
   ProcessHistoryID fakePHID1;
@@ -104,6 +114,16 @@ public:
                            LuminosityBlockNumber_t lumi,
                            IndexIntoFile::EntryNumber_t entry);
 
+  void checkEventEntryRanges(edm::IndexIntoFile const& indexIntoFile,
+                             IndexIntoFile::SortOrder sortOrder);
+
+  // Random runs and lumis, some lumis appearing twice in a run
+  void fillRandomIndex(edm::IndexIntoFile& indexIntoFile, unsigned int seed);
+
+  void checkLumiMask(edm::IndexIntoFile const& indexIntoFile,
+                     IndexIntoFile::SortOrder sortOrder,
+                     std::vector<LuminosityBlockRange> const& lumiMask);
+
 };
 
 ///registration of the test so that the runner can find it
@@ -847,3 +867,379 @@ void TestIndexIntoFile3::testIterEndWithEvent() {
   checkSkipped(0, 11, 102, 4);
   check(iterNum, kRun, 0, 4, 4, 1, 2);
 }
+
+// Compare the event entry ranges and skipEventsInLumi with stepping
+// through the same events one at a time, at every position of an iteration.
+void TestIndexIntoFile3::checkEventEntryRanges(edm::IndexIntoFile const& indexIntoFile,
+                                               IndexIntoFile::SortOrder sortOrder) {
+  edm::IndexIntoFile::IndexIntoFileItr iterEnd = indexIntoFile.end(sortOrder);
+  for (edm::IndexIntoFile::IndexIntoFileItr iter = indexIntoFile.begin(sortOrder); iter != iterEnd; ++iter) {
+    if (iter.getEntryType() == kRun) continue;
+
+    std::vector<IndexIntoFile::EntryRange> ranges(1, IndexIntoFile::EntryRange(100, 101));
+    long long nEvents = iter.getEventEntryRangesInLumi(ranges);
+    CPPUNIT_ASSERT(ranges.front() == IndexIntoFile::EntryRange(100, 101));
+
+    std::vector<IndexIntoFile::EntryNumber_t> fromRanges;
+    for (size_t i = 1; i < ranges.size(); ++i) {
+      CPPUNIT_ASSERT(ranges[i].first < ranges[i].second);
+      if (i > 1) CPPUNIT_ASSERT(ranges[i].first != ranges[i - 1].second);
+      for (IndexIntoFile::EntryNumber_t entry = ranges[i].first; entry < ranges[i].second; ++entry) {
+        fromRanges.push_back(entry);
+      }
+    }
+    CPPUNIT_ASSERT(static_cast<long long>(fromRanges.size()) == nEvents);
+
+    std::vector<IndexIntoFile::EntryNumber_t> fromStepping;
+    if (nEvents > 0) {
+      edm::IndexIntoFile::IndexIntoFileItr stepper(iter);
+      while (stepper.getEntryType() != kEvent) ++stepper;
+      while (stepper.getEntryType() == kEvent) {
+        fromStepping.push_back(stepper.entry());
+        ++stepper;
+      }
+    }
+    CPPUNIT_ASSERT(fromRanges == fromStepping);
+
+    if (iter.getEntryType() == kEvent) {
+      edm::IndexIntoFile::IndexIntoFileItr skipper(iter);
+      skipper.skipEventsInLumi();
+      edm::IndexIntoFile::IndexIntoFileItr stepper(iter);
+      while (stepper.getEntryType() == kEvent) ++stepper;
+      CPPUNIT_ASSERT(skipper == stepper);
+    } else {
+      edm::IndexIntoFile::IndexIntoFileItr skipper(iter);
+      skipper.skipEventsInLumi();
+      CPPUNIT_ASSERT(skipper == iter);
+    }
+  }
+}
+
+void TestIndexIntoFile3::testEventEntryRanges() {
+  edm::IndexIntoFile indexIntoFile;
+  indexIntoFile.addEntry(fakePHID1, 11, 101, 7, 0); // Event
+  indexIntoFile.addEntry(fakePHID1, 11, 101, 6, 1); // Event
+  indexIntoFile.addEntry(fakePHID1, 11, 101, 0, 0); // Lumi
+  indexIntoFile.addEntry(fakePHID1, 11, 101, 0, 1); // Lumi
+  indexIntoFile.addEntry(fakePHID1, 11, 101, 5, 2); // Event
+  indexIntoFile.addEntry(fakePHID1, 11, 101, 4, 3); // Event
+  indexIntoFile.addEntry(fakePHID1, 11, 101, 0, 2); // Lumi
+  indexIntoFile.addEntry(fakePHID1, 11, 102, 5, 4); // Event
+  indexIntoFile.addEntry(fakePHID1, 11, 102, 4, 5); // Event
+  indexIntoFile.addEntry(fakePHID1, 11, 102, 0, 3); // Lumi
+  indexIntoFile.addEntry(fakePHID1, 11,   0, 0, 0); // Run
+  indexIntoFile.addEntry(fakePHID2, 11,   0, 0, 1); // Run
+  indexIntoFile.addEntry(fakePHID2, 11, 101, 0, 4); // Lumi
+  indexIntoFile.addEntry(fakePHID2, 11, 102, 0, 5); // Lumi
+  indexIntoFile.addEntry(fakePHID2, 11, 102, 4, 6); // Event
+  indexIntoFile.addEntry(fakePHID2, 11, 102, 0, 6); // Lumi
+  indexIntoFile.addEntry(fakePHID2, 11,   0, 0, 2); // Run
+  indexIntoFile.sortVector_Run_Or_Lumi_Entries();
+
+  checkEventEntryRanges(indexIntoFile, IndexIntoFile::firstAppearanceOrder);
+
+  // The two event ranges of lumi 101 are contiguous in the TTree
+  edm::IndexIntoFile::IndexIntoFileItr iterFirst = indexIntoFile.begin(IndexIntoFile::firstAppearanceOrder);
+  std::vector<IndexIntoFile::EntryRange> ranges;
+  CPPUNIT_ASSERT(iterFirst.getEventEntryRangesInLumi(ranges) == 4);
+  CPPUNIT_ASSERT(ranges.size() == 1);
+  CPPUNIT_ASSERT(ranges[0] == IndexIntoFile::EntryRange(0, 4));
+
+  std::vector<IndexIntoFile::EventEntry>&  eventEntries  = indexIntoFile.eventEntries();
+  eventEntries.emplace_back(7, 0);
+  eventEntries.emplace_back(6, 1);
+  eventEntries.emplace_back(5, 2);
+  eventEntries.emplace_back(4, 3);
+  eventEntries.emplace_back(5, 4);
+  eventEntries.emplace_back(4, 5);
+  eventEntries.emplace_back(4, 6);
+  indexIntoFile.sortEventEntries();
+
+  checkEventEntryRanges(indexIntoFile, IndexIntoFile::numericalOrder);
+
+  // Sorted by event number the entries of lumi 101 are in reverse order
+  edm::IndexIntoFile::IndexIntoFileItr iterNum = indexIntoFile.begin(IndexIntoFile::numericalOrder);
+  ranges.clear();
+  CPPUNIT_ASSERT(iterNum.getEventEntryRangesInLumi(ranges) == 4);
+  CPPUNIT_ASSERT(ranges.size() == 4);
+  CPPUNIT_ASSERT(ranges[0] == IndexIntoFile::EntryRange(3, 4));
+  CPPUNIT_ASSERT(ranges[3] == IndexIntoFile::EntryRange(0, 1));
+}
+
+namespace {
+  struct Visited {
+    IndexIntoFile::EntryType type;
+    int phIndex;
+    RunNumber_t run;
+    LuminosityBlockNumber_t lumi;
+    IndexIntoFile::EntryNumber_t entry;
+    bool operator==(Visited const& right) const {
+      return type == right.type && phIndex == right.phIndex && run == right.run &&
+             lumi == right.lumi && entry == right.entry;
+    }
+  };
+
+  Visited visit(edm::IndexIntoFile::IndexIntoFileItr const& iter) {
+    Visited visited = {iter.getEntryType(), iter.processHistoryIDIndex(), iter.run(), iter.lumi(), iter.entry()};
+    return visited;
+  }
+
+  bool accepted(std::vector<LuminosityBlockRange> const& lumiMask, RunNumber_t run, LuminosityBlockNumber_t lumi) {
+    for (size_t i = 0; i < lumiMask.size(); ++i) {
+      if (contains(lumiMask[i], LuminosityBlockID(run, lumi))) return true;
+    }
+    return false;
+  }
+}
+
+// The masked iteration must visit what the unmasked iteration visits in
+// accepted lumis, and the runs only if they contain an accepted lumi.
+void TestIndexIntoFile3::checkLumiMask(edm::IndexIntoFile const& indexIntoFile,
+                                       IndexIntoFile::SortOrder sortOrder,
+                                       std::vector<LuminosityBlockRange> const& lumiMask) {
+  std::vector<Visited> expected;
+  std::vector<IndexIntoFile::EntryNumber_t> expectedEvents;
+  size_t runStart = 0;
+  bool runAccepted = false;
+  for (edm::IndexIntoFile::IndexIntoFileItr iter = indexIntoFile.begin(sortOrder),
+                                            iterEnd = indexIntoFile.end(sortOrder);
+       iter != iterEnd; ++iter) {
+    Visited visited = visit(iter);
+    if (visited.type == kRun) {
+      bool sameRun = !expected.empty() && expected.back().type == kRun &&
+                     expected.back().phIndex == visited.phIndex && expected.back().run == visited.run;
+      if (!sameRun) {
+        if (!runAccepted) expected.resize(runStart);
+        runStart = expected.size();
+        runAccepted = false;
+      }
+      expected.push_back(visited);
+    } else if (accepted(lumiMask, visited.run, visited.lumi)) {
+      runAccepted = true;
+      expected.push_back(visited);
+      if (visited.type == kEvent) expectedEvents.push_back(visited.entry);
+    }
+  }
+  if (!runAccepted) expected.resize(runStart);
+
+  std::vector<Visited> masked;
+  edm::IndexIntoFile::IndexIntoFileItr iterEnd = indexIntoFile.end(sortOrder);
+  for (edm::IndexIntoFile::IndexIntoFileItr iter = indexIntoFile.begin(sortOrder, lumiMask); iter != iterEnd; ++iter) {
+    masked.push_back(visit(iter));
+  }
+  CPPUNIT_ASSERT(masked == expected);
+
+  // skipEventForward skips exactly the accepted events
+  std::vector<IndexIntoFile::EntryNumber_t> skippedEvents;
+  edm::IndexIntoFile::IndexIntoFileItr iter = indexIntoFile.begin(sortOrder, lumiMask);
+  while (iter != iterEnd) {
+    skipEventForward(iter);
+    if (skipped_.skippedEventEntry_ != IndexIntoFile::invalidEntry) {
+      CPPUNIT_ASSERT(accepted(lumiMask, skipped_.runOfSkippedEvent_, skipped_.lumiOfSkippedEvent_));
+      skippedEvents.push_back(skipped_.skippedEventEntry_);
+    }
+  }
+  CPPUNIT_ASSERT(skippedEvents == expectedEvents);
+
+  // skipEventBackward from the end steps back over the rejected lumis
+  // and returns exactly the accepted events, in reverse
+  skippedEvents.clear();
+  iter = indexIntoFile.begin(sortOrder, lumiMask);
+  while (iter != iterEnd) ++iter;
+  while (true) {
+    skipEventBackward(iter);
+    if (skipped_.skippedEventEntry_ == IndexIntoFile::invalidEntry) break;
+    CPPUNIT_ASSERT(accepted(lumiMask, skipped_.runOfSkippedEvent_, skipped_.lumiOfSkippedEvent_));
+    skippedEvents.push_back(skipped_.skippedEventEntry_);
+  }
+  std::reverse(skippedEvents.begin(), skippedEvents.end());
+  CPPUNIT_ASSERT(skippedEvents == expectedEvents);
+  CPPUNIT_ASSERT(iter == indexIntoFile.begin(sortOrder, lumiMask));
+
+  // copyPosition refuses positions at rejected lumis
+  if (sortOrder == IndexIntoFile::numericalOrder) {
+    for (edm::IndexIntoFile::IndexIntoFileItr all = indexIntoFile.begin(sortOrder); all != iterEnd; ++all) {
+      if (all.getEntryType() != kLumi) continue;
+      bool threw = false;
+      try {
+        iter.copyPosition(indexIntoFile.findPosition(all.run(), all.lumi()));
+      } catch (edm::Exception const&) {
+        threw = true;
+      }
+      CPPUNIT_ASSERT(threw != accepted(lumiMask, all.run(), all.lumi()));
+    }
+  }
+
+  // advanceToNextLumiOrRun and skipLumiInRun stop only at accepted lumis
+  for (iter = indexIntoFile.begin(sortOrder, lumiMask); iter != iterEnd; iter.advanceToNextLumiOrRun()) {
+    if (iter.getEntryType() == kLumi) CPPUNIT_ASSERT(accepted(lumiMask, iter.run(), iter.lumi()));
+    edm::IndexIntoFile::IndexIntoFileItr skipper(iter);
+    while (skipper.skipLumiInRun()) {
+      CPPUNIT_ASSERT(accepted(lumiMask, skipper.run(), skipper.peekAheadAtLumi()));
+      CPPUNIT_ASSERT(skipper.run() == iter.run());
+    }
+  }
+}
+
+void TestIndexIntoFile3::fillRandomIndex(edm::IndexIntoFile& indexIntoFile, unsigned int seed) {
+  std::vector<EventNumber_t> events;
+  std::srand(seed);
+  IndexIntoFile::EntryNumber_t lumiEntry = 0;
+  IndexIntoFile::EntryNumber_t runEntry = 0;
+  ProcessHistoryID phids[] = {fakePHID1, fakePHID2};
+  for (int iph = 0; iph < 2; ++iph) {
+    for (RunNumber_t run = 1 + std::rand() % 2; run < 6; ++run) {
+      for (int pass = 0; pass < 2; ++pass) {
+        for (LuminosityBlockNumber_t lumi = 1 + std::rand() % 3; lumi < 12; lumi += 1 + std::rand() % 2) {
+          int nEvents = std::rand() % 4;
+          for (int i = 0; i < nEvents; ++i) {
+            EventNumber_t event = 1 + std::rand() % 100;
+            indexIntoFile.addEntry(phids[iph], run, lumi, event, events.size()); // Event
+            events.push_back(event);
+          }
+          indexIntoFile.addEntry(phids[iph], run, lumi, 0, lumiEntry++); // Lumi
+        }
+      }
+      indexIntoFile.addEntry(phids[iph], run, 0, 0, runEntry++); // Run
+    }
+  }
+  indexIntoFile.sortVector_Run_Or_Lumi_Entries();
+  std::vector<IndexIntoFile::EventEntry>& eventEntries = indexIntoFile.eventEntries();
+  for (size_t i = 0; i < events.size(); ++i) {
+    eventEntries.emplace_back(events[i], i);
+  }
+  indexIntoFile.sortEventEntries();
+}
+
+void TestIndexIntoFile3::testLumiMask() {
+  edm::IndexIntoFile indexIntoFile;
+  fillRandomIndex(indexIntoFile, 3);
+
+  // An empty mask rejects everything
+  std::vector<LuminosityBlockRange> lumiMask;
+  CPPUNIT_ASSERT(indexIntoFile.begin(IndexIntoFile::numericalOrder, lumiMask) ==
+                 indexIntoFile.end(IndexIntoFile::numericalOrder));
+  CPPUNIT_ASSERT(indexIntoFile.begin(IndexIntoFile::firstAppearanceOrder, lumiMask) ==
+                 indexIntoFile.end(IndexIntoFile::firstAppearanceOrder));
+
+  // Everything and nothing in the file
+  lumiMask.push_back(LuminosityBlockRange(1, 1, 10, 0));
+  checkLumiMask(indexIntoFile, IndexIntoFile::numericalOrder, lumiMask);
+  checkLumiMask(indexIntoFile, IndexIntoFile::firstAppearanceOrder, lumiMask);
+  lumiMask[0] = LuminosityBlockRange(7, 1, 8, 0);
+  checkLumiMask(indexIntoFile, IndexIntoFile::numericalOrder, lumiMask);
+  checkLumiMask(indexIntoFile, IndexIntoFile::firstAppearanceOrder, lumiMask);
+
+  // Random masks, dense and sparse, some ranges spanning runs
+  for (int trial = 0; trial < 40; ++trial) {
+    lumiMask.clear();
+    RunNumber_t run = 1;
+    LuminosityBlockNumber_t lumi = 1 + std::rand() % 4;
+    while (run < 6) {
+      RunNumber_t endRun = run + (std::rand() % 8 == 0 ? 1 : 0);
+      LuminosityBlockNumber_t endLumi = endRun == run ? lumi + std::rand() % (1 + trial % 4) : 1 + std::rand() % 4;
+      lumiMask.push_back(LuminosityBlockRange(run, lumi, endRun, endLumi));
+      run = endRun;
+      lumi = endLumi + 1 + std::rand() % (1 + trial % 8);
+      if (lumi > 12) {
+        run += 1 + std::rand() % 2;
+        lumi = 1 + std::rand() % 4;
+      }
+    }
+    sortAndRemoveOverlaps(lumiMask);
+    checkLumiMask(indexIntoFile, IndexIntoFile::numericalOrder, lumiMask);
+    checkLumiMask(indexIntoFile, IndexIntoFile::firstAppearanceOrder, lumiMask);
+  }
+}
+
+void TestIndexIntoFile3::testPartition() {
+  edm::IndexIntoFile indexIntoFile;
+  fillRandomIndex(indexIntoFile, 5);
+
+  IndexIntoFile::SortOrder sortOrders[] = {IndexIntoFile::numericalOrder, IndexIntoFile::firstAppearanceOrder};
+  for (int iOrder = 0; iOrder < 2; ++iOrder) {
+    IndexIntoFile::SortOrder sortOrder = sortOrders[iOrder];
+    std::vector<Visited> all;
+    long long nEvents = 0;
+    for (edm::IndexIntoFile::IndexIntoFileItr iter = indexIntoFile.begin(sortOrder),
+                                              iterEnd = indexIntoFile.end(sortOrder);
+         iter != iterEnd; ++iter) {
+      all.push_back(visit(iter));
+      if (iter.getEntryType() == kEvent) ++nEvents;
+    }
+
+    for (unsigned int nChunks = 1; nChunks < 12; ++nChunks) {
+      std::vector<std::pair<IndexIntoFile::IndexIntoFileItr, IndexIntoFile::IndexIntoFileItr> > chunks;
+      indexIntoFile.partition(sortOrder, nChunks, chunks);
+      CPPUNIT_ASSERT(chunks.size() == nChunks);
+
+      // Concatenated, the chunks visit everything once in the same order,
+      // except that a chunk starting in the middle of a run visits the run again
+      std::vector<Visited> concatenated;
+      long long maxEventsInChunk = 0;
+      Visited lastRun = Visited();
+      for (size_t i = 0; i < chunks.size(); ++i) {
+        CPPUNIT_ASSERT(chunks[i].first.getEntryType() == kRun);
+        bool leadingRuns = true;
+        long long nEventsInChunk = 0;
+        for (edm::IndexIntoFile::IndexIntoFileItr iter = chunks[i].first; iter != chunks[i].second; ++iter) {
+          Visited visited = visit(iter);
+          if (visited.type != kRun) {
+            leadingRuns = false;
+          } else if (leadingRuns && i > 0 && visited.phIndex == lastRun.phIndex && visited.run == lastRun.run) {
+            continue;
+          } else {
+            lastRun = visited;
+          }
+          if (visited.type == kEvent) ++nEventsInChunk;
+          concatenated.push_back(visited);
+        }
+        CPPUNIT_ASSERT(nEventsInChunk > 0);
+        if (nEventsInChunk > maxEventsInChunk) maxEventsInChunk = nEventsInChunk;
+      }
+      CPPUNIT_ASSERT(concatenated == all);
+      CPPUNIT_ASSERT(maxEventsInChunk <= nEvents / nChunks + 12);
+    }
+
+    // More chunks than lumis with events
+    std::vector<std::pair<IndexIntoFile::IndexIntoFileItr, IndexIntoFile::IndexIntoFileItr> > chunks;
+    indexIntoFile.partition(sortOrder, 100000, chunks);
+    long long nEventsInChunks = 0;
+    for (size_t i = 0; i < chunks.size(); ++i) {
+      long long nEventsInChunk = 0;
+      for (edm::IndexIntoFile::IndexIntoFileItr iter = chunks[i].first; iter != chunks[i].second; ++iter) {
+        if (iter.getEntryType() == kEvent) ++nEventsInChunk;
+      }
+      CPPUNIT_ASSERT(nEventsInChunk > 0);
+      nEventsInChunks += nEventsInChunk;
+    }
+    CPPUNIT_ASSERT(chunks.size() < 100000U);
+    CPPUNIT_ASSERT(nEventsInChunks == nEvents);
+  }
+
+  // A file without events is a single chunk
+  edm::IndexIntoFile noEvents;
+  noEvents.addEntry(fakePHID1, 1, 1, 0, 0); // Lumi
+  noEvents.addEntry(fakePHID1, 1, 2, 0, 1); // Lumi
+  noEvents.addEntry(fakePHID1, 1, 0, 0, 0); // Run
+  noEvents.sortVector_Run_Or_Lumi_Entries();
+  std::vector<std::pair<IndexIntoFile::IndexIntoFileItr, IndexIntoFile::IndexIntoFileItr> > chunks;
+  noEvents.partition(IndexIntoFile::numericalOrder, 4, chunks);
+  CPPUNIT_ASSERT(chunks.size() == 1);
+  CPPUNIT_ASSERT(chunks[0].first == noEvents.begin(IndexIntoFile::numericalOrder));
+  CPPUNIT_ASSERT(chunks[0].second == noEvents.end(IndexIntoFile::numericalOrder));
+
+  // So is an empty file, in either order
+  edm::IndexIntoFile emptyIndex;
+  for (int iOrder = 0; iOrder < 2; ++iOrder) {
+    chunks.clear();
+    emptyIndex.partition(sortOrders[iOrder], 4, chunks);
+    CPPUNIT_ASSERT(chunks.size() == 1);
+    CPPUNIT_ASSERT(chunks[0].first == emptyIndex.begin(sortOrders[iOrder]));
+    CPPUNIT_ASSERT(chunks[0].second == emptyIndex.end(sortOrders[iOrder]));
+    CPPUNIT_ASSERT(chunks[0].first == chunks[0].second);
+  }
+  chunks.clear();
+  emptyIndex.partition(IndexIntoFile::numericalOrder, 0, chunks);
+  CPPUNIT_ASSERT(chunks.empty());
+}
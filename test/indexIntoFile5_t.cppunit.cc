@@ -14,6 +14,8 @@
 #include "DataFormats/Provenance/interface/IndexIntoFile.h"
 #undef private
 
+#include <algorithm>
+#include <cstdlib>
 #include <string>
 #include <iostream>
 #include <memory>
@@ -24,6 +26,10 @@ class TestIndexIntoFile5: public CppUnit::TestFixture
 {
   CPPUNIT_TEST_SUITE(TestIndexIntoFile5);  
   CPPUNIT_TEST(testDuplicateCheckerFunctions);
+  CPPUNIT_TEST(testConcurrentFill);
+  CPPUNIT_TEST(testIntersectionVector);
+  CPPUNIT_TEST(testHashDuplicateCheck);
+  CPPUNIT_TEST(testStatistics);
   CPPUNIT_TEST_SUITE_END();
   
 public:
@@ -77,6 +83,10 @@ public:
   void tearDown() { }
 
   void testDuplicateCheckerFunctions();
+  void testConcurrentFill();
+  void testIntersectionVector();
+  void testHashDuplicateCheck();
+  void testStatistics();
 
   ProcessHistoryID nullPHID;
   ProcessHistoryID fakePHID1;
@@ -104,11 +114,26 @@ public:
   private:
     std::vector<EventNumber_t> testData_;
   };
+
+  // Keeps the statistics reported each time memory is about to be freed
+  class TestStatisticsHook : public IndexIntoFile::StatisticsHook {
+  public:
+    virtual void beforeRelease(IndexIntoFile const&, IndexIntoFile::Statistics const& statistics) {
+      reports_.push_back(statistics);
+    }
+    std::vector<IndexIntoFile::Statistics> reports_;
+  };
 };
 
 ///registration of the test so that the runner can find it
 CPPUNIT_TEST_SUITE_REGISTRATION(TestIndexIntoFile5);
 
+namespace {
+  bool keysEqual(IndexIntoFile::IndexRunLumiEventKey const& left, IndexIntoFile::IndexRunLumiEventKey const& right) {
+    return !(left < right) && !(right < left);
+  }
+}
+
 void TestIndexIntoFile5::check(edm::IndexIntoFile::IndexIntoFileItr const& iter,
                               IndexIntoFile::EntryType type,
                               int indexToRun,
@@ -196,7 +221,7 @@ void TestIndexIntoFile5::testDuplicateCheckerFunctions() {
   CPPUNIT_ASSERT(relevantPreviousEvents.empty());
 
 
-  for (int j = 0; j < 2; ++j) {
+  for (int j = 0; j < 4; ++j) {
     edm::IndexIntoFile indexIntoFile11;
     indexIntoFile11.addEntry(fakePHID1, 6, 2, 0, 0); // Lumi
     indexIntoFile11.addEntry(fakePHID1, 6, 3, 0, 1); // Lumi
@@ -297,11 +322,32 @@ void TestIndexIntoFile5::testDuplicateCheckerFunctions() {
       indexIntoFile12.fillEventNumbers();
       indexIntoFile22.fillEventNumbers();
     }
-    else {
+    else if (j == 1) {
       indexIntoFile11.fillEventEntries();
       indexIntoFile12.fillEventEntries();
       indexIntoFile22.fillEventEntries();
     }
+    else if (j == 2) {
+      indexIntoFile11.compressEventNumbers();
+      indexIntoFile12.compressEventNumbers();
+      indexIntoFile22.compressEventNumbers();
+      CPPUNIT_ASSERT(indexIntoFile12.eventNumbers().empty());
+      CPPUNIT_ASSERT(indexIntoFile12.compressedEventNumbers().size() == 8);
+      CPPUNIT_ASSERT(indexIntoFile12.containsItem(7, 1, 11));
+      CPPUNIT_ASSERT(indexIntoFile12.containsItem(7, 0, 6));
+      CPPUNIT_ASSERT(!indexIntoFile12.containsItem(7, 1, 5));
+      CPPUNIT_ASSERT(!indexIntoFile12.containsItem(7, 0, 12));
+    }
+
+    CPPUNIT_ASSERT(!indexIntoFile11.containsDuplicateEvents(IndexIntoFile::hashDuplicateCheck));
+    CPPUNIT_ASSERT(indexIntoFile12.containsDuplicateEvents(IndexIntoFile::hashDuplicateCheck));
+    CPPUNIT_ASSERT(indexIntoFile22.containsDuplicateEvents(IndexIntoFile::hashDuplicateCheck));
+    if (j == 3) {
+      // The hash check only uses the unsorted event numbers
+      CPPUNIT_ASSERT(!indexIntoFile12.hasEventNumbers());
+      CPPUNIT_ASSERT(indexIntoFile12.eventEntries().empty());
+      CPPUNIT_ASSERT(indexIntoFile12.unsortedEventNumbers().size() == 8);
+    }
 
     CPPUNIT_ASSERT(!indexIntoFile11.containsDuplicateEvents());
     CPPUNIT_ASSERT(indexIntoFile12.containsDuplicateEvents());
@@ -335,3 +381,271 @@ void TestIndexIntoFile5::testDuplicateCheckerFunctions() {
     
   }
 }
+
+void TestIndexIntoFile5::testConcurrentFill() {
+  // Several runs, each lumi appearing twice so that lumis have more than
+  // one event range, random lumi sizes and duplicate event numbers.
+  edm::IndexIntoFile indexIntoFile;
+  TestEventFinder* ptr(new TestEventFinder);
+  boost::shared_ptr<IndexIntoFile::EventFinder> shptr(ptr);
+  std::srand(7);
+  IndexIntoFile::EntryNumber_t eventEntry = 0;
+  IndexIntoFile::EntryNumber_t lumiEntry = 0;
+  IndexIntoFile::EntryNumber_t runEntry = 0;
+  for (RunNumber_t run = 1; run < 4; ++run) {
+    for (int pass = 0; pass < 2; ++pass) {
+      for (LuminosityBlockNumber_t lumi = 1; lumi < 30; ++lumi) {
+        int nEvents = std::rand() % 60;
+        for (int i = 0; i < nEvents; ++i) {
+          EventNumber_t event = 1 + std::rand() % 1000;
+          indexIntoFile.addEntry(fakePHID1, run, lumi, event, eventEntry++); // Event
+          ptr->push_back(event);
+        }
+        indexIntoFile.addEntry(fakePHID1, run, lumi, 0, lumiEntry++); // Lumi
+      }
+    }
+    indexIntoFile.addEntry(fakePHID1, run, 0, 0, runEntry++); // Run
+  }
+  indexIntoFile.sortVector_Run_Or_Lumi_Entries();
+  indexIntoFile.setEventFinder(shptr);
+  indexIntoFile.fillEventNumbersOrEntries(true, true);
+
+  std::vector<EventNumber_t> serialNumbers = indexIntoFile.eventNumbers();
+  std::vector<IndexIntoFile::EventEntry> serialEntries = indexIntoFile.eventEntries();
+  CPPUNIT_ASSERT(serialNumbers.size() == static_cast<size_t>(eventEntry));
+
+  for (unsigned int nChunks = 2; nChunks < 9; nChunks += 3) {
+    indexIntoFile.eventNumbers().assign(serialNumbers.size(), IndexIntoFile::invalidEvent);
+    indexIntoFile.eventEntries().assign(serialEntries.size(), IndexIntoFile::EventEntry());
+    indexIntoFile.fillEventNumbersOrEntriesConcurrently(true, true, nChunks);
+    CPPUNIT_ASSERT(indexIntoFile.eventNumbers() == serialNumbers);
+    CPPUNIT_ASSERT(indexIntoFile.eventEntries().size() == serialEntries.size());
+    for (size_t i = 0; i < serialEntries.size(); ++i) {
+      CPPUNIT_ASSERT(indexIntoFile.eventEntries()[i].event() == serialEntries[i].event());
+      CPPUNIT_ASSERT(indexIntoFile.eventEntries()[i].entry() == serialEntries[i].entry());
+    }
+
+    indexIntoFile.eventEntries().clear();
+    indexIntoFile.fillEventEntries();
+    CPPUNIT_ASSERT(indexIntoFile.eventEntries().size() == serialEntries.size());
+    for (size_t i = 0; i < serialEntries.size(); ++i) {
+      CPPUNIT_ASSERT(indexIntoFile.eventEntries()[i].entry() == serialEntries[i].entry());
+    }
+  }
+
+  // Lumis without events. Lumi 2 comes directly before a lumi with
+  // events and, with 2 chunks, lumi 4 is where the second chunk
+  // starts. The events of each lumi are written in descending order.
+  int const lumiSizes[] = { 10, 0, 10, 0, 10, 10, 0 };
+  edm::IndexIntoFile emptyLumis;
+  TestEventFinder* emptyLumisPtr(new TestEventFinder);
+  boost::shared_ptr<IndexIntoFile::EventFinder> emptyLumisShptr(emptyLumisPtr);
+  std::vector<EventNumber_t> expectedNumbers;
+  eventEntry = 0;
+  for (LuminosityBlockNumber_t lumi = 1; lumi <= 7; ++lumi) {
+    for (int i = lumiSizes[lumi - 1]; i > 0; --i) {
+      EventNumber_t event = lumi * 100 + i;
+      emptyLumis.addEntry(fakePHID1, 1, lumi, event, eventEntry++); // Event
+      emptyLumisPtr->push_back(event);
+    }
+    for (int i = 1; i <= lumiSizes[lumi - 1]; ++i) {
+      expectedNumbers.push_back(lumi * 100 + i);
+    }
+    emptyLumis.addEntry(fakePHID1, 1, lumi, 0, lumi - 1); // Lumi
+  }
+  emptyLumis.addEntry(fakePHID1, 1, 0, 0, 0); // Run
+  emptyLumis.sortVector_Run_Or_Lumi_Entries();
+  emptyLumis.setEventFinder(emptyLumisShptr);
+  emptyLumis.fillEventNumbersOrEntries(true, true);
+  CPPUNIT_ASSERT(emptyLumis.eventNumbers() == expectedNumbers);
+  serialEntries = emptyLumis.eventEntries();
+
+  for (unsigned int nChunks = 2; nChunks < 5; ++nChunks) {
+    emptyLumis.eventNumbers().assign(expectedNumbers.size(), IndexIntoFile::invalidEvent);
+    emptyLumis.eventEntries().assign(serialEntries.size(), IndexIntoFile::EventEntry());
+    emptyLumis.fillEventNumbersOrEntriesConcurrently(true, true, nChunks);
+    CPPUNIT_ASSERT(emptyLumis.eventNumbers() == expectedNumbers);
+    CPPUNIT_ASSERT(emptyLumis.eventEntries().size() == serialEntries.size());
+    for (size_t i = 0; i < serialEntries.size(); ++i) {
+      CPPUNIT_ASSERT(emptyLumis.eventEntries()[i].event() == serialEntries[i].event());
+      CPPUNIT_ASSERT(emptyLumis.eventEntries()[i].entry() == serialEntries[i].entry());
+    }
+  }
+
+  // Empty ranges, including one at the end of the event numbers
+  long long const nEvents = static_cast<long long>(expectedNumbers.size());
+  std::vector<EventNumber_t> buffer;
+  CPPUNIT_ASSERT(emptyLumis.eventNumbersInRange(nEvents, nEvents, buffer) == emptyLumis.eventNumbers().data() + nEvents);
+  CPPUNIT_ASSERT(emptyLumis.eventNumbersInRange(10, 10, buffer) == emptyLumis.eventNumbers().data() + 10);
+  emptyLumis.compressEventNumbers();
+  emptyLumis.eventNumbersInRange(nEvents, nEvents, buffer);
+  CPPUNIT_ASSERT(buffer.empty());
+  CPPUNIT_ASSERT(*emptyLumis.eventNumbersInRange(nEvents - 1, nEvents, buffer) == expectedNumbers.back());
+}
+
+void TestIndexIntoFile5::testIntersectionVector() {
+  // Two files with overlapping runs and lumis, lumis appearing
+  // twice and event numbers repeated within each lumi.
+  edm::IndexIntoFile indexIntoFile[2];
+  for (unsigned int file = 0; file < 2; ++file) {
+    TestEventFinder* ptr(new TestEventFinder);
+    boost::shared_ptr<IndexIntoFile::EventFinder> shptr(ptr);
+    std::srand(21 + file);
+    IndexIntoFile::EntryNumber_t eventEntry = 0;
+    IndexIntoFile::EntryNumber_t lumiEntry = 0;
+    IndexIntoFile::EntryNumber_t runEntry = 0;
+    for (RunNumber_t run = 1 + file; run < 5 + file; ++run) {
+      for (int pass = 0; pass < 2; ++pass) {
+        for (LuminosityBlockNumber_t lumi = 1 + file; lumi < 20; lumi += 1 + file) {
+          int nEvents = std::rand() % 40;
+          for (int i = 0; i < nEvents; ++i) {
+            EventNumber_t event = 1 + std::rand() % 100;
+            indexIntoFile[file].addEntry(fakePHID1, run, lumi, event, eventEntry++); // Event
+            ptr->push_back(event);
+          }
+          indexIntoFile[file].addEntry(fakePHID1, run, lumi, 0, lumiEntry++); // Lumi
+        }
+      }
+      indexIntoFile[file].addEntry(fakePHID1, run, 0, 0, runEntry++); // Run
+    }
+    indexIntoFile[file].sortVector_Run_Or_Lumi_Entries();
+    indexIntoFile[file].setNumberOfEvents(eventEntry);
+    indexIntoFile[file].setEventFinder(shptr);
+  }
+
+  std::set<IndexIntoFile::IndexRunLumiEventKey> expected;
+  indexIntoFile[0].set_intersection(indexIntoFile[1], expected);
+  CPPUNIT_ASSERT(!expected.empty());
+
+  // Event numbers, event entries and compressed event numbers,
+  // each serially and with several threads
+  for (int j = 0; j < 3; ++j) {
+    if (j == 1) {
+      indexIntoFile[0].fillEventEntries();
+      indexIntoFile[1].fillEventEntries();
+    } else if (j == 2) {
+      indexIntoFile[0].eventEntries().clear();
+      indexIntoFile[0].compressEventNumbers();
+    }
+    for (unsigned int nThreads = 0; nThreads < 8; nThreads += 3) {
+      std::vector<IndexIntoFile::IndexRunLumiEventKey> intersection;
+      indexIntoFile[0].set_intersection(indexIntoFile[1], intersection, nThreads);
+      CPPUNIT_ASSERT(intersection.size() == expected.size());
+      CPPUNIT_ASSERT(std::equal(intersection.begin(), intersection.end(), expected.begin(), keysEqual));
+    }
+  }
+
+  // Appends to what is already there
+  std::vector<IndexIntoFile::IndexRunLumiEventKey> intersection(1, *expected.begin());
+  indexIntoFile[1].set_intersection(indexIntoFile[0], intersection);
+  CPPUNIT_ASSERT(intersection.size() == expected.size() + 1);
+}
+
+void TestIndexIntoFile5::testHashDuplicateCheck() {
+  // Large lumis, each appearing twice, with distinct event numbers
+  // spread over both appearances. Then the same with one duplicate
+  // placed in the last lumi, once in each appearance.
+  for (int duplicate = 0; duplicate < 2; ++duplicate) {
+    edm::IndexIntoFile indexIntoFile;
+    TestEventFinder* ptr(new TestEventFinder);
+    boost::shared_ptr<IndexIntoFile::EventFinder> shptr(ptr);
+    IndexIntoFile::EntryNumber_t eventEntry = 0;
+    IndexIntoFile::EntryNumber_t lumiEntry = 0;
+    for (int pass = 0; pass < 2; ++pass) {
+      for (LuminosityBlockNumber_t lumi = 1; lumi < 6; ++lumi) {
+        for (EventNumber_t i = 0; i < 500U * lumi; ++i) {
+          EventNumber_t event = 2 * (i * 7919U % 5000U) + pass + 1;
+          if (duplicate && lumi == 5 && i == 499) event = 1000;
+          indexIntoFile.addEntry(fakePHID1, 1, lumi, event, eventEntry++); // Event
+          ptr->push_back(event);
+        }
+        indexIntoFile.addEntry(fakePHID1, 1, lumi, 0, lumiEntry++); // Lumi
+      }
+    }
+    indexIntoFile.addEntry(fakePHID1, 1, 0, 0, 0); // Run
+    indexIntoFile.sortVector_Run_Or_Lumi_Entries();
+    indexIntoFile.setNumberOfEvents(eventEntry);
+    indexIntoFile.setEventFinder(shptr);
+
+    CPPUNIT_ASSERT(indexIntoFile.containsDuplicateEvents(IndexIntoFile::hashDuplicateCheck) == (duplicate == 1));
+    CPPUNIT_ASSERT(!indexIntoFile.hasEventNumbers());
+    CPPUNIT_ASSERT(indexIntoFile.containsDuplicateEvents() == (duplicate == 1));
+  }
+}
+
+void TestIndexIntoFile5::testStatistics() {
+  edm::IndexIntoFile indexIntoFile;
+  IndexIntoFile::Statistics statistics = indexIntoFile.statistics();
+  CPPUNIT_ASSERT(statistics.totalBytes() == 0U);
+  CPPUNIT_ASSERT(statistics.runOrLumiIndexes_.fills_ == 0U);
+
+  TestEventFinder* ptr(new TestEventFinder);
+  boost::shared_ptr<IndexIntoFile::EventFinder> shptr(ptr);
+  IndexIntoFile::EntryNumber_t eventEntry = 0;
+  for (LuminosityBlockNumber_t lumi = 1; lumi < 4; ++lumi) {
+    for (EventNumber_t event = 100; event > 0; --event) {
+      indexIntoFile.addEntry(fakePHID1, 1, lumi, event, eventEntry++); // Event
+      ptr->push_back(event);
+    }
+    indexIntoFile.addEntry(fakePHID1, 1, lumi, 0, lumi - 1); // Lumi
+  }
+  indexIntoFile.addEntry(fakePHID1, 1, 0, 0, 0); // Run
+  indexIntoFile.sortVector_Run_Or_Lumi_Entries();
+  indexIntoFile.setNumberOfEvents(eventEntry);
+  indexIntoFile.setEventFinder(shptr);
+  boost::shared_ptr<TestStatisticsHook> hook(new TestStatisticsHook);
+  indexIntoFile.setStatisticsHook(hook);
+
+  indexIntoFile.fillEventNumbersOrEntries(true, true);
+  indexIntoFile.fillEventNumbersOrEntries(true, true); // Already filled, not counted
+  statistics = indexIntoFile.statistics();
+  CPPUNIT_ASSERT(statistics.runOrLumiIndexes_.fills_ == 1U);
+  CPPUNIT_ASSERT(statistics.runOrLumiIndexes_.elements_ == 4U);
+  CPPUNIT_ASSERT(statistics.runOrLumiIndexes_.bytes_ >= 4U * sizeof(IndexIntoFile::RunOrLumiIndexes));
+  CPPUNIT_ASSERT(statistics.unsortedEventNumbers_.fills_ == 1U);
+  CPPUNIT_ASSERT(statistics.unsortedEventNumbers_.elements_ == 300U);
+  CPPUNIT_ASSERT(statistics.eventNumbers_.fills_ == 1U);
+  CPPUNIT_ASSERT(statistics.eventNumbers_.elements_ == 300U);
+  CPPUNIT_ASSERT(statistics.eventNumbers_.bytes_ >= 300U * sizeof(EventNumber_t));
+  CPPUNIT_ASSERT(statistics.eventEntries_.fills_ == 1U);
+  CPPUNIT_ASSERT(statistics.eventEntries_.elements_ == 300U);
+  CPPUNIT_ASSERT(statistics.eventEntries_.fillSeconds_ >= 0.0);
+  CPPUNIT_ASSERT(statistics.eventEntries_.fillSeconds_ == statistics.eventNumbers_.fillSeconds_);
+  CPPUNIT_ASSERT(statistics.compressedEventNumbers_.fills_ == 0U);
+  CPPUNIT_ASSERT(statistics.eventFilter_.bytes_ == 0U);
+  CPPUNIT_ASSERT(statistics.totalBytes() >= 300U * (2 * sizeof(EventNumber_t) + sizeof(IndexIntoFile::EventEntry)));
+
+  indexIntoFile.fillEventFilter();
+  indexIntoFile.fillEventSearchIndex(50);
+  statistics = indexIntoFile.statistics();
+  CPPUNIT_ASSERT(statistics.eventFilter_.fills_ == 1U);
+  CPPUNIT_ASSERT(statistics.eventFilter_.bytes_ > 0U);
+  CPPUNIT_ASSERT(statistics.eventSearchIndex_.fills_ == 1U);
+  CPPUNIT_ASSERT(statistics.eventSearchIndex_.elements_ == 3U * 16U);
+
+  indexIntoFile.doneFileInitialization();
+  CPPUNIT_ASSERT(hook->reports_.size() == 1U);
+  CPPUNIT_ASSERT(hook->reports_[0].unsortedEventNumbers_.elements_ == 300U);
+  CPPUNIT_ASSERT(indexIntoFile.statistics().unsortedEventNumbers_.bytes_ == 0U);
+
+  indexIntoFile.compressEventNumbers();
+  indexIntoFile.inputFileClosed();
+  CPPUNIT_ASSERT(hook->reports_.size() == 2U);
+  CPPUNIT_ASSERT(hook->reports_[1].eventEntries_.elements_ == 300U);
+  CPPUNIT_ASSERT(hook->reports_[1].compressedEventNumbers_.fills_ == 1U);
+  CPPUNIT_ASSERT(hook->reports_[1].compressedEventNumbers_.elements_ == 300U);
+  statistics = indexIntoFile.statistics();
+  CPPUNIT_ASSERT(statistics.eventEntries_.bytes_ == 0U);
+  CPPUNIT_ASSERT(statistics.runOrLumiIndexes_.bytes_ == 0U);
+  CPPUNIT_ASSERT(statistics.eventNumbers_.bytes_ == 0U);
+  CPPUNIT_ASSERT(statistics.compressedEventNumbers_.bytes_ > 0U);
+  // The fill counts and times are kept until the transients are reset
+  CPPUNIT_ASSERT(statistics.eventEntries_.fills_ == 1U);
+
+  indexIntoFile.initializeTransients();
+  statistics = indexIntoFile.statistics();
+  CPPUNIT_ASSERT(statistics.totalBytes() == 0U);
+  CPPUNIT_ASSERT(statistics.eventEntries_.fills_ == 0U);
+  indexIntoFile.inputFileClosed();
+  CPPUNIT_ASSERT(hook->reports_.size() == 2U);
+}
@@ -0,0 +1,141 @@
+#include "DataFormats/Provenance/interface/IndexIntoFile.h"
+#include "DataFormats/Provenance/interface/ProcessHistoryID.h"
+#include "FWCore/Utilities/interface/CPUTimer.h"
+
+#include "boost/shared_ptr.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+// This program times how IndexIntoFile gets the event numbers from an
+// EventFinder. The event numbers are held in memory, so what is measured
+// is the overhead of one virtual call per entry compared with requesting
+// them in chunks with getEventNumbersOfEntries. A real source also saves
+// the per entry ROOT read overhead, which is not included here.
+
+// Just running the program prints the timing info to std::cout.
+// An optional argument sets the number of events (default 20000000).
+
+using namespace edm;
+
+namespace edmtestindex {
+
+  // Only implements the per entry interface, so the
+  // default getEventNumbersOfEntries loops over entries.
+  class PerEntryEventFinder : public IndexIntoFile::EventFinder {
+  public:
+    explicit PerEntryEventFinder(std::vector<EventNumber_t> const& events) : events_(events) {}
+    virtual EventNumber_t getEventNumberOfEntry(IndexIntoFile::EntryNumber_t entry) const {
+      return events_[entry];
+    }
+  private:
+    std::vector<EventNumber_t> const& events_;
+  };
+
+  // Also implements the bulk interface as a source with a
+  // pre-extracted event number column would.
+  class BulkEventFinder : public PerEntryEventFinder {
+  public:
+    explicit BulkEventFinder(std::vector<EventNumber_t> const& events) : PerEntryEventFinder(events), events_(events) {}
+    virtual void getEventNumbersOfEntries(IndexIntoFile::EntryNumber_t begin,
+                                          IndexIntoFile::EntryNumber_t end,
+                                          EventNumber_t* out) const {
+      std::copy(events_.begin() + begin, events_.begin() + end, out);
+    }
+  private:
+    std::vector<EventNumber_t> const& events_;
+  };
+
+  unsigned int const nEventsPerLumi = 2000;
+
+  void fillIndex(IndexIntoFile& indexIntoFile, std::vector<EventNumber_t> const& events) {
+    ProcessHistoryID phid;
+    IndexIntoFile::EntryNumber_t lumiEntry = 0;
+    LuminosityBlockNumber_t lumi = 1;
+    for(std::vector<EventNumber_t>::size_type i = 0; i < events.size(); ++i) {
+      indexIntoFile.addEntry(phid, 1, lumi, events[i], i);
+      if((i + 1) % nEventsPerLumi == 0 || i + 1 == events.size()) {
+        indexIntoFile.addEntry(phid, 1, lumi, 0, lumiEntry++);
+        ++lumi;
+      }
+    }
+    indexIntoFile.addEntry(phid, 1, 0, 0, 0);
+    indexIntoFile.sortVector_Run_Or_Lumi_Entries();
+    indexIntoFile.setNumberOfEvents(events.size());
+  }
+}
+
+using namespace edmtestindex;
+
+int main(int argc, char* argv[]) {
+
+  std::vector<EventNumber_t>::size_type nEvents = 20000000;
+  if(argc > 1) nEvents = std::atol(argv[1]);
+
+  // Events in each lumi are in random order, as in a merged file
+  std::vector<EventNumber_t> events(nEvents);
+  std::srand(1);
+  for(std::vector<EventNumber_t>::size_type i = 0; i < nEvents; ++i) {
+    events[i] = 1 + (i / nEventsPerLumi) * nEventsPerLumi + std::rand() % nEventsPerLumi;
+  }
+
+  PerEntryEventFinder perEntry(events);
+  BulkEventFinder bulk(events);
+  IndexIntoFile::EventFinder const& perEntryBase = perEntry;
+  IndexIntoFile::EventFinder const& bulkBase = bulk;
+
+  std::vector<EventNumber_t> out(nEvents);
+  unsigned long long sum = 0;
+  edm::CPUTimer timer;
+
+  timer.start();
+  for(std::vector<EventNumber_t>::size_type i = 0; i < nEvents; ++i) {
+    out[i] = perEntryBase.getEventNumberOfEntry(i);
+  }
+  timer.stop();
+  sum += out[nEvents / 2];
+  std::cout << "getEventNumberOfEntry per entry: real " << timer.realTime() << " cpu " << timer.cpuTime() << std::endl;
+  timer.reset();
+
+  IndexIntoFile::EntryNumber_t const chunk = IndexIntoFile::eventNumbersChunkSize;
+  IndexIntoFile::EntryNumber_t const n = nEvents;
+
+  timer.start();
+  for(IndexIntoFile::EntryNumber_t begin = 0; begin < n; begin += chunk) {
+    perEntryBase.getEventNumbersOfEntries(begin, std::min(begin + chunk, n), &out[begin]);
+  }
+  timer.stop();
+  sum += out[nEvents / 2];
+  std::cout << "getEventNumbersOfEntries default: real " << timer.realTime() << " cpu " << timer.cpuTime() << std::endl;
+  timer.reset();
+
+  timer.start();
+  for(IndexIntoFile::EntryNumber_t begin = 0; begin < n; begin += chunk) {
+    bulkBase.getEventNumbersOfEntries(begin, std::min(begin + chunk, n), &out[begin]);
+  }
+  timer.stop();
+  sum += out[nEvents / 2];
+  std::cout << "getEventNumbersOfEntries bulk: real " << timer.realTime() << " cpu " << timer.cpuTime() << std::endl;
+  timer.reset();
+
+  // The complete fill, including the per lumi sort
+  for(int i = 0; i < 2; ++i) {
+    IndexIntoFile indexIntoFile;
+    fillIndex(indexIntoFile, events);
+    if(i == 0) {
+      indexIntoFile.setEventFinder(boost::shared_ptr<IndexIntoFile::EventFinder>(new PerEntryEventFinder(events)));
+    } else {
+      indexIntoFile.setEventFinder(boost::shared_ptr<IndexIntoFile::EventFinder>(new BulkEventFinder(events)));
+    }
+    timer.start();
+    indexIntoFile.fillEventNumbers();
+    timer.stop();
+    sum += indexIntoFile.containsEvent(1, 1, events[0]);
+    std::cout << (i == 0 ? "fillEventNumbers per entry finder" : "fillEventNumbers bulk finder")
+              << ": real " << timer.realTime() << " cpu " << timer.cpuTime() << std::endl;
+    timer.reset();
+  }
+  return sum == 0;
+}
@@ -0,0 +1,134 @@
+#include "DataFormats/Provenance/interface/IndexIntoFile.h"
+#include "DataFormats/Provenance/interface/ProcessHistoryID.h"
+#include "FWCore/Utilities/interface/CPUTimer.h"
+
+#include "boost/shared_ptr.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <set>
+#include <thread>
+#include <vector>
+
+// This program times IndexIntoFile::set_intersection for two files
+// which contain the same events, the worst case for the duplicate
+// checking across files. It compares inserting into the std::set with
+// appending to a reserved vector, in one chunk and in several chunks
+// run as concurrent tasks, and reports the peak heap memory allocated
+// by each call.
+
+// Just running the program prints the timing info to std::cout.
+// An optional argument sets the number of events (default 5000000).
+
+using namespace edm;
+
+namespace edmtestindex {
+
+  // Tracks the heap memory in use and its peak
+  std::atomic<std::size_t> bytesInUse(0);
+  std::atomic<std::size_t> peakBytes(0);
+
+  void resetPeak() {peakBytes.store(bytesInUse.load());}
+
+  class VectorEventFinder : public IndexIntoFile::EventFinder {
+  public:
+    explicit VectorEventFinder(std::vector<EventNumber_t> const& events) : events_(events) {}
+    virtual EventNumber_t getEventNumberOfEntry(IndexIntoFile::EntryNumber_t entry) const {
+      return events_[entry];
+    }
+  private:
+    std::vector<EventNumber_t> const& events_;
+  };
+
+  unsigned int const nEventsPerLumi = 1000;
+
+  void fillIndex(IndexIntoFile& indexIntoFile, std::vector<EventNumber_t> const& events) {
+    ProcessHistoryID phid;
+    IndexIntoFile::EntryNumber_t lumiEntry = 0;
+    LuminosityBlockNumber_t lumi = 1;
+    for(std::vector<EventNumber_t>::size_type i = 0; i < events.size(); ++i) {
+      indexIntoFile.addEntry(phid, 1, lumi, events[i], i);
+      if((i + 1) % nEventsPerLumi == 0 || i + 1 == events.size()) {
+        indexIntoFile.addEntry(phid, 1, lumi, 0, lumiEntry++);
+        ++lumi;
+      }
+    }
+    indexIntoFile.addEntry(phid, 1, 0, 0, 0);
+    indexIntoFile.sortVector_Run_Or_Lumi_Entries();
+    indexIntoFile.setNumberOfEvents(events.size());
+    indexIntoFile.setEventFinder(boost::shared_ptr<IndexIntoFile::EventFinder>(new VectorEventFinder(events)));
+    indexIntoFile.fillEventNumbers();
+  }
+}
+
+void* operator new(std::size_t size) {
+  std::size_t* p = static_cast<std::size_t*>(std::malloc(size + sizeof(std::size_t)));
+  if(p == 0) throw std::bad_alloc();
+  *p = size;
+  std::size_t inUse = edmtestindex::bytesInUse += size;
+  std::size_t peak = edmtestindex::peakBytes;
+  while(inUse > peak && !edmtestindex::peakBytes.compare_exchange_weak(peak, inUse)) {}
+  return p + 1;
+}
+
+void operator delete(void* ptr) noexcept {
+  if(ptr == 0) return;
+  std::size_t* p = static_cast<std::size_t*>(ptr) - 1;
+  edmtestindex::bytesInUse -= *p;
+  std::free(p);
+}
+
+using namespace edmtestindex;
+
+int main(int argc, char* argv[]) {
+
+  std::vector<EventNumber_t>::size_type nEvents = 5000000;
+  if(argc > 1) nEvents = std::atol(argv[1]);
+
+  std::vector<EventNumber_t> events(nEvents);
+  for(std::vector<EventNumber_t>::size_type i = 0; i < nEvents; ++i) {
+    events[i] = i + 1;
+  }
+
+  IndexIntoFile indexIntoFile1;
+  IndexIntoFile indexIntoFile2;
+  fillIndex(indexIntoFile1, events);
+  fillIndex(indexIntoFile2, events);
+
+  edm::CPUTimer timer;
+  std::size_t sum = 0;
+
+  {
+    std::size_t before = bytesInUse;
+    resetPeak();
+    timer.start();
+    std::set<IndexIntoFile::IndexRunLumiEventKey> intersection;
+    indexIntoFile1.set_intersection(indexIntoFile2, intersection);
+    timer.stop();
+    sum += intersection.size();
+    std::cout << "std::set: keys " << intersection.size()
+              << " real " << timer.realTime() << " cpu " << timer.cpuTime()
+              << " peak memory " << (peakBytes - before) / 1000000.0 << " MB" << std::endl;
+    timer.reset();
+  }
+
+  unsigned int nChunks = std::thread::hardware_concurrency();
+  if(nChunks < 2) nChunks = 2;
+  for(int i = 0; i < 2; ++i) {
+    std::size_t before = bytesInUse;
+    resetPeak();
+    timer.start();
+    std::vector<IndexIntoFile::IndexRunLumiEventKey> intersection;
+    intersection.reserve(nEvents);
+    indexIntoFile1.set_intersection(indexIntoFile2, intersection, i == 0 ? 1 : nChunks);
+    timer.stop();
+    sum += intersection.size();
+    std::cout << "reserved std::vector, " << (i == 0 ? 1 : nChunks) << " chunks: keys " << intersection.size()
+              << " real " << timer.realTime() << " cpu " << timer.cpuTime()
+              << " peak memory " << (peakBytes - before) / 1000000.0 << " MB" << std::endl;
+    timer.reset();
+  }
+  return sum == 0;
+}
@@ -0,0 +1,99 @@
+#include "DataFormats/Provenance/interface/IndexIntoFile.h"
+#include "DataFormats/Provenance/interface/ProcessHistoryID.h"
+#include "FWCore/Utilities/interface/CPUTimer.h"
+
+#include "boost/shared_ptr.hpp"
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+// This program times iteration with IndexIntoFileItr over a synthetic
+// IndexIntoFile in both sort orders. For every event it does what
+// the input source does: copy the iterator, read the run, lumi and
+// entry, then advance it.
+
+// Just running the program prints the timing info to std::cout.
+// An optional argument sets the number of events (default 10000000).
+
+using namespace edm;
+
+namespace edmtestindex {
+
+  class VectorEventFinder : public IndexIntoFile::EventFinder {
+  public:
+    explicit VectorEventFinder(std::vector<EventNumber_t> const& events) : events_(events) {}
+    virtual EventNumber_t getEventNumberOfEntry(IndexIntoFile::EntryNumber_t entry) const {
+      return events_[entry];
+    }
+  private:
+    std::vector<EventNumber_t> events_;
+  };
+
+  unsigned int const nEventsPerLumi = 1000;
+  unsigned int const nLumisPerRun = 100;
+}
+
+using namespace edmtestindex;
+
+int main(int argc, char* argv[]) {
+
+  std::vector<EventNumber_t>::size_type nEvents = 10000000;
+  if(argc > 1) nEvents = std::atol(argv[1]);
+
+  std::vector<EventNumber_t> events(nEvents);
+  std::srand(1);
+  for(std::vector<EventNumber_t>::size_type i = 0; i < nEvents; ++i) {
+    events[i] = 1 + std::rand() % (4 * nEventsPerLumi);
+  }
+
+  ProcessHistoryID phid;
+  IndexIntoFile indexIntoFile;
+  IndexIntoFile::EntryNumber_t lumiEntry = 0;
+  IndexIntoFile::EntryNumber_t runEntry = 0;
+  RunNumber_t run = 1;
+  LuminosityBlockNumber_t lumi = 1;
+  for(std::vector<EventNumber_t>::size_type i = 0; i < nEvents; ++i) {
+    indexIntoFile.addEntry(phid, run, lumi, events[i], i);
+    if((i + 1) % nEventsPerLumi == 0 || i + 1 == nEvents) {
+      indexIntoFile.addEntry(phid, run, lumi, 0, lumiEntry++);
+      ++lumi;
+      if(lumi > nLumisPerRun || i + 1 == nEvents) {
+        indexIntoFile.addEntry(phid, run, 0, 0, runEntry++);
+        lumi = 1;
+        ++run;
+      }
+    }
+  }
+  indexIntoFile.sortVector_Run_Or_Lumi_Entries();
+  indexIntoFile.setNumberOfEvents(nEvents);
+  indexIntoFile.setEventFinder(boost::shared_ptr<IndexIntoFile::EventFinder>(new VectorEventFinder(events)));
+  indexIntoFile.fillEventEntries();
+
+  edm::CPUTimer timer;
+  long long sum = 0;
+
+  for(int order = 0; order < 2; ++order) {
+    IndexIntoFile::SortOrder sortOrder = order == 0 ? IndexIntoFile::firstAppearanceOrder : IndexIntoFile::numericalOrder;
+    long long nIterated = 0;
+
+    timer.start();
+    for(IndexIntoFile::IndexIntoFileItr it = indexIntoFile.begin(sortOrder),
+                                        itEnd = indexIntoFile.end(sortOrder);
+        it != itEnd; ++it) {
+      if(it.getEntryType() == IndexIntoFile::kEvent) {
+        IndexIntoFile::IndexIntoFileItr position(it);
+        sum += position.run() + position.lumi() + position.entry();
+        ++nIterated;
+      }
+    }
+    timer.stop();
+
+    std::cout << (order == 0 ? "firstAppearanceOrder" : "numericalOrder")
+              << " events " << nIterated
+              << ": real " << timer.realTime() << " cpu " << timer.cpuTime()
+              << " (" << 1e9 * timer.realTime() / nIterated << " ns per event)" << std::endl;
+    timer.reset();
+  }
+  return sum == 0;
+}
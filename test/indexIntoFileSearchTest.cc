@@ -0,0 +1,111 @@
+#include "DataFormats/Provenance/interface/IndexIntoFile.h"
+#include "DataFormats/Provenance/interface/ProcessHistoryID.h"
+#include "FWCore/Utilities/interface/CPUTimer.h"
+
+#include "boost/shared_ptr.hpp"
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+// This program times random IndexIntoFile::findEventPosition lookups in
+// a file with large lumis, first with the binary search over the sorted
+// event numbers of the lumi and then with the EventSearchIndex levels.
+
+// Just running the program prints the timing info to std::cout.
+// The optional arguments set the number of events (default 100000000),
+// the number of events per lumi (default 1000000) and the number of
+// lookups (default 2000000).
+
+using namespace edm;
+
+namespace edmtestindex {
+
+  // The events of a lumi are written in a scrambled order and their
+  // event numbers are odd, so half of the lookups are for missing events.
+  class ScrambledEventFinder : public IndexIntoFile::EventFinder {
+  public:
+    ScrambledEventFinder(long long nEventsPerLumi) : nEventsPerLumi_(nEventsPerLumi) {}
+    virtual EventNumber_t getEventNumberOfEntry(IndexIntoFile::EntryNumber_t entry) const {
+      long long lumiIndex = entry / nEventsPerLumi_;
+      long long i = entry % nEventsPerLumi_;
+      long long scrambled = (i * 7919LL) % nEventsPerLumi_;
+      return static_cast<EventNumber_t>((lumiIndex * nEventsPerLumi_ + scrambled) * 2 + 1);
+    }
+  private:
+    long long nEventsPerLumi_;
+  };
+
+  double timeLookups(IndexIntoFile const& indexIntoFile, std::vector<EventNumber_t> const& events,
+                     long long nEventsPerLumi, long long& nFound) {
+    edm::CPUTimer timer;
+    timer.start();
+    nFound = 0;
+    for(std::vector<EventNumber_t>::const_iterator event = events.begin(); event != events.end(); ++event) {
+      LuminosityBlockNumber_t lumi = 1 + (*event - 1) / 2 / nEventsPerLumi;
+      IndexIntoFile::IndexIntoFileItr iter = indexIntoFile.findEventPosition(1, lumi, *event);
+      if(iter.getEntryType() == IndexIntoFile::kEvent) ++nFound;
+    }
+    timer.stop();
+    return timer.realTime();
+  }
+}
+
+using namespace edmtestindex;
+
+int main(int argc, char* argv[]) {
+
+  long long nEvents = 100000000LL;
+  long long nEventsPerLumi = 1000000LL;
+  long long nLookups = 2000000LL;
+  if(argc > 1) nEvents = std::atoll(argv[1]);
+  if(argc > 2) nEventsPerLumi = std::atoll(argv[2]);
+  if(argc > 3) nLookups = std::atoll(argv[3]);
+  if(nEventsPerLumi % 7919 == 0) ++nEventsPerLumi;
+
+  ProcessHistoryID phid;
+  IndexIntoFile indexIntoFile;
+  IndexIntoFile::EntryNumber_t lumiEntry = 0;
+  LuminosityBlockNumber_t lumi = 1;
+  boost::shared_ptr<IndexIntoFile::EventFinder> finder(new ScrambledEventFinder(nEventsPerLumi));
+  for(long long i = 0; i < nEvents; ++i) {
+    indexIntoFile.addEntry(phid, 1, lumi, finder->getEventNumberOfEntry(i), i);
+    if((i + 1) % nEventsPerLumi == 0 || i + 1 == nEvents) {
+      indexIntoFile.addEntry(phid, 1, lumi, 0, lumiEntry++);
+      ++lumi;
+    }
+  }
+  indexIntoFile.addEntry(phid, 1, 0, 0, 0);
+  indexIntoFile.sortVector_Run_Or_Lumi_Entries();
+  indexIntoFile.setNumberOfEvents(nEvents);
+  indexIntoFile.setEventFinder(finder);
+  indexIntoFile.fillEventNumbers();
+  indexIntoFile.doneFileInitialization();
+
+  std::srand(11);
+  std::vector<EventNumber_t> lookups;
+  lookups.reserve(nLookups);
+  for(long long i = 0; i < nLookups; ++i) {
+    long long r = (static_cast<long long>(std::rand()) * RAND_MAX + std::rand()) % (2 * nEvents);
+    lookups.push_back(static_cast<EventNumber_t>(r + 1));
+  }
+
+  long long nFound = 0;
+  double binarySearch = timeLookups(indexIntoFile, lookups, nEventsPerLumi, nFound);
+  std::cout << "binary search: lookups " << nLookups << " found " << nFound
+            << " real " << binarySearch << " s" << std::endl;
+
+  edm::CPUTimer timer;
+  timer.start();
+  indexIntoFile.fillEventSearchIndex();
+  timer.stop();
+  std::cout << "fillEventSearchIndex: real " << timer.realTime()
+            << " s memory " << indexIntoFile.eventSearchIndex().memoryUsed() / 1000000.0 << " MB" << std::endl;
+
+  long long nFoundWithLevels = 0;
+  double withLevels = timeLookups(indexIntoFile, lookups, nEventsPerLumi, nFoundWithLevels);
+  std::cout << "search index: lookups " << nLookups << " found " << nFoundWithLevels
+            << " real " << withLevels << " s" << std::endl;
+
+  return nFound != nFoundWithLevels;
+}
@@ -0,0 +1,79 @@
+/*
+ *  internedHash_t.cppunit.cc
+ *  CMSSW
+ *
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "DataFormats/Provenance/interface/InternedHash.h"
+#include "DataFormats/Provenance/interface/ParameterSetID.h"
+#include "DataFormats/Provenance/interface/ProcessHistoryID.h"
+
+#include <cstdio>
+#include <string>
+
+class testInternedHash: public CppUnit::TestFixture
+{
+  CPPUNIT_TEST_SUITE(testInternedHash);
+  CPPUNIT_TEST(invalidTest);
+  CPPUNIT_TEST(internTest);
+  CPPUNIT_TEST_SUITE_END();
+
+ public:
+  void setUp(){}
+  void tearDown(){}
+
+  void invalidTest();
+  void internTest();
+};
+
+///registration of the test so that the runner can find it
+CPPUNIT_TEST_SUITE_REGISTRATION(testInternedHash);
+
+namespace {
+  edm::ProcessHistoryID makeID(unsigned int i) {
+    char buffer[33];
+    std::snprintf(buffer, sizeof(buffer), "%08x%08x%08x%08x", i * 2654435761U, i, 0xabcdef12U, i + 1U);
+    return edm::ProcessHistoryID(std::string(buffer));
+  }
+}
+
+void testInternedHash::invalidTest()
+{
+  edm::InternedProcessHistoryID dflt;
+  CPPUNIT_ASSERT(!dflt.isValid());
+  CPPUNIT_ASSERT(dflt.handle() == 0U);
+  CPPUNIT_ASSERT(dflt.hash() == edm::ProcessHistoryID());
+
+  edm::InternedProcessHistoryID fromInvalid((edm::ProcessHistoryID()));
+  CPPUNIT_ASSERT(fromInvalid == dflt);
+
+  edm::InternedParameterSetID psetDflt;
+  CPPUNIT_ASSERT(psetDflt.hash() == edm::ParameterSetID());
+}
+
+void testInternedHash::internTest()
+{
+  unsigned int const sizeBefore = edm::HashInterner<edm::ProcessHistoryType>::instance()->size();
+  // Enough to need more than one chunk of the table
+  unsigned int const n = 10000;
+  for(unsigned int i = 0; i < n; ++i) {
+    edm::InternedProcessHistoryID a(makeID(i));
+    CPPUNIT_ASSERT(a.isValid());
+    CPPUNIT_ASSERT(a.hash() == makeID(i));
+  }
+  CPPUNIT_ASSERT(edm::HashInterner<edm::ProcessHistoryType>::instance()->size() == sizeBefore + n);
+
+  for(unsigned int i = 0; i < n; ++i) {
+    edm::InternedProcessHistoryID a(makeID(i));
+    edm::InternedProcessHistoryID b(makeID(i));
+    CPPUNIT_ASSERT(a == b);
+    CPPUNIT_ASSERT(a.hash() == makeID(i));
+    if(i != 0) {
+      CPPUNIT_ASSERT(a != edm::InternedProcessHistoryID(makeID(i - 1)));
+      CPPUNIT_ASSERT(edm::InternedProcessHistoryID(makeID(i - 1)) < a);
+    }
+  }
+  CPPUNIT_ASSERT(edm::HashInterner<edm::ProcessHistoryType>::instance()->size() == sizeBefore + n);
+}
@@ -0,0 +1,274 @@
+/*
+ *  mergedIndexIntoFile_t.cppunit.cc
+ */
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "DataFormats/Provenance/interface/ProcessHistoryID.h"
+#include "DataFormats/Provenance/interface/ProcessConfiguration.h"
+#include "DataFormats/Provenance/interface/ProcessHistory.h"
+#include "DataFormats/Provenance/interface/ProcessHistoryRegistry.h"
+#include "DataFormats/Provenance/interface/MergedIndexIntoFile.h"
+#include "FWCore/Utilities/interface/EDMException.h"
+
+#include "boost/shared_ptr.hpp"
+
+#include <cstdlib>
+#include <memory>
+#include <set>
+#include <vector>
+
+using namespace edm;
+
+class TestMergedIndexIntoFile: public CppUnit::TestFixture
+{
+  CPPUNIT_TEST_SUITE(TestMergedIndexIntoFile);
+  CPPUNIT_TEST(testMergedOrder);
+  CPPUNIT_TEST(testDuplicates);
+  CPPUNIT_TEST(testInconsistentIndexes);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+
+  void setUp() {
+    ProcessConfiguration pc;
+    std::unique_ptr<ProcessHistory> processHistory1(new ProcessHistory);
+    processHistory1->push_back(pc);
+    ProcessHistoryRegistry::instance()->insertMapped(*processHistory1);
+    fakePHID1 = processHistory1->id();
+
+    std::unique_ptr<ProcessHistory> processHistory2(new ProcessHistory);
+    processHistory2->push_back(pc);
+    processHistory2->push_back(pc);
+    ProcessHistoryRegistry::instance()->insertMapped(*processHistory2);
+    fakePHID2 = processHistory2->id();
+  }
+
+  void tearDown() { }
+
+  void testMergedOrder();
+  void testDuplicates();
+  void testInconsistentIndexes();
+
+  ProcessHistoryID fakePHID1;
+  ProcessHistoryID fakePHID2;
+
+  class TestEventFinder : public IndexIntoFile::EventFinder {
+  public:
+    explicit TestEventFinder() {}
+    virtual ~TestEventFinder() {}
+    virtual EventNumber_t getEventNumberOfEntry(IndexIntoFile::EntryNumber_t entry) const {
+      return testData_.at(entry);
+    }
+    void push_back(EventNumber_t e) {testData_.push_back(e); }
+
+  private:
+    std::vector<EventNumber_t> testData_;
+  };
+
+  // Random runs and lumis, some lumis appearing twice in a run,
+  // with event numbers repeated within and across files.
+  void fillIndex(IndexIntoFile& indexIntoFile, std::vector<ProcessHistoryID> const& phids, unsigned int seed);
+
+  // Three files whose ProcessHistoryIDs appear in different orders
+  void makeFiles(std::vector<boost::shared_ptr<IndexIntoFile> >& files, bool fix);
+};
+
+///registration of the test so that the runner can find it
+CPPUNIT_TEST_SUITE_REGISTRATION(TestMergedIndexIntoFile);
+
+namespace {
+  bool sameEvent(MergedIndexIntoFile::Event const& left, MergedIndexIntoFile::Event const& right) {
+    return left.processHistoryIDIndex() == right.processHistoryIDIndex() &&
+           left.run() == right.run() &&
+           left.lumi() == right.lumi() &&
+           left.event() == right.event();
+  }
+
+  bool lessOrEqual(MergedIndexIntoFile::Event const& left, MergedIndexIntoFile::Event const& right) {
+    if(left.processHistoryIDIndex() != right.processHistoryIDIndex()) {
+      return left.processHistoryIDIndex() < right.processHistoryIDIndex();
+    }
+    if(left.run() != right.run()) return left.run() < right.run();
+    if(left.lumi() != right.lumi()) return left.lumi() < right.lumi();
+    if(left.event() != right.event()) return left.event() < right.event();
+    return left.fileIndex() <= right.fileIndex();
+  }
+}
+
+void TestMergedIndexIntoFile::fillIndex(IndexIntoFile& indexIntoFile,
+                                        std::vector<ProcessHistoryID> const& phids,
+                                        unsigned int seed) {
+  TestEventFinder* ptr(new TestEventFinder);
+  boost::shared_ptr<IndexIntoFile::EventFinder> shptr(ptr);
+  std::srand(seed);
+  IndexIntoFile::EntryNumber_t eventEntry = 0;
+  IndexIntoFile::EntryNumber_t lumiEntry = 0;
+  IndexIntoFile::EntryNumber_t runEntry = 0;
+  for (std::vector<ProcessHistoryID>::const_iterator phid = phids.begin(); phid != phids.end(); ++phid) {
+    for (RunNumber_t run = 1 + std::rand() % 2; run < 4; ++run) {
+      for (int pass = 0; pass < 2; ++pass) {
+        for (LuminosityBlockNumber_t lumi = 1 + std::rand() % 3; lumi < 8; lumi += 1 + std::rand() % 2) {
+          int nEvents = std::rand() % 20;
+          for (int i = 0; i < nEvents; ++i) {
+            EventNumber_t event = 1 + std::rand() % 40;
+            indexIntoFile.addEntry(*phid, run, lumi, event, eventEntry++); // Event
+            ptr->push_back(event);
+          }
+          indexIntoFile.addEntry(*phid, run, lumi, 0, lumiEntry++); // Lumi
+        }
+      }
+      indexIntoFile.addEntry(*phid, run, 0, 0, runEntry++); // Run
+    }
+  }
+  indexIntoFile.sortVector_Run_Or_Lumi_Entries();
+  indexIntoFile.setNumberOfEvents(eventEntry);
+  indexIntoFile.setEventFinder(shptr);
+}
+
+void TestMergedIndexIntoFile::makeFiles(std::vector<boost::shared_ptr<IndexIntoFile> >& files, bool fix) {
+  std::vector<std::vector<ProcessHistoryID> > phids(3);
+  phids[0].push_back(fakePHID1);
+  phids[0].push_back(fakePHID2);
+  phids[1].push_back(fakePHID2);
+  phids[2].push_back(fakePHID2);
+  phids[2].push_back(fakePHID1);
+
+  std::vector<ProcessHistoryID> sourcePHIDs;
+  for (unsigned int i = 0; i < phids.size(); ++i) {
+    files.push_back(boost::shared_ptr<IndexIntoFile>(new IndexIntoFile));
+    fillIndex(*files.back(), phids[i], 100 + i);
+    if (fix) files.back()->fixIndexes(sourcePHIDs);
+  }
+}
+
+void TestMergedIndexIntoFile::testMergedOrder() {
+  std::vector<boost::shared_ptr<IndexIntoFile> > files;
+  makeFiles(files, true);
+  std::vector<IndexIntoFile const*> pointers;
+  for (unsigned int i = 0; i < files.size(); ++i) pointers.push_back(files[i].get());
+
+  MergedIndexIntoFile merged(pointers);
+  std::vector<MergedIndexIntoFile::Event> events;
+  MergedIndexIntoFile::Event event;
+  while (merged.next(event)) {
+    if (!events.empty()) CPPUNIT_ASSERT(lessOrEqual(events.back(), event));
+    events.push_back(event);
+  }
+  CPPUNIT_ASSERT(!merged.next(event));
+
+  // Each file contributes its events in its own numerical order
+  long long nTotal = 0;
+  for (unsigned int i = 0; i < files.size(); ++i) {
+    std::vector<MergedIndexIntoFile::Event>::const_iterator iter = events.begin();
+    for (IndexIntoFile::IndexIntoFileItr it = files[i]->begin(IndexIntoFile::numericalOrder),
+                                         itEnd = files[i]->end(IndexIntoFile::numericalOrder);
+         it != itEnd; ++it) {
+      if (it.getEntryType() != IndexIntoFile::kEvent) continue;
+      while (iter != events.end() && iter->fileIndex() != static_cast<int>(i)) ++iter;
+      CPPUNIT_ASSERT(iter != events.end());
+      CPPUNIT_ASSERT(iter->entry() == it.entry());
+      CPPUNIT_ASSERT(iter->run() == it.run());
+      CPPUNIT_ASSERT(iter->lumi() == it.lumi());
+      CPPUNIT_ASSERT(iter->processHistoryIDIndex() == it.processHistoryIDIndex());
+      ++iter;
+      ++nTotal;
+    }
+    while (iter != events.end() && iter->fileIndex() != static_cast<int>(i)) ++iter;
+    CPPUNIT_ASSERT(iter == events.end());
+  }
+  CPPUNIT_ASSERT(nTotal == static_cast<long long>(events.size()));
+
+  merged.rewind();
+  for (std::vector<MergedIndexIntoFile::Event>::const_iterator iter = events.begin(); iter != events.end(); ++iter) {
+    CPPUNIT_ASSERT(merged.next(event));
+    CPPUNIT_ASSERT(event.fileIndex() == iter->fileIndex() && event.entry() == iter->entry());
+  }
+  CPPUNIT_ASSERT(!merged.next(event));
+
+  // No files and only empty files
+  MergedIndexIntoFile none((std::vector<IndexIntoFile const*>()));
+  CPPUNIT_ASSERT(!none.next(event));
+  IndexIntoFile empty;
+  MergedIndexIntoFile onlyEmpty(std::vector<IndexIntoFile const*>(2, &empty));
+  CPPUNIT_ASSERT(!onlyEmpty.next(event));
+}
+
+void TestMergedIndexIntoFile::testDuplicates() {
+  std::vector<boost::shared_ptr<IndexIntoFile> > files;
+  makeFiles(files, true);
+  std::vector<IndexIntoFile const*> pointers;
+  for (unsigned int i = 0; i < files.size(); ++i) pointers.push_back(files[i].get());
+
+  MergedIndexIntoFile merged(pointers);
+  MergedIndexIntoFile::Event event;
+  CPPUNIT_ASSERT(merged.next(event));
+
+  std::vector<MergedIndexIntoFile::Event> duplicates;
+  merged.findDuplicateEvents(duplicates);
+
+  // Does not disturb the iteration in progress
+  MergedIndexIntoFile::Event second;
+  CPPUNIT_ASSERT(merged.next(second));
+  merged.rewind();
+  CPPUNIT_ASSERT(merged.next(event));
+  CPPUNIT_ASSERT(merged.next(event));
+  CPPUNIT_ASSERT(event.fileIndex() == second.fileIndex() && event.entry() == second.entry());
+
+  // Every duplicate follows an event with the same key in the merged
+  // order, and all but the first event of each key are duplicates.
+  merged.rewind();
+  std::vector<MergedIndexIntoFile::Event> expected;
+  MergedIndexIntoFile::Event previous;
+  bool first = true;
+  while (merged.next(event)) {
+    if (!first && sameEvent(previous, event)) {
+      expected.push_back(event);
+    } else {
+      previous = event;
+    }
+    first = false;
+  }
+  CPPUNIT_ASSERT(!expected.empty());
+  CPPUNIT_ASSERT(duplicates.size() == expected.size());
+  for (unsigned int i = 0; i < duplicates.size(); ++i) {
+    CPPUNIT_ASSERT(duplicates[i].fileIndex() == expected[i].fileIndex());
+    CPPUNIT_ASSERT(duplicates[i].entry() == expected[i].entry());
+  }
+
+  // Every event a later file shares with an earlier one, as found by
+  // the pairwise set_intersection, is reported as a duplicate in the later file.
+  for (unsigned int i = 1; i < files.size(); ++i) {
+    for (unsigned int j = 0; j < i; ++j) {
+      std::set<IndexIntoFile::IndexRunLumiEventKey> intersection;
+      files[j]->set_intersection(*files[i], intersection);
+      for (std::set<IndexIntoFile::IndexRunLumiEventKey>::const_iterator key = intersection.begin();
+           key != intersection.end(); ++key) {
+        bool found = false;
+        for (unsigned int k = 0; k < duplicates.size() && !found; ++k) {
+          found = duplicates[k].fileIndex() == static_cast<int>(i) &&
+                  duplicates[k].processHistoryIDIndex() == key->processHistoryIDIndex() &&
+                  duplicates[k].run() == key->run() &&
+                  duplicates[k].lumi() == key->lumi() &&
+                  duplicates[k].event() == key->event();
+        }
+        CPPUNIT_ASSERT(found);
+      }
+    }
+  }
+}
+
+void TestMergedIndexIntoFile::testInconsistentIndexes() {
+  std::vector<boost::shared_ptr<IndexIntoFile> > files;
+  makeFiles(files, false);
+  std::vector<IndexIntoFile const*> pointers;
+  for (unsigned int i = 0; i < files.size(); ++i) pointers.push_back(files[i].get());
+
+  bool threw = false;
+  try {
+    MergedIndexIntoFile merged(pointers);
+  } catch (edm::Exception const&) {
+    threw = true;
+  }
+  CPPUNIT_ASSERT(threw);
+}
@@ -5,6 +5,7 @@
  */
 
 #include <map>
+#include <sstream>
 #include <string>
 
 #include <cppunit/extensions/HelperMacros.h>
@@ -142,28 +143,42 @@ void testParameterSetID::printTest()
   CPPUNIT_ASSERT(output2 == s2);
 }
 
-#include <iostream>
 void testParameterSetID::oldRootFileCompatibilityTest()
 {
   using namespace edm;
-  //simulate what ROOT does when reading an old ParameterSetID which has 32 characters
+  //simulate what the ROOT I/O rule in classes_def.xml does when reading
+  //a ParameterSetID written before class version 11, which was stored
+  //as a 32 character string
   ParameterSetID dflt(default_id_string);
-  std::string sValue(default_id_string);
-  ParameterSetID* evil(reinterpret_cast<ParameterSetID*>(&sValue));
+  ParameterSetID::bytes_type hash_;
+  hash_detail::toBytes_(hash_.data(), default_id_string);
+  ParameterSetID fromOld(hash_);
+  CPPUNIT_ASSERT(dflt == fromOld);
+  CPPUNIT_ASSERT(fromOld.bytes() == hash_);
+  CPPUNIT_ASSERT(fromOld.isCompactForm());
+  CPPUNIT_ASSERT(fromOld.compactForm().size() == 16);
+
+  //and the same for one stored as a 16 byte string
+  std::string onfile = dflt.compactForm();
+  ParameterSetID::bytes_type compactHash_;
+  hash_detail::toBytes_(compactHash_.data(), onfile);
+  ParameterSetID fromOldCompact(compactHash_);
+  CPPUNIT_ASSERT(dflt == fromOldCompact);
+  CPPUNIT_ASSERT(fromOldCompact.compactForm() == onfile);
+
+  //copies are plain 16 byte copies
+  CPPUNIT_ASSERT(sizeof(ParameterSetID) == 16);
+
+  //a default constructed ID is the invalid MD5 checksum
+  CPPUNIT_ASSERT(ParameterSetID().compactForm() == detail::InvalidHash());
+  CPPUNIT_ASSERT(!ParameterSetID().isValid());
+  CPPUNIT_ASSERT(ParameterSetID(detail::InvalidHash()) == ParameterSetID());
+
+  ParameterSetID copy(fromOld);
+  CPPUNIT_ASSERT(copy == dflt);
+  CPPUNIT_ASSERT(!(copy < dflt));
+  CPPUNIT_ASSERT(!(copy > dflt));
 
-  CPPUNIT_ASSERT(not evil->isCompactForm());
-  CPPUNIT_ASSERT(dflt.isCompactForm());
-
-  ParameterSetID evilCopy(*evil);
-  CPPUNIT_ASSERT(evilCopy.isCompactForm());
-  
-  CPPUNIT_ASSERT(dflt == evilCopy);
-  CPPUNIT_ASSERT(evilCopy == *evil);
-
-  std::cout << dflt<<std::endl;
-  std::cout << evil<<std::endl;
-  CPPUNIT_ASSERT(dflt == *evil);
-  
   /*Do an 'exhaustive' test to see if comparisons are preserved
     in the case of conversion from non-compact to compact form
     and that comparision between non-compact to compact form also 
@@ -198,11 +213,10 @@ void testParameterSetID::oldRootFileCompatibilityTest()
       ParameterSetID theHash(theValue);
       CPPUNIT_ASSERT(theOldHash < theHash);
       
-      ParameterSetID* theEvil(reinterpret_cast<ParameterSetID*>(&theValue));
-      ParameterSetID* theOldEvil(reinterpret_cast<ParameterSetID*>(&theOldValue));
-      CPPUNIT_ASSERT(*theOldEvil < *theEvil);
-      CPPUNIT_ASSERT(*theOldEvil < theHash);
-      CPPUNIT_ASSERT(theOldHash < *theEvil);
+      //ordering must be the same as that of the compact strings
+      CPPUNIT_ASSERT(theOldHash.compactForm() < theHash.compactForm());
+      CPPUNIT_ASSERT(theHash > theOldHash);
+      CPPUNIT_ASSERT(theHash != theOldHash);
       theOldValue = theValue;
       theOldHash = theHash;
     }
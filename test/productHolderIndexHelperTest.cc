@@ -188,5 +188,56 @@ int main() {
   timer.stop();
 
   std::cout <<"index loop time = real "<<timer.realTime()<<" cpu "<<timer.cpuTime()<< std::endl;
+  timer.reset();
+
+  // The same with the hash table
+  edm::ProductHolderIndexHelper hashedPhih;
+  for (auto const& n : vNames) {
+    hashedPhih.insert(TypeWithDict(n.typeID.typeInfo()),
+                      n.label.c_str(),
+                      n.instance.c_str(),
+                      n.process.c_str());
+  }
+  timer.start();
+  hashedPhih.setFrozen(true);
+  timer.stop();
+  std::cout <<"Freezing Time with hash table: real "<<timer.realTime()<<" cpu "<<timer.cpuTime()<< std::endl;
+  timer.reset();
+
+  timer.start();
+  unsigned hashedSum = 0;
+  for (unsigned j = 0; j < 100; ++j) {
+    for (auto & n : vNames) {
+      hashedSum += hashedPhih.index(PRODUCT_TYPE, n.typeID, n.label.c_str(), n.instance.c_str(), n.process.c_str());
+    }
+  }
+  timer.stop();
+
+  std::cout <<"hashed index loop time = real "<<timer.realTime()<<" cpu "<<timer.cpuTime()<< std::endl;
+  if (hashedSum != sum) {
+    std::cout << "ERROR: the hashed lookups found different indexes\n";
+  }
+  timer.reset();
+
+  std::vector<ProductHolderIndexHelper::IndexRequest> requests;
+  requests.reserve(vNames.size());
+  for (auto const& n : vNames) {
+    requests.emplace_back(PRODUCT_TYPE, n.typeID, n.label.c_str(), n.instance.c_str(), n.process.c_str());
+  }
+  std::vector<ProductHolderIndex> results;
+  timer.start();
+  unsigned batchSum = 0;
+  for (unsigned j = 0; j < 100; ++j) {
+    phih.indexes(requests, results);
+    for (auto index : results) {
+      batchSum += index;
+    }
+  }
+  timer.stop();
+
+  std::cout <<"batch index loop time = real "<<timer.realTime()<<" cpu "<<timer.cpuTime()<< std::endl;
+  if (batchSum != sum) {
+    std::cout << "ERROR: the batch lookups found different indexes\n";
+  }
   return sum;
 }
@@ -17,6 +17,10 @@
 
 #include <iostream>
 #include <iomanip>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
 
 static bool alreadyCalledLoader_productHolderIndexHelper_t = false;
 
@@ -28,6 +32,8 @@ class TestProductHolderIndexHelper: public CppUnit::TestFixture
   CPPUNIT_TEST(testCreateEmpty);
   CPPUNIT_TEST(testOneEntry);
   CPPUNIT_TEST(testManyEntries);
+  CPPUNIT_TEST(testHashedLookup);
+  CPPUNIT_TEST(testBatchLookup);
   CPPUNIT_TEST_SUITE_END();
   
 public:
@@ -38,6 +44,8 @@ public:
   void testCreateEmpty();
   void testOneEntry();
   void testManyEntries();
+  void testHashedLookup();
+  void testBatchLookup();
 
   TypeID typeID_ProductID;
   TypeID typeID_EventID;
@@ -221,3 +229,182 @@ void TestProductHolderIndexHelper::testManyEntries() {
   CPPUNIT_ASSERT_THROW(matches.index(2), cms::Exception);
   CPPUNIT_ASSERT(indexC == 27);
 }
+
+namespace {
+
+  // Many labels, instances and processes over a few types, with some
+  // combinations left out, for comparing the different lookups
+  class LookupTestData {
+  public:
+    LookupTestData() {
+      types.push_back(TypeWithDict(typeid(ProductID)));
+      types.push_back(TypeWithDict(typeid(EventID)));
+      types.push_back(TypeWithDict(typeid(std::vector<int>)));
+      types.push_back(TypeWithDict(typeid(std::set<int>)));
+      types.push_back(TypeWithDict(typeid(std::vector<edmtest::SimpleDerived>)));
+
+      for (auto const& type : types) {
+        typeIDs.push_back(TypeID(type.typeInfo()));
+      }
+      typeIDs.push_back(TypeID(typeid(int)));
+      typeIDs.push_back(TypeID(typeid(edmtest::Simple)));
+      typeIDs.push_back(TypeID(typeid(edmtest::SimpleDerived)));
+      typeIDs.push_back(TypeID(typeid(double)));
+
+      for (unsigned int i = 0; i < 40; ++i) {
+        std::ostringstream label;
+        label << "label" << i;
+        labels.push_back(label.str());
+      }
+      labels.push_back("");
+      char const* const allInstances[] = { "", "instanceA", "instanceB", "instance" };
+      instances.assign(allInstances, allInstances + 4);
+      char const* const allProcesses[] = { "HLT", "RECO", "RECO2", "REC" };
+      processes.assign(allProcesses, allProcesses + 4);
+    }
+
+    // Inserts the products in the same order into each helper
+    void fill(edm::ProductHolderIndexHelper& helper) const {
+      for (unsigned int i = 0; i + 1 < labels.size(); ++i) {
+        for (unsigned int j = 0; j < 3; ++j) {
+          for (unsigned int k = 0; k < 3; ++k) {
+            if ((i + j + k) % 4 == 0) continue;
+            TypeWithDict const& type = types[(i + 2 * j + k) % types.size()];
+            helper.insert(type, labels[i].c_str(), instances[j], processes[k]);
+          }
+        }
+      }
+    }
+
+    std::vector<TypeWithDict> types;
+    std::vector<TypeID> typeIDs;
+    std::vector<std::string> labels;
+    std::vector<char const*> instances;
+    std::vector<char const*> processes;
+  };
+}
+
+void TestProductHolderIndexHelper::testHashedLookup() {
+
+  LookupTestData data;
+  std::vector<TypeID> const& typeIDs = data.typeIDs;
+  std::vector<std::string> const& labels = data.labels;
+  std::vector<char const*> const& instances = data.instances;
+  std::vector<char const*> const& processes = data.processes;
+
+  edm::ProductHolderIndexHelper helper;
+  edm::ProductHolderIndexHelper hashedHelper;
+  data.fill(helper);
+  data.fill(hashedHelper);
+  helper.setFrozen();
+  hashedHelper.setFrozen(true);
+  CPPUNIT_ASSERT(!helper.hasHashedLookup());
+  CPPUNIT_ASSERT(hashedHelper.hasHashedLookup());
+
+  unsigned int nFound = 0;
+  KindOfType const kinds[] = { PRODUCT_TYPE, ELEMENT_TYPE };
+  for (auto kind : kinds) {
+    for (auto const& typeID : typeIDs) {
+      for (auto const& label : labels) {
+        for (auto instance : instances) {
+          ProductHolderIndex expected = helper.index(kind, typeID, label.c_str(), instance);
+          CPPUNIT_ASSERT(hashedHelper.index(kind, typeID, label.c_str(), instance) == expected);
+          CPPUNIT_ASSERT(hashedHelper.index(kind, typeID, label.c_str(), instance, "") == expected);
+          for (auto process : processes) {
+            expected = helper.index(kind, typeID, label.c_str(), instance, process);
+            CPPUNIT_ASSERT(hashedHelper.index(kind, typeID, label.c_str(), instance, process) == expected);
+            if (expected != ProductHolderIndexInvalid) ++nFound;
+          }
+          edm::ProductHolderIndexHelper::Matches matches = helper.relatedIndexes(kind, typeID, label.c_str(), instance);
+          edm::ProductHolderIndexHelper::Matches hashedMatches = hashedHelper.relatedIndexes(kind, typeID, label.c_str(), instance);
+          CPPUNIT_ASSERT(matches.numberOfMatches() == hashedMatches.numberOfMatches());
+          for (unsigned int m = 0; m < matches.numberOfMatches(); ++m) {
+            CPPUNIT_ASSERT(matches.index(m) == hashedMatches.index(m));
+          }
+        }
+      }
+    }
+  }
+  CPPUNIT_ASSERT(nFound > 0);
+
+  edm::ProductHolderIndexHelper emptyHelper;
+  emptyHelper.setFrozen(true);
+  CPPUNIT_ASSERT(emptyHelper.index(PRODUCT_TYPE, typeID_ProductID, "labelA", "instanceA", "processA") == ProductHolderIndexInvalid);
+}
+
+void TestProductHolderIndexHelper::testBatchLookup() {
+
+  LookupTestData data;
+
+  // Every combination, including ones that are not there, in an
+  // order unrelated to the sorted order and with repeats
+  std::vector<edm::ProductHolderIndexHelper::IndexRequest> requests;
+  KindOfType const kinds[] = { ELEMENT_TYPE, PRODUCT_TYPE };
+  for (auto const& label : data.labels) {
+    for (auto instance : data.instances) {
+      for (auto kind : kinds) {
+        for (auto const& typeID : data.typeIDs) {
+          requests.emplace_back(kind, typeID, label.c_str(), instance);
+          requests.emplace_back(kind, typeID, label.c_str(), instance, "");
+          for (auto process : data.processes) {
+            requests.emplace_back(kind, typeID, label.c_str(), instance, process);
+          }
+          requests.emplace_back(kind, typeID, label.c_str(), instance, "processA");
+        }
+      }
+    }
+  }
+  std::vector<edm::ProductHolderIndexHelper::IndexRequest> repeated(requests.begin(), requests.begin() + 1000);
+  requests.insert(requests.end(), repeated.begin(), repeated.end());
+
+  for (unsigned int hashed = 0; hashed < 2; ++hashed) {
+    edm::ProductHolderIndexHelper helper;
+    std::vector<ProductHolderIndex> indexes;
+    std::vector<edm::ProductHolderIndexHelper::Matches> matches;
+
+    // Nothing is found without any products
+    edm::ProductHolderIndexHelper emptyHelper;
+    emptyHelper.setFrozen(hashed != 0);
+    emptyHelper.indexes(requests, indexes);
+    emptyHelper.relatedIndexes(requests, matches);
+    CPPUNIT_ASSERT(indexes.size() == requests.size());
+    CPPUNIT_ASSERT(matches.size() == requests.size());
+    for (unsigned int i = 0; i < requests.size(); ++i) {
+      CPPUNIT_ASSERT(indexes[i] == ProductHolderIndexInvalid);
+      CPPUNIT_ASSERT(matches[i].numberOfMatches() == 0);
+    }
+
+    data.fill(helper);
+    helper.setFrozen(hashed != 0);
+    CPPUNIT_ASSERT(helper.hasHashedLookup() == (hashed != 0));
+
+    helper.indexes(requests, indexes);
+    helper.relatedIndexes(requests, matches);
+    CPPUNIT_ASSERT(indexes.size() == requests.size());
+    CPPUNIT_ASSERT(matches.size() == requests.size());
+
+    unsigned int nFound = 0;
+    for (unsigned int i = 0; i < requests.size(); ++i) {
+      edm::ProductHolderIndexHelper::IndexRequest const& request = requests[i];
+      ProductHolderIndex expected = helper.index(request.kindOfType(), request.typeID(),
+                                                 request.moduleLabel(), request.instance(),
+                                                 request.process());
+      CPPUNIT_ASSERT(indexes[i] == expected);
+      if (expected != ProductHolderIndexInvalid) ++nFound;
+
+      edm::ProductHolderIndexHelper::Matches expectedMatches =
+        helper.relatedIndexes(request.kindOfType(), request.typeID(),
+                              request.moduleLabel(), request.instance());
+      CPPUNIT_ASSERT(matches[i].numberOfMatches() == expectedMatches.numberOfMatches());
+      for (unsigned int m = 0; m < expectedMatches.numberOfMatches(); ++m) {
+        CPPUNIT_ASSERT(matches[i].index(m) == expectedMatches.index(m));
+        CPPUNIT_ASSERT(matches[i].isFullyResolved(m) == expectedMatches.isFullyResolved(m));
+      }
+    }
+    CPPUNIT_ASSERT(nFound > 0);
+
+    std::vector<edm::ProductHolderIndexHelper::IndexRequest> none;
+    helper.indexes(none, indexes);
+    CPPUNIT_ASSERT(indexes.empty());
+  }
+}